@@ -0,0 +1,229 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	flowtest.cpp
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Exercises the wbuart's hardware flow control, through the
+//		flowtest.v design, against a UARTSIM with flow control of its
+//	own.  A block of bytes is sent to the design, which echoes them back
+//	out again at a rate set by -d.  The UARTSIM models a host with a
+//	receive buffer of -q bytes, which it empties at a rate set by -r.
+//
+//	Either end may therefore be the slow one.  With RTS/CTS honored, all
+//	of the bytes should come back, in order, with no overflow at either
+//	end, no matter how slow.  The time it takes, compared to the time the
+//	line alone would take, then measures how well the wbuart's FIFOs (of
+//	2^LGFLEN bytes, as flowtest.v was built) keep the line busy.
+//
+//	Options:
+//		-s <setup>	The setup word.  Bit 30 is cleared, to turn on
+//				hardware flow control.  (Default: 25, 8N1)
+//		-n <nbytes>	How many bytes to send (Default: 1024)
+//		-d <clocks>	Clocks between the design's reads of its receive
+//				FIFO (Default: 0, as fast as it can)
+//		-q <depth>	The UARTSIM's receive buffer depth (Default: 16)
+//		-r <clocks>	Clocks between the bytes the host takes from
+//				that buffer (Default: 0, as fast as they come)
+//		-i		Ignore the design's RTS, so as to find out what
+//				overflows without it
+//		-c <clocks>	The clock budget.  (Default: enough for every
+//				byte at the slowest of the line, -d, and -r,
+//				twice over, plus a bit)
+//
+//	The result is a report, ending in PASS or FAIL.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <verilatedos.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "verilated.h"
+#include "Vflowtest.h"
+#include "uartsim.h"
+
+// tick(tb)
+// {{{
+static inline void	tick(Vflowtest *tb) {
+	tb->i_clk = 1;
+	tb->eval();
+	tb->i_clk = 0;
+	tb->eval();
+}
+// }}}
+
+int	main(int argc, char **argv) {
+	Verilated::commandArgs(argc, argv);
+	Vflowtest	tb;
+	unsigned	setup = 25, drain = 0, depth = 16, rate = 0, baudclocks;
+	unsigned long	nbytes = 1024, clocks = 0, maxclocks = 0;
+	bool		ignore_rts = false;
+	char		*msg, *reply;
+	int		first_bad = -1;
+
+	// Argument processing
+	// {{{
+	for(int argn=1; argn<argc; argn++) {
+		if (argv[argn][0] == '-') for(int j=1; (j<1000)&&(argv[argn][j]); j++)
+		switch(argv[argn][j]) {
+			case 's':
+				setup = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'n':
+				nbytes = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'd':
+				drain = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'q':
+				depth = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'r':
+				rate = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'i':
+				ignore_rts = true;
+				break;
+			case 'c':
+				maxclocks = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			default:
+				printf("Undefined option, -%c\n", argv[argn][j]);
+				break;
+		}
+	}
+	// }}}
+
+	setup &= 0x3fffffff;
+	baudclocks = setup & 0x0ffffff;
+	if ((nbytes == 0)||(drain > 0x0ffff)) {
+		fprintf(stderr, "ERR: Bad -n or -d (-d must fit in 16 bits)\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// The bytes to send.  Only the data bits will come back.
+	// {{{
+	msg   = new char[nbytes];
+	reply = new char[nbytes];
+	for(unsigned long k=0; k<nbytes; k++)
+		msg[k] = (char)(k * 7 + 3);
+	memset(reply, 0, nbytes);
+	// }}}
+
+	UARTSIMT<LOOPTRANSPORT>	uart(msg, (int)nbytes, reply, (int)nbytes);
+	unsigned	char_clocks = baudclocks * (2 + (8-((setup>>28)&3))
+				+ ((setup>>26)&1) + ((setup>>27)&1));
+
+	uart.setup(setup);
+	uart.flush_threshold(1);
+	uart.flow_control(depth, rate);
+
+	if (maxclocks == 0) {
+		unsigned long	slowest = char_clocks;
+
+		if (drain + 16 > slowest)
+			slowest = drain + 16;
+		if (rate > slowest)
+			slowest = rate;
+		maxclocks = 2 * slowest * nbytes + 1000 * (unsigned long)char_clocks;
+	}
+
+	// Reset the design, and give it time to set itself up
+	// {{{
+	tb.i_setup  = setup;
+	tb.i_drain  = drain;
+	tb.i_uart_rx = 1;
+	tb.i_cts_n  = 1;
+	tb.i_reset  = 1;
+	for(int k=0; k<4; k++)
+		tick(&tb);
+	tb.i_reset = 0;
+
+	for(unsigned k=0; k<baudclocks*24; k++)
+		tick(&tb);
+	// }}}
+
+	// The test itself
+	// {{{
+	while((uart.host().received() < (int)nbytes)&&(clocks < maxclocks)) {
+		tb.i_cts_n = uart.cts_n();
+		tick(&tb);
+		uart.rts((ignore_rts) ? 0 : tb.o_rts_n);
+		tb.i_uart_rx = uart(tb.o_uart_tx);
+		clocks++;
+	}
+	// }}}
+
+	// Report
+	// {{{
+	UARTSTATS	st = uart.stats();
+	unsigned	mask = (1u << (8-((setup>>28)&3))) - 1;
+	int		nrcvd = uart.host().received();
+
+	if (nrcvd > (int)nbytes)
+		nrcvd = (int)nbytes;
+	for(int k=0; k<nrcvd; k++) {
+		if (((reply[k] ^ msg[k]) & mask) != 0) {
+			first_bad = k;
+			break;
+		}
+	}
+
+	printf("Setup 0x%08x, %lu bytes, read every %u clocks, "
+			"host buffer %u taken every %u clocks%s\n",
+		setup, nbytes, drain, depth, rate,
+		(ignore_rts) ? ", RTS ignored" : "");
+	printf("Received  %d of %lu bytes", uart.host().received(), nbytes);
+	if (first_bad >= 0)
+		printf(", first mismatch at byte %d", first_bad);
+	printf("\n");
+	printf("Clocks    %lu, %.1f%% of the line rate\n", clocks,
+		(clocks > 0) ? 100.0 * (double)uart.host().received()
+			* char_clocks / clocks : 0.0);
+	printf("Stalls    %lu clocks waiting on RTS, %lu with CTS held off\n",
+		st.m_rts_stalls, st.m_cts_stalls);
+	printf("Overflows %lu at the host, %s in the design\n",
+		st.m_overflows, (tb.o_err) ? "some" : "none");
+
+	delete[] msg;
+	delete[] reply;
+
+	if ((uart.host().received() == (int)nbytes)&&(first_bad < 0)
+			&&(st.m_overflows == 0)&&(!tb.o_err)) {
+		printf("PASS\n");
+		exit(EXIT_SUCCESS);
+	}
+
+	printf("FAIL\n");
+	exit(EXIT_FAILURE);
+	// }}}
+}
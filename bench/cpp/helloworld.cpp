@@ -7,6 +7,26 @@
 // Purpose:	To demonstrate a useful Verilog file which could be used as a
 //		toplevel program later, to demo the transmit UART.
 //
+//	Options:
+//		-s <setup>	The setup word (baud rate, parity, etc.)
+//		-c <clocks>	How many clocks to simulate
+//		-p <port>	Send the output to a TCP/IP port, rather than
+//				to stdout
+//		-m		Accept several clients on that port at once,
+//				sending the output to all of them
+//		-q		Talk to the host from a separate thread, so the
+//				simulation never waits on it
+//		-t <file.vcd>	Where to write the trace, rather than
+//				helloworld.vcd
+//		-n		Don't write any trace at all
+//		-T <event>	Only start tracing on the given event: byte,
+//				perr, ferr, error, or =text.  See tracectl.h.
+//		-E <event>	Stop tracing on the given event
+//		-W <clocks>	How many clocks to keep before the start event
+//		-A <clocks>	How many clocks to trace after the start event
+//		-P <clocks>	Report the UARTSIM's statistics to stderr every
+//				<clocks>, and at the end
+//
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
 //
@@ -39,6 +59,7 @@
 // }}}
 #include <verilatedos.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
@@ -46,7 +67,6 @@
 #include <sys/types.h>
 #include <signal.h>
 #include "verilated.h"
-#include "verilated_vcd_c.h"
 #ifdef	USE_UART_LITE
 #include "Vhelloworldlite.h"
 #define	SIMCLASS	Vhelloworldlite
@@ -55,57 +75,108 @@
 #define	SIMCLASS	Vhelloworld
 #endif
 #include "uartsim.h"
+#include "tracectl.h"
+#include "testb.h"
 
 int	main(int argc, char **argv) {
 	Verilated::commandArgs(argc, argv);
-	SIMCLASS	tb;
-	UARTSIM		*uart;
 	int		port = 0;
-	unsigned	setup = 868, clocks = 0, baudclocks;
+	bool		multi = false, threaded = false;
+	unsigned	setup = 868, baudclocks;
+	unsigned long	maxclocks = 0;
+	const char	*vcdfile = "helloworld.vcd",
+			*trace_start = NULL, *trace_stop = NULL;
+	unsigned long	trace_before = 0, trace_after = 0, stats_clocks = 0;
+
+	// Argument processing
+	// {{{
+	for(int argn=1; argn<argc; argn++) {
+		if (argv[argn][0] == '-') for(int j=1; (j<1000)&&(argv[argn][j]); j++)
+		switch(argv[argn][j]) {
+			case 's':
+				setup= strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'c':
+				maxclocks = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'p':
+				port = atoi(argv[++argn]); j+= 4000;
+				break;
+			case 'm':
+				multi = true;
+				break;
+			case 'q':
+				threaded = true;
+				break;
+			case 't':
+				vcdfile = argv[++argn]; j+= 4000;
+				break;
+			case 'n':
+				vcdfile = NULL;
+				break;
+			case 'T':
+				trace_start = argv[++argn]; j+= 4000;
+				break;
+			case 'E':
+				trace_stop = argv[++argn]; j+= 4000;
+				break;
+			case 'W':
+				trace_before = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'A':
+				trace_after = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'P':
+				stats_clocks = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			default:
+				printf("Undefined option, -%c\n", argv[argn][j]);
+				break;
+		}
+	}
+	// }}}
 
 	// Set our baud rate
 	// {{{
-	tb.i_setup = setup;
-	uart = new UARTSIM(port);
-	uart->setup(tb.i_setup);
-	baudclocks = tb.i_setup & 0xfffffff;
+	TESTB<SIMCLASS, UARTSIM, TRACECTL>	tb(port, multi, threaded);
+
+	tb.m_core.i_setup = setup;
+	tb.m_uart.setup(tb.m_core.i_setup);
+	if (stats_clocks > 0) {
+		tb.m_uart.profile(true);
+		tb.m_uart.stats_every(stats_clocks);
+	}
+	baudclocks = tb.m_core.i_setup & 0xfffffff;
+	if (maxclocks == 0)
+		maxclocks = 16*32*baudclocks;
 	// }}}
 
 	// Setup a VCD trace
 	// {{{
-#define	VCDTRACE
-#ifdef	VCDTRACE
-	Verilated::traceEverOn(true);
-	VerilatedVcdC* tfp = new VerilatedVcdC;
-	tb.trace(tfp, 99);
-	tfp->open("helloworld.vcd");
-#define	TRACE_POSEDGE	tfp->dump(10*clocks)
-#define	TRACE_NEGEDGE	tfp->dump(10*clocks+5)
-#define	TRACE_CLOSE	tfp->close()
-#else
-#define	TRACE_POSEDGE
-#define	TRACE_NEGEDGE
-#define	TRACE_CLOSE
-#endif
+	TRACECTL	trace((vcdfile) ? vcdfile : "helloworld.vcd");
+	if (vcdfile) {
+		if ((trace_start)&&(!trace.start_on(trace_start))) {
+			fprintf(stderr, "ERR: Unknown trace event, %s\n", trace_start);
+			exit(EXIT_FAILURE);
+		}
+
+		if ((trace_stop)&&(!trace.stop_on(trace_stop))) {
+			fprintf(stderr, "ERR: Unknown trace event, %s\n", trace_stop);
+			exit(EXIT_FAILURE);
+		}
+		trace.window(trace_before, trace_after);
+		tb.trace(&trace);
+	}
 	// }}}
 
 	// Main simulation loop
 	// {{{
-	clocks = 0;
-	while(clocks < 16*32*baudclocks) {
-
-		tb.i_clk = 1;
-		tb.eval();
-		TRACE_POSEDGE;
-		tb.i_clk = 0;
-		tb.eval();
-		TRACE_NEGEDGE;
-
-		(*uart)(tb.o_uart_tx);
-		clocks++;
-	}
+	while(tb.clocks() < maxclocks)
+		tb.tick();
 	// }}}
 
-	TRACE_CLOSE;
+	tb.close();
+	if (stats_clocks > 0)
+		tb.m_uart.stats_dump();
 	printf("\n\nSimulation complete\n");
 }
@@ -0,0 +1,398 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	linesweep.cpp
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Runs the linetest loopback across every framing the UART
+//		supports--five to eight data bits, no parity, odd, even, space,
+//	or mark parity, and one or two stop bits--at each of a range of baud
+//	rates, and reports which combinations passed as a matrix.
+//
+//	For each combination, a test string is sent into the linetest design
+//	from the UARTSIM, and must come back out again (limited to the number
+//	of data bits) within a budget of simulated clocks.
+//
+//	The combinations are handed out to a pool of worker processes, one per
+//	core by default, as each worker becomes free.  Each worker builds one
+//	copy of the Verilated design and then reuses it for every combination
+//	it's given, resetting it (via i_reset) and changing its i_setup rather
+//	than building a new one each time.
+//
+//	The exit status will be EXIT_SUCCESS only if every combination passes.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <verilatedos.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "verilated.h"
+#include "Vlinetest.h"
+#include "uartsim.h"
+
+#define	MAXBAUDS	32
+#define	MAXMSG		256
+
+// Every framing:  4 data widths, 5 parity modes, and 2 stop bit settings
+#define	NFRAMINGS	(4*5*2)
+
+void	usage(void) {
+// {{{
+	fprintf(stderr, "USAGE: linesweep [-j <jobs>] [-b <clocks>] [-v]\n");
+	fprintf(stderr, "\n"
+"\tRuns the linetest loopback across every framing, and several baud\n"
+"\trates, in parallel, and reports a matrix of the results.\n"
+"\n"
+"\t-j <jobs>\tRuns this many worker processes.  (Default: one per core)\n"
+"\t-b <clocks>\tTests this number of clocks per baud, rather than the\n"
+"\t\tdefault set of 25, 50, 100, 217, and 868.  May be repeated.\n"
+"\t-v\tDescribes each failure, following the matrix\n\n");
+}
+// }}}
+
+// framing_bits(k), framing_name(bits, str)
+// {{{
+// Returns bits [29:24] of the setup word for framing number k
+static unsigned	framing_bits(unsigned k) {
+	static const unsigned	parity[5] = { 0, 4, 5, 6, 7 };
+	unsigned	width = k / 10, par = (k/2) % 5, stop = k & 1;
+
+	return (width << 28) | (stop << 27) | (parity[par] << 24);
+}
+
+// Describes a framing in the usual form, as in 8N1 or 7E2
+static void	framing_name(unsigned bits, char *str) {
+	static const char	pname[8] = { 'N', 'N', 'N', 'N', 'O', 'E', 'S', 'M' };
+
+	sprintf(str, "%d%c%d", 8-((bits >> 28)&3), pname[(bits >> 24)&7],
+		((bits >> 27)&1)+1);
+}
+// }}}
+
+// SWEEPRESULT
+// {{{
+// What a worker sends back for each combination it's given.  It's kept
+// small enough to be written to a pipe in one piece.
+typedef	struct {
+	unsigned	m_index;
+	int		m_received, m_first_bad;
+	unsigned long	m_clocks;
+} SWEEPRESULT;
+// }}}
+
+// tick(tb)
+// {{{
+static inline void	tick(Vlinetest *tb) {
+	tb->i_clk = 1;
+	tb->eval();
+	tb->i_clk = 0;
+	tb->eval();
+}
+// }}}
+
+// loopback(tb, setup, msg, len, result)
+// {{{
+// Resets the design to the given setup, sends it msg, and compares what comes
+// back.
+static void	loopback(Vlinetest *tb, unsigned setup, const char *msg, int len,
+		SWEEPRESULT &result) {
+	char		reply[MAXMSG];
+	unsigned	baudclocks = setup & 0x0ffffff, mask;
+	unsigned long	clocks = 0, maxclocks;
+	unsigned	uart_idle = 0, uart_skipped = 0;
+	int		last_tx = 1, rx = 1;
+
+	// Reset the design, with its new setup
+	// {{{
+	tb->i_setup   = setup;
+	tb->i_uart_rx = 1;
+	tb->i_reset   = 1;
+	for(int k=0; k<4; k++)
+		tick(tb);
+	tb->i_reset = 0;
+
+	// Clear any initial break condition, as linetest does
+	for(unsigned k=0; k<baudclocks*24; k++)
+		tick(tb);
+	// }}}
+
+	UARTSIMT<LOOPTRANSPORT>	uart(msg, len, reply, (int)sizeof(reply));
+	uart.setup(setup);
+	uart.flush_threshold(1);
+
+	// As with linetest, allow enough time for the message to go out and
+	// come back, at 16 baud intervals per character
+	maxclocks = 2ul*(baudclocks*16)*len;
+
+	while((uart.host().received() < len)&&(clocks < maxclocks)) {
+		tick(tb);
+		clocks++;
+
+		// Only step the UART when something might happen
+		if ((uart_idle > 0)&&(tb->o_uart_tx == last_tx)) {
+			uart_idle--;
+			uart_skipped++;
+		} else {
+			uart.skip(uart_skipped);
+			uart_skipped = 0;
+			rx = uart(tb->o_uart_tx);
+			last_tx = tb->o_uart_tx;
+			uart_idle = uart.next_event_clocks();
+		}
+
+		tb->i_uart_rx = rx;
+	}
+
+	uart.skip(uart_skipped);
+	uart.flush();
+
+	// Only the data bits can come back
+	mask = (1u << (8-((setup >> 28)&3)))-1;
+
+	result.m_received  = uart.host().received();
+	result.m_clocks    = clocks;
+	result.m_first_bad = -1;
+	for(int k=0; k<len; k++) {
+		if ((k >= result.m_received)||(k >= (int)sizeof(reply))
+				||((reply[k] & mask) != (msg[k] & mask))) {
+			result.m_first_bad = k;
+			break;
+		}
+	}
+}
+// }}}
+
+// worker(work_fd, result_fd, setups, msg)
+// {{{
+// Takes combination numbers from work_fd, one at a time, until there are no
+// more, and writes a SWEEPRESULT for each to result_fd
+static void	worker(int work_fd, int result_fd, const unsigned *setups,
+		const char *msg) {
+	Vlinetest	*tb = new Vlinetest;
+	unsigned	index;
+	int		len = strlen(msg);
+
+	while(read(work_fd, &index, sizeof(index)) == sizeof(index)) {
+		SWEEPRESULT	result;
+
+		result.m_index = index;
+		loopback(tb, setups[index], msg, len, result);
+		if (write(result_fd, &result, sizeof(result)) != sizeof(result))
+			break;
+	}
+
+	tb->final();
+	delete tb;
+}
+// }}}
+
+int	main(int argc, char **argv) {
+	Verilated::commandArgs(argc, argv);
+	const char	*msg = "This is a UART testing string\r\n";
+	unsigned	bauds[MAXBAUDS], nbauds = 0, ncombos, npass = 0;
+	unsigned	*setups;
+	SWEEPRESULT	*results;
+	bool		*done, verbose = false;
+	int		njobs = 0, work[2], res[2];
+	pid_t		*pids;
+
+	// Argument processing
+	// {{{
+	for(int argn=1; argn<argc; argn++) {
+		if ((argv[argn][0] == '-')&&(argv[argn][2] == '\0')
+				&&(strchr("jb", argv[argn][1]))
+				&&(argn+1 >= argc)) {
+			usage();
+			exit(EXIT_FAILURE);
+		} else if (strcmp(argv[argn], "-j") == 0) {
+			njobs = atoi(argv[++argn]);
+		} else if (strcmp(argv[argn], "-b") == 0) {
+			unsigned	b = strtoul(argv[++argn], NULL, 0);
+
+			if ((b < 1)||(b > 0x0ffffff)) {
+				fprintf(stderr, "Bad baud clock count, %s\n",
+					argv[argn]);
+				exit(EXIT_FAILURE);
+			} else if (nbauds < MAXBAUDS)
+				bauds[nbauds++] = b;
+		} else if (strcmp(argv[argn], "-v") == 0) {
+			verbose = true;
+		} else {
+			usage();
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (nbauds == 0) {
+		bauds[nbauds++] = 25;
+		bauds[nbauds++] = 50;
+		bauds[nbauds++] = 100;
+		bauds[nbauds++] = 217;
+		bauds[nbauds++] = 868;
+	}
+
+	if (njobs <= 0)
+		njobs = sysconf(_SC_NPROCESSORS_ONLN);
+	if (njobs <= 0)
+		njobs = 1;
+	// }}}
+
+	// Every combination, framing major
+	// {{{
+	ncombos = NFRAMINGS * nbauds;
+	if ((unsigned)njobs > ncombos)
+		njobs = ncombos;
+
+	setups  = new unsigned[ncombos];
+	results = new SWEEPRESULT[ncombos];
+	done    = new bool[ncombos];
+	pids    = new pid_t[njobs];
+	for(unsigned f=0; f<NFRAMINGS; f++)
+	for(unsigned b=0; b<nbauds; b++) {
+		setups[f*nbauds+b] = framing_bits(f) | bauds[b];
+		done[f*nbauds+b] = false;
+	}
+	// }}}
+
+	// Queue up the work, and start the workers
+	// {{{
+	// All of the combination numbers are written into a pipe up front.
+	// Each worker then reads the next number from it whenever it's free,
+	// so the slow (high clocks per baud) combinations don't all end up
+	// waiting on the same worker.
+	if ((pipe(work) != 0)||(pipe(res) != 0)) {
+		perror("O/S ERR: pipe");
+		exit(EXIT_FAILURE);
+	}
+
+	for(unsigned k=0; k<ncombos; k++) {
+		if (write(work[1], &k, sizeof(k)) != sizeof(k)) {
+			perror("O/S ERR: queueing work");
+			exit(EXIT_FAILURE);
+		}
+	} close(work[1]);
+
+	fflush(stdout);
+	for(int w=0; w<njobs; w++) {
+		pids[w] = fork();
+		if (pids[w] < 0) {
+			perror("O/S ERR: fork");
+			exit(EXIT_FAILURE);
+		} else if (pids[w] == 0) {
+			close(res[0]);
+			worker(work[0], res[1], setups, msg);
+			exit(EXIT_SUCCESS);
+		}
+	}
+
+	close(work[0]);
+	close(res[1]);
+	// }}}
+
+	// Collect the results, until every worker has closed its end
+	// {{{
+	{
+		SWEEPRESULT	r;
+		ssize_t		nr;
+
+		while(((nr = read(res[0], &r, sizeof(r))) == sizeof(r))
+				||((nr < 0)&&(errno == EINTR))) {
+			if ((nr > 0)&&(r.m_index < ncombos)) {
+				results[r.m_index] = r;
+				done[r.m_index] = true;
+			}
+		}
+		close(res[0]);
+
+		for(int w=0; w<njobs; w++)
+			waitpid(pids[w], NULL, 0);
+	}
+	// }}}
+
+	// Report the pass/fail matrix
+	// {{{
+	printf("Framing");
+	for(unsigned b=0; b<nbauds; b++)
+		printf(" %8u", bauds[b]);
+	printf("\n");
+
+	for(unsigned f=0; f<NFRAMINGS; f++) {
+		char	name[8];
+
+		framing_name(framing_bits(f), name);
+		printf("%-7s", name);
+		for(unsigned b=0; b<nbauds; b++) {
+			unsigned	k = f*nbauds+b;
+			bool	pass = (done[k])&&(results[k].m_first_bad < 0);
+
+			if (pass)
+				npass++;
+			printf(" %8s", (!done[k]) ? "----" : (pass) ? "PASS":"FAIL");
+		} printf("\n");
+	}
+
+	if (verbose) {
+		printf("\n");
+		for(unsigned k=0; k<ncombos; k++) {
+			char	name[8];
+
+			if ((done[k])&&(results[k].m_first_bad < 0))
+				continue;
+
+			framing_name(setups[k], name);
+			if (!done[k])
+				printf("%s @ %u: never run\n", name,
+					setups[k] & 0x0ffffff);
+			else
+				printf("%s @ %u: received %d of %d characters in %lu clocks, first bad character at %d\n",
+					name, setups[k] & 0x0ffffff,
+					results[k].m_received, (int)strlen(msg),
+					results[k].m_clocks,
+					results[k].m_first_bad);
+		}
+	}
+
+	printf("\n%u of %u combinations passed\n%s\n", npass, ncombos,
+		(npass == ncombos) ? "PASS" : "FAIL");
+	// }}}
+
+	delete[] setups;
+	delete[] results;
+	delete[] done;
+	delete[] pids;
+
+	return (npass == ncombos) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -9,12 +9,41 @@
 //
 //	If you run this program with no arguments, it will run an automatic
 //	test, returning "PASS" on success, or "FAIL" on failure as a last
-//	output line--hence it should support automated testing.
+//	output line--hence it should support automated testing.  Along the
+//	way, a SCOREBOARD (scoreboard.h) checks every character each way, as
+//	it goes, against the UARTSIM.  The first that differs, arrives late,
+//	or never arrives at all ends the test, with a report of the clock and
+//	bit where it went wrong--so that no trace is needed to find it.
 //
 //	If you run with a '-i' argument, the program will run interactively.
 //	It will then be up to you to determine if it works (or not).  As
 //	always, it may be killed with a control C.
 //
+//	Other options:
+//		-s <setup>	The setup word (baud rate, parity, etc.)
+//		-c <clocks>	How many clocks the automatic test may take
+//		-p <port>	Run interactively, through a TCP/IP port rather
+//				than stdin and stdout
+//		-m		Accept several clients on that port at once.
+//				All of them see the output, the first to
+//				connect provides the input.
+//		-q		Talk to the host from a separate thread, so the
+//				simulation never waits on it
+//		-t <file.vcd>	Where to write the trace, rather than
+//				linetest.vcd
+//		-n		Don't write any trace at all
+//		-T <event>	Only start tracing on the given event: byte,
+//				perr, ferr, error, or =text.  See tracectl.h.
+//		-E <event>	Stop tracing on the given event
+//		-W <clocks>	How many clocks to keep before the start event
+//		-A <clocks>	How many clocks to trace after the start event
+//
+//	Built with FRACTIONAL_BAUD defined, this tests Vlinetestfrac instead:
+//	the same design, with LGFRAC=4 fractional bits in its baud rate.  The
+//	baud field of the setup is then in sixteenths of a clock, and the
+//	default is 8.5 clocks per baud--a rate that whole clocks can't come
+//	within tolerance of.
+//
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
 //
@@ -58,20 +87,37 @@
 #ifdef	USE_UART_LITE
 #include "Vlinetestlite.h"
 #define	SIMCLASS	Vlinetestlite
+#elif	defined(FRACTIONAL_BAUD)
+#include "Vlinetestfrac.h"
+#define	SIMCLASS	Vlinetestfrac
+// As Vlinetestfrac was built
+#define	LGFRAC		4
 #else
 #include "Vlinetest.h"
 #define	SIMCLASS	Vlinetest
 #endif
-#include "verilated_vcd_c.h"
 #include "uartsim.h"
+#include "tracectl.h"
+#include "testb.h"
+#include "scoreboard.h"
+
+#ifndef	LGFRAC
+#define	LGFRAC		0
+#define	DEFAULT_SETUP	868
+#else
+#define	DEFAULT_SETUP	(17 << (LGFRAC-1))	// 8.5 clocks per baud
+#endif
 
 int	main(int argc, char **argv) {
 	Verilated::commandArgs(argc, argv);
-	SIMCLASS	tb;
-	UARTSIM		*uart;
 	bool		run_interactively = false;
 	int		port = 0;
-	unsigned	setup = 868;
+	bool		multi = false, threaded = false;
+	unsigned	setup = DEFAULT_SETUP;
+	unsigned long	maxclocks = 0;
+	const char	*vcdfile = "linetest.vcd",
+			*trace_start = NULL, *trace_stop = NULL;
+	unsigned long	trace_before = 0, trace_after = 0;
 	char string[] = "This is a UART testing string\r\n";
 
 	// Argument processing
@@ -83,12 +129,39 @@ int	main(int argc, char **argv) {
 				run_interactively = true;
 				break;
 			case 'p':
-				port = atoi(argv[argn++]); j+= 4000;
+				port = atoi(argv[++argn]); j+= 4000;
 				run_interactively = true;
 				break;
+			case 'm':
+				multi = true;
+				break;
+			case 'q':
+				threaded = true;
+				break;
 			case 's':
 				setup= strtoul(argv[++argn], NULL, 0); j+= 4000;
 				break;
+			case 'c':
+				maxclocks = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 't':
+				vcdfile = argv[++argn]; j+= 4000;
+				break;
+			case 'n':
+				vcdfile = NULL;
+				break;
+			case 'T':
+				trace_start = argv[++argn]; j+= 4000;
+				break;
+			case 'E':
+				trace_stop = argv[++argn]; j+= 4000;
+				break;
+			case 'W':
+				trace_before = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'A':
+				trace_after = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
 			default:
 				printf("Undefined option, -%c\n", argv[argn][j]);
 				break;
@@ -98,64 +171,47 @@ int	main(int argc, char **argv) {
 
 	// Setup the baud rate
 	// {{{
-	tb.i_setup = setup;
-	int baudclocks = setup & 0x0ffffff;
-	tb.i_uart_rx = 1;
+	int baudclocks = (setup & 0x0ffffff) >> LGFRAC;
+
+	// By default, simulate long enough to send the string twice over,
+	// at 16 baud intervals per character
+	if (maxclocks == 0)
+		maxclocks = 2*(baudclocks*16)*strlen(string);
 	// }}}
 
 	if (run_interactively) {
 		// {{{
-		uart = new UARTSIM(port);
-		uart->setup(tb.i_setup);
+		TESTB<SIMCLASS>	tb(port, multi, threaded);
 
-		while(1) {
+		tb.m_core.i_setup = setup;
+		tb.m_core.i_uart_rx = 1;
+		tb.m_uart.fractional(LGFRAC);
+		tb.m_uart.setup(setup);
 
-			tb.i_clk = 1;
-			tb.eval();
-			tb.i_clk = 0;
-			tb.eval();
-
-			tb.i_uart_rx = (*uart)(tb.o_uart_tx);
-		}
+		while(1)
+			tb.tick();
 		// }}}
 	} else {
-		// Set up a child process
-		// {{{
-		int	childs_stdin[2], childs_stdout[2];
-
-		if ((pipe(childs_stdin)!=0)||(pipe(childs_stdout) != 0)) {
-			fprintf(stderr, "ERR setting up child pipes\n");
-			perror("O/S ERR");
-			printf("TEST FAILURE\n");
-			exit(EXIT_FAILURE);
-		}
-
-		pid_t childs_pid = fork();
+		int	to_child, from_child;
+		pid_t	childs_pid = testb_fork(to_child, from_child);
 
 		if (childs_pid < 0) {
 			fprintf(stderr, "ERR setting up child process\n");
-			perror("O/S ERR");
 			printf("TEST FAILURE\n");
 			exit(EXIT_FAILURE);
 		}
-		// }}}
 
 		if (childs_pid) { // The parent, feeding the simulation
 			// {{{
 			int	nr=-2, nw;
-
-			// We are the parent
-			close(childs_stdin[ 0]); // Close the read end
-			close(childs_stdout[1]); // Close the write end
-
 			char test[256];
 
-			nw = write(childs_stdin[1], string, strlen(string));
+			nw = write(to_child, string, strlen(string));
 			if (nw == (int)strlen(string)) {
 				int	rpos = 0;
 				test[0] = '\0';
 				while((rpos<nw)
-					&&(0<(nr=read(childs_stdout[0],
+					&&(0<(nr=read(from_child,
 						&test[rpos], strlen(string)-rpos))))
 					rpos += nr;
 				
@@ -165,30 +221,28 @@ int	main(int argc, char **argv) {
 				printf("Successfully read %d characters: %s\n", nr, test);
 			}
 
-			int	status = 0, rv = -1;
+			int	status = 0, rv;
 
-			// Give the child the oppoortunity to take another
-			// 60 seconds to finish closing itself
-			for(int waitcount=0; waitcount < 60; waitcount++) {
-				rv = waitpid(-1, &status, WNOHANG);
-				if (rv == childs_pid)
-					break;
-				else if (rv < 0)
-					break;
-				else // rv == 0
-					sleep(1);
-			}
+			// The child stops on its own once it has simulated
+			// maxclocks, so there's no need to poll for it.  Just
+			// wait.
+			rv = waitpid(childs_pid, &status, 0);
 
 			if (rv != childs_pid) {
 				kill(childs_pid, SIGTERM);
 				printf("WARNING: Child/simulator did not terminate normally\n");
 			}
 
-			if (WEXITSTATUS(status) != EXIT_SUCCESS) {
+			bool	child_ok = (rv == childs_pid)
+					&&(WIFEXITED(status))
+					&&(WEXITSTATUS(status) == EXIT_SUCCESS);
+			if (!child_ok) {
 				printf("WARNING: Child/simulator exit status does not indicate success\n");
 			}
 
-			if ((nr == nw)&&(nw == (int)strlen(string))
+			// The child fails if its scoreboard found anything
+			// wrong along the way
+			if ((child_ok)&&(nr == nw)&&(nw == (int)strlen(string))
 					&&(strcmp(test, string) == 0)) {
 				printf("PASS!\n");
 				exit(EXIT_SUCCESS);
@@ -200,122 +254,70 @@ int	main(int argc, char **argv) {
 		} else { // The child (Verilator simulation)
 			// {{{
 
-			// Fix up the FILE I/O
-			// {{{
-			close(childs_stdin[ 1]);
-			close(childs_stdout[0]);
-			close(STDIN_FILENO);
-			if (dup(childs_stdin[0]) < 0) {
-				fprintf(stderr, "ERR setting up child FD\n");
-				perror("O/S ERR");
-				exit(EXIT_FAILURE);
-			}
-			close(STDOUT_FILENO); 
-			if (dup(childs_stdout[1]) < 0) {
-				fprintf(stderr, "ERR setting up child FD\n");
-				perror("O/S ERR");
-				exit(EXIT_FAILURE);
-			}
+			// UARTSIM(0) uses stdin and stdout for its FD's, which
+			// testb_fork() has already connected to our parent
+			TESTB<SIMCLASS, UARTSIM, TRACECTL>	tb(0);
+			SCOREBOARD	sb(setup, LGFRAC);
 
-			// UARTSIM(0) uses stdin and stdout for its FD's
-			uart = new UARTSIM(0);
-			uart->setup(tb.i_setup);
-			// }}}
+			tb.m_core.i_setup = setup;
+			tb.m_core.i_uart_rx = 1;
+			tb.m_uart.fractional(LGFRAC);
+			tb.m_uart.setup(setup);
 
-			// Make sure we don't run longer than 4 seconds ...
+			// Make sure we don't run longer than 60 seconds ...
 			time_t	start = time(NULL);
 			int	iterations_before_check = 2048;
-			unsigned	clocks = 0;
 			bool	done = false;
 
 			// VCD trace setup
 			// {{{
-#define	VCDTRACE
-#ifdef	VCDTRACE
-			Verilated::traceEverOn(true);
-			VerilatedVcdC* tfp = new VerilatedVcdC;
-			tb.trace(tfp, 99);
-			tfp->open("linetest.vcd");
-#define	TRACE_POSEDGE	tfp->dump(10*clocks)
-#define	TRACE_NEGEDGE	tfp->dump(10*clocks+5)
-#define	TRACE_CLOSE	tfp->close()
-#else
-#define	TRACE_POSEDGE	while(0)
-#define	TRACE_NEGEDGE	while(0)
-#define	TRACE_CLOSE	while(0)
-#endif
+			TRACECTL	trace((vcdfile) ? vcdfile : "linetest.vcd");
+			if (vcdfile) {
+				if ((trace_start)&&(!trace.start_on(trace_start))) {
+					fprintf(stderr, "ERR: Unknown trace event, %s\n", trace_start);
+					exit(EXIT_FAILURE);
+				}
+
+				if ((trace_stop)&&(!trace.stop_on(trace_stop))) {
+					fprintf(stderr, "ERR: Unknown trace event, %s\n", trace_stop);
+					exit(EXIT_FAILURE);
+				}
+				trace.window(trace_before, trace_after);
+				tb.trace(&trace);
+			}
 			// }}}
 
 			// Clear any initial break condition
 			// {{{
-			for(int i=0; i<(baudclocks*24); i++) {
-				tb.i_clk = 1;
-				tb.eval();
-				tb.i_clk = 0;
-				tb.eval();
-
-				tb.i_uart_rx = 1;
-			}
+			for(int i=0; i<(baudclocks*24); i++)
+				tb.clock();
 			// }}}
 
 			// Simulation loop: process the hello world string
 			// {{{
-			while(clocks < 2*(baudclocks*16)*strlen(string)) {
-				tb.i_clk = 1;
-				tb.eval();
-				TRACE_POSEDGE;
-				tb.i_clk = 0;
-				tb.eval();
-				TRACE_NEGEDGE;
-				clocks++;
-
-				tb.i_uart_rx = (*uart)(tb.o_uart_tx);
-
-				if (false) { // Used only for debugging
-					// {{{
-					/*
-					static long counts = 0;
-					static int lasti = 1, lasto = 1;
-					bool	writeout = false;
-
-					counts++;
-					if (lasti != tb.i_uart) {
-						writeout = true;
-						lasti = tb.i_uart;
-					} if (lasto != tb.o_uart) {
-						writeout = true;
-						lasto = tb.o_uart;
-					}
-
-					if (writeout) {
-					fprintf(stderr, "%08lx : [%d -> %d] %02x:%02x (%02x/%d) %d,%d->%02x [%2d/%d/%08x]\n",
-						counts, tb.i_uart, tb.o_uart,
-						tb.v__DOT__head,
-						tb.v__DOT__tail,
-						tb.v__DOT__lineend,
-						tb.v__DOT__run_tx,
-						tb.v__DOT__tx_stb,
-						tb.v__DOT__transmitter__DOT__r_busy,
-						tb.v__DOT__tx_data & 0x0ff,
-						tb.v__DOT__transmitter__DOT__state,
-						tb.v__DOT__transmitter__DOT__zero_baud_counter,
-						tb.v__DOT__transmitter__DOT__baud_counter);
-					} */
-					// }}}
-				}
+			for(unsigned long k=0; k<maxclocks; k++) {
+				tb.tick();
+				if (!sb.check(tb.m_core, tb.m_uart,
+						tb.clocks()))
+					break;
 
 				if (iterations_before_check-- <= 0) {
 					iterations_before_check = 2048;
 					done = ((time(NULL)-start)>60);
-					if (done)
-					fprintf(stderr, "CHILD-TIMEOUT\n");
+					if (done) {
+						fprintf(stderr, "CHILD-TIMEOUT\n");
+						break;
+					}
 				}
 			}
 			// }}}
 
-			TRACE_CLOSE;
+			// Send anything still waiting in the UARTSIM's
+			// buffers to our parent
+			tb.close();
+			sb.report();
 
-			exit(EXIT_SUCCESS);
+			exit((done)||(sb.failed()) ? EXIT_FAILURE : EXIT_SUCCESS);
 			// }}}
 		}
 	}
@@ -0,0 +1,277 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	losstest.cpp
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Measures how much of a bursty stream is lost to receive FIFO
+//		overflow, at each of several FIFO depths.  flowtest.v, built
+//	with FIFOs of 2^4, 2^10, and 2^15 bytes (Vflowlg4, Vflowlg10, and
+//	Vflowlg15), echoes everything it receives, reading its receive FIFO
+//	only once every -d clocks--slower than the line.  Hardware flow control
+//	is turned off, so nothing holds the sender back.  The UARTSIM then
+//	sends bursts of -B bytes at the full line rate, one every -p clocks.
+//	On average, the design keeps up--but during each burst its receive
+//	FIFO fills, and whatever doesn't fit is lost.  The bytes that come
+//	back measure the loss.
+//
+//	Options:
+//		-s <setup>	The setup word.  Bit 30 is set, to turn off
+//				hardware flow control.  (Default: 25, 8N1)
+//		-B <bytes>	Bytes per burst (Default: 4096)
+//		-N <bursts>	How many bursts (Default: 4)
+//		-d <clocks>	Clocks between the design's reads of its receive
+//				FIFO (Default: two characters' worth)
+//		-p <clocks>	Clocks from the start of one burst to the next
+//				(Default: long enough to empty the FIFO twice
+//				over at the -d rate)
+//
+//	The result is a table of the loss at each depth.  It passes if no
+//	deeper FIFO ever loses more than a shallower one, and if a FIFO deeper
+//	than the burst loses nothing.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <verilatedos.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "verilated.h"
+#include "Vflowlg4.h"
+#include "Vflowlg10.h"
+#include "Vflowlg15.h"
+#include "testb.h"
+
+// BURSTTRANSPORT
+// {{{
+// A host that sends one message to the UARTSIM, but only a burst of it at a
+// time--the next burst waits until next_burst() is called.  Whatever comes
+// back is kept, as with a LOOPTRANSPORT.
+class	BURSTTRANSPORT {
+	const char	*m_src;
+	int		m_srclen, m_sent, m_burst, m_left;
+	char		*m_dst;
+	int		m_dstlen, m_received;
+public:
+	BURSTTRANSPORT(const char *src, int srclen, char *dst, int dstlen,
+			int burst) : m_src(src), m_srclen(srclen), m_sent(0),
+			m_burst(burst), m_left(0),
+			m_dst(dst), m_dstlen(dstlen), m_received(0) {}
+
+	int	read(char *buf, int len) {
+		if (len > m_left)
+			len = m_left;
+		if (len > m_srclen - m_sent)
+			len = m_srclen - m_sent;
+		memcpy(buf, &m_src[m_sent], len);
+		m_sent += len;
+		m_left -= len;
+		return len;
+	}
+
+	int	write(const char *buf, int len) {
+		for(int k=0; k<len; k++, m_received++)
+			if (m_received < m_dstlen)
+				m_dst[m_received] = buf[k];
+		return len;
+	}
+
+	bool	connected(void) const { return true; }
+	bool	readable(void) const {
+		return (m_left > 0)&&(m_sent < m_srclen); }
+	void	close(void) {}
+
+	void	next_burst(void) { m_left = m_burst; }
+	int	sent(void) const { return m_sent; }
+	int	received(void) const { return m_received; }
+};
+// }}}
+
+// LOSS
+// {{{
+// What one depth made of the bursts
+typedef	struct {
+	unsigned	m_lgflen;
+	unsigned long	m_sent, m_received;
+	bool		m_overflow;
+} LOSS;
+// }}}
+
+// runloss(lgflen, setup, burst, nbursts, drain, period)
+// {{{
+// Runs the bursts through one build of flowtest.v, VA, and returns the loss
+template <class VA>	static LOSS	runloss(unsigned lgflen, unsigned setup,
+		unsigned burst, unsigned nbursts, unsigned drain,
+		unsigned long period) {
+	unsigned	baudclocks = setup & 0x0ffffff;
+	unsigned long	total = (unsigned long)burst * nbursts, next = 0;
+	char		*msg = new char[total], *reply = new char[total];
+	unsigned	nstarted = 0;
+	LOSS		r;
+
+	for(unsigned long k=0; k<total; k++)
+		msg[k] = (char)(k * 7 + 3);
+
+	TESTB<VA, UARTSIMT<BURSTTRANSPORT> >	*tb
+		= new TESTB<VA, UARTSIMT<BURSTTRANSPORT> >(msg, (int)total,
+				reply, (int)total, (int)burst);
+
+	tb->m_uart.setup(setup);
+	tb->m_uart.flush_threshold(1);
+
+	// Reset the design, and give it time to set itself up
+	// {{{
+	tb->m_core.i_setup   = setup;
+	tb->m_core.i_drain   = drain;
+	tb->m_core.i_uart_rx = 1;
+	tb->m_core.i_cts_n   = 0;
+	tb->m_core.i_reset   = 1;
+	for(int k=0; k<4; k++)
+		tb->clock();
+	tb->m_core.i_reset = 0;
+
+	for(unsigned k=0; k<baudclocks*24; k++)
+		tb->clock();
+	// }}}
+
+	// One burst every period clocks, and then one period more to let
+	// the last of them drain
+	next = tb->clocks();
+	while(nstarted <= nbursts) {
+		if (tb->clocks() >= next) {
+			if (nstarted < nbursts) {
+				tb->wake();
+				tb->m_uart.host().next_burst();
+			}
+			nstarted++;
+			next += period;
+		}
+		tb->tick();
+	}
+	tb->close();
+
+	r.m_lgflen   = lgflen;
+	r.m_sent     = tb->m_uart.host().sent();
+	r.m_received = tb->m_uart.host().received();
+	r.m_overflow = tb->m_core.o_err;
+
+	delete	tb;
+	delete[] msg;
+	delete[] reply;
+	return r;
+}
+// }}}
+
+int	main(int argc, char **argv) {
+	Verilated::commandArgs(argc, argv);
+	unsigned	setup = 25, burst = 4096, nbursts = 4, drain = 0,
+			baudclocks, char_clocks;
+	unsigned long	period = 0;
+	const int	NDEPTHS = 3;
+	LOSS		loss[NDEPTHS];
+	bool		pass = true;
+
+	// Argument processing
+	// {{{
+	for(int argn=1; argn<argc; argn++) {
+		if (argv[argn][0] == '-') for(int j=1; (j<1000)&&(argv[argn][j]); j++)
+		switch(argv[argn][j]) {
+			case 's':
+				setup = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'B':
+				burst = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'N':
+				nbursts = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'd':
+				drain = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'p':
+				period = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			default:
+				printf("Undefined option, -%c\n", argv[argn][j]);
+				break;
+		}
+	}
+	// }}}
+
+	setup = (setup & 0x3fffffff) | 0x40000000;
+	baudclocks = setup & 0x0ffffff;
+	char_clocks = baudclocks * (2 + (8-((setup>>28)&3))
+				+ ((setup>>26)&1) + ((setup>>27)&1));
+	if (drain == 0)
+		drain = 2 * char_clocks;
+	if (period == 0)
+		period = (unsigned long)burst * (char_clocks + 2 * (drain + 16));
+	if ((burst == 0)||(nbursts == 0)||(drain > 0x0ffff)) {
+		fprintf(stderr, "ERR: Bad -B, -N, or -d (-d must fit in 16 bits)\n");
+		exit(EXIT_FAILURE);
+	}
+
+	loss[0] = runloss<Vflowlg4>( 4, setup, burst, nbursts, drain, period);
+	loss[1] = runloss<Vflowlg10>(10, setup, burst, nbursts, drain, period);
+	loss[2] = runloss<Vflowlg15>(15, setup, burst, nbursts, drain, period);
+
+	// Report
+	// {{{
+	printf("Setup 0x%08x, %u bursts of %u bytes every %lu clocks, "
+			"read every %u clocks\n",
+		setup, nbursts, burst, period, drain);
+	printf("%6s %8s %10s %10s %10s %7s %s\n", "LGFLEN", "Depth", "Sent",
+		"Received", "Lost", "Loss", "Overflow");
+	for(int k=0; k<NDEPTHS; k++) {
+		unsigned long	lost = loss[k].m_sent - loss[k].m_received;
+
+		printf("%6u %8u %10lu %10lu %10lu %6.2f%% %s\n",
+			loss[k].m_lgflen, 1u << loss[k].m_lgflen,
+			loss[k].m_sent, loss[k].m_received, lost,
+			(loss[k].m_sent > 0)
+				? 100.0 * lost / loss[k].m_sent : 0.0,
+			(loss[k].m_overflow) ? "yes" : "no");
+
+		if (loss[k].m_received > loss[k].m_sent)
+			pass = false;
+		if ((k > 0)&&(loss[k].m_received < loss[k-1].m_received))
+			pass = false;
+		if (((1ul << loss[k].m_lgflen) > burst)
+				&&((lost != 0)||(loss[k].m_overflow)))
+			pass = false;
+		if (loss[k].m_sent != (unsigned long)burst * nbursts)
+			pass = false;
+	}
+
+	printf("%s\n", (pass) ? "PASS" : "FAIL");
+	exit((pass) ? EXIT_SUCCESS : EXIT_FAILURE);
+	// }}}
+}
@@ -0,0 +1,467 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	marginsweep.cpp
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Finds how far off the baud rate the receiver within the
+//		linetest design can be driven before it fails, at each of a
+//	range of clocks per baud.  A block of random characters is sent into
+//	the design from a UARTSIM whose transmitter has been impair()ed, and
+//	must come back out again--through the design's (unimpaired)
+//	transmitter--unchanged.  For each clocks per baud, the offset is
+//	searched for, in both directions, until the largest that still passes
+//	is known to within the resolution.  Any jitter or glitches requested
+//	apply to every run, so the margin found is what remains on top of
+//	them.
+//
+//	To keep a fast transmitter from simply overflowing the design's FIFO,
+//	no more than a few characters are allowed to be outstanding at once
+//	(by way of the UARTSIM's RTS input).
+//
+//	Built with USE_UART_LITE defined (as marginsweeplite), this tests
+//	rxuartlite instead, which is fixed at 8N1 and 868 clocks per baud.
+//
+//	The searches are handed out to a pool of worker processes, as in
+//	linesweep.  The exit status will be EXIT_SUCCESS only if every margin
+//	found is at least that required (-t).
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <verilatedos.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "verilated.h"
+#ifdef	USE_UART_LITE
+#include "Vlinetestlite.h"
+#define	SIMCLASS	Vlinetestlite
+#define	PROGNAME	"marginsweeplite"
+#else
+#include "Vlinetest.h"
+#define	SIMCLASS	Vlinetest
+#define	PROGNAME	"marginsweep"
+#endif
+#include "uartsim.h"
+
+#define	MAXBAUDS	32
+// The most characters that may be on their way through the design at once
+#define	WINDOW		8
+// How many character times may pass without anything coming back before
+// we give up on a run
+#define	TIMEOUT		(4*WINDOW)
+
+void	usage(void) {
+	fprintf(stderr, "USAGE: " PROGNAME " [-j <jobs>] [-b <clocks>] [-n <chars>] [-J <clocks>] [-g <rate>] [-G <clocks>] [-r <ppm>] [-m <ppm>] [-t <ppm>] [-s <seed>]\n");
+	fprintf(stderr, "\n"
+"\tFinds the margin, in parts per million of baud rate error, that the\n"
+"\tlinetest design's receiver has at each of several clocks per baud.\n"
+"\n"
+"\t-j <jobs>\tRuns this many worker processes.  (Default: one per core)\n"
+#ifndef	USE_UART_LITE
+"\t-b <clocks>\tTests this number of clocks per baud, rather than the\n"
+"\t\tdefault set of 8, 16, 25, 100, and 868.  May be repeated.\n"
+#endif
+"\t-n <chars>\tSends this many characters for each offset tried.\n"
+"\t\t(Default: 2000)\n"
+"\t-J <clocks>\tMoves every edge by up to this many clocks either way\n"
+"\t-g <rate>\tGlitches this many bits in every million ...\n"
+"\t-G <clocks>\t... by inverting them for this many clocks (Default: 1)\n"
+"\t-r <ppm>\tThe resolution of the search (Default: 500)\n"
+"\t-m <ppm>\tThe largest offset to search (Default: 200000)\n"
+"\t-t <ppm>\tThe margin required to pass (Default: 10000, or 1%%)\n"
+"\t-s <seed>\tSeeds the random characters, jitter, and glitches\n\n");
+}
+
+typedef	struct {
+	unsigned	m_baud, m_chars, m_jitter, m_glitch_rate, m_glitch_clocks,
+			m_seed;
+} MARGINOPTS;
+
+typedef	struct {
+	unsigned	m_index;
+	// Whether it passed with no offset at all, and if so the largest
+	// offset (in the direction searched) that still passed
+	bool		m_nominal;
+	int		m_margin;
+	unsigned long	m_chars, m_clocks;
+} MARGINRESULT;
+
+// tick(tb)
+// {{{
+static inline void	tick(SIMCLASS *tb) {
+	tb->i_clk = 1;
+	tb->eval();
+	tb->i_clk = 0;
+	tb->eval();
+}
+// }}}
+
+// loopback(tb, setup, ppm, opts, msg, reply, clocks)
+// {{{
+// Sends msg through the design, with the UARTSIM's transmitter off by ppm.
+// Returns the number of characters that came back correctly.
+static int	loopback(SIMCLASS *tb, unsigned setup, int ppm,
+		const MARGINOPTS &opts, const char *msg, char *reply,
+		unsigned long &clocks) {
+	const int	len = opts.m_chars;
+	unsigned	baudclocks = setup & 0x0ffffff;
+	unsigned long	last_reply = 0, timeout;
+	unsigned	uart_idle = 0, uart_skipped = 0;
+	int		last_tx = 1, rx = 1, nrcvd = 0;
+
+	// Reset the design, and clear any initial break condition
+	// {{{
+	tb->i_setup   = setup;
+	tb->i_uart_rx = 1;
+	tb->i_reset   = 1;
+	for(int k=0; k<4; k++)
+		tick(tb);
+	tb->i_reset = 0;
+
+	for(unsigned k=0; k<baudclocks*24; k++)
+		tick(tb);
+	// }}}
+
+	UARTSIMT<LOOPTRANSPORT>	uart(msg, len, reply, len);
+	uart.setup(setup);
+	uart.flush_threshold(1);
+	uart.impair(ppm, opts.m_jitter, opts.m_glitch_rate,
+			opts.m_glitch_clocks, opts.m_seed);
+
+	timeout = (unsigned long)TIMEOUT * baudclocks * 12;
+	clocks = 0;
+	while((nrcvd < len)&&(clocks - last_reply < timeout)) {
+		tick(tb);
+		clocks++;
+
+		// Only step the UART when something might happen
+		if ((uart_idle > 0)&&(tb->o_uart_tx == last_tx)) {
+			uart_idle--;
+			uart_skipped++;
+		} else {
+			uart.skip(uart_skipped);
+			uart_skipped = 0;
+			// Hold the transmitter off while WINDOW characters are
+			// still on their way back
+			uart.rts(uart.tx_chars() >= uart.rx_chars() + WINDOW);
+			rx = uart(tb->o_uart_tx);
+			last_tx = tb->o_uart_tx;
+			uart_idle = uart.next_event_clocks();
+
+			// Stop at the first thing to come back wrong
+			if ((int)uart.rx_chars() > nrcvd) {
+				uart.flush();
+				for(; nrcvd < uart.host().received(); nrcvd++)
+					if (reply[nrcvd] != msg[nrcvd])
+						return nrcvd;
+				last_reply = clocks;
+			}
+		}
+
+		tb->i_uart_rx = rx;
+	}
+
+	return nrcvd;
+}
+// }}}
+
+// search(tb, sign, opts, result)
+// {{{
+// Finds the largest offset, in the direction of sign, at which every
+// character still comes back
+static void	search(SIMCLASS *tb, int sign, int resolution, int maxppm,
+		const MARGINOPTS &opts, MARGINRESULT &result) {
+	unsigned	setup = opts.m_baud;	// 8N1
+	char		*msg   = new char[opts.m_chars],
+			*reply = new char[opts.m_chars];
+	uint32_t	rng = (opts.m_seed) ? opts.m_seed : 1;
+	int		lo = 0, hi = maxppm;
+	unsigned long	clocks;
+
+	for(unsigned k=0; k<opts.m_chars; k++) {
+		rng ^= rng << 13;
+		rng ^= rng >> 17;
+		rng ^= rng << 5;
+		msg[k] = (char)rng;
+	}
+
+	result.m_chars = result.m_clocks = 0;
+
+	// Both ends of the search must be checked first: it may fail with no
+	// offset at all, or pass at the largest
+	// {{{
+	result.m_chars += opts.m_chars;
+	if (loopback(tb, setup, 0, opts, msg, reply, clocks)
+			< (int)opts.m_chars) {
+		result.m_clocks += clocks;
+		result.m_nominal = false;
+		result.m_margin = 0;
+		delete[] msg;
+		delete[] reply;
+		return;
+	} result.m_clocks += clocks;
+
+	result.m_chars += opts.m_chars;
+	if (loopback(tb, setup, sign*hi, opts, msg, reply, clocks)
+			>= (int)opts.m_chars)
+		lo = hi;
+	result.m_clocks += clocks;
+	// }}}
+
+	while(hi - lo > resolution) {
+		int	mid = (lo + hi) / 2;
+
+		result.m_chars += opts.m_chars;
+		if (loopback(tb, setup, sign*mid, opts, msg, reply, clocks)
+				>= (int)opts.m_chars)
+			lo = mid;
+		else
+			hi = mid;
+		result.m_clocks += clocks;
+	}
+
+	result.m_nominal = true;
+	result.m_margin = lo;
+	delete[] msg;
+	delete[] reply;
+}
+// }}}
+
+// worker(work_fd, result_fd, ...)
+// {{{
+static void	worker(int work_fd, int result_fd, const unsigned *bauds,
+		int resolution, int maxppm, const MARGINOPTS &base) {
+	SIMCLASS	*tb = new SIMCLASS;
+	unsigned	index;
+
+	while(read(work_fd, &index, sizeof(index)) == sizeof(index)) {
+		MARGINRESULT	result;
+		MARGINOPTS	opts = base;
+
+		// Each baud rate has two searches, slow (+) and fast (-)
+		opts.m_baud = bauds[index/2];
+		result.m_index = index;
+		search(tb, (index & 1) ? -1 : 1, resolution, maxppm, opts,
+			result);
+		if (write(result_fd, &result, sizeof(result)) != sizeof(result))
+			break;
+	}
+
+	tb->final();
+	delete tb;
+}
+// }}}
+
+int	main(int argc, char **argv) {
+	Verilated::commandArgs(argc, argv);
+	unsigned	bauds[MAXBAUDS], nbauds = 0, nsearches, nfail = 0;
+	int		njobs = 0, resolution = 500, maxppm = 200000,
+			required = 10000, work[2], res[2];
+	MARGINOPTS	opts;
+	MARGINRESULT	*results;
+	bool		*done;
+	pid_t		*pids;
+	unsigned long	total_chars = 0;
+
+	opts.m_baud = 0;
+	opts.m_chars = 2000;
+	opts.m_jitter = 0;
+	opts.m_glitch_rate = 0;
+	opts.m_glitch_clocks = 1;
+	opts.m_seed = 1;
+
+	// Argument processing
+	// {{{
+	for(int argn=1; argn<argc; argn++) {
+		if ((argv[argn][0] != '-')||(argv[argn][1] == '\0')
+				||(argv[argn][2] != '\0')
+				||(!strchr("jbnJgGrmts", argv[argn][1]))
+				||(argn+1 >= argc)) {
+			usage();
+			exit(EXIT_FAILURE);
+		}
+
+		unsigned long	v = strtoul(argv[argn+1], NULL, 0);
+
+		switch(argv[argn++][1]) {
+		case 'j': njobs = (int)v; break;
+		case 'b':
+#ifdef	USE_UART_LITE
+			fprintf(stderr, "The lite UART only runs at 868 clocks per baud\n");
+			exit(EXIT_FAILURE);
+#else
+			if ((v < 4)||(v > 0x0ffffff)) {
+				fprintf(stderr, "Bad baud clock count, %s\n",
+					argv[argn]);
+				exit(EXIT_FAILURE);
+			} else if (nbauds < MAXBAUDS)
+				bauds[nbauds++] = (unsigned)v;
+#endif
+			break;
+		case 'n': opts.m_chars = (v > 0) ? (unsigned)v : 1; break;
+		case 'J': opts.m_jitter = (unsigned)v; break;
+		case 'g': opts.m_glitch_rate = (unsigned)v; break;
+		case 'G': opts.m_glitch_clocks = (unsigned)v; break;
+		case 'r': resolution = (v > 0) ? (int)v : 1; break;
+		case 'm': maxppm = (v > 0) ? (int)v : 1; break;
+		case 't': required = (int)v; break;
+		case 's': opts.m_seed = (v > 0) ? (unsigned)v : 1; break;
+		}
+	}
+
+	if (nbauds == 0) {
+#ifndef	USE_UART_LITE
+		bauds[nbauds++] = 8;
+		bauds[nbauds++] = 16;
+		bauds[nbauds++] = 25;
+		bauds[nbauds++] = 100;
+#endif
+		bauds[nbauds++] = 868;
+	}
+
+	if (njobs <= 0)
+		njobs = sysconf(_SC_NPROCESSORS_ONLN);
+	if (njobs <= 0)
+		njobs = 1;
+	// }}}
+
+	nsearches = 2 * nbauds;
+	if ((unsigned)njobs > nsearches)
+		njobs = nsearches;
+
+	results = new MARGINRESULT[nsearches];
+	done    = new bool[nsearches];
+	pids    = new pid_t[njobs];
+	for(unsigned k=0; k<nsearches; k++)
+		done[k] = false;
+
+	// Queue up the work, and start the workers
+	// {{{
+	if ((pipe(work) != 0)||(pipe(res) != 0)) {
+		perror("O/S ERR: pipe");
+		exit(EXIT_FAILURE);
+	}
+
+	// The slowest searches (the most clocks per baud) go first
+	for(int k=nsearches-1; k>=0; k--) {
+		unsigned	index = k;
+
+		if (write(work[1], &index, sizeof(index)) != sizeof(index)) {
+			perror("O/S ERR: queueing work");
+			exit(EXIT_FAILURE);
+		}
+	} close(work[1]);
+
+	fflush(stdout);
+	for(int w=0; w<njobs; w++) {
+		pids[w] = fork();
+		if (pids[w] < 0) {
+			perror("O/S ERR: fork");
+			exit(EXIT_FAILURE);
+		} else if (pids[w] == 0) {
+			close(res[0]);
+			worker(work[0], res[1], bauds, resolution, maxppm, opts);
+			exit(EXIT_SUCCESS);
+		}
+	}
+
+	close(work[0]);
+	close(res[1]);
+	// }}}
+
+	// Collect the results, until every worker has closed its end
+	// {{{
+	{
+		MARGINRESULT	r;
+		ssize_t		nr;
+
+		while(((nr = read(res[0], &r, sizeof(r))) == sizeof(r))
+				||((nr < 0)&&(errno == EINTR))) {
+			if ((nr > 0)&&(r.m_index < nsearches)) {
+				results[r.m_index] = r;
+				done[r.m_index] = true;
+			}
+		}
+		close(res[0]);
+
+		for(int w=0; w<njobs; w++)
+			waitpid(pids[w], NULL, 0);
+	}
+	// }}}
+
+	// Report the margins
+	// {{{
+	printf("%u characters per run, jitter %u, glitches %u/M x %u clocks, resolution %d ppm\n",
+		opts.m_chars, opts.m_jitter, opts.m_glitch_rate,
+		opts.m_glitch_clocks, resolution);
+	printf("%10s %12s %12s %8s\n", "Clks/baud", "Fast (ppm)", "Slow (ppm)",
+		"Margin");
+	for(unsigned b=0; b<nbauds; b++) {
+		MARGINRESULT	&slow = results[2*b], &fast = results[2*b+1];
+		bool		ok = (done[2*b])&&(done[2*b+1]);
+		int		margin = 0;
+
+		if (ok) {
+			margin = (slow.m_margin < fast.m_margin)
+					? slow.m_margin : fast.m_margin;
+			total_chars += slow.m_chars + fast.m_chars;
+		}
+
+		printf("%10u", bauds[b]);
+		if (!ok)
+			printf(" %12s %12s %8s", "----", "----", "----");
+		else if ((!slow.m_nominal)||(!fast.m_nominal))
+			printf(" %12s %12s %8s", "FAIL", "FAIL", "none");
+		else
+			printf(" %12d %12d %7.2f%%", -fast.m_margin,
+				slow.m_margin, margin / 1e4);
+		if ((!ok)||(margin < required)) {
+			printf("  << below %.2f%%", required / 1e4);
+			nfail++;
+		}
+		printf("\n");
+	}
+
+	printf("\n%lu characters in all\n%s\n", total_chars,
+		(nfail == 0) ? "PASS" : "FAIL");
+	// }}}
+
+	delete[] results;
+	delete[] done;
+	delete[] pids;
+
+	return (nfail == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
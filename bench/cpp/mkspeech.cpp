@@ -7,6 +7,14 @@
 // Purpose:	To turn a text file (i.e. the Gettysburg address) into a 
 //		hex file that can be included via readmemh.
 //
+//	The text file is memory mapped, and the output built up in a large
+//	buffer and written a megabyte at a time, so that message images of
+//	many megabytes take no longer to build than they do to write.  With
+//	-H, the length of the message (after every newline has been turned
+//	into a CR/LF pair) is also written to a Verilog header and a C++
+//	header, so that speechfifo.v and speechtest.cpp can be built for a
+//	message other than the Gettysburg address.
+//
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
 //
@@ -41,6 +49,10 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
 
 /*
 * endswith
@@ -66,7 +78,7 @@ bool	endswith(const char *str, const char *ending) {
 * can be used to accomplish.
 */
 void	usage(void) {
-	fprintf(stderr, "USAGE:\tmkspeech [-x] <filename>.txt [-o <outfile>]\n");
+	fprintf(stderr, "USAGE:\tmkspeech [-x|-b] [-H <name>] <filename>.txt [-o <outfile>]\n");
 	fprintf(stderr, "\n"
 "\tConverts a text file to a file such as can be included in a Verilog\n"
 "\tprogram.  Without the -x argument, the mkspeech program defaults\n"
@@ -75,14 +87,121 @@ void	usage(void) {
 "\tinto an include file such as might be used in a Verilog program\n"
 "\tif and when the synthesis tool doesn\'t support hex files (Xilinx\'s\n"
 "\tISE).  In this case, the output filename defaults to \'speech.inc\'.\n"
+"\tWith -b, the output is instead a binary image of the message, one\n"
+"\tbyte per character, defaulting to \'speech.bin\'.\n"
+"\n"
+"\t-H <name>\talso writes <name>.vh and <name>.h, defining\n"
+"\t\tSPEECH_MSGLEN as the length of the message, together with the\n"
+"\t\tnames of the files it came from and was written to.  Verilate\n"
+"\t\t<name>.vh ahead of speechfifo.v, or build speechtest.cpp with\n"
+"\t\t-include <name>.h, to build them for this message.\n"
 "\n\n");
 }
 // }}}
 
+/*
+* OUTBUF
+* {{{
+* The output, collected into a large buffer so that it may be written with a
+* handful of large writes, rather than one small write per character.
+*/
+class	OUTBUF {
+	static const size_t	BUFLEN = (1<<20);
+	FILE	*m_fp;
+	char	*m_buf;
+	size_t	m_len;
+public:
+	OUTBUF(FILE *fp) : m_fp(fp), m_len(0) {
+		m_buf = new char[BUFLEN];
+	}
+
+	~OUTBUF(void) {
+		flush();
+		delete[] m_buf;
+	}
+
+	void	flush(void) {
+		if ((m_len > 0)&&(fwrite(m_buf, 1, m_len, m_fp) != m_len)) {
+			perror("O/S Err: write");
+			exit(EXIT_FAILURE);
+		} m_len = 0;
+	}
+
+	// Makes certain there's room for at least n more characters
+	char	*room(size_t n) {
+		if (m_len + n > BUFLEN)
+			flush();
+		return &m_buf[m_len];
+	}
+
+	void	byte(int ch) {
+		*room(1) = ch;
+		m_len++;
+	}
+
+	void	hex(int ch) {
+		static const char	digits[] = "0123456789abcdef";
+		char	*dp = room(3);
+
+		dp[0] = digits[(ch >> 4)&0x0f];
+		dp[1] = digits[ch & 0x0f];
+		dp[2] = ' ';
+		m_len += 3;
+	}
+
+	void	printf(const char *fmt, unsigned addr, int ch) {
+		char	*dp = room(64);
+
+		m_len += snprintf(dp, 64, fmt, addr, ch);
+	}
+};
+// }}}
+
+/*
+* write_headers(name, infile, outkind, outfile, msglen)
+* {{{
+* Writes <name>.vh, for speechfifo.v, and <name>.h, for speechtest.cpp, both
+* defining the length of the message just written.  The .vh file also names
+* the output, as SPEECH_HEXFILE, SPEECH_INCFILE, or SPEECH_BINFILE.
+*/
+void	write_headers(const char *name, const char *infile,
+		const char *outkind, const char *outfile,
+		unsigned long msglen) {
+	std::string	vh = std::string(name) + ".vh",
+			ch = std::string(name) + ".h";
+	FILE	*fp;
+
+	if (NULL == (fp = fopen(vh.c_str(), "w"))) {
+		fprintf(stderr, "Err: Cannot write %s\n", vh.c_str());
+		exit(EXIT_FAILURE);
+	}
+	fprintf(fp, "// Written by mkspeech, from %s.  Don\'t edit.\n"
+		"`define\tSPEECH_MSGLEN\t%lu\n"
+		"`define\tSPEECH_%sFILE\t\"%s\"\n", infile, msglen,
+		outkind, outfile);
+	fclose(fp);
+
+	if (NULL == (fp = fopen(ch.c_str(), "w"))) {
+		fprintf(stderr, "Err: Cannot write %s\n", ch.c_str());
+		exit(EXIT_FAILURE);
+	}
+	fprintf(fp, "// Written by mkspeech, from %s.  Don\'t edit.\n"
+		"#define\tSPEECH_MSGLEN\t%lu\n"
+		"#define\tSPEECH_TXTFILE\t\"%s\"\n", infile, msglen, infile);
+	fclose(fp);
+}
+// }}}
+
 int main(int argc, char **argv) {
-	FILE	*fp, *fout;
-	const	char	*input_filename = NULL, *output_filename = NULL;
-	bool	xise_file = false;
+	FILE	*fout;
+	int	fd;
+	struct	stat	sb;
+	const	char	*input_filename = NULL, *output_filename = NULL,
+			*header_name = NULL;
+	const	unsigned char	*text = NULL;
+	size_t	textlen;
+	unsigned long	addr = 0;
+	bool	xise_file = false, bin_file = false;
 
 	// Argument processing
 	// {{{
@@ -91,14 +210,18 @@ int main(int argc, char **argv) {
 			if (argv[argn][2] == '\0') {
 				if (argv[argn][1] == 'x')
 					xise_file = true;
-				else if (argv[argn][1] == 'o') {
-					if (argn+1<argc)
-						output_filename = argv[++argn];
-					else  {
-					fprintf(stderr, "ERR: -o given, but no filename given");
+				else if (argv[argn][1] == 'b')
+					bin_file = true;
+				else if ((argv[argn][1] == 'o')
+						||(argv[argn][1] == 'H')) {
+					if (argn+1>=argc) {
+					fprintf(stderr, "ERR: -%c given, but no filename given", argv[argn][1]);
 						usage();
 						exit(EXIT_FAILURE);
-					}
+					} else if (argv[argn][1] == 'o')
+						output_filename = argv[++argn];
+					else
+						header_name = argv[++argn];
 				} else {
 					fprintf(stderr, "ERR: Unknown argument, %s\n", argv[argn]);
 					usage();
@@ -117,6 +240,12 @@ int main(int argc, char **argv) {
 			exit(EXIT_FAILURE);
 		}
 	}
+
+	if ((xise_file)&&(bin_file)) {
+		fprintf(stderr, "ERR: Only one of -x or -b may be given\n");
+		usage();
+		exit(EXIT_FAILURE);
+	}
 	// }}}
 
 	// The input file name must not be NULL
@@ -147,69 +276,116 @@ int main(int argc, char **argv) {
 	}
 	// }}}
 
-	// Open the input file
+	// Map the input file into memory
 	// {{{
-	fp = fopen(input_filename, "r");
-	if (fp == NULL) {
+	fd = open(input_filename, O_RDONLY);
+	if ((fd < 0)||(fstat(fd, &sb) != 0)) {
 		fprintf(stderr, "Err: Cannot read %s\n", input_filename);
 		exit(EXIT_FAILURE);
 	}
+
+	textlen = sb.st_size;
+	if (textlen > 0) {
+		// mmap() will fail on an empty file, but then there's nothing
+		// to map
+		void	*map = mmap(NULL, textlen, PROT_READ, MAP_PRIVATE,
+					fd, 0);
+		if (map == MAP_FAILED) {
+			fprintf(stderr, "Err: Cannot map %s\n", input_filename);
+			perror("O/S Err:");
+			exit(EXIT_FAILURE);
+		}
+		madvise(map, textlen, MADV_SEQUENTIAL);
+		text = (const unsigned char *)map;
+	}
 	// }}}
 
 	// Open the output file
 	// {{{
 	if (output_filename == NULL)
-		output_filename = (xise_file) ? "speech.inc" : "speech.hex";
+		output_filename = (xise_file) ? "speech.inc"
+			: (bin_file) ? "speech.bin" : "speech.hex";
 
-	fout = fopen(output_filename, "w");
+	fout = fopen(output_filename, (bin_file) ? "wb" : "w");
 	if (fout == NULL) {
 		fprintf(stderr, "Err: Cannot write %s\n", output_filename);
 		exit(EXIT_FAILURE);
 	}
 	// }}}
 
-	if (xise_file) {
-		// ISE can't handle $readmemh, so let's build an include file
-		// {{{
-		// instead
-		int	ch, addr = 0;
-		while((ch = fgetc(fp))!=EOF) {
-			if (ch == '\n')
-				fprintf(fout, "\t\tmessage[%4d] = 8\'h%02x;\n",
-					addr++, '\n');
-			fprintf(fout, "\t\tmessage[%4d] = 8\'h%02x;\n",
-				addr++, ch);
-		}
+	{
+		OUTBUF	out(fout);
+
+		if (xise_file) {
+			// ISE can't handle $readmemh, so let's build an include
+			// {{{
+			// file instead
+			for(size_t k=0; k<textlen; k++) {
+				int	ch = text[k];
+
+				if (ch == '\n')
+					out.printf("\t\tmessage[%4u] = 8\'h%02x;\n",
+						addr++, '\r');
+				out.printf("\t\tmessage[%4u] = 8\'h%02x;\n",
+					addr++, ch);
+			}
+
+			for(unsigned pad = addr; pad<2048; pad++)
+				out.printf("\t\tmessage[%4u] = 8'h%02x;\n",
+					pad, ' ');
+			// }}}
+		} else if (bin_file) {
+			// A binary image, with the same CR/LF pairs
+			// {{{
+			for(size_t k=0; k<textlen; k++) {
+				if (text[k] == '\n') {
+					out.byte('\r'); addr++;
+				}
+				out.byte(text[k]); addr++;
+			}
+			// }}}
+		} else {
+			// Bulid a proper hex file for $readmemh
+			// {{{
+			int	linelen = 0;
+
+			out.printf("@%08x ", addr, 0); linelen += 4+6;
+			for(size_t k=0; k<textlen; k++) {
+				int	ch = text[k];
+
+				if (ch == '\n') {
+					out.hex('\r'); linelen += 3; addr++;
+					if (linelen >= 77) {
+						out.byte('\n');
+						linelen = 0;
+						out.printf("@%08x ", addr, 0);
+						linelen += 4+6;
+					}
+				}
+				out.hex(ch); linelen += 3; addr++;
 
-		for(; addr<2048; addr++)
-			fprintf(fout, "\t\tmessage[%4d] = 8'h%02x;\n", addr, ' ');
-		// }}}
-	} else {
-		// Bulid a proper hex file for $readmemh
-		// {{{
-		int	linelen = 0;
-		int	ch, addr = 0;
-
-		fprintf(fout, "@%08x ", addr); linelen += 4+6;
-		while((ch = fgetc(fp))!=EOF) {
-			if (ch == '\n') {
-				fprintf(fout, "%02x ", '\r' & 0x0ff); linelen += 3; addr++;
 				if (linelen >= 77) {
-					fprintf(fout, "\n");
+					out.byte('\n');
 					linelen = 0;
-					fprintf(fout, "@%08x ", addr); linelen += 4+6;
+					out.printf("@%08x ", addr, 0);
+					linelen += 4+6;
 				}
-			}
-			fprintf(fout, "%02x ", ch & 0x0ff); linelen += 3; addr++;
+			} out.byte('\n');
+			// }}}
+		}
+	}
 
-			if (linelen >= 77) {
-				fprintf(fout, "\n");
-				linelen = 0;
-				fprintf(fout, "@%08x ", addr); linelen += 4+6;
-			}
-		} fprintf(fout, "\n");
-		// }}}
+	if (textlen > 0)
+		munmap((void *)text, textlen);
+	close(fd);
+	if (fclose(fout) != 0) {
+		fprintf(stderr, "Err: Cannot write %s\n", output_filename);
+		exit(EXIT_FAILURE);
 	}
-	fclose(fp);
-	fclose(fout);
+
+	if (header_name)
+		write_headers(header_name, input_filename,
+			(xise_file) ? "INC" : (bin_file) ? "BIN" : "HEX",
+			output_filename, addr);
 }
+// }}}
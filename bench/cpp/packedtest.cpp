@@ -0,0 +1,251 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	packedtest.cpp
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Checks the packed access mode of the wbuart (a Verilated
+//		wbuart.v, built with OPT_PACKED set, with a UARTSIM on its
+//	line).  Setup bit 31 is set, and then:
+//
+//	1. Four words are written to the transmit register:  two of four bytes,
+//		one of three, and one of a single byte, with the byte selects
+//		giving which lanes to send.  The host must receive all twelve
+//		bytes, in order.
+//
+//	2. The host's ten bytes are read back from the receive register, three
+//		at a time.  Each read must return the count it claims in its
+//		top two bits, the bytes in order from the bottom up, and zeros
+//		in any unused bytes.  The last is a partial word of one byte,
+//		and a final read must then find none, with its empty flag set.
+//
+//	Options:
+//		-s <setup>	The setup word, less the packed and flow control
+//				bits which are set here.  (Default: 25, 8N1)
+//
+//	The result is a report, ending in PASS or FAIL.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <verilatedos.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "verilated.h"
+#include "Vwbuart.h"
+#include "testb.h"
+
+typedef	TESTB<Vwbuart, UARTSIMT<LOOPTRANSPORT> >	PACKEDTB;
+
+static const unsigned	UART_SETUP = 0, UART_RXREG = 2, UART_TXREG = 3;
+
+// The words written to the transmit register, and the lanes each selects
+static const unsigned	NTXWORDS = 4;
+static const unsigned	txsel[NTXWORDS] = { 0x0f, 0x0f, 0x07, 0x01 };
+static const char	txmsg[] = "Packed bytes";	// Twelve of them
+
+static const char	rxmsg[] = "0123456789";		// And ten of these
+static const unsigned	RXBYTES = 10;
+
+// access(tb, addr, we, data, sel)
+// {{{
+// One Wishbone transaction:  the request is held until it isn't stalled, and
+// then the cycle until it is acknowledged.  The UARTSIM is only clocked once
+// ready is set, so that the host doesn't start sending before the setup has
+// been written.
+static unsigned	access(PACKEDTB &tb, bool ready, unsigned addr, bool we,
+		unsigned data, unsigned sel) {
+	bool	stalled;
+
+	tb.m_core.i_wb_cyc  = 1;
+	tb.m_core.i_wb_stb  = 1;
+	tb.m_core.i_wb_we   = (we) ? 1 : 0;
+	tb.m_core.i_wb_addr = addr & 3;
+	tb.m_core.i_wb_data = data;
+	tb.m_core.i_wb_sel  = sel;
+	do {
+		stalled = tb.m_core.o_wb_stall;
+		if (ready) tb.tick(); else tb.clock();
+	} while(stalled);
+	tb.m_core.i_wb_stb = 0;
+
+	while(!tb.m_core.o_wb_ack) {
+		if (ready) tb.tick(); else tb.clock();
+	}
+	tb.m_core.i_wb_cyc = 0;
+	return tb.m_core.o_wb_data;
+}
+// }}}
+
+int	main(int argc, char **argv) {
+	Verilated::commandArgs(argc, argv);
+	unsigned	setup = 25, baudclocks, char_clocks, ntx = 0;
+	char		reply[sizeof(txmsg)];
+	bool		pass = true;
+
+	// Argument processing
+	// {{{
+	for(int argn=1; argn<argc; argn++) {
+		if (argv[argn][0] == '-') for(int j=1; (j<1000)&&(argv[argn][j]); j++)
+		switch(argv[argn][j]) {
+			case 's':
+				setup = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			default:
+				printf("Undefined option, -%c\n", argv[argn][j]);
+				break;
+		}
+	}
+	// }}}
+
+	// Eight data bits without parity, since the bytes here are eight bits,
+	// and no flow control, since the UARTSIM here doesn't watch RTS
+	setup = (setup & 0x0bffffff) | 0xc0000000;
+	baudclocks  = setup & 0x0ffffff;
+	char_clocks = baudclocks * (10 + ((setup>>27)&1));
+
+	for(unsigned k=0; k<NTXWORDS; k++)
+		for(unsigned s = txsel[k]; s; s >>= 1)
+			ntx += (s & 1);
+
+	memset(reply, 0, sizeof(reply));
+	PACKEDTB	tb(rxmsg, (int)RXBYTES, reply, (int)ntx);
+
+	tb.m_uart.setup(setup);
+	tb.m_uart.flush_threshold(1);
+
+	// Reset, and set up the core for packed access
+	// {{{
+	tb.m_core.i_wb_cyc  = 0;
+	tb.m_core.i_wb_stb  = 0;
+	tb.m_core.i_uart_rx = 1;
+	tb.m_core.i_cts_n   = 0;
+	tb.m_core.i_reset   = 1;
+	for(int k=0; k<4; k++)
+		tb.clock();
+	tb.m_core.i_reset = 0;
+
+	access(tb, false, UART_SETUP, true, setup, 0x0f);
+	if ((access(tb, false, UART_SETUP, false, 0, 0x0f) & 0x80000000) == 0) {
+		printf("Packed mode is not available.  Was Vwbuart built with "
+			"OPT_PACKED set?\nFAIL\n");
+		tb.close();
+		exit(EXIT_FAILURE);
+	}
+	for(unsigned k=0; k<baudclocks*24; k++)
+		tb.clock();
+	// }}}
+
+	// Packed writes, the last two of them partial words
+	// {{{
+	// The host is sending its bytes all the while
+	for(unsigned k=0, p=0; k<NTXWORDS; k++) {
+		unsigned	word = 0;
+
+		for(unsigned b=0; b<4; b++)
+			if ((txsel[k] >> b) & 1)
+				word |= (txmsg[p++] & 0x0ff) << (8*b);
+		access(tb, true, UART_TXREG, true, word, txsel[k]);
+	}
+
+	unsigned long	deadline = tb.clocks() + 2 * (ntx + 4) * char_clocks;
+	while(tb.clocks() < deadline) {
+		tb.tick();
+		tb.sync();
+		if (tb.m_uart.host().received() >= (int)ntx)
+			break;
+	}
+
+	if (tb.m_uart.host().received() < (int)ntx) {
+		printf("TX: Only %d of %u bytes received\n",
+			tb.m_uart.host().received(), ntx);
+		pass = false;
+	} else if (memcmp(reply, txmsg, ntx) != 0) {
+		printf("TX: Received \"%.*s\", not \"%.*s\"\n", (int)ntx,
+			reply, (int)ntx, txmsg);
+		pass = false;
+	} else
+		printf("TX: %u bytes, in %u packed writes\n", ntx, NTXWORDS);
+	// }}}
+
+	// Packed reads, ending in a partial word and then an empty one
+	// {{{
+	// Wait for the last of the host's bytes to arrive first
+	deadline = tb.clocks() + 2 * (RXBYTES + 4) * char_clocks;
+	while((tb.m_uart.tx_chars() < RXBYTES)&&(tb.clocks() < deadline))
+		tb.tick();
+	for(unsigned k=0; k<2*char_clocks; k++)
+		tb.tick();
+
+	const unsigned	expect[] = { 3, 3, 3, 1, 0 };
+	for(unsigned k=0, p=0; k<sizeof(expect)/sizeof(expect[0]); k++) {
+		unsigned	v, n;
+
+		// A few clocks between reads, as firmware would take, give the
+		// buffer time to refill three bytes
+		for(int i=0; i<8; i++)
+			tb.tick();
+
+		v = access(tb, true, UART_RXREG, false, 0, 0x0f);
+		n = v >> 30;
+		if (n != expect[k]) {
+			printf("RX: Read %u returned %u bytes, not %u (0x%08x)\n",
+				k, n, expect[k], v);
+			pass = false;
+			break;
+		} else if (((v >> 24) & 1) != ((n == 0) ? 1u : 0u)) {
+			printf("RX: Read %u has its empty flag %s (0x%08x)\n",
+				k, (n == 0) ? "clear" : "set", v);
+			pass = false;
+		} else if ((n < 3)&&((v & 0x0ffffff) >> (8*n)) != 0) {
+			printf("RX: Read %u has data in its unused bytes "
+				"(0x%08x)\n", k, v);
+			pass = false;
+		}
+
+		for(unsigned b=0; b<n; b++, p++)
+			if ((char)(v >> (8*b)) != rxmsg[p]) {
+				printf("RX: Byte %u read as 0x%02x, not 0x%02x\n",
+					p, (v >> (8*b)) & 0x0ff,
+					rxmsg[p] & 0x0ff);
+				pass = false;
+			}
+	}
+
+	if (pass)
+		printf("RX: %u bytes, in %u packed reads\n", RXBYTES,
+			(unsigned)(sizeof(expect)/sizeof(expect[0])));
+	// }}}
+
+	tb.close();
+	printf("%s\n", (pass) ? "PASS" : "FAIL");
+	exit((pass) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -0,0 +1,424 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	regress.cpp
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Runs every one of the test programs in this directory, together
+//		with sweeps of linetest and speechtest across baud rates,
+//	parity and stop bit settings, as many at a time as there are cores.
+//
+//	Each test is its own process, with its output captured to its own log
+//	file.  None of the tests needs watching:  each is given a budget of
+//	simulated clocks (by default, scaled to its baud rate), and stops and
+//	fails on its own if it hasn't finished by then.  Hence we only ever
+//	need to wait for whichever test finishes next.
+//
+//	Once all the tests have finished, a single report lists each test, its
+//	result, how long it took, and where its log may be found.  The same
+//	report is written to report.txt within the log directory.  The exit
+//	status will be EXIT_SUCCESS only if every test passed.
+//
+//	This needs to be run from the directory containing the test programs,
+//	since speechtest needs to find speech.hex and speech.txt there.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <string>
+#include <vector>
+
+void	usage(void) {
+// {{{
+	fprintf(stderr, "USAGE: regress [-j <jobs>] [-o <logdir>] [-k <pattern>] [-l] [-t]\n");
+	fprintf(stderr, "\n"
+"\tRuns the test programs, and sweeps of them, in parallel.\n"
+"\n"
+"\t-j <jobs>\tRuns this many tests at once.  (Default: one per core)\n"
+"\t-o <logdir>\tPlaces the test logs, and the report, in this directory.\n"
+"\t\t(Default: regress.d)\n"
+"\t-k <pattern>\tOnly runs those tests whose names contain this pattern.\n"
+"\t\tMay be repeated.\n"
+"\t-l\tLists the tests that would be run, and then exits\n"
+"\t-t\tKeeps a VCD trace of each test that can produce one, next to\n"
+"\t\tits log\n\n");
+}
+// }}}
+
+// The sweeps
+// {{{
+// The baud rates, in clocks per baud, to sweep across
+static const unsigned	sweep_baud[] = { 25, 100, 868 };
+
+// The framing options to sweep across, from bits [29:24] of the setup word
+static const struct {
+	const char	*m_name;
+	unsigned	m_bits;
+} sweep_framing[] = {
+	{ "8N1", 0x00000000 },
+	{ "8N2", 0x08000000 },		// Two stop bits
+	{ "8O1", 0x04000000 },		// Odd parity, bit 24 clear
+	{ "8E1", 0x05000000 },		// Even parity, bit 24 set
+	{ "8S1", 0x06000000 },		// Parity bit fixed at zero (space)
+	{ "8M1", 0x07000000 }		// Parity bit fixed at one (mark)
+};
+
+// The tests that check their results, and so are worth sweeping, along with
+// their default setup--which is already covered by the basic tests
+static const struct {
+	const char	*m_prog;
+	unsigned	m_default_setup;
+	bool		m_traces;
+} sweep_tests[] = {
+	{ "linetest",   868, true  },
+	{ "speechtest",  25, false }
+};
+
+// The basic tests, as "make test" would run them
+static const struct {
+	const char	*m_prog;
+	bool		m_traces;
+} basic_tests[] = {
+	{ "linetest",       true  },
+	{ "linetestlite",   true  },
+	{ "helloworld",     true  },
+	{ "helloworldlite", true  },
+	{ "speechtest",     false },
+	{ "speechtestlite", false }
+};
+#define	NELEMS(A)	(sizeof(A)/sizeof(A[0]))
+// }}}
+
+// REGRESSJOB
+// {{{
+class	REGRESSJOB {
+public:
+	std::string			m_name, m_log;
+	std::vector<std::string>	m_args;
+	pid_t	m_pid;
+	int	m_status;
+	double	m_start, m_seconds;
+
+	REGRESSJOB(const std::string &name) : m_name(name), m_pid(0),
+		m_status(-1), m_start(0.0), m_seconds(0.0) {}
+
+	// passed(void)
+	// {{{
+	// A test passes if, and only if, it exits normally with EXIT_SUCCESS
+	bool	passed(void) const {
+		return (WIFEXITED(m_status))
+			&&(WEXITSTATUS(m_status) == EXIT_SUCCESS); }
+	// }}}
+};
+// }}}
+
+static double	now(void) {
+	struct	timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// add_job(jobs, name, prog, setup, traces, logdir, keep_traces)
+// {{{
+static void	add_job(std::vector<REGRESSJOB> &jobs, const std::string &name,
+		const char *prog, const char *setup, bool traces,
+		const std::string &logdir, bool keep_traces) {
+	REGRESSJOB	job(name);
+
+	job.m_log = logdir + "/" + name + ".log";
+	job.m_args.push_back(std::string("./") + prog);
+	if (setup) {
+		job.m_args.push_back("-s");
+		job.m_args.push_back(setup);
+	} if ((traces)&&(keep_traces)) {
+		job.m_args.push_back("-t");
+		job.m_args.push_back(logdir + "/" + name + ".vcd");
+	} else if (traces)
+		job.m_args.push_back("-n");
+
+	jobs.push_back(job);
+}
+// }}}
+
+// launch(job)
+// {{{
+// Starts a job running, with its stdout and stderr both going to its log
+static void	launch(REGRESSJOB &job) {
+	pid_t	pid;
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0) {
+		perror("O/S ERR: fork");
+		job.m_pid = 0;
+		job.m_status = -1;
+		return;
+	} else if (pid == 0) {
+		// The child
+		// {{{
+		std::vector<char *>	argv;
+		int	fd;
+
+		fd = open("/dev/null", O_RDONLY);
+		if ((fd < 0)||(dup2(fd, STDIN_FILENO) < 0))
+			_exit(EXIT_FAILURE);
+		close(fd);
+
+		fd = open(job.m_log.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+		if ((fd < 0)||(dup2(fd, STDOUT_FILENO) < 0)
+				||(dup2(fd, STDERR_FILENO) < 0))
+			_exit(EXIT_FAILURE);
+		close(fd);
+
+		for(unsigned k=0; k<job.m_args.size(); k++)
+			argv.push_back((char *)job.m_args[k].c_str());
+		argv.push_back(NULL);
+
+		execv(argv[0], &argv[0]);
+		fprintf(stderr, "Could not run %s: %s\n", argv[0],
+			strerror(errno));
+		_exit(127);
+		// }}}
+	}
+
+	job.m_pid   = pid;
+	job.m_start = now();
+}
+// }}}
+
+// report(fp, jobs)
+// {{{
+static int	report(FILE *fp, const std::vector<REGRESSJOB> &jobs) {
+	int	npass = 0;
+
+	for(unsigned k=0; k<jobs.size(); k++) {
+		const REGRESSJOB &job = jobs[k];
+		char	result[32];
+
+		if (job.passed()) {
+			npass++;
+			strcpy(result, "PASS");
+		} else if (WIFSIGNALED(job.m_status))
+			sprintf(result, "FAIL (signal %d)",
+				WTERMSIG(job.m_status));
+		else if (WIFEXITED(job.m_status))
+			sprintf(result, "FAIL (exit %d)",
+				WEXITSTATUS(job.m_status));
+		else
+			strcpy(result, "FAIL");
+
+		fprintf(fp, "%-24s %-18s %9.2fs  %s\n", job.m_name.c_str(),
+			result, job.m_seconds, job.m_log.c_str());
+	}
+
+	fprintf(fp, "\n%d of %d tests passed%s\n", npass, (int)jobs.size(),
+		(npass == (int)jobs.size()) ? "\nPASS" : "\nFAIL");
+
+	return npass;
+}
+// }}}
+
+int	main(int argc, char **argv) {
+	std::vector<REGRESSJOB>		jobs;
+	std::vector<const char *>	patterns;
+	std::string	logdir = "regress.d";
+	bool		list_only = false, keep_traces = false;
+	int		njobs = 0, running = 0, npass;
+	unsigned	next = 0, ndone = 0;
+	double		start;
+
+	// Argument processing
+	// {{{
+	for(int argn=1; argn<argc; argn++) {
+		if ((argv[argn][0] == '-')&&(argv[argn][2] == '\0')
+				&&(strchr("jok", argv[argn][1]))
+				&&(argn+1 >= argc)) {
+			usage();
+			exit(EXIT_FAILURE);
+		} else if (strcmp(argv[argn], "-j") == 0) {
+			njobs = atoi(argv[++argn]);
+		} else if (strcmp(argv[argn], "-o") == 0) {
+			logdir = argv[++argn];
+		} else if (strcmp(argv[argn], "-k") == 0) {
+			patterns.push_back(argv[++argn]);
+		} else if (strcmp(argv[argn], "-l") == 0) {
+			list_only = true;
+		} else if (strcmp(argv[argn], "-t") == 0) {
+			keep_traces = true;
+		} else {
+			usage();
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (njobs <= 0)
+		njobs = sysconf(_SC_NPROCESSORS_ONLN);
+	if (njobs <= 0)
+		njobs = 1;
+	// }}}
+
+	// Build the list of tests
+	// {{{
+	{
+		std::vector<REGRESSJOB>	all;
+
+		for(unsigned k=0; k<NELEMS(basic_tests); k++)
+			add_job(all, basic_tests[k].m_prog,
+				basic_tests[k].m_prog, NULL,
+				basic_tests[k].m_traces, logdir, keep_traces);
+
+		for(unsigned t=0; t<NELEMS(sweep_tests); t++)
+		for(unsigned f=0; f<NELEMS(sweep_framing); f++)
+		for(unsigned b=0; b<NELEMS(sweep_baud); b++) {
+			unsigned	setup = sweep_framing[f].m_bits
+						| sweep_baud[b];
+			char		name[64], setupstr[16];
+
+			if (setup == sweep_tests[t].m_default_setup)
+				continue;
+
+			sprintf(name, "%s-%s-%u", sweep_tests[t].m_prog,
+				sweep_framing[f].m_name, sweep_baud[b]);
+			sprintf(setupstr, "0x%08x", setup);
+			add_job(all, name, sweep_tests[t].m_prog, setupstr,
+				sweep_tests[t].m_traces, logdir, keep_traces);
+		}
+
+		for(unsigned k=0; k<all.size(); k++) {
+			bool	keep = patterns.empty();
+
+			for(unsigned p=0; (!keep)&&(p<patterns.size()); p++)
+				keep = (strstr(all[k].m_name.c_str(),
+						patterns[p]) != NULL);
+			if (keep)
+				jobs.push_back(all[k]);
+		}
+	}
+
+	if (list_only) {
+		for(unsigned k=0; k<jobs.size(); k++) {
+			printf("%-24s", jobs[k].m_name.c_str());
+			for(unsigned a=0; a<jobs[k].m_args.size(); a++)
+				printf(" %s", jobs[k].m_args[a].c_str());
+			printf("\n");
+		}
+		exit(EXIT_SUCCESS);
+	} else if (jobs.empty()) {
+		fprintf(stderr, "No tests match\n");
+		exit(EXIT_FAILURE);
+	}
+	// }}}
+
+	if ((mkdir(logdir.c_str(), 0755) != 0)&&(errno != EEXIST)) {
+		fprintf(stderr, "Could not create %s\n", logdir.c_str());
+		perror("O/S ERR");
+		exit(EXIT_FAILURE);
+	}
+
+	// Run the tests
+	// {{{
+	start = now();
+	while(ndone < jobs.size()) {
+		int	status;
+		pid_t	pid;
+
+		// Keep njobs running
+		while((running < njobs)&&(next < jobs.size())) {
+			launch(jobs[next]);
+			if (jobs[next].m_pid == 0) {
+				// Couldn't start it, so it's already over
+				ndone++;
+			} else
+				running++;
+			next++;
+		}
+
+		if (running == 0)
+			continue;
+
+		// Then wait on whichever finishes first
+		pid = waitpid(-1, &status, 0);
+		if (pid < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("O/S ERR: waitpid");
+			break;
+		}
+
+		for(unsigned k=0; k<next; k++) {
+			if (jobs[k].m_pid != pid)
+				continue;
+
+			jobs[k].m_status  = status;
+			jobs[k].m_seconds = now() - jobs[k].m_start;
+			jobs[k].m_pid = 0;
+			running--;
+			ndone++;
+
+			printf("[%3u/%3u] %s %s\n", ndone, (unsigned)jobs.size(),
+				(jobs[k].passed()) ? "PASS" : "FAIL",
+				jobs[k].m_name.c_str());
+			break;
+		}
+	}
+	// }}}
+
+	// The report
+	// {{{
+	printf("\n");
+	npass = report(stdout, jobs);
+	printf("Total time: %.2f seconds, %d jobs at a time\n", now()-start,
+		njobs);
+
+	{
+		std::string	rname = logdir + "/report.txt";
+		FILE	*fp = fopen(rname.c_str(), "w");
+
+		if (fp) {
+			report(fp, jobs);
+			fclose(fp);
+		} else
+			fprintf(stderr, "Could not write %s\n", rname.c_str());
+	}
+	// }}}
+
+	return (npass == (int)jobs.size()) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,281 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	rxinttest.cpp
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Checks when the wbuart's receive FIFO interrupt is set, through
+//		the rxinttest.v design.  Each of several cases sends a burst of
+//	bytes to the design, and then measures when the interrupt rises,
+//	counted in clocks from the end of the last stop bit.  The interrupt
+//	should rise as the byte that brings the FIFO to its threshold arrives,
+//	or, when the threshold isn't reached, once the FIFO has sat idle for
+//	the timeout--and never otherwise.  Once it has risen, the design is
+//	told to read the FIFO dry.  The interrupt must then fall, with every
+//	byte accounted for.
+//
+//	The cases are:
+//		half full	No threshold nor timeout: the original interrupt,
+//				once the FIFO is half full
+//		threshold	-t bytes, with no timeout
+//		below threshold	One byte fewer.  This should never interrupt.
+//		timeout		One byte fewer, but with a timeout of -k baud
+//				intervals
+//		one byte	A single byte, with the same timeout
+//		packed		-t bytes again, in packed mode.  Bytes moved
+//				into the packed read buffer must still count
+//				towards the threshold.
+//		packed below	One byte fewer, in packed mode.  This should
+//				never interrupt.
+//		packed small	A threshold, and a burst, of two bytes in
+//				packed mode
+//
+//	Options:
+//		-s <setup>	The setup word.  Bit 30 is set, as the design
+//				has no flow control.  (Default: 25, 8N1)
+//		-t <bytes>	The receive threshold (Default: 6)
+//		-k <bauds>	The idle timeout, in baud intervals (Default:
+//				40, or four 8N1 characters)
+//		-l <lgflen>	The log, base two, of the FIFO size rxinttest.v
+//				was built with (Default: 4)
+//
+//	Built with USE_AXILUART defined, as rxinttestaxil, the same cases are
+//	run against the axiluart (Vrxinttestaxil) instead.
+//
+//	The result is a line per case, and a PASS or FAIL at the end.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <verilatedos.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "verilated.h"
+#ifdef	USE_AXILUART
+#include "Vrxinttestaxil.h"
+#define	SIMCLASS	Vrxinttestaxil
+#else
+#include "Vrxinttest.h"
+#define	SIMCLASS	Vrxinttest
+#endif
+#include "testb.h"
+
+typedef	TESTB<SIMCLASS, UARTSIMT<LOOPTRANSPORT> >	RXINTTB;
+
+// runcase(name, setup, packed, threshold, timeout, nbytes, expect, lo, hi)
+// {{{
+// Runs one case, returning true if it passes.  If expect is set, the interrupt
+// must rise between lo and hi clocks from the end of the last byte's stop bit.
+// Otherwise, it mustn't rise at all, for as long as hi clocks past that point.
+static bool	runcase(const char *name, unsigned setup, bool packed,
+		unsigned threshold, unsigned timeout, unsigned nbytes,
+		bool expect, long lo, long hi) {
+	unsigned	baudclocks = setup & 0x0ffffff;
+	unsigned	char_clocks = baudclocks * (2 + (8-((setup>>28)&3))
+				+ ((setup>>26)&1) + ((setup>>27)&1));
+	char		*msg = new char[nbytes], reply[1];
+	unsigned long	last_start = 0, int_clock = 0;
+	bool		sent = false, raised = false, pass;
+	long		when = 0;
+
+	for(unsigned k=0; k<nbytes; k++)
+		msg[k] = (char)(k * 5 + 1);
+
+	RXINTTB	tb(msg, (int)nbytes, reply, 1);
+
+	tb.m_uart.setup(setup);
+
+	// Reset the design, and give it time to set itself up
+	// {{{
+	// Only the design is clocked until then, so that the UARTSIM doesn't
+	// start sending until the receiver is ready for it.
+	tb.m_core.i_setup     = setup;
+	tb.m_core.i_packed    = (packed) ? 1 : 0;
+	tb.m_core.i_threshold = threshold;
+	tb.m_core.i_timeout   = timeout;
+	tb.m_core.i_drain     = 0;
+	tb.m_core.i_uart_rx   = 1;
+	tb.m_core.i_reset     = 1;
+	for(int k=0; k<4; k++)
+		tb.clock();
+	tb.m_core.i_reset = 0;
+
+	while(!tb.m_core.o_ready)
+		tb.clock();
+	for(unsigned k=0; k<baudclocks*24; k++)
+		tb.clock();
+	// }}}
+
+	// Send the bytes, and wait for the interrupt
+	// {{{
+	unsigned long	deadline = tb.clocks() + 2 * (nbytes+4) * char_clocks;
+
+	while(!raised) {
+		tb.tick();
+		if (!sent) {
+			tb.sync();
+			if (tb.m_uart.tx_chars() >= nbytes) {
+				sent = true;
+				last_start = tb.clocks();
+			}
+		}
+
+		if (tb.m_core.o_rxfifo_int) {
+			raised = true;
+			int_clock = tb.clocks();
+		} else if ((sent)&&((long)(tb.clocks() - last_start)
+				> (long)char_clocks + hi))
+			break;
+		else if ((!sent)&&(tb.clocks() > deadline))
+			break;
+	}
+
+	if (raised)
+		when = (long)int_clock - (long)(last_start + char_clocks);
+	// }}}
+
+	// Check the result
+	// {{{
+	if (expect)
+		pass = (raised)&&(sent)&&(when >= lo)&&(when <= hi);
+	else
+		pass = (sent)&&(!raised);
+
+	printf("%-16s %3u bytes, threshold %3u, timeout %5u: ", name, nbytes,
+		threshold, timeout);
+	if ((!raised)&&(!sent))
+		printf("only %lu bytes sent", tb.m_uart.tx_chars());
+	else if (!raised)
+		printf("no interrupt");
+	else if (!sent)
+		printf("interrupt before the last byte");
+	else
+		printf("interrupt at %+6ld clocks", when);
+	if (expect)
+		printf(" (expected %+ld to %+ld)", lo, hi);
+	// }}}
+
+	// Drain the FIFO
+	// {{{
+	if (raised) {
+		deadline = tb.clocks() + 64 * (nbytes + 1);
+
+		tb.m_core.i_drain = 1;
+		while(((tb.m_core.o_count < nbytes)||(tb.m_core.o_rxfifo_int))
+				&&(tb.clocks() < deadline))
+			tb.tick();
+		tb.m_core.i_drain = 0;
+
+		if ((tb.m_core.o_count != nbytes)||(tb.m_core.o_rxfifo_int)) {
+			printf(", but read %u bytes, interrupt %s",
+				tb.m_core.o_count,
+				(tb.m_core.o_rxfifo_int) ? "stuck" : "clear");
+			pass = false;
+		}
+	}
+
+	printf(": %s\n", (pass) ? "PASS" : "FAIL");
+	// }}}
+
+	tb.close();
+	delete[] msg;
+	return pass;
+}
+// }}}
+
+int	main(int argc, char **argv) {
+	Verilated::commandArgs(argc, argv);
+	unsigned	setup = 25, threshold = 6, timeout = 40, lgflen = 4,
+			baudclocks, half;
+	bool		pass = true;
+
+	// Argument processing
+	// {{{
+	for(int argn=1; argn<argc; argn++) {
+		if (argv[argn][0] == '-') for(int j=1; (j<1000)&&(argv[argn][j]); j++)
+		switch(argv[argn][j]) {
+			case 's':
+				setup = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 't':
+				threshold = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'k':
+				timeout = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'l':
+				lgflen = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			default:
+				printf("Undefined option, -%c\n", argv[argn][j]);
+				break;
+		}
+	}
+	// }}}
+
+	setup = (setup & 0x3fffffff) | 0x40000000;
+	baudclocks = setup & 0x0ffffff;
+	half = 1u << (lgflen-1);
+	if ((lgflen < 2)||(lgflen > 15)||(threshold < 2)
+			||(threshold >= (1u<<lgflen))||(timeout < 2)
+			||(timeout > 0x0ffff)) {
+		fprintf(stderr, "ERR: Bad -t, -k, or -l\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// The threshold interrupt is set as the last byte is written into the
+	// FIFO, somewhere in its stop bit.  The timeout follows the last byte
+	// by the timeout, less up to one baud interval for the free running
+	// baud counter.  The few clocks of slack cover the FIFO's latency.
+	long	lvlo = -2 * (long)baudclocks, lvhi = 16,
+		tmlo = (long)(timeout-2) * baudclocks,
+		tmhi = (long)timeout * baudclocks + 16;
+
+	pass = runcase("half full", setup, false, 0, 0, half, true,
+			lvlo, lvhi) && pass;
+	pass = runcase("threshold", setup, false, threshold, 0, threshold, true,
+			lvlo, lvhi) && pass;
+	pass = runcase("below threshold", setup, false, threshold, 0,
+			threshold-1, false, 0, 2*tmhi) && pass;
+	pass = runcase("timeout", setup, false, threshold, timeout,
+			threshold-1, true, tmlo, tmhi) && pass;
+	pass = runcase("one byte", setup, false, threshold, timeout, 1, true,
+			tmlo, tmhi) && pass;
+	pass = runcase("packed", setup, true, threshold, 0, threshold, true,
+			lvlo, lvhi) && pass;
+	pass = runcase("packed below", setup, true, threshold, 0, threshold-1,
+			false, 0, 2*tmhi) && pass;
+	pass = runcase("packed small", setup, true, 2, 0, 2, true,
+			lvlo, lvhi) && pass;
+
+	printf("%s\n", (pass) ? "PASS" : "FAIL");
+	exit((pass) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -0,0 +1,333 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	scoreboard.cpp
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Implements the scoreboard described in scoreboard.h.  Only
+//		check() itself, in the header, runs every clock.  Everything
+//	here runs once per character, or once on a failure.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "scoreboard.h"
+
+// No deadline is pending
+#define	NOTIME	(~0ul)
+
+// SBLINE::level_at(clock)
+// {{{
+int	SBLINE::level_at(unsigned long clock) const {
+	unsigned	n = (m_nedges < SCOREBOARD_EDGES) ? m_nedges
+				: SCOREBOARD_EDGES;
+
+	// Newest to oldest, for the last edge at or before the clock
+	for(unsigned k=1; k<=n; k++) {
+		const SBEDGE &e = m_edges[(m_nedges-k) & (SCOREBOARD_EDGES-1)];
+		if (e.m_clock <= clock)
+			return e.m_level;
+	}
+
+	// Before any edge at all, the line was idle
+	return (m_nedges <= SCOREBOARD_EDGES) ? 1 : -1;
+}
+// }}}
+
+// SBLINE::frame_start(clock)
+// {{{
+unsigned long	SBLINE::frame_start(unsigned long clock) const {
+	unsigned	n = (m_nedges < SCOREBOARD_EDGES) ? m_nedges
+				: SCOREBOARD_EDGES;
+
+	// Oldest to newest, for the first falling edge at or after the clock
+	for(unsigned k=n; k>0; k--) {
+		const SBEDGE &e = m_edges[(m_nedges-k) & (SCOREBOARD_EDGES-1)];
+		if ((e.m_clock >= clock)&&(e.m_level == 0))
+			return e.m_clock;
+	}
+
+	return clock;
+}
+// }}}
+
+// SCOREBOARD::SCOREBOARD(setup, lgfrac, fp)
+// {{{
+SCOREBOARD::SCOREBOARD(unsigned setup, unsigned lgfrac, FILE *fp)
+		: m_rx("RX", "UARTSIM", "design's receiver"),
+		m_tx("TX", "design's transmitter", "UARTSIM"), m_fp(fp) {
+	this->setup(setup, lgfrac);
+}
+// }}}
+
+// SCOREBOARD::setup(setup, lgfrac)
+// {{{
+void	SCOREBOARD::setup(unsigned setup, unsigned lgfrac) {
+	double	early, late;
+
+	m_setup  = setup;
+	m_lgfrac = (lgfrac > 15) ? 15 : lgfrac;
+	m_baud   = (double)(setup & 0x0ffffff) / (double)(1u << m_lgfrac);
+	if (m_baud < 1.0)
+		m_baud = 1.0;
+
+	// A character can't arrive before its stop bit has begun, and should
+	// arrive within the stop bit(s).  A baud interval, and a few clocks,
+	// are allowed for the design's (and the UARTSIM's) own delays.
+	early = (1+nbits()+nparity()) * m_baud - 2;
+	late  = (2+nbits()+nparity()+nstop()) * m_baud + 4;
+	m_early = (early > 0) ? (unsigned long)early : 0;
+	m_late  = (unsigned long)ceil(late);
+
+	m_rx.clear();
+	m_tx.clear();
+	m_failed = false;
+	m_uart_sent = m_uart_rcvd = m_uart_errs = 0;
+	m_deadline = NOTIME;
+}
+// }}}
+
+// SCOREBOARD::update_deadline
+// {{{
+// The soonest either line's oldest character must arrive by
+void	SCOREBOARD::update_deadline(void) {
+	m_deadline = NOTIME;
+	if (!m_rx.empty())
+		m_deadline = m_rx.oldest().m_sent + m_late;
+	if ((!m_tx.empty())&&(m_tx.oldest().m_sent + m_late < m_deadline))
+		m_deadline = m_tx.oldest().m_sent + m_late;
+}
+// }}}
+
+// SCOREBOARD::sent(line, ch, clock)
+// {{{
+void	SCOREBOARD::sent(SBLINE &line, int ch, unsigned long clock) {
+	if (line.m_qhead - line.m_qtail >= SCOREBOARD_QUEUE) {
+		diverged(line, "Too many characters outstanding", ch, -1,
+			clock, clock);
+		return;
+	}
+
+	SBLINE::SBCHAR	&c = line.m_queue[(line.m_qhead++)
+					& (SCOREBOARD_QUEUE-1)];
+	c.m_sent = clock;
+	c.m_seen = 0;
+	c.m_ch   = ch & data_mask();
+	if (line.m_qhead - line.m_qtail == 1)
+		update_deadline();
+}
+// }}}
+
+// SCOREBOARD::seen(line, ch, err, clock)
+// {{{
+void	SCOREBOARD::seen(SBLINE &line, int ch, bool err, unsigned long clock) {
+	ch &= data_mask();
+	if (line.empty()) {
+		diverged(line, "Unexpected character", -1, ch, clock, clock);
+		return;
+	}
+
+	SBLINE::SBCHAR	c = line.oldest();
+
+	if (c.m_ch != ch)
+		diverged(line, "Wrong character", c.m_ch, ch, c.m_sent, clock);
+	else if (err)
+		diverged(line, "Character received with an error", c.m_ch, ch,
+			c.m_sent, clock);
+	else if (clock < c.m_sent + m_early)
+		diverged(line, "Character arrived too soon", c.m_ch, ch,
+			c.m_sent, clock);
+	if (m_failed)
+		return;
+
+	line.m_qtail++;
+	line.m_matched++;
+	c.m_seen = clock;
+	line.m_history[(line.m_nhistory++) & (SCOREBOARD_HISTORY-1)] = c;
+	update_deadline();
+}
+// }}}
+
+// SCOREBOARD::timeout(clock)
+// {{{
+void	SCOREBOARD::timeout(unsigned long clock) {
+	SBLINE	&line = ((!m_rx.empty())&&(m_rx.oldest().m_sent + m_late
+				<= clock)) ? m_rx : m_tx;
+
+	diverged(line, "Character never arrived", line.oldest().m_ch, -1,
+		line.oldest().m_sent, clock);
+}
+// }}}
+
+// SCOREBOARD::frame(line, start, ch)
+// {{{
+// Writes out a frame as it was on the line, sampled mid bit, starting at the
+// given clock--or, if ch isn't negative, that character's frame as it should
+// have been
+void	SCOREBOARD::frame(const SBLINE &line, unsigned long start, int ch)
+		const {
+	const unsigned	nb = 1+nbits()+nparity()+nstop();
+	char		str[64];
+	unsigned	p = 0;
+
+	for(unsigned k=0; k<nb; k++) {
+		int	v;
+
+		if ((k == 1)||(k == 1+nbits())
+				||((nparity())&&(k == 2+nbits())))
+			str[p++] = ' ';
+
+		if (ch >= 0) {
+			// The frame that should've been sent
+			if (k == 0)
+				v = 0;
+			else if (k <= nbits())
+				v = (ch >> (k-1))&1;
+			else if ((nparity())&&(k == 1+nbits())) {
+				if ((m_setup >> 25)&1)		// Fixed parity
+					v = (m_setup >> 24)&1;
+				else {
+					v = ((m_setup >> 24)&1)^1;
+					for(unsigned b=0; b<nbits(); b++)
+						v ^= (ch >> b)&1;
+				}
+			} else
+				v = 1;
+		} else
+			v = line.level_at(start + (unsigned long)((k+0.5)*m_baud));
+
+		str[p++] = (v < 0) ? '?' : ('0'+v);
+	}
+	str[p] = '\0';
+
+	fprintf(m_fp, "%s", str);
+}
+// }}}
+
+// SCOREBOARD::diverged(line, why, expected, actual, sent, clock)
+// {{{
+// Reports the first divergence.  expected or actual are negative if there was
+// no such character.
+void	SCOREBOARD::diverged(SBLINE &line, const char *why, int expected,
+		int actual, unsigned long sent, unsigned long clock) {
+	unsigned long	start;
+
+	m_failed = true;
+
+	fprintf(m_fp, "SCOREBOARD: %s diverged at clock %lu:  %s\n",
+		line.m_name, clock, why);
+	fprintf(m_fp, "\tFrom the %s to the %s\n", line.m_from, line.m_to);
+	if (expected >= 0)
+		fprintf(m_fp, "\tExpected 0x%02x, sent at clock %lu\n",
+			expected, sent);
+	if (actual >= 0)
+		fprintf(m_fp, "\tReceived 0x%02x, at clock %lu\n",
+			actual, clock);
+
+	// Where on the line the first bad bit was
+	// {{{
+	start = line.frame_start(sent);
+	if ((expected >= 0)&&(actual >= 0)&&(expected != actual)) {
+		unsigned	bit = 0, x = expected ^ actual;
+		unsigned long	from, to;
+
+		while(((x >> bit)&1) == 0)
+			bit++;
+		from = start + (unsigned long)((1+bit) * m_baud);
+		to   = start + (unsigned long)((2+bit) * m_baud);
+		fprintf(m_fp, "\tFirst bad bit:  d%u, on the line from clock "
+			"%lu to %lu (sampled near %lu)\n", bit, from, to,
+			(from+to)/2);
+	}
+	// }}}
+
+	// The frame, as it was, and as it should have been
+	// {{{
+	// Both are written start bit first, then the data bits (d0 first),
+	// any parity bit, and the stop bit(s)
+	if (expected >= 0) {
+		int	w;
+
+		w = fprintf(m_fp, "\tOn the line, from clock %lu:  ", start);
+		frame(line, start, -1);
+		fprintf(m_fp, "\n%-*s", (w > 0) ? w : 0, "\tExpected:");
+		frame(line, start, expected);
+		fprintf(m_fp, "\n");
+	}
+	// }}}
+
+	// What led up to it
+	// {{{
+	{
+		unsigned	n, first;
+
+		n = (line.m_nhistory < SCOREBOARD_HISTORY) ? line.m_nhistory
+				: SCOREBOARD_HISTORY;
+		if (n > 0)
+			fprintf(m_fp, "\tThe last %u characters matched "
+				"(of %lu):\n", n, line.m_matched);
+		first = line.m_nhistory - n;
+		for(unsigned k=first; k<line.m_nhistory; k++) {
+			const SBLINE::SBCHAR &c
+				= line.m_history[k & (SCOREBOARD_HISTORY-1)];
+			fprintf(m_fp, "\t\t0x%02x, sent at %lu, seen at %lu\n",
+				c.m_ch, c.m_sent, c.m_seen);
+		}
+
+		n = (line.m_nedges < SCOREBOARD_EDGES) ? line.m_nedges
+				: SCOREBOARD_EDGES;
+		if (n > 16)
+			n = 16;
+		if (n > 0)
+			fprintf(m_fp, "\tThe last %u edges on the line "
+				"(clock:level):\n\t\t", n);
+		for(unsigned k=n; k>0; k--) {
+			const SBLINE::SBEDGE &e = line.m_edges[(line.m_nedges-k)
+					& (SCOREBOARD_EDGES-1)];
+			fprintf(m_fp, "%lu:%d%s", e.m_clock, e.m_level,
+				(k == 1) ? "\n" : ((n-k)%6 == 5) ? "\n\t\t":" ");
+		}
+	}
+	// }}}
+}
+// }}}
+
+// SCOREBOARD::report(void)
+// {{{
+void	SCOREBOARD::report(void) const {
+	fprintf(m_fp, "SCOREBOARD: %lu characters into the design, and %lu "
+		"out of it, %s\n", m_rx.m_matched, m_tx.m_matched,
+		(m_failed) ? "before diverging" : "all matched");
+}
+// }}}
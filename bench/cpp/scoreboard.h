@@ -0,0 +1,226 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	scoreboard.h
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Checks a design against the UARTSIM on its line, clock by
+//		clock, so that a failing test can say where it first went
+//	wrong without needing a trace to be rerun.
+//
+//	Both directions are checked.  Each character the UARTSIM starts
+//	sending must come out of the design's receiver (its o_rx_stb and
+//	o_rx_data), unchanged and without error, in order, and within a
+//	character time of when its start bit began.  Likewise, each character
+//	handed to the design's transmitter (o_tx_stb and o_tx_data) must be
+//	decoded by the UARTSIM, with no parity or framing error, within a
+//	character time.
+//
+//	Only a handful of characters are ever outstanding, and the only work
+//	done on most clocks is a few comparisons, so this costs very little
+//	next to the design itself.  A short history is also kept, of the last
+//	SCOREBOARD_EDGES edges on each line and the last SCOREBOARD_HISTORY
+//	characters each way.  At the first divergence, this is used to report
+//	the clock, the first bit that differed, when that bit was on the line,
+//	the frame as it was on the line (sampled mid bit), and what led up to
+//	it.  From then on, check() returns false, and nothing more is checked.
+//
+//	The design must have the i_uart_rx and o_uart_tx ports, as well as
+//	o_rx_stb, o_rx_data, o_rx_err (any break, parity, or framing error),
+//	o_tx_stb, and o_tx_data, as linetest.v does.
+//
+//	Usage:
+//		SCOREBOARD	sb(setup, lgfrac);
+//		...
+//		Every clock:
+//			tb.tick();
+//			if (!sb.check(tb.m_core, tb.m_uart, tb.clocks()))
+//				break;
+//		...
+//		sb.report();
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	SCOREBOARD_H
+#define	SCOREBOARD_H
+
+#include <stdio.h>
+
+// How many characters may be outstanding each way, how many of those already
+// checked are kept for the report, and how many edges are kept of each line.
+// All must be powers of two.
+#define	SCOREBOARD_QUEUE	16
+#define	SCOREBOARD_HISTORY	8
+#define	SCOREBOARD_EDGES	64
+
+// SBLINE
+// {{{
+// One direction:  the characters sent on a line, in order, that have yet to
+// be seen at its far end, the last few that have been, and the line's last
+// few edges
+class	SBLINE {
+public:
+	typedef	struct { unsigned long m_sent, m_seen; int m_ch; } SBCHAR;
+	typedef	struct { unsigned long m_clock; int m_level; } SBEDGE;
+
+	const char	*m_name, *m_from, *m_to;
+	SBCHAR		m_queue[SCOREBOARD_QUEUE], m_history[SCOREBOARD_HISTORY];
+	SBEDGE		m_edges[SCOREBOARD_EDGES];
+	unsigned	m_qhead, m_qtail, m_nhistory, m_nedges;
+	int		m_level;
+	unsigned long	m_matched;
+
+	SBLINE(const char *name, const char *from, const char *to)
+		: m_name(name), m_from(from), m_to(to) { clear(); }
+
+	void	clear(void) {
+		m_qhead = m_qtail = m_nhistory = m_nedges = 0;
+		m_level = 1;
+		m_matched = 0;
+	}
+
+	bool	empty(void) const { return (m_qhead == m_qtail); }
+	const SBCHAR	&oldest(void) const {
+		return m_queue[m_qtail & (SCOREBOARD_QUEUE-1)]; }
+
+	void	edge(int level, unsigned long clock) {
+		SBEDGE	&e = m_edges[(m_nedges++) & (SCOREBOARD_EDGES-1)];
+		e.m_clock = clock;
+		e.m_level = m_level = level;
+	}
+
+	// level_at(clock) is the line's level as of the given clock, or -1 if
+	// that's from before the edges kept.  frame_start(clock) is the clock
+	// of the first start bit (falling edge) at or after the given clock,
+	// or the clock itself if there's none.
+	int		level_at(unsigned long clock) const;
+	unsigned long	frame_start(unsigned long clock) const;
+};
+// }}}
+
+// SCOREBOARD
+// {{{
+class	SCOREBOARD {
+	SBLINE		m_rx, m_tx;
+	FILE		*m_fp;
+	unsigned	m_setup, m_lgfrac;
+	double		m_baud;
+	unsigned long	m_early, m_late, m_deadline;
+	bool		m_failed;
+
+	// The UARTSIM's counts, as of the last check()
+	unsigned long	m_uart_sent, m_uart_rcvd, m_uart_errs;
+
+	unsigned	nbits(void) const { return 8-((m_setup >> 28)&3); }
+	unsigned	nparity(void) const { return (m_setup >> 26)&1; }
+	unsigned	nstop(void) const { return ((m_setup >> 27)&1)+1; }
+	unsigned	data_mask(void) const { return (1u << nbits())-1; }
+
+	void	update_deadline(void);
+
+	// sent(line, ch, clock) queues a character started on the line,
+	// seen(line, ch, err, clock) checks one arriving at its far end, and
+	// diverged() reports the first failure
+	void	sent(SBLINE &line, int ch, unsigned long clock);
+	void	seen(SBLINE &line, int ch, bool err, unsigned long clock);
+	void	timeout(unsigned long clock);
+	void	diverged(SBLINE &line, const char *why, int expected, int actual,
+			unsigned long sent, unsigned long clock);
+	void	frame(const SBLINE &line, unsigned long start, int ch) const;
+public:
+	// SCOREBOARD(setup, lgfrac, fp)
+	// {{{
+	// The setup, and its fractional bits, give the framing and baud rate
+	// of both lines.  Any divergence, and the report, are written to fp.
+	SCOREBOARD(unsigned setup, unsigned lgfrac = 0, FILE *fp = stderr);
+	// }}}
+
+	// setup(setup, lgfrac)
+	// {{{
+	// Changes the framing or baud rate, as when the design and the
+	// UARTSIM are set up anew.  Anything outstanding is forgotten.
+	void	setup(unsigned setup, unsigned lgfrac = 0);
+	// }}}
+
+	// check(core, uart, clock)
+	// {{{
+	// Called after every clock, once the UARTSIM has been stepped (as
+	// TESTB::tick() does), with the clock count.  Returns false once the
+	// design and the UARTSIM have diverged.
+	template <class VA, class UART>
+	bool	check(const VA &core, const UART &uart, unsigned long clock) {
+		if (m_failed)
+			return false;
+
+		// The line edges
+		if (core.i_uart_rx != m_rx.m_level)
+			m_rx.edge(core.i_uart_rx, clock);
+		if (core.o_uart_tx != m_tx.m_level)
+			m_tx.edge(core.o_uart_tx, clock);
+
+		// Into the design
+		if (uart.tx_chars() != m_uart_sent) {
+			m_uart_sent = uart.tx_chars();
+			sent(m_rx, uart.tx_last_char(), clock);
+		} if (core.o_rx_stb)
+			seen(m_rx, core.o_rx_data, core.o_rx_err, clock);
+
+		// Out of the design
+		if (core.o_tx_stb)
+			sent(m_tx, core.o_tx_data, clock);
+		if (uart.rx_chars() != m_uart_rcvd) {
+			unsigned long	errs = uart.rx_parity_errors()
+						+ uart.rx_frame_errors();
+
+			m_uart_rcvd = uart.rx_chars();
+			seen(m_tx, uart.rx_last_char(), (errs != m_uart_errs),
+				clock);
+			m_uart_errs = errs;
+		}
+
+		if (clock >= m_deadline)
+			timeout(clock);
+
+		return !m_failed;
+	}
+	// }}}
+
+	// failed(void), report(void)
+	// {{{
+	// failed() is true once anything has diverged.  report() writes a one
+	// line summary of what's been checked.
+	bool	failed(void) const { return m_failed; }
+	void	report(void) const;
+	// }}}
+};
+// }}}
+
+#endif
@@ -0,0 +1,584 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	soaktest.cpp
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	A soak test: streams data through either linetest.v or
+//		speechfifo.v for as long as it is let run--hours, or billions
+//	of characters--and checks all of it as it arrives, in constant memory.
+//
+//	Nothing received is ever kept.  Instead, the data is treated as a
+//	series of lines, each ending in a newline.  The payload is generated
+//	so that its n'th line can always be generated again, and each line
+//	received is checked by comparing its CRC-32 and length against those
+//	of the line expected there.  A line that doesn't match is an error.
+//	The check then looks for the received line a few lines either side of
+//	where it was expected, so that a lost, split, or repeated line costs
+//	only a few errors, rather than throwing off everything after it.
+//
+//	Against linetest, which echoes each line it receives, the payload is
+//	either pseudo-random lines of printable characters, or the lines of a
+//	text file (-f) over and over.  The UARTSIM keeps no more than two lines
+//	outstanding, so as not to overflow the design's 256 byte buffer, but
+//	otherwise sends as fast as the design will echo.
+//
+//	Against speechfifo, which sends its message on its own, the payload is
+//	that message--speech.txt, or whatever -f names, which must then match
+//	speech.hex--repeated for as long as the test runs.  speechfifo only
+//	restarts its message once every 2^31 clocks, so it spends most of its
+//	time idle.
+//
+//	Every -P seconds, a report is written of the clocks and bytes so far,
+//	the rate of each over the last interval and overall, and the number of
+//	line, parity, and framing errors.
+//
+//	Options:
+//		-d <design>	linetest (the default) or speechfifo
+//		-s <setup>	The setup word (Default: 25, 8N1)
+//		-f <file>.txt	Sends the lines of this file, over and over,
+//				rather than pseudo-random ones
+//		-r <seed>	The seed for the pseudo-random lines
+//		-c <clocks>	Stops after this many clocks
+//		-n <bytes>	Stops after this many bytes have been received
+//		-t <seconds>	Stops after this many seconds
+//		-P <seconds>	Seconds between reports (Default: 10)
+//
+//	Without a -c, -n, or -t, the soak runs until interrupted (^C), and
+//	then writes a final report.  It ends in PASS if nothing was in error.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <verilatedos.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <vector>
+#include "verilated.h"
+#include "Vlinetest.h"
+#include "Vspeechfifo.h"
+#include "testb.h"
+
+// crc32
+// {{{
+// The usual (reflected, 0xedb88320) CRC-32, a byte at a time
+static uint32_t	crctbl[256];
+
+static void	crc_init(void) {
+	for(unsigned k=0; k<256; k++) {
+		uint32_t	c = k;
+		for(int b=0; b<8; b++)
+			c = (c & 1) ? (0xedb88320u ^ (c >> 1)) : (c >> 1);
+		crctbl[k] = c;
+	}
+}
+
+static inline uint32_t	crc_byte(uint32_t crc, unsigned ch) {
+	return crctbl[(crc ^ ch) & 0x0ff] ^ (crc >> 8);
+}
+// }}}
+
+// SOAKSOURCE
+// {{{
+// The payload, one line at a time.  Any line, n, may be asked for at any time,
+// so the checker can regenerate what it expects rather than keeping what was
+// sent.  The lines are either those of a text file, repeated, or pseudo-random
+// lines of 1-79 printable characters.  Either way, only the data bits of
+// each character (mask) are kept.
+class	SOAKSOURCE {
+	std::vector<char>	m_text;
+	std::vector<size_t>	m_start;	// Where each line begins
+	uint64_t	m_seed;
+	unsigned	m_mask, m_maxline;
+public:
+	static const unsigned	RANDLINE = 80;
+
+	SOAKSOURCE(uint64_t seed, unsigned mask)
+		: m_seed(seed), m_mask(mask), m_maxline(RANDLINE) {}
+
+	// load(fname, crlf)
+	// {{{
+	// Switches from pseudo-random lines to those of the given file, with
+	// (if crlf) a CR placed before every LF, as mkspeech does.  The file
+	// must end in a newline.
+	bool	load(const char *fname, bool crlf) {
+		FILE	*fp = fopen(fname, "rb");
+		int	ch;
+
+		if (fp == NULL) {
+			fprintf(stderr, "ERR: Cannot open %s\n", fname);
+			return false;
+		}
+
+		m_text.clear();
+		m_start.clear();
+		m_start.push_back(0);
+		m_maxline = 0;
+		while((ch = fgetc(fp)) != EOF) {
+			if ((ch == '\n')&&(crlf))
+				m_text.push_back('\r');
+			m_text.push_back((char)ch);
+			if (ch == '\n') {
+				size_t	len = m_text.size() - m_start.back();
+				if (len > m_maxline)
+					m_maxline = len;
+				m_start.push_back(m_text.size());
+			}
+		} fclose(fp);
+
+		if ((m_text.empty())||(m_text.back() != '\n')) {
+			fprintf(stderr, "ERR: %s is empty, or doesn\'t end in a newline\n", fname);
+			return false;
+		} return true;
+	}
+	// }}}
+
+	// The longest line, including its newline
+	unsigned	maxline(void) const { return m_maxline; }
+
+	// line(n, buf)
+	// {{{
+	// Writes the n'th line, ending in a newline, into buf--which must have
+	// room for maxline() characters--and returns its length
+	unsigned	line(uint64_t n, char *buf) const {
+		unsigned	len;
+
+		if (!m_text.empty()) {
+			size_t	k = (size_t)(n % (m_start.size()-1));
+
+			len = (unsigned)(m_start[k+1] - m_start[k]);
+			for(unsigned i=0; i<len; i++)
+				buf[i] = m_text[m_start[k]+i] & m_mask;
+			return len;
+		}
+
+		// A splitmix64 hash of the line number starts an xorshift64
+		// generator for the line
+		uint64_t	z = m_seed + (n+1) * 0x9e3779b97f4a7c15ull;
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		z = (z ^ (z >> 31)) | 1;
+
+		len = 1 + (unsigned)(z % (RANDLINE-1));
+		for(unsigned i=0; i<len; i++) {
+			int	ch;
+
+			z ^= z << 13; z ^= z >> 7; z ^= z << 17;
+			ch = (0x20 + (int)(z % 95)) & m_mask;
+			// With fewer than 8 bits, a character might become a
+			// line ending
+			if ((ch == '\n')||(ch == '\r'))
+				ch ^= 1;
+			buf[i] = ch;
+		}
+		buf[len++] = '\n';
+		return len;
+	}
+	// }}}
+};
+// }}}
+
+// SOAKCHECK
+// {{{
+// Checks the received data a line at a time, as it arrives, against the
+// lines of a SOAKSOURCE
+class	SOAKCHECK {
+	// How far either side of where a line was expected to look for it
+	static const int	BEHIND = 2, AHEAD = 8;
+
+	const SOAKSOURCE	&m_src;
+	char		*m_expect;
+	uint64_t	m_next;		// The line expected next
+	uint32_t	m_crc;
+	unsigned	m_len, m_mask;
+	unsigned long	m_bytes, m_lines, m_errors, m_resyncs;
+
+	bool	matches(uint64_t n) {
+		unsigned	len = m_src.line(n, m_expect);
+		uint32_t	crc = 0xffffffffu;
+
+		if (len != m_len)
+			return false;
+		for(unsigned k=0; k<len; k++)
+			crc = crc_byte(crc, (unsigned char)m_expect[k]);
+		return (crc == m_crc);
+	}
+
+	void	end_of_line(void) {
+		m_lines++;
+		if (matches(m_next)) {
+			m_next++;
+		} else {
+			// Look for what was received nearby, in case lines
+			// were lost, split, or repeated
+			uint64_t	first = (m_next > BEHIND)
+						? m_next - BEHIND : 0;
+
+			m_errors++;
+			for(uint64_t n=first; n<=m_next+AHEAD; n++) {
+				if ((n != m_next)&&(matches(n))) {
+					// Count any lines skipped over as lost
+					if (n > m_next+1)
+						m_errors += n - m_next - 1;
+					m_resyncs++;
+					m_next = n;
+					break;
+				}
+			} m_next++;
+		}
+
+		m_crc = 0xffffffffu;
+		m_len = 0;
+	}
+public:
+	SOAKCHECK(const SOAKSOURCE &src, unsigned mask) : m_src(src),
+			m_next(0), m_crc(0xffffffffu), m_len(0), m_mask(mask),
+			m_bytes(0), m_lines(0), m_errors(0), m_resyncs(0) {
+		m_expect = new char[src.maxline()];
+	}
+
+	~SOAKCHECK(void) { delete[] m_expect; }
+
+	void	byte(int ch) {
+		ch &= m_mask;
+		m_crc = crc_byte(m_crc, ch);
+		m_len++;
+		m_bytes++;
+		// A line that's already too long to match anything ends here
+		if ((ch == '\n')||(m_len > m_src.maxline()))
+			end_of_line();
+	}
+
+	unsigned long	bytes(void) const { return m_bytes; }
+	unsigned long	lines(void) const { return m_lines; }
+	unsigned long	errors(void) const { return m_errors; }
+	unsigned long	resyncs(void) const { return m_resyncs; }
+};
+// }}}
+
+// SOAKTRANSPORT
+// {{{
+// The UARTSIM's host.  Everything received goes straight to the SOAKCHECK.
+// With a nonzero window, the SOAKSOURCE's lines are also sent, so long as no
+// more than window bytes are outstanding (sent, but not yet received back).
+//
+// Should the design lose anything, the window would never open again.  So,
+// if the host has been polled (once a baud) while the window was full for
+// long enough to have received the whole window twice over, whatever is
+// outstanding is presumed lost, and the window starts over.
+class	SOAKTRANSPORT {
+	const SOAKSOURCE	*m_src;
+	SOAKCHECK	*m_check;
+	unsigned	m_window, m_len, m_posn, m_blocked;
+	char		*m_line;
+	uint64_t	m_next;
+	unsigned long	m_sent, m_lost, m_stalls;
+public:
+	SOAKTRANSPORT(const SOAKSOURCE *src, SOAKCHECK *check, unsigned window)
+			: m_src(src), m_check(check), m_window(window),
+			m_len(0), m_posn(0), m_blocked(0), m_next(0),
+			m_sent(0), m_lost(0), m_stalls(0) {
+		m_line = new char[src->maxline()];
+	}
+
+	~SOAKTRANSPORT(void) { delete[] m_line; }
+
+	int	read(char *buf, int len) {
+		unsigned long	outstanding = m_sent - m_lost - m_check->bytes();
+		int		nr = 0;
+
+		if (outstanding >= m_window) {
+			// Each character takes at least ten bauds
+			if (++m_blocked < 20 * m_window)
+				return 0;
+			m_lost += outstanding;
+			m_stalls++;
+			outstanding = 0;
+		}
+		m_blocked = 0;
+		if ((unsigned long)len > m_window - outstanding)
+			len = (int)(m_window - outstanding);
+
+		while(nr < len) {
+			unsigned	ln;
+
+			if (m_posn >= m_len) {
+				m_len  = m_src->line(m_next++, m_line);
+				m_posn = 0;
+			}
+
+			ln = m_len - m_posn;
+			if (ln > (unsigned)(len - nr))
+				ln = len - nr;
+			memcpy(&buf[nr], &m_line[m_posn], ln);
+			m_posn += ln;
+			nr += ln;
+		}
+
+		m_sent += nr;
+		return nr;
+	}
+
+	int	write(const char *buf, int len) {
+		for(int k=0; k<len; k++)
+			m_check->byte((unsigned char)buf[k]);
+		return len;
+	}
+
+	bool	connected(void) const { return true; }
+	bool	readable(void) const { return (m_window > 0); }
+	void	close(void) {}
+
+	unsigned long	sent(void) const { return m_sent; }
+	unsigned long	stalls(void) const { return m_stalls; }
+};
+// }}}
+
+// soak_init(core, setup)
+// {{{
+// Of the two designs, only linetest has a receive input and a reset
+static inline void	soak_init(Vlinetest &core, unsigned setup) {
+	core.i_setup   = setup;
+	core.i_uart_rx = 1;
+	core.i_reset   = 0;
+}
+
+static inline void	soak_init(Vspeechfifo &core, unsigned setup) {
+	core.i_setup   = setup;
+}
+// }}}
+
+static volatile sig_atomic_t	gbl_stop = 0;
+
+static void	soak_stop(int sig) { gbl_stop = 1; }
+
+static double	now(void) {
+	struct	timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// SOAKLIMITS
+// {{{
+// When to stop (zero for never), and how often to report
+typedef	struct {
+	unsigned long	m_clocks, m_bytes;
+	double		m_seconds, m_period;
+} SOAKLIMITS;
+// }}}
+
+// soak<VA>(setup, src, window, limits)
+// {{{
+// Runs the soak against the design VA, reporting as it goes, and returns the
+// number of errors found
+template <class VA> unsigned long	soak(unsigned setup,
+		const SOAKSOURCE &src, unsigned window,
+		const SOAKLIMITS &lim) {
+	// The clocks run between looks at the time and the limits
+	const unsigned	CHUNK = 65536;
+	const unsigned	baudclocks = setup & 0x0ffffff,
+			mask = (1u << (8-((setup>>28)&3))) - 1,
+			char_clocks = baudclocks * (2 + (8-((setup>>28)&3))
+				+ ((setup>>26)&1) + ((setup>>27)&1));
+	SOAKCHECK	check(src, mask);
+	TESTB<VA, UARTSIMT<SOAKTRANSPORT> >	*tb
+		= new TESTB<VA, UARTSIMT<SOAKTRANSPORT> >(&src, &check,
+				window);
+	double		start, last, tnow;
+	unsigned long	last_clocks = 0, last_bytes = 0, errors;
+
+	soak_init(tb->m_core, setup);
+	tb->m_uart.setup(setup);
+	// Hand each byte over as it arrives, so the window is never held up
+	// waiting on a flush, and check the host for more every baud without
+	// backing off, so the window doesn't sit open for long
+	tb->m_uart.flush_threshold(1);
+	tb->m_uart.poll_interval(baudclocks, 0);
+
+	printf("%10s %14s %10s %10s %14s %10s %10s %6s %10s %6s %6s %6s\n",
+		"Seconds", "Clocks", "Clk/s", "(overall)", "Bytes", "Bytes/s",
+		"(overall)", "%Line", "Lines", "Errs", "PErrs", "FErrs");
+
+	start = last = now();
+	while(!gbl_stop) {
+		bool	done = false;
+
+		for(unsigned k=0; k<CHUNK; k++)
+			tb->tick();
+		tb->sync();
+		tnow = now();
+
+		if ((lim.m_clocks > 0)&&(tb->clocks() >= lim.m_clocks))
+			done = true;
+		if ((lim.m_bytes > 0)&&(check.bytes() >= lim.m_bytes))
+			done = true;
+		if ((lim.m_seconds > 0)&&(tnow - start >= lim.m_seconds))
+			done = true;
+
+		if ((done)||(tnow - last >= lim.m_period)) {
+			// Report
+			// {{{
+			double	dt = tnow - last, dtall = tnow - start;
+
+			printf("%10.1f %14lu %10.3e %10.3e %14lu %10.1f %10.1f %5.1f%% %10lu %6lu %6lu %6lu\n",
+				dtall, tb->clocks(),
+				(tb->clocks() - last_clocks) / dt,
+				tb->clocks() / dtall,
+				check.bytes(),
+				(check.bytes() - last_bytes) / dt,
+				check.bytes() / dtall,
+				100.0 * check.bytes() * char_clocks
+					/ (double)tb->clocks(),
+				check.lines(), check.errors(),
+				tb->m_uart.rx_parity_errors(),
+				tb->m_uart.rx_frame_errors());
+			fflush(stdout);
+
+			last = tnow;
+			last_clocks = tb->clocks();
+			last_bytes  = check.bytes();
+			// }}}
+		}
+
+		if (done)
+			break;
+	}
+
+	errors = check.errors() + tb->m_uart.rx_parity_errors()
+			+ tb->m_uart.rx_frame_errors()
+			+ tb->m_uart.host().stalls();
+	printf("Soak complete: %lu clocks, %lu bytes sent, %lu bytes and %lu lines received, %lu errors (%lu resynchronized, %lu stalls)\n",
+		tb->clocks(), tb->m_uart.host().sent(), check.bytes(),
+		check.lines(), errors, check.resyncs(),
+		tb->m_uart.host().stalls());
+	if (check.lines() == 0)
+		errors++;	// Nothing at all was received
+
+	delete tb;
+	return errors;
+}
+// }}}
+
+int	main(int argc, char **argv) {
+	Verilated::commandArgs(argc, argv);
+	const char	*design = "linetest", *textfile = NULL;
+	unsigned	setup = 25;
+	uint64_t	seed = 1;
+	SOAKLIMITS	lim = { 0, 0, 0.0, 10.0 };
+	unsigned long	errors;
+	bool		speech;
+
+	// Argument processing
+	// {{{
+	for(int argn=1; argn<argc; argn++) {
+		if (argv[argn][0] == '-') for(int j=1; (j<1000)&&(argv[argn][j]); j++) {
+			// Every option takes an argument
+			if (argn+1 >= argc) {
+				fprintf(stderr, "ERR: -%c needs an argument\n", argv[argn][j]);
+				exit(EXIT_FAILURE);
+			}
+
+			switch(argv[argn][j]) {
+			case 'd':
+				design = argv[++argn]; j+= 4000;
+				break;
+			case 's':
+				setup = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'f':
+				textfile = argv[++argn]; j+= 4000;
+				break;
+			case 'r':
+				seed = strtoull(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'c':
+				lim.m_clocks = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'n':
+				lim.m_bytes = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 't':
+				lim.m_seconds = atof(argv[++argn]); j+= 4000;
+				break;
+			case 'P':
+				lim.m_period = atof(argv[++argn]); j+= 4000;
+				break;
+			default:
+				printf("Undefined option, -%c\n", argv[argn][j]);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+	// }}}
+
+	if (strcmp(design, "speechfifo") == 0) {
+		speech = true;
+		if (textfile == NULL)
+			textfile = "speech.txt";
+	} else if (strcmp(design, "linetest") == 0) {
+		speech = false;
+	} else {
+		fprintf(stderr, "ERR: Unknown design, %s\n", design);
+		exit(EXIT_FAILURE);
+	}
+
+	setup &= 0x3fffffff;
+	crc_init();
+
+	SOAKSOURCE	src(seed, (1u << (8-((setup>>28)&3))) - 1);
+
+	// speechfifo sends CR/LF pairs, as mkspeech made them
+	if ((textfile)&&(!src.load(textfile, speech)))
+		exit(EXIT_FAILURE);
+
+	signal(SIGINT,  soak_stop);
+	signal(SIGTERM, soak_stop);
+
+	printf("Soaking %s, setup 0x%08x, with %s\n", design, setup,
+		(textfile) ? textfile : "pseudo-random lines");
+	if (speech)
+		errors = soak<Vspeechfifo>(setup, src, 0, lim);
+	else
+		errors = soak<Vlinetest>(setup, src,
+				2*SOAKSOURCE::RANDLINE, lim);
+
+	if (errors == 0) {
+		printf("PASS\n");
+		exit(EXIT_SUCCESS);
+	}
+
+	printf("FAIL\n");
+	exit(EXIT_FAILURE);
+}
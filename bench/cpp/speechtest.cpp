@@ -12,6 +12,10 @@
 //	address in interactive mode.  In non-interactive mode, the program will
 //	read its own output and report on whether or not it worked well.
 //
+//	Built with -include of a header from mkspeech -H (and against a
+//	speechfifo.v Verilated with the matching .vh), as speechtestbig is,
+//	the same test checks that message instead.
+//
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
 //
@@ -52,25 +56,72 @@
 #include <signal.h>
 #include <ctype.h>
 #include "verilated.h"
+#include "verilated_save.h"
 #ifdef	USE_UART_LITE
 #include "Vspeechfifolite.h"
 #define	SIMCLASS	Vspeechfifolite
+#elif	defined(BIGSPEECH)
+#include "Vbigspeech.h"
+#define	SIMCLASS	Vbigspeech
 #else
 #include "Vspeechfifo.h"
 #define	SIMCLASS	Vspeechfifo
 #endif
 #include "uartsim.h"
-#include "verilated_vcd_c.h"
+#include "streammatch.h"
+#include "tracectl.h"
+#include "testb.h"
+
+// Unless built with mkspeech's header for some other message, the message is
+// the Gettysburg address.  SPEECH_MSGLEN counts the CR before every LF.
+#ifndef	SPEECH_MSGLEN
+#define	SPEECH_MSGLEN	2203
+#define	SPEECH_TXTFILE	"speech.txt"
+#endif
 
 void	usage(void) {
 // {{{
-	fprintf(stderr, "USAGE: speechtest [-i] [<matchfile>.txt]\n");
+	fprintf(stderr, "USAGE: speechtest [-i] [-f] [-q] [-s <setup>] [-c <clocks>] [-S <ckpt>] [-R <ckpt>] [-T <event>] [-E <event>] [-W <clocks>] [-A <clocks>] [-P <clocks>] [<matchfile>.txt]\n");
 	fprintf(stderr, "\n"
 "\tWhere ... \n"
 "\t-i\tis an optional argument, instructing speechtest to run\n"
 "\t\tinteractively.  This mode offers no checkin against any possible\n"
 "\t\ttruth or match file.\n"
 "\n"
+"\t-f\tchecks the output by forking, and reading the simulation\n"
+"\t\toutput through a pipe, rather than checking it as the simulation\n"
+"\t\tproduces it.\n"
+"\n"
+"\t-q\ttalks to the host (stdout, or the pipe with -f) from a separate\n"
+"\t\tthread, so that the simulation never waits on it.\n"
+"\n"
+"\t-s <setup>\tsets the UART setup word, the baud rate, parity,\n"
+"\t\tand so on.  (Default: 25)\n"
+"\n"
+"\t-c <clocks>\tis the maximum number of clocks to simulate before\n"
+"\t\tgiving up on the test.  (Default: enough for 4096 characters\n"
+"\t\tof 16 baud intervals each, or 4096 more than the message if\n"
+"\t\tit is longer than that)\n"
+"\n"
+"\t-S <ckpt>\tsaves a checkpoint of the simulation, the UARTSIM, and\n"
+"\t\tthe match so far to this file once -c <clocks> have been\n"
+"\t\tsimulated, rather than failing the test\n"
+"\n"
+"\t-R <ckpt>\tstarts from a checkpoint saved by -S, rather than from\n"
+"\t\treset.  The setup and match file should be the same as when the\n"
+"\t\tcheckpoint was saved.  Neither -S nor -R works with -i or -f.\n"
+"\n"
+"\t-T <event>\tstarts the interactive mode's trace, speechtrace.vcd,\n"
+"\t\tonly on the given event: byte, perr, ferr, error, or =text\n"
+"\t\t(See tracectl.h).  -E <event> stops it on another.\n"
+"\n"
+"\t-W <clocks>\tkeeps this many clocks before the -T event in the\n"
+"\t\ttrace, and -A <clocks> traces only this many after it.\n"
+"\n"
+"\t-P <clocks>\treports the UARTSIM's statistics, including the time\n"
+"\t\tspent within it, to stderr every <clocks> and at the end of\n"
+"\t\tthe test.  Not used with -i or -f.\n"
+"\n"
 "\t<matchfile.txt>\t is the name of a file which will be compared against\n"
 "\t\tthe output of the simulation.  If the output matches the match\n"
 "\t\tfile, the simulation will exit with success.  Only the number of\n"
@@ -80,12 +131,15 @@ void	usage(void) {
 
 int	main(int argc, char **argv) {
 	Verilated::commandArgs(argc, argv);
-	SIMCLASS	tb;
-	UARTSIM		*uart;
 	int		port = 0;
-	unsigned	setup = 25, testcount = 0, baudclocks;
-	const char	*matchfile = "speech.txt";
-	bool		run_interactively = false;
+	unsigned	setup = 25, baudclocks;
+	unsigned long	testcount = 0, maxclocks = 0;
+	const char	*matchfile = SPEECH_TXTFILE;
+	const char	*save_file = NULL, *restore_file = NULL;
+	const char	*trace_start = NULL, *trace_stop = NULL;
+	unsigned long	trace_before = 0, trace_after = 0, stats_clocks = 0;
+	bool		run_interactively = false, use_fork = false,
+			threaded = false;
 
 	// Argument processing
 	// {{{
@@ -94,6 +148,70 @@ int	main(int argc, char **argv) {
 		switch(argv[argn][j]) {
 			case 'i': run_interactively = true;
 				break;
+			case 'f': use_fork = true;
+				break;
+			case 'q': threaded = true;
+				break;
+			case 's':
+				if (argn+1 >= argc) {
+					usage();
+					exit(EXIT_FAILURE);
+				}
+				setup = strtoul(argv[++argn], NULL, 0);
+				j += 4000;
+				break;
+			case 'c':
+				if (argn+1 >= argc) {
+					usage();
+					exit(EXIT_FAILURE);
+				}
+				maxclocks = strtoul(argv[++argn], NULL, 0);
+				j += 4000;
+				break;
+			case 'S':
+			case 'R':
+				if (argn+1 >= argc) {
+					usage();
+					exit(EXIT_FAILURE);
+				}
+				if (argv[argn][j] == 'S')
+					save_file = argv[++argn];
+				else
+					restore_file = argv[++argn];
+				j += 4000;
+				break;
+			case 'T':
+			case 'E':
+				if (argn+1 >= argc) {
+					usage();
+					exit(EXIT_FAILURE);
+				}
+				if (argv[argn][j] == 'T')
+					trace_start = argv[++argn];
+				else
+					trace_stop = argv[++argn];
+				j += 4000;
+				break;
+			case 'W':
+			case 'A':
+				if (argn+1 >= argc) {
+					usage();
+					exit(EXIT_FAILURE);
+				}
+				if (argv[argn][j] == 'W')
+					trace_before = strtoul(argv[++argn], NULL, 0);
+				else
+					trace_after = strtoul(argv[++argn], NULL, 0);
+				j += 4000;
+				break;
+			case 'P':
+				if (argn+1 >= argc) {
+					usage();
+					exit(EXIT_FAILURE);
+				}
+				stats_clocks = strtoul(argv[++argn], NULL, 0);
+				j += 4000;
+				break;
 			default:
 				printf("Undefined option, -%c\n", argv[argn][j]);
 				usage();
@@ -104,9 +222,14 @@ int	main(int argc, char **argv) {
 	}
 	// }}}
 
-	tb.i_setup = setup;
 	baudclocks = setup & 0x0ffffff;
 
+	// The clock budget.  A test that hasn't finished by then has failed,
+	// rather than leaving us waiting on it forever.
+	if (maxclocks == 0)
+		maxclocks = (unsigned long)baudclocks * 16
+			* ((SPEECH_MSGLEN < 4096) ? 4096 : (SPEECH_MSGLEN+4096));
+
 	if (run_interactively) {
 		// {{{
 		// The difference between the non-interactive mode and the
@@ -119,61 +242,32 @@ int	main(int argc, char **argv) {
 		// debug by printf.  We can also dump things to a VCD file,
 		// should you wish to run GTKwave.
 		//
-		uart = new UARTSIM(port);
-		uart->setup(tb.i_setup);
-
-		Verilated::traceEverOn(true);
-		VerilatedVcdC* tfp = new VerilatedVcdC;
-		tb.trace(tfp, 99);
-		tfp->open("speechtrace.vcd");
-
-		testcount = 0;
-		while(testcount < baudclocks * 16 * 4096) {
-			// Run one tick of the clock.
-
-			tb.i_clk = 1;	// Positive edge
-			tb.eval();
-			tfp->dump(5*(2*testcount));
-			tb.i_clk = 0;	// Negative edge
-			tb.eval();
+		TESTB<SIMCLASS, UARTSIM, TRACECTL>	tb(port, false, threaded);
+		TRACECTL	trace("speechtrace.vcd");
 
-			// Now, evaluate the UART, throwing away the received
-			// value since the SpeechTest doesnt use it.
-			(*uart)(tb.o_uart_tx);
+		tb.m_core.i_setup = setup;
+		tb.m_uart.setup(setup);
 
-			tfp->dump(5*(2*testcount+1));
-			testcount++;
+		if ((trace_start)&&(!trace.start_on(trace_start))) {
+			fprintf(stderr, "ERR: Unknown trace event, %s\n", trace_start);
+			exit(EXIT_FAILURE);
+		}
 
-// #define	DEBUG
-#ifdef	DEBUG
-		//
-		// Here are my notes from my last attempt at debug by printf.
-		printf("%08x ", 
-			tb.v__DOT__restart_counter);
-		printf("%s %s@%d<-%08x[%c/%4d] (%s%s,%08x,%2d,%2d,%2d,%c,%s) %s,%02x >%d\n",
-			(tb.v__DOT__restart)?"RST":"   ",
-			(tb.v__DOT__wb_stb)?"STB":"   ",
-			(tb.v__DOT__wb_addr),
-			(tb.v__DOT__wb_data),
-				isgraph(tb.v__DOT__wb_data&0x0ff)?
-					(tb.v__DOT__wb_data&0x0ff) : '.',
-			(tb.v__DOT__msg_index),
-			(tb.v__DOT__wbuarti__DOT____Vcellinp__txfifo____pinNumber2)?"RST":"   ",
-			(tb.v__DOT__wbuarti__DOT__txf_wb_write)?"WR":"  ",
-			(tb.v__DOT__wbuarti__DOT__txfifo__DOT__r_fill),
-			(tb.v__DOT__wbuarti__DOT__txfifo__DOT__r_first),
-			(tb.v__DOT__wbuarti__DOT__txfifo__DOT__w_first_plus_one),
-			(tb.v__DOT__wbuarti__DOT__txfifo__DOT__r_last),
-			isgraph(tb.v__DOT__wbuarti__DOT__tx_data&0x0ff)?
-					(tb.v__DOT__wbuarti__DOT__tx_data&0x0ff) : '.',
-			(tb.v__DOT__wbuarti__DOT____Vcellinp__txfifo____pinNumber5)?"RD":"  ",
-			(tb.v__DOT__wbuarti__DOT__tx_empty_n)?"TXI":"EMP",
-			(tb.v__DOT__wbuarti__DOT__tx_data),
-			(tb.o_uart_tx));
-#endif
+		if ((trace_stop)&&(!trace.stop_on(trace_stop))) {
+			fprintf(stderr, "ERR: Unknown trace event, %s\n", trace_stop);
+			exit(EXIT_FAILURE);
+		}
+		trace.window(trace_before, trace_after);
+		tb.trace(&trace);
+
+		while(tb.clocks() < (unsigned long)baudclocks * 16 * 4096) {
+			// Run one tick of the clock, and of the UART.  The
+			// speechfifo has no receive input, so whatever the UART
+			// would send it is thrown away.
+			tb.tick();
 		}
 
-		tfp->close();
+		tb.close();
 
 		//
 		// *IF* we ever get here, then at least explain to the user
@@ -181,6 +275,119 @@ int	main(int argc, char **argv) {
 		//
 		printf("\n\nSimulation complete\n");
 		// }}}
+	} else if (!use_fork) {
+		// In-process checking
+		// {{{
+		// The UARTSIM hands each byte to our matcher as it arrives.
+		// The matcher compares it against the (memory mapped) match
+		// file, so we can stop the moment the match is complete--or
+		// the moment it fails.
+		STREAMMATCH	match(matchfile);
+
+		if (!match.ok()) {
+			printf("FAIL\n");
+			exit(EXIT_FAILURE);
+		}
+
+		TESTB<SIMCLASS, UARTSIMT<CALLBACKTRANSPORT> >
+				tb(STREAMMATCH::callback, &match);
+		UARTSIMT<CALLBACKTRANSPORT>	&muart = tb.m_uart;
+
+		tb.m_core.i_setup = setup;
+		muart.setup(setup);
+		// There's no system call to save by buffering the output, so
+		// hand each byte over as soon as it arrives
+		muart.flush_threshold(1);
+		if (stats_clocks > 0) {
+			muart.profile(true);
+			muart.stats_every(stats_clocks);
+		}
+
+		testcount = 0;
+		if (restore_file) {
+			// Pick up from a checkpoint
+			// {{{
+			VerilatedRestore	is;
+
+			is.open(restore_file);
+			if (!is.isOpen()) {
+				fprintf(stderr, "ERR: Could not open %s\n",
+					restore_file);
+				printf("FAIL\n");
+				exit(EXIT_FAILURE);
+			}
+
+			is >> tb.m_core;
+			is.read(&testcount, sizeof(testcount));
+			if ((!muart.restore(is))||(!match.restore(is))) {
+				fprintf(stderr, "ERR: %s is not a checkpoint of this test\n",
+					restore_file);
+				printf("FAIL\n");
+				exit(EXIT_FAILURE);
+			}
+			is.close();
+
+			printf("Restored from %s at clock %lu, %lu bytes matched\n",
+				restore_file, testcount, match.matched());
+			// }}}
+		}
+
+		while((!match.done())&&(testcount < maxclocks)) {
+			testcount++;
+			tb.tick();
+		}
+
+		if ((save_file)&&(!match.done())) {
+			// Save a checkpoint, rather than failing
+			// {{{
+			VerilatedSave	os;
+
+			// Bring the UARTSIM up to date first
+			tb.sync();
+
+			os.open(save_file);
+			if (!os.isOpen()) {
+				fprintf(stderr, "ERR: Could not create %s\n",
+					save_file);
+				printf("FAIL\n");
+				exit(EXIT_FAILURE);
+			}
+
+			os << tb.m_core;
+			os.write(&testcount, sizeof(testcount));
+			muart.save(os);
+			match.save(os);
+			os.close();
+
+			printf("Checkpoint saved to %s at clock %lu, %lu (/ %lu) bytes matched\n",
+				save_file, testcount, match.matched(),
+				match.expected());
+			exit(EXIT_SUCCESS);
+			// }}}
+		}
+
+		if (stats_clocks > 0) {
+			tb.sync();
+			muart.stats_dump();
+		}
+
+		printf("MATCH COMPLETE, nr = %lu (/ %lu)\n", match.matched(),
+			match.expected());
+
+		if ((match.done())&&(!match.failed())) {
+			printf("PASS\n");
+			exit(EXIT_SUCCESS);
+		} else if (match.failed()) {
+			int	got = match.fail_received(),
+				exp = match.fail_expected();
+
+			printf("\nDoes not match.  MISMATCH: ch[%lu]=%c (%02x) != %c (%02x)\nFAIL\n",
+				match.matched(), isprint(got) ? got : '.', got,
+				isprint(exp) ? exp : '.', exp);
+		} else
+			printf("Simulation ended before the match was complete\nFAIL\n");
+		exit(EXIT_FAILURE);
+		// }}}
 	} else {
 		//
 		// Non-interactive mode is more difficult.  In this case, we
@@ -196,7 +403,7 @@ int	main(int argc, char **argv) {
 
 		// Setup parent/child processes
 		// {{{
-		int	childs_stdin[2], childs_stdout[2];
+		int	to_child, from_child;
 		FILE	*fp = fopen(matchfile, "r");
 		long	flen = 0;
 
@@ -230,28 +437,19 @@ int	main(int argc, char **argv) {
 		}
 
 
-		// We are ready to do our forking magic.  So, let's allocate
-		// pipes for the childs standard input and output streams.
-		if ((pipe(childs_stdin)!=0)||(pipe(childs_stdout) != 0)) {
-			fprintf(stderr, "ERR setting up child pipes\n");
-			perror("O/S Err:");
-			printf("FAIL\n");
-			exit(EXIT_FAILURE);
-		}
-
-	
 		//
 		//	FORK	!!!!!
 		//
 		// After this line, there are two threads running--a parent and
 		// a child.  The childs child_pid will be zero, the parents
-		// child_pid will be the pid of the child.
-		pid_t	child_pid = fork();
+		// child_pid will be the pid of the child.  testb_fork() also
+		// sets up the pipes for the childs standard input and output
+		// streams.
+		pid_t	child_pid = testb_fork(to_child, from_child);
 
 		// Make sure the fork worked ...
 		if (child_pid < 0) {
 			fprintf(stderr, "ERR setting up child process fork\n");
-			perror("O/S Err:");
 			printf("FAIL\n");
 			exit(EXIT_FAILURE);
 		}
@@ -261,14 +459,6 @@ int	main(int argc, char **argv) {
 			// {{{
 			int	nr = -2, rd, fail;
 
-			// Set up the parents file relationships
-			// {{{
-			// Adjust our pipe file descriptors so that they are
-			// useful.
-			close(childs_stdin[ 0]); // Close the read end
-			close(childs_stdout[1]); // Close the write end
-			// }}}
-
 			// Read the string to match against here
 			// {{{
 			// Let's allocate some buffers to contain both our
@@ -320,7 +510,7 @@ int	main(int argc, char **argv) {
 			rd = 0;
 			fail = -1;
 			while((nr<flen)
-				&&((rd = read(childs_stdout[0],
+				&&((rd = read(from_child,
 					&rdbuf[nr], 1))>0)) {
 				for(int i=0; i<rd; i++)
 					if (rdbuf[nr+i] != string[nr+i]) {
@@ -365,58 +555,25 @@ int	main(int argc, char **argv) {
 		} else { // If childs_pid == 0, then we are the child
 			// {{{
 
-			// Finish setting up the child's I/O
-			// {{{
-			// The child reports the uart result via stdout, so
-			// let's make certain it points to STDOUT_FILENO.
-			//
-			close(childs_stdin[ 1]); // Close the write end
-			close(childs_stdout[0]); // Close the read end
-
-			// Now, adjust our stdin/stdout file numbers
-			// Stdin first.  (Yes, I know we arent use stdin, this
-			// is more for form than anything else.)
-			close(STDIN_FILENO);
-			if (dup(childs_stdin[0]) != STDIN_FILENO) {
-				fprintf(stderr, "Could not create childs stdin\n");
-				perror("O/S ERR");
-				exit(EXIT_FAILURE);
-			}
-
-			// Set up the standard out file descriptor so that it
-			// points to our pipe
-			close(STDOUT_FILENO);
-			if (dup(childs_stdout[1]) != STDOUT_FILENO) {
-				fprintf(stderr, "Could not create childs stdout\n");
-				perror("O/S ERR");
-				exit(EXIT_FAILURE);
-			}
-			// }}}
-
 			// Set the UARTSIM up to producing an output to the
-			// STDOUT, rather than a TCP/IP port
-			uart = new UARTSIM(0);
+			// STDOUT, rather than a TCP/IP port.  testb_fork()
+			// has already pointed STDOUT at our pipe.
+			TESTB<SIMCLASS>	tb(0, false, threaded);
+
 			// Set up our baud rate, stop bits, parity, etc.
 			// properly
-			uart->setup(tb.i_setup);
+			tb.m_core.i_setup = setup;
+			tb.m_uart.setup(setup);
 
 			// Main simulation loop
 			// {{{
 			// Now ... we're finally ready to run our simulation.
+			// tb.tick() advances the UART based upon the output
+			// o_uart_tx value, or--while nothing is happening--
+			// just counts the clocks to skip
 			//
-			// while(testcount < baudclocks * 16 * 2048)
-			while(testcount++ < 0x7f000000) {
-				// Rising edge of the clock
-				tb.i_clk = 1;
-				tb.eval();
-				// Negative edge of the clock
-				tb.i_clk = 0;
-				tb.eval();
-
-				// Advance the UART based upon the output
-				// o_uart_tx value
-				(*uart)(tb.o_uart_tx);
-			}
+			while(tb.clocks() < maxclocks)
+				tb.tick();
 			// }}}
 
 			// Fail if we ever get here
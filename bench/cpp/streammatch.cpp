@@ -0,0 +1,142 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	streammatch.cpp
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Compares bytes, as they arrive from the UARTSIM, against a
+//		memory mapped file.  See streammatch.h for more details.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "streammatch.h"
+
+// STREAMMATCH::STREAMMATCH(fname)
+// {{{
+STREAMMATCH::STREAMMATCH(const char *fname) {
+	struct	stat	sb;
+	int	fd;
+
+	m_data = NULL;
+	m_len  = 0;
+	m_posn = 0;
+	m_cr   = false;
+	m_matched = m_expected = 0;
+	m_fail_got = m_fail_expected = -1;
+	m_failed = false;
+
+	fd = open(fname, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "ERR - could not open %s\n", fname);
+		perror("O/S Err:");
+		return;
+	}
+
+	if (fstat(fd, &sb) != 0) {
+		fprintf(stderr, "ERR - getting file length\n");
+		perror("O/S Err:");
+		close(fd);
+		return;
+	} else if (sb.st_size == 0) {
+		fprintf(stderr, "ERR - zero length match file!\n");
+		close(fd);
+		return;
+	}
+
+	m_len = sb.st_size;
+	m_data = (const char *)mmap(NULL, m_len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (m_data == MAP_FAILED) {
+		perror("ERR - could not map match file:");
+		m_data = NULL;
+		m_len  = 0;
+		return;
+	}
+
+	// Every newline will be expected as a CR/LF pair
+	m_expected = m_len;
+	for(const char *ptr = m_data;
+		(ptr = (const char *)memchr(ptr, '\n', m_data+m_len-ptr));
+		ptr++)
+		m_expected++;
+}
+// }}}
+
+// STREAMMATCH::~STREAMMATCH
+// {{{
+STREAMMATCH::~STREAMMATCH(void) {
+	if (m_data)
+		munmap((void *)m_data, m_len);
+}
+// }}}
+
+// STREAMMATCH::match(buf, len)
+// {{{
+int	STREAMMATCH::match(const char *buf, int len) {
+	int	nmatched = 0;
+
+	for(int k=0; (k<len)&&(!done()); k++) {
+		int	ch = m_data[m_posn];
+
+		// Expand newlines into CR/LF pairs
+		if ((ch == '\n')&&(!m_cr))
+			ch = '\r';
+
+		if (buf[k] != ch) {
+			m_failed = true;
+			m_fail_got = buf[k] & 0x0ff;
+			m_fail_expected = ch;
+			break;
+		}
+
+		if ((ch == '\r')&&(m_data[m_posn] == '\n'))
+			// Now expect the newline itself
+			m_cr = true;
+		else {
+			m_posn++;
+			m_cr = false;
+		}
+
+		m_matched++;
+		nmatched++;
+	}
+
+	return nmatched;
+}
+// }}}
@@ -0,0 +1,166 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	streammatch.h
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Compares a stream of bytes from the UARTSIM, as they arrive,
+//		against the contents of a file.  The file is memory mapped,
+//	rather than read, and newlines within it are expected to arrive as
+//	carriage-return newline pairs (as mkspeech produces them), without
+//	ever making an expanded copy of the file.
+//
+//	The STREAMMATCH may be given to the UARTSIM directly, by way of a
+//	CALLBACKTRANSPORT:
+//
+//		STREAMMATCH	match("speech.txt");
+//		UARTSIMT<CALLBACKTRANSPORT>
+//				uart(STREAMMATCH::callback, &match);
+//		...
+//		while(!match.done())
+//			step the simulation
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	STREAMMATCH_H
+#define	STREAMMATCH_H
+
+#include <stddef.h>
+
+class	STREAMMATCH {
+	// Member declarations
+	// {{{
+	// The mapped file, and its length
+	const char	*m_data;
+	size_t		m_len;
+	// m_posn is the next character of the file to match.  If it's a
+	// newline, m_cr is true once the carriage return preceding it has
+	// been matched.
+	size_t		m_posn;
+	bool		m_cr;
+	// m_matched counts the bytes matched so far, m_expected the number
+	// of bytes expected in all, both after expansion.
+	unsigned long	m_matched, m_expected;
+	// On a mismatch, what was received and what was expected instead
+	int		m_fail_got, m_fail_expected;
+	bool		m_failed;
+	// }}}
+public:
+	// STREAMMATCH(fname)
+	// {{{
+	// Maps the given file.  On any failure, the reason is printed and
+	// ok() will return false.
+	STREAMMATCH(const char *fname);
+	~STREAMMATCH(void);
+	// }}}
+
+	// ok(void)
+	// {{{
+	// True if the file was successfully mapped, and isn't empty
+	bool	ok(void) const { return (m_data != NULL); }
+	// }}}
+
+	// match(buf, len)
+	// {{{
+	// Compares the next len bytes received against the file.  Returns the
+	// number of bytes that matched.  Anything arriving after the whole
+	// file has been matched is ignored.
+	int	match(const char *buf, int len);
+	// }}}
+
+	// done(void), failed(void)
+	// {{{
+	// done() is true once the comparison is over, either because the
+	// whole file has been matched or because of a mismatch.  failed() is
+	// true only in the latter case.
+	bool	done(void) const {
+		return (m_failed)||(m_matched >= m_expected); }
+	bool	failed(void) const { return m_failed; }
+	// }}}
+
+	// matched(void), expected(void)
+	// {{{
+	unsigned long	matched(void) const { return m_matched; }
+	unsigned long	expected(void) const { return m_expected; }
+	// }}}
+
+	// fail_received(void), fail_expected(void)
+	// {{{
+	// Following a mismatch, the byte received and the one expected
+	int	fail_received(void) const { return m_fail_got; }
+	int	fail_expected(void) const { return m_fail_expected; }
+	// }}}
+
+	// save(os), restore(is)
+	// {{{
+	// Checkpoints how far the comparison has gotten, as the UARTSIM's
+	// save() and restore() do, so that a checkpointed test can pick up
+	// where it left off.  restore() returns false if the checkpoint was
+	// taken against a different file (or rather, one of a different
+	// length).
+	template <class OS>	void	save(OS &os) const {
+		os.write(&m_expected, sizeof(m_expected));
+		os.write(&m_posn, sizeof(m_posn));
+		os.write(&m_cr, sizeof(m_cr));
+		os.write(&m_matched, sizeof(m_matched));
+		os.write(&m_failed, sizeof(m_failed));
+		os.write(&m_fail_got, sizeof(m_fail_got));
+		os.write(&m_fail_expected, sizeof(m_fail_expected));
+	}
+
+	template <class IS>	bool	restore(IS &is) {
+		unsigned long	expected = 0;
+
+		is.read(&expected, sizeof(expected));
+		if (expected != m_expected)
+			return false;
+		is.read(&m_posn, sizeof(m_posn));
+		is.read(&m_cr, sizeof(m_cr));
+		is.read(&m_matched, sizeof(m_matched));
+		is.read(&m_failed, sizeof(m_failed));
+		is.read(&m_fail_got, sizeof(m_fail_got));
+		is.read(&m_fail_expected, sizeof(m_fail_expected));
+		if (m_posn > m_len)
+			m_posn = m_len;
+		return true;
+	}
+	// }}}
+
+	// callback(data, buf, len)
+	// {{{
+	// For use with a CALLBACKTRANSPORT, with data pointing to the
+	// STREAMMATCH
+	static int	callback(void *data, const char *buf, int len) {
+		((STREAMMATCH *)data)->match(buf, len); return len; }
+	// }}}
+};
+
+#endif
@@ -0,0 +1,274 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	streamtest.cpp
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Exercises the axiluart's AXI-Stream ports, through the
+//		streamtest.v design, and measures the bytes per clock they
+//	sustain.  This test bench plays the part of a DMA at both ends at once:
+//	a block of bytes is sent to the design by the UARTSIM, and taken from
+//	the stream master (M_AXIS_*) as it arrives, while another block is fed
+//	into the stream slave (S_AXIS_*) as fast as it will take it, for the
+//	UARTSIM to receive.  Both blocks must arrive unchanged, and TLAST must
+//	be set on the last byte received--and no other.
+//
+//	Options:
+//		-s <setup>	The setup word.  Bit 30 is set, as the design
+//				has no flow control.  (Default: 25, 8N1)
+//		-n <nbytes>	How many bytes to send each way (Default: 4096)
+//		-k <bauds>	The receive idle timeout, which sets when TLAST
+//				is sent, in baud intervals (Default: 40)
+//		-b <percent>	The percentage of clocks M_AXIS_TREADY is held
+//				low, for backpressure (Default: 0)
+//		-r <percent>	The least share of the line rate each direction
+//				must sustain to pass (Default: 95)
+//
+//	The result is a report, ending in PASS or FAIL.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <verilatedos.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "verilated.h"
+#include "Vstreamtest.h"
+#include "testb.h"
+
+int	main(int argc, char **argv) {
+	Verilated::commandArgs(argc, argv);
+	unsigned	setup = 25, timeout = 40, backpressure = 0,
+			minrate = 95, baudclocks, char_clocks;
+	unsigned long	nbytes = 4096, maxclocks,
+			nrx = 0, ntx = 0, nlast = 0, last_at = 0,
+			rx_first = 0, rx_prior = 0, tx_first = 0, tx_done = 0;
+	char		*msg, *reply, *src, *rcvd;
+	int		rx_bad = -1, tx_bad = -1;
+	bool		pass;
+
+	// Argument processing
+	// {{{
+	for(int argn=1; argn<argc; argn++) {
+		if (argv[argn][0] == '-') for(int j=1; (j<1000)&&(argv[argn][j]); j++)
+		switch(argv[argn][j]) {
+			case 's':
+				setup = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'n':
+				nbytes = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'k':
+				timeout = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'b':
+				backpressure = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'r':
+				minrate = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			default:
+				printf("Undefined option, -%c\n", argv[argn][j]);
+				break;
+		}
+	}
+	// }}}
+
+	setup = (setup & 0x3fffffff) | 0x40000000;
+	baudclocks = setup & 0x0ffffff;
+	char_clocks = baudclocks * (2 + (8-((setup>>28)&3))
+				+ ((setup>>26)&1) + ((setup>>27)&1));
+	if ((nbytes < 3)||(timeout < 2)||(timeout > 0x0ffff)
+			||(backpressure >= 100)) {
+		fprintf(stderr, "ERR: Bad -n, -k, or -b\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// The bytes to send each way.  Only the data bits will arrive.
+	// {{{
+	msg   = new char[nbytes];
+	reply = new char[nbytes];
+	src   = new char[nbytes];
+	rcvd  = new char[nbytes];
+	for(unsigned long k=0; k<nbytes; k++) {
+		msg[k] = (char)(k * 7 + 3);
+		src[k] = (char)(k * 13 + 5);
+	}
+	memset(reply, 0, nbytes);
+	memset(rcvd,  0, nbytes);
+	// }}}
+
+	TESTB<Vstreamtest, UARTSIMT<LOOPTRANSPORT> >	tb(msg, (int)nbytes,
+							reply, (int)nbytes);
+
+	tb.m_uart.setup(setup);
+	tb.m_uart.flush_threshold(1);
+
+	// Reset the design, and give it time to set itself up
+	// {{{
+	// Only the design is clocked until then, so that the UARTSIM doesn't
+	// start sending until the receiver is ready for it.
+	tb.m_core.i_setup   = setup;
+	tb.m_core.i_timeout = timeout;
+	tb.m_core.i_uart_rx = 1;
+	tb.m_core.M_AXIS_TREADY = 0;
+	tb.m_core.S_AXIS_TVALID = 0;
+	tb.m_core.S_AXIS_TDATA  = 0;
+	tb.m_core.S_AXIS_TLAST  = 0;
+	tb.m_core.i_reset = 1;
+	for(int k=0; k<4; k++)
+		tb.clock();
+	tb.m_core.i_reset = 0;
+
+	while(!tb.m_core.o_ready)
+		tb.clock();
+	for(unsigned k=0; k<baudclocks*24; k++)
+		tb.clock();
+	// }}}
+
+	// The test itself
+	// {{{
+	// Each clock, a beat is taken from the master if it's valid and we
+	// are ready, and given to the slave if it's ready for one--both as
+	// seen going into the clock edge.
+	maxclocks = tb.clocks() + 2 * (nbytes + 4) * char_clocks
+			* 100 / (100 - backpressure)
+			+ 4 * (unsigned long)timeout * baudclocks;
+	while(((nrx < nbytes)||(tx_done == 0))&&(tb.clocks() < maxclocks)) {
+		bool	rx_beat, tx_beat, last;
+		char	data;
+
+		tb.m_core.M_AXIS_TREADY = ((backpressure == 0)
+				||((unsigned)(rand() % 100) >= backpressure));
+		tb.m_core.S_AXIS_TVALID = (ntx < nbytes);
+		tb.m_core.S_AXIS_TDATA  = src[(ntx < nbytes) ? ntx : 0];
+		tb.m_core.S_AXIS_TLAST  = (ntx+1 == nbytes);
+
+		rx_beat = (tb.m_core.M_AXIS_TVALID)&&(tb.m_core.M_AXIS_TREADY);
+		tx_beat = (tb.m_core.S_AXIS_TVALID)&&(tb.m_core.S_AXIS_TREADY);
+		data    = tb.m_core.M_AXIS_TDATA;
+		last    = tb.m_core.M_AXIS_TLAST;
+
+		tb.tick();
+
+		if (rx_beat) {
+			if (nrx == 0)
+				rx_first = tb.clocks();
+			if (nrx+2 == nbytes)
+				rx_prior = tb.clocks();
+			if (last) {
+				nlast++;
+				last_at = nrx;
+			}
+			if (nrx < nbytes)
+				rcvd[nrx] = data;
+			nrx++;
+		}
+
+		if (tx_beat) {
+			if (ntx == 0)
+				tx_first = tb.clocks();
+			ntx++;
+		}
+
+		if ((tx_done == 0)&&(ntx == nbytes)) {
+			tb.sync();
+			if (tb.m_uart.host().received() >= (int)nbytes)
+				tx_done = tb.clocks();
+		}
+	}
+	tb.close();
+	// }}}
+
+	// Report
+	// {{{
+	unsigned	mask = (1u << (8-((setup>>28)&3))) - 1;
+	int		nreply = tb.m_uart.host().received();
+	double		line = 1.0 / char_clocks, rx_rate = 0.0, tx_rate = 0.0;
+
+	if (nreply > (int)nbytes)
+		nreply = (int)nbytes;
+	for(unsigned long k=0; k<nrx && k<nbytes; k++) {
+		if (((rcvd[k] ^ msg[k]) & mask) != 0) {
+			rx_bad = (int)k;
+			break;
+		}
+	}
+	for(int k=0; k<nreply; k++) {
+		if (((reply[k] ^ src[k]) & mask) != 0) {
+			tx_bad = k;
+			break;
+		}
+	}
+
+	// The last byte received waits on the timeout for its TLAST, so the
+	// receive rate is measured up to the byte before it
+	if (rx_prior > rx_first)
+		rx_rate = (double)(nbytes-2) / (double)(rx_prior - rx_first);
+	if (tx_done > tx_first)
+		tx_rate = (double)nbytes / (double)(tx_done - tx_first);
+
+	printf("Setup 0x%08x, %lu bytes each way, timeout %u bauds, "
+			"TREADY low %u%% of the time\n",
+		setup, nbytes, timeout, backpressure);
+	printf("Line rate  %.5f bytes per clock\n", line);
+	printf("M_AXIS     %lu of %lu bytes", nrx, nbytes);
+	if (rx_bad >= 0)
+		printf(", first mismatch at byte %d", rx_bad);
+	printf(", %.5f bytes per clock (%.1f%% of the line rate)\n",
+		rx_rate, 100.0 * rx_rate / line);
+	if (nlast == 0)
+		printf("TLAST      never set\n");
+	else
+		printf("TLAST      set %lu time%s, last on byte %lu\n", nlast,
+			(nlast == 1) ? "" : "s", last_at);
+	printf("S_AXIS     %lu of %lu bytes, %d arrived", ntx, nbytes,
+		tb.m_uart.host().received());
+	if (tx_bad >= 0)
+		printf(", first mismatch at byte %d", tx_bad);
+	printf(", %.5f bytes per clock (%.1f%% of the line rate)\n",
+		tx_rate, 100.0 * tx_rate / line);
+
+	pass = (nrx == nbytes)&&(rx_bad < 0)
+		&&(nlast == 1)&&(last_at == nbytes-1)
+		&&(tb.m_uart.host().received() == (int)nbytes)&&(tx_bad < 0)
+		&&(100.0 * rx_rate >= minrate * line)
+		&&(100.0 * tx_rate >= minrate * line);
+
+	delete[] msg;
+	delete[] reply;
+	delete[] src;
+	delete[] rcvd;
+
+	printf("%s\n", (pass) ? "PASS" : "FAIL");
+	exit((pass) ? EXIT_SUCCESS : EXIT_FAILURE);
+	// }}}
+}
@@ -0,0 +1,299 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	testb.h
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	A test bench base for the Verilated UART designs, so that each
+//		harness doesn't need to repeat the same clock loop, UARTSIM
+//	wiring, and tracing.  The design, the UARTSIM, and everything about the
+//	run are held by value--there's nothing on the heap to leak--and the
+//	clock is all inline, so a harness built on this gets the fast path
+//	(only stepping the UARTSIM when something might happen) for free.
+//
+//	TESTB<VA, UART, TRACE>
+//		VA	The Verilated design.  It must have i_clk and o_uart_tx.
+//			If it has an i_uart_rx, the UARTSIM drives it.
+//		UART	The UARTSIM, or any other UARTSIMT<>.  (Default: UARTSIM)
+//		TRACE	The tracing policy.  NOTRACE, the default, compiles
+//			to nothing at all.  TRACECTL traces, once given one
+//			with trace().
+//
+//	The constructor's arguments are passed on to the UART's constructor.
+//	Hence,
+//
+//		TESTB<Vhelloworld>		tb(port);
+//		TESTB<Vlinetest, UARTSIM, TRACECTL>	tb(0, false, threaded);
+//
+//		tb.m_core.i_setup = setup;
+//		tb.m_uart.setup(setup);
+//		tb.trace(&trace);		// Only with a TRACE policy
+//		while(tb.clocks() < maxclocks)
+//			tb.tick();
+//		tb.sync();			// Before looking at the UART
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	TESTB_H
+#define	TESTB_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <utility>
+#include "verilated.h"
+#include "uartsim.h"
+
+// NOTRACE
+// {{{
+// The tracing policy for a test bench that never traces.  Every call into it
+// is an empty inline, behind a test of ENABLED, so none of it survives
+// compilation.
+class	NOTRACE {
+public:
+	static const bool	ENABLED = false;
+
+	void	dump(uint64_t t) {}
+	template <class UART> void	check(const UART &uart, uint64_t t) {}
+	void	close(void) {}
+};
+// }}}
+
+// TESTB
+// {{{
+template <class VA, class UART = UARTSIM, class TRACE = NOTRACE>
+class	TESTB {
+	// set_rx(core, rx)
+	// {{{
+	// Drives the design's i_uart_rx, for those designs that have one
+	template <class C> static auto	set_rx(C &core, int rx, int)
+			-> decltype(core.i_uart_rx = rx, void()) {
+		core.i_uart_rx = rx;
+	}
+
+	template <class C> static void	set_rx(C &core, int rx, long) {}
+	// }}}
+
+	// trace_core(core, tracer)
+	// {{{
+	// Starts the design's trace, returning false if it was Verilated
+	// without tracing (as for the -fast builds), and so can't be traced
+	template <class C, class T> static auto	trace_core(C &core, T *tracer,
+			int) -> decltype(core.trace(tracer, 99), bool()) {
+		core.trace(tracer, 99);
+		return true;
+	}
+
+	template <class C, class T> static bool	trace_core(C &core, T *tracer,
+			long) { return false; }
+	// }}}
+public:
+	VA		m_core;
+	UART		m_uart;
+protected:
+	TRACE		*m_trace;
+	unsigned long	m_clocks;
+	unsigned	m_uart_idle, m_uart_skipped;
+	int		m_last_tx;
+
+	bool	tracing(void) const {
+		return (TRACE::ENABLED)&&(m_trace != NULL); }
+public:
+	// TESTB(args...)
+	// {{{
+	template <typename... ARGS>	TESTB(ARGS&&... args)
+			: m_uart(std::forward<ARGS>(args)...), m_trace(NULL),
+			m_clocks(0), m_uart_idle(0), m_uart_skipped(0),
+			m_last_tx(1) {
+	}
+	// }}}
+
+	// trace(tracer)
+	// {{{
+	// Starts tracing through a trace controller that the caller owns, and
+	// has already set up.  Only available with a TRACE policy.  If the
+	// design was Verilated without tracing, this only warns that there
+	// will be no trace.
+	void	trace(TRACE *tracer) {
+		m_trace = tracer;
+		if (m_trace) {
+			Verilated::traceEverOn(true);
+			if (trace_core(m_core, m_trace->tracer(), 0))
+				m_trace->open();
+			else {
+				fprintf(stderr, "WARNING: This design was built "
+					"without tracing, so won't be traced\n");
+				m_trace = NULL;
+			}
+		}
+	}
+	// }}}
+
+	unsigned long	clocks(void) const { return m_clocks; }
+
+	// clock(void)
+	// {{{
+	// One clock of the design alone, tracing both edges
+	void	clock(void) {
+		m_core.i_clk = 1;
+		m_core.eval();
+		if (tracing())
+			m_trace->dump(10*m_clocks);
+		m_core.i_clk = 0;
+		m_core.eval();
+		if (tracing())
+			m_trace->dump(10*m_clocks+5);
+		m_clocks++;
+	}
+	// }}}
+
+	// uart_tick(void)
+	// {{{
+	// One clock of the UARTSIM.  While nothing can happen, the clocks are
+	// only counted, and handed to the UARTSIM later, all at once.  Its
+	// output can't change in the meantime, so the design's i_uart_rx is
+	// only driven when it is stepped.
+	void	uart_tick(void) {
+		if ((m_uart_idle > 0)&&(m_core.o_uart_tx == m_last_tx)) {
+			m_uart_idle--;
+			m_uart_skipped++;
+		} else {
+			m_uart.skip(m_uart_skipped);
+			m_uart_skipped = 0;
+			set_rx(m_core, m_uart(m_core.o_uart_tx), 0);
+			if (tracing())
+				m_trace->check(m_uart, 10*m_clocks);
+			m_last_tx = m_core.o_uart_tx;
+			m_uart_idle = m_uart.next_event_clocks();
+		}
+	}
+	// }}}
+
+	// wake(void)
+	// {{{
+	// Brings the UARTSIM up to date, and then steps it on the next clock,
+	// rather than waiting out its last guess as to when anything could
+	// next happen.  Call this just before changing something it can't
+	// know about, such as giving its host more to send--else the clocks
+	// it skipped would be run as though the change had already happened.
+	void	wake(void) {
+		sync();
+		m_uart_idle = 0;
+	}
+	// }}}
+
+	// tick(void)
+	// {{{
+	void	tick(void) {
+		clock();
+		uart_tick();
+	}
+	// }}}
+
+	// sync(void)
+	// {{{
+	// Brings the UARTSIM up to date with any clocks it has yet to see.
+	// Call this before looking at, saving, or killing it.
+	void	sync(void) {
+		m_uart.skip(m_uart_skipped);
+		m_uart_skipped = 0;
+	}
+	// }}}
+
+	// close(void)
+	// {{{
+	// Ends the run: sends anything the UARTSIM is still holding on to, and
+	// closes the trace
+	void	close(void) {
+		sync();
+		m_uart.kill();
+		if (tracing())
+			m_trace->close();
+	}
+	// }}}
+};
+// }}}
+
+// testb_fork(to_child, from_child)
+// {{{
+// Forks a child, to run the simulation with a UARTSIM on stdin and stdout
+// (port zero), and connects those to pipes for the parent.  As with fork(),
+// the child's pid is returned to the parent, while zero is returned to the
+// child.  The parent writes to the child's stdin through to_child, and reads
+// its stdout from from_child.  On any error, -1 is returned to the parent.
+static inline pid_t	testb_fork(int &to_child, int &from_child) {
+	int	childs_stdin[2], childs_stdout[2];
+	pid_t	pid;
+
+	if (pipe(childs_stdin) != 0) {
+		perror("O/S ERR: pipe");
+		return -1;
+	} else if (pipe(childs_stdout) != 0) {
+		perror("O/S ERR: pipe");
+		close(childs_stdin[0]);
+		close(childs_stdin[1]);
+		return -1;
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		perror("O/S ERR: fork");
+		close(childs_stdin[0]);  close(childs_stdin[1]);
+		close(childs_stdout[0]); close(childs_stdout[1]);
+		return -1;
+	}
+
+	if (pid) {
+		// The parent
+		close(childs_stdin[ 0]);	// Close the read end
+		close(childs_stdout[1]);	// Close the write end
+		to_child   = childs_stdin[1];
+		from_child = childs_stdout[0];
+		return pid;
+	}
+
+	// The child
+	close(childs_stdin[ 1]);
+	close(childs_stdout[0]);
+	if ((dup2(childs_stdin[0], STDIN_FILENO) != STDIN_FILENO)
+		||(dup2(childs_stdout[1], STDOUT_FILENO) != STDOUT_FILENO)) {
+		perror("O/S ERR: dup2");
+		exit(EXIT_FAILURE);
+	}
+	close(childs_stdin[0]);
+	close(childs_stdout[1]);
+	to_child = from_child = -1;
+	return 0;
+}
+// }}}
+#endif
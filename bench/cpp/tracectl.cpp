@@ -0,0 +1,329 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	tracectl.cpp
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Implements the trace control described in tracectl.h.
+//
+//	The window before the start event relies upon two things Verilator's
+//	VCD writer already does:  it may be given its own file object to
+//	write through (a VerilatedVcdFile), and openNext() starts a new
+//	segment with a full dump of every signal, without the header.  Hence
+//	the header, the previous segment, and the current one are always
+//	enough to make a complete trace.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tracectl.h"
+
+// No time has yet been seen
+#define	NOTIME	(~(uint64_t)0)
+
+// TRACERING
+// {{{
+// Holds VCD output in memory, one segment at a time, until commit()ed to a
+// file.  Thereafter, everything goes straight to the file.
+#ifndef	TRACE_FST
+class	TRACERING : public VerilatedVcdFile {
+	std::string	m_fname, m_header, m_segment[2];
+	int		m_cur;
+	FILE		*m_fp;
+
+	// split_header(seg)
+	// {{{
+	// Verilator writes the header as part of the first segment.  Pull it
+	// off (once) so that it can be written at the top of the file, no
+	// matter which segments are kept.
+	void	split_header(std::string &seg) {
+		size_t	p = seg.find("$enddefinitions");
+
+		if (p == std::string::npos)
+			return;
+		p = seg.find('\n', p);
+		p = (p == std::string::npos) ? seg.size() : p+1;
+		if (m_header.empty())
+			m_header = seg.substr(0, p);
+		seg.erase(0, p);
+	}
+	// }}}
+public:
+	TRACERING(const char *fname) : m_fname(fname), m_cur(0), m_fp(NULL) {}
+	virtual	~TRACERING(void) { close(); }
+
+	// open(name)
+	// {{{
+	// Called by Verilator on every open() and openNext().  Until
+	// committed, each begins a new segment, replacing the oldest.
+	virtual	bool	open(const std::string &name) {
+		if (m_fp)
+			return true;
+		split_header(m_segment[m_cur]);
+		m_cur ^= 1;
+		m_segment[m_cur].clear();
+		return true;
+	}
+	// }}}
+
+	// close(void)
+	// {{{
+	// Verilator closes the file between segments as well, so nothing
+	// happens here until we've been committed to a file
+	virtual	void	close(void) {
+		if (m_fp) {
+			fclose(m_fp);
+			m_fp = NULL;
+		}
+	}
+	// }}}
+
+	virtual	ssize_t	write(const char *bufp, ssize_t len) {
+		if (m_fp)
+			return fwrite(bufp, 1, len, m_fp);
+		m_segment[m_cur].append(bufp, len);
+		return len;
+	}
+
+	// commit(void)
+	// {{{
+	// Writes the header and the last two segments to the trace file, and
+	// sends everything after to it as well
+	bool	commit(void) {
+		split_header(m_segment[m_cur]);
+
+		m_fp = fopen(m_fname.c_str(), "w");
+		if (!m_fp) {
+			fprintf(stderr, "ERR: Could not create %s\n",
+				m_fname.c_str());
+			perror("O/S Err:");
+			return false;
+		}
+
+		fwrite(m_header.data(), 1, m_header.size(), m_fp);
+		fwrite(m_segment[m_cur^1].data(), 1, m_segment[m_cur^1].size(),
+			m_fp);
+		fwrite(m_segment[m_cur].data(), 1, m_segment[m_cur].size(),
+			m_fp);
+		m_segment[0].clear();
+		m_segment[1].clear();
+		return true;
+	}
+	// }}}
+};
+#else
+// There's no way of holding FST output in memory
+class	TRACERING {};
+#endif
+// }}}
+
+// TRACEEVENT::parse(spec)
+// {{{
+bool	TRACEEVENT::parse(const char *spec) {
+	if (strcmp(spec, "byte") == 0)
+		m_kind = BYTE;
+	else if (strcmp(spec, "perr") == 0)
+		m_kind = PERR;
+	else if (strcmp(spec, "ferr") == 0)
+		m_kind = FERR;
+	else if (strcmp(spec, "error") == 0)
+		m_kind = ERROR;
+	else if ((spec[0] == '=')&&(spec[1] != '\0')) {
+		std::string	pattern;
+
+		for(const char *ptr = &spec[1]; *ptr; ptr++) {
+			if ((ptr[0] == '\\')&&(ptr[1] != '\0')) {
+				ptr++;
+				switch(*ptr) {
+				case 'r': pattern += '\r'; break;
+				case 'n': pattern += '\n'; break;
+				case 't': pattern += '\t'; break;
+				default:  pattern += *ptr; break;
+				}
+			} else
+				pattern += *ptr;
+		}
+
+		m_kind = MATCH;
+		m_pattern = pattern;
+		m_recent.clear();
+	} else
+		return false;
+	return true;
+}
+// }}}
+
+// TRACEEVENT::happened(ch, perr, ferr)
+// {{{
+bool	TRACEEVENT::happened(int ch, bool perr, bool ferr) {
+	switch(m_kind) {
+	case BYTE:	return true;
+	case PERR:	return perr;
+	case FERR:	return ferr;
+	case ERROR:	return (perr)||(ferr);
+	case MATCH:
+		m_recent += (char)ch;
+		if (m_recent.size() > m_pattern.size())
+			m_recent.erase(0, m_recent.size() - m_pattern.size());
+		return (m_recent == m_pattern);
+	default:	return false;
+	}
+}
+// }}}
+
+// TRACECTL::TRACECTL(fname, period)
+// {{{
+TRACECTL::TRACECTL(const char *fname, unsigned period) : m_tfp(NULL),
+		m_ring(NULL), m_fname(fname), m_state(WAITING),
+		m_period((period > 0) ? period : 1), m_before(0), m_after(0),
+		m_segment_start(NOTIME), m_stop_time(0), m_opened(false),
+		m_chars(0), m_perrs(0), m_ferrs(0) {
+}
+
+TRACECTL::~TRACECTL(void) {
+	stop();
+	delete m_tfp;
+#ifndef	TRACE_FST
+	delete m_ring;
+#endif
+}
+// }}}
+
+bool	TRACECTL::start_on(const char *spec) { return m_start.parse(spec); }
+bool	TRACECTL::stop_on(const char *spec)  { return m_stop.parse(spec); }
+
+// TRACECTL::tracer(void)
+// {{{
+TRACECLASS	*TRACECTL::tracer(void) {
+	if (!m_tfp) {
+#ifndef	TRACE_FST
+		// Only hold the trace in memory if there's something to be
+		// kept from before the start event
+		if ((!m_start.none())&&(m_before > 0)) {
+			m_ring = new TRACERING(m_fname.c_str());
+			m_tfp  = new VerilatedVcdC(m_ring);
+		} else
+#endif
+			m_tfp = new TRACECLASS;
+	}
+
+	return m_tfp;
+}
+// }}}
+
+// TRACECTL::open(void)
+// {{{
+void	TRACECTL::open(void) {
+	tracer();
+	m_opened = true;
+
+	if (m_ring)
+		// Start collecting segments
+		m_tfp->open(m_fname.c_str());
+	else if (m_start.none())
+		trigger(0);
+}
+// }}}
+
+// TRACECTL::dump(t)
+// {{{
+void	TRACECTL::dump(uint64_t t) {
+	if (m_state == TRACING) {
+		if ((m_stop_time > 0)&&(t >= m_stop_time)) {
+			stop();
+			return;
+		}
+
+		m_tfp->dump(t);
+#ifndef	TRACE_FST
+	} else if ((m_state == WAITING)&&(m_ring)) {
+		// Start a new segment every m_before clocks
+		if (m_segment_start == NOTIME)
+			m_segment_start = t;
+		else if (t - m_segment_start >= m_before * m_period) {
+			m_tfp->openNext(false);
+			m_segment_start = t;
+		}
+
+		m_tfp->dump(t);
+#endif
+	}
+}
+// }}}
+
+// TRACECTL::event(ch, perr, ferr, t)
+// {{{
+void	TRACECTL::event(int ch, bool perr, bool ferr, uint64_t t) {
+	bool	was_tracing = (m_state == TRACING);
+
+	// Both events need to see every character, in case either is
+	// looking for a pattern.  A stop event, though, only applies to
+	// characters after the start.
+	if ((m_start.happened(ch, perr, ferr))&&(m_state == WAITING))
+		trigger(t);
+	if ((m_stop.happened(ch, perr, ferr))&&(was_tracing))
+		stop();
+}
+// }}}
+
+// TRACECTL::trigger(t)
+// {{{
+void	TRACECTL::trigger(uint64_t t) {
+	if ((m_state != WAITING)||(!m_opened))
+		return;
+
+#ifndef	TRACE_FST
+	if (m_ring) {
+		if (!m_ring->commit()) {
+			stop();
+			return;
+		}
+	} else
+#endif
+		m_tfp->open(m_fname.c_str());
+
+	m_state = TRACING;
+	m_stop_time = (m_after > 0) ? t + m_after * m_period : 0;
+}
+// }}}
+
+// TRACECTL::stop(void)
+// {{{
+void	TRACECTL::stop(void) {
+	// A trace still collecting segments is simply discarded
+	if ((m_state == TRACING)||((m_state == WAITING)&&(m_ring)&&(m_opened)))
+		m_tfp->close();
+	m_state = DONE;
+}
+// }}}
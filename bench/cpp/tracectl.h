@@ -0,0 +1,234 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	tracectl.h
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Controls when a test bench's trace is recorded, so that only
+//		the clocks around something of interest need be kept, rather
+//	than the whole simulation.
+//
+//	By default, a TRACECTL traces everything, just as the test benches
+//	always have.  It may instead be told to start tracing on a UART event:
+//
+//		byte	Any character received from the device
+//		perr	A character with a parity error
+//		ferr	A character with a framing error (a low stop bit)
+//		error	Either of the above
+//		=text	Once the given text has been received.  \r, \n, \t and
+//			\\ may be used within the text.
+//
+//	and, optionally, to stop on another.  It may also be given a window:
+//	the number of clocks before the start event to keep, and the number
+//	to trace after it (zero, the default, to keep tracing until the stop
+//	event or the end of the simulation).
+//
+//	To keep the clocks before the event, the VCD output is held in memory,
+//	split into segments the length of the window.  Only the last two
+//	segments are ever kept, and nothing is written to disk until the start
+//	event.  At least the window's worth of clocks, and no more than twice
+//	that, will then precede the event in the trace.  If the event never
+//	happens, no trace file is written at all.
+//
+//	If built with TRACE_FST defined, FST traces are written instead (the
+//	Verilated designs must also then be built with --trace-fst).  FST
+//	traces don't support the window before the start event, so they begin
+//	at the event itself.
+//
+//	Usage:
+//		TRACECTL	trace("test.vcd");
+//		trace.start_on("perr");			// Optional
+//		trace.window(5000, 20000);		// Optional
+//		Verilated::traceEverOn(true);
+//		tb->trace(trace.tracer(), 99);
+//		trace.open();
+//		...
+//		Every clock:
+//			trace.dump(10*clocks);
+//			...
+//			(*uart)(tb->o_uart_tx);
+//			trace.check(*uart, 10*clocks);
+//		...
+//		trace.close();
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	TRACECTL_H
+#define	TRACECTL_H
+
+#include <stdint.h>
+#include <string>
+
+#ifdef	TRACE_FST
+#include "verilated_fst_c.h"
+typedef	VerilatedFstC	TRACECLASS;
+#else
+#include "verilated_vcd_c.h"
+typedef	VerilatedVcdC	TRACECLASS;
+#endif
+
+class	TRACERING;
+
+// TRACEEVENT
+// {{{
+// Watches the characters coming from a UARTSIM for a particular event
+class	TRACEEVENT {
+public:
+	typedef	enum { NONE, BYTE, PERR, FERR, ERROR, MATCH } KIND;
+private:
+	KIND		m_kind;
+	std::string	m_pattern, m_recent;
+public:
+	TRACEEVENT(void) : m_kind(NONE) {}
+
+	// parse(spec)
+	// {{{
+	// Sets the event from a description, as above.  Returns false if the
+	// description isn't understood.
+	bool	parse(const char *spec);
+	// }}}
+
+	bool	none(void) const { return (m_kind == NONE); }
+
+	// happened(ch, perr, ferr)
+	// {{{
+	// Given a newly received character, and whether it had a parity or
+	// framing error, returns true if this is the event.
+	bool	happened(int ch, bool perr, bool ferr);
+	// }}}
+};
+// }}}
+
+// TRACECTL
+// {{{
+class	TRACECTL {
+	typedef	enum { WAITING, TRACING, DONE } STATE;
+
+	TRACECLASS	*m_tfp;
+	TRACERING	*m_ring;
+	std::string	m_fname;
+	TRACEEVENT	m_start, m_stop;
+	STATE		m_state;
+	unsigned	m_period;
+	uint64_t	m_before, m_after, m_segment_start, m_stop_time;
+	bool		m_opened;
+
+	// The UARTSIM's counts, as of the last check()
+	unsigned long	m_chars, m_perrs, m_ferrs;
+
+	void	event(int ch, bool perr, bool ferr, uint64_t t);
+public:
+	// As a TESTB tracing policy (testb.h), this one traces
+	static const bool	ENABLED = true;
+
+	// TRACECTL(fname, period)
+	// {{{
+	// Traces to the file fname.  period is the trace time between clocks,
+	// so that windows may be given in clocks.
+	TRACECTL(const char *fname, unsigned period = 10);
+	~TRACECTL(void);
+	// }}}
+
+	// start_on(event), stop_on(event)
+	// {{{
+	// Sets the events that start and stop tracing.  These return false,
+	// and leave things as they were, if the event isn't understood.
+	bool	start_on(const char *spec);
+	bool	stop_on(const char *spec);
+	// }}}
+
+	// window(before, after)
+	// {{{
+	// Sets how many clocks to keep before the start event, and (if
+	// nonzero) how many to trace after it.
+	void	window(uint64_t before, uint64_t after = 0) {
+		m_before = before; m_after = after; }
+	// }}}
+
+	// tracer(void)
+	// {{{
+	// The trace object, to be given to the design's trace() method before
+	// open() is called
+	TRACECLASS	*tracer(void);
+	// }}}
+
+	// open(void)
+	// {{{
+	// Starts things up.  Unless there's a start event, tracing begins now.
+	void	open(void);
+	// }}}
+
+	// dump(t)
+	// {{{
+	// Called in place of the trace's own dump(t)
+	void	dump(uint64_t t);
+	// }}}
+
+	// check(uart, t)
+	// {{{
+	// Called after each step of the UARTSIM, to look for events.  This
+	// costs no more than a comparison unless something has been received.
+	template <class UART> void	check(const UART &uart, uint64_t t) {
+		if (uart.rx_chars() == m_chars)
+			return;
+
+		bool	perr = (uart.rx_parity_errors() != m_perrs),
+			ferr = (uart.rx_frame_errors() != m_ferrs);
+
+		m_chars = uart.rx_chars();
+		m_perrs = uart.rx_parity_errors();
+		m_ferrs = uart.rx_frame_errors();
+		event(uart.rx_last_char(), perr, ferr, t);
+	}
+	// }}}
+
+	// trigger(t), stop(void)
+	// {{{
+	// Starts, or stops, tracing directly
+	void	trigger(uint64_t t);
+	void	stop(void);
+	// }}}
+
+	// tracing(void)
+	// {{{
+	// True while the trace is being written
+	bool	tracing(void) const { return (m_state == TRACING); }
+	// }}}
+
+	// close(void)
+	// {{{
+	// Stops tracing, and writes out whatever is to be kept
+	void	close(void) { stop(); }
+	// }}}
+};
+// }}}
+
+#endif
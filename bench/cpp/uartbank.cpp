@@ -0,0 +1,514 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	uartbank.cpp
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Implements a bank of UART simulators, all stepped together.
+//		Each channel follows the same bit-level model as the UARTSIM,
+//	but rather than each channel polling its own socket, a single epoll
+//	instance watches every listener and connection, and is checked once
+//	per character time for all of them at once.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <signal.h>
+
+#include "uartsim.h"
+#include "uartbank.h"
+
+// The most events handled by any one epoll_wait() call.  Any more will simply
+// be picked up on the next poll.
+#define	UARTBANK_MAXEVENTS	64
+
+// Each epoll event identifies its channel, and whether it is for the listener
+// or the connection
+#define	EV_LISTENER(CHAN)	((CHAN)<<1)
+#define	EV_CONNECTION(CHAN)	(((CHAN)<<1)|1)
+
+// UARTBANK::UARTBANK(nchan, baseport)
+// {{{
+UARTBANK::UARTBANK(const unsigned nchan, const int baseport) {
+	m_nchan = nchan;
+
+	m_skt = new int[nchan];
+	m_con = new int[nchan];
+
+	m_setup       = new unsigned[nchan];
+	m_nparity     = new int[nchan];
+	m_fixdp       = new int[nchan];
+	m_evenp       = new int[nchan];
+	m_nbits       = new int[nchan];
+	m_nstop       = new int[nchan];
+	m_baud_counts = new int[nchan];
+
+	m_rx_baudcounter = new int[nchan];
+	m_rx_state       = new int[nchan];
+	m_rx_busy        = new int[nchan];
+	m_rx_changectr   = new int[nchan];
+	m_last_tx        = new int[nchan];
+	m_tx_baudcounter = new int[nchan];
+	m_tx_state       = new int[nchan];
+	m_tx_busy        = new int[nchan];
+	m_rx_data        = new unsigned[nchan];
+	m_tx_data        = new unsigned[nchan];
+
+	m_ibuf  = new char[nchan * UARTBANK_BUFLEN];
+	m_obuf  = new char[nchan * UARTBANK_BUFLEN];
+	m_ihead = new unsigned[nchan];
+	m_itail = new unsigned[nchan];
+	m_olen  = new unsigned[nchan];
+
+	m_poll_countdown  = 0;
+	m_flush_countdown = 0;
+	m_ochans = 0;
+
+	signal(SIGPIPE, SIG_IGN);
+	m_epfd = epoll_create1(0);
+	if (m_epfd < 0) {
+		perror("ERR: Could not create epoll instance: ");
+		exit(EXIT_FAILURE);
+	}
+
+	for(unsigned k=0; k<nchan; k++)
+		m_setup[k] = 0;
+
+	printf("Listening on ports %d-%d\n", baseport, baseport+nchan-1);
+	for(unsigned k=0; k<nchan; k++) {
+		m_rx_baudcounter[k] = 0;
+		m_tx_baudcounter[k] = 0;
+		m_rx_state[k] = RXIDLE;
+		m_tx_state[k] = TXIDLE;
+		m_rx_busy[k] = 0;
+		m_tx_busy[k] = 0;
+		m_rx_data[k] = 0;
+		m_tx_data[k] = -1;
+		m_rx_changectr[k] = 0;
+		m_last_tx[k] = 1;
+		m_ihead[k] = m_itail[k] = 0;
+		m_olen[k] = 0;
+
+		setup(k, 25);	// (Default) 8N1 w/ a baud rate of CLK/25
+
+		m_con[k] = -1;
+		setup_listener(k, baseport+k);
+	}
+}
+// }}}
+
+// UARTBANK::~UARTBANK
+// {{{
+UARTBANK::~UARTBANK(void) {
+	kill();
+	if (m_epfd >= 0)
+		close(m_epfd);
+
+	delete[] m_skt;
+	delete[] m_con;
+
+	delete[] m_setup;
+	delete[] m_nparity;
+	delete[] m_fixdp;
+	delete[] m_evenp;
+	delete[] m_nbits;
+	delete[] m_nstop;
+	delete[] m_baud_counts;
+
+	delete[] m_rx_baudcounter;
+	delete[] m_rx_state;
+	delete[] m_rx_busy;
+	delete[] m_rx_changectr;
+	delete[] m_last_tx;
+	delete[] m_tx_baudcounter;
+	delete[] m_tx_state;
+	delete[] m_tx_busy;
+	delete[] m_rx_data;
+	delete[] m_tx_data;
+
+	delete[] m_ibuf;
+	delete[] m_obuf;
+	delete[] m_ihead;
+	delete[] m_itail;
+	delete[] m_olen;
+}
+// }}}
+
+// UARTBANK::setup_listener(chan, port)
+// {{{
+void	UARTBANK::setup_listener(const unsigned chan, const int port) {
+	struct	sockaddr_in	my_addr;
+	struct	epoll_event	ev;
+	int	skt;
+
+	skt = socket(AF_INET, SOCK_STREAM, 0);
+	if (skt < 0) {
+		perror("ERR: Could not allocate socket: ");
+		exit(EXIT_FAILURE);
+	}
+
+	// Set the reuse address option
+	{
+		int optv = 1, er;
+		er = setsockopt(skt, SOL_SOCKET, SO_REUSEADDR, &optv, sizeof(optv));
+		if (er != 0) {
+			perror("ERR: SockOpt Err:");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	memset(&my_addr, 0, sizeof(struct sockaddr_in)); // clear structure
+	my_addr.sin_family = AF_INET;
+	my_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	my_addr.sin_port = htons(port);
+
+	if (bind(skt, (struct sockaddr *)&my_addr, sizeof(my_addr))!=0) {
+		perror("ERR: BIND FAILED:");
+		exit(EXIT_FAILURE);
+	}
+
+	if (listen(skt, 1) != 0) {
+		perror("ERR: Listen failed:");
+		exit(EXIT_FAILURE);
+	}
+
+	m_skt[chan] = skt;
+
+	ev.events   = EPOLLIN;
+	ev.data.u64 = EV_LISTENER(chan);
+	if (epoll_ctl(m_epfd, EPOLL_CTL_ADD, skt, &ev) != 0) {
+		perror("ERR: Could not watch socket:");
+		exit(EXIT_FAILURE);
+	}
+}
+// }}}
+
+// UARTBANK::close_connection(chan)
+// {{{
+// Closes the channel's connection, and starts listening for a new one
+void	UARTBANK::close_connection(const unsigned chan) {
+	if (m_con[chan] >= 0) {
+		// Closing the socket also removes it from the epoll set
+		close(m_con[chan]);
+		m_con[chan] = -1;
+
+		if (m_skt[chan] >= 0) {
+			struct	epoll_event	ev;
+
+			ev.events   = EPOLLIN;
+			ev.data.u64 = EV_LISTENER(chan);
+			epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_skt[chan], &ev);
+		}
+	}
+}
+// }}}
+
+// UARTBANK::setup(chan, isetup)
+// {{{
+void	UARTBANK::setup(const unsigned chan, const unsigned isetup) {
+	if (isetup != m_setup[chan]) {
+		unsigned	chclocks = -1;
+
+		m_setup[chan] = isetup;
+		m_baud_counts[chan] = (isetup & 0x0ffffff);
+		m_nbits[chan]   = 8-((isetup >> 28)&0x03);
+		m_nstop[chan]   =((isetup >> 27)&1)+1;
+		m_nparity[chan] = (isetup >> 26)&1;
+		m_fixdp[chan]   = (isetup >> 25)&1;
+		m_evenp[chan]   = (isetup >> 24)&1;
+
+		// The host is checked once per the shortest character time of
+		// any channel.  Channels not yet set up don't count.
+		for(unsigned k=0; k<m_nchan; k++) {
+			unsigned	ck;
+
+			if (m_setup[k] == 0)
+				continue;
+			ck = m_baud_counts[k]
+				* (1+m_nbits[k]+m_nparity[k]+m_nstop[k]);
+			if (ck < chclocks)
+				chclocks = ck;
+		}
+
+		m_poll_clocks  = chclocks;
+		m_flush_clocks = 64 * chclocks;
+		if (m_poll_countdown > m_poll_clocks)
+			m_poll_countdown = m_poll_clocks;
+		if (m_flush_countdown > m_flush_clocks)
+			m_flush_countdown = m_flush_clocks;
+	}
+}
+// }}}
+
+// UARTBANK::host_write(chan)
+// {{{
+void	UARTBANK::host_write(const unsigned chan) {
+	unsigned	posn = 0, len = m_olen[chan];
+	const char	*buf = &m_obuf[chan * UARTBANK_BUFLEN];
+
+	if (len == 0)
+		return;
+
+	while((posn < len)&&(m_con[chan] >= 0)) {
+		int	nw = send(m_con[chan], &buf[posn], len-posn, 0);
+
+		if (nw > 0)
+			posn += nw;
+		else {
+			close_connection(chan);
+			fprintf(stderr, "Failed write, channel %d connection closed\n", chan);
+		}
+	}
+
+	m_olen[chan] = 0;
+	m_ochans--;
+}
+// }}}
+
+// UARTBANK::host_poll
+// {{{
+// Accepts any new connections, and reads from any connection that has data
+// while its channel has nothing else waiting to be sent.  Connections whose
+// channels are still busy are simply left for a later poll.
+void	UARTBANK::host_poll(void) {
+	struct	epoll_event	evs[UARTBANK_MAXEVENTS];
+	int	nev;
+
+	nev = epoll_wait(m_epfd, evs, UARTBANK_MAXEVENTS, 0);
+	if (nev < 0)
+		perror("Polling error:");
+
+	for(int e=0; e<nev; e++) {
+		unsigned	chan = (unsigned)(evs[e].data.u64 >> 1);
+
+		if (0 == (evs[e].data.u64 & 1)) {
+			// A new connection
+			// {{{
+			struct	epoll_event	ev;
+			int	con;
+
+			if (m_con[chan] >= 0)
+				continue;
+
+			con = accept(m_skt[chan], 0, 0);
+			if (con < 0) {
+				perror("Accept failed:");
+				continue;
+			}
+
+			// Only one connection per channel at a time, so stop
+			// listening until this one goes away.
+			m_con[chan] = con;
+			epoll_ctl(m_epfd, EPOLL_CTL_DEL, m_skt[chan], NULL);
+
+			ev.events   = EPOLLIN;
+			ev.data.u64 = EV_CONNECTION(chan);
+			if (epoll_ctl(m_epfd, EPOLL_CTL_ADD, con, &ev) != 0) {
+				perror("ERR: Could not watch connection:");
+				close_connection(chan);
+			}
+			// }}}
+		} else if (m_itail[chan] >= m_ihead[chan]) {
+			// New data for an idle channel
+			// {{{
+			int	nr;
+
+			nr = recv(m_con[chan], &m_ibuf[chan * UARTBANK_BUFLEN],
+				UARTBANK_BUFLEN, MSG_DONTWAIT);
+			if (nr <= 0) {
+				if (nr < 0)
+					perror("O/S Read err:");
+				close_connection(chan);
+				nr = 0;
+			}
+
+			m_itail[chan] = 0;
+			m_ihead[chan] = nr;
+			// }}}
+		}
+	}
+
+	m_poll_countdown = m_poll_clocks;
+}
+// }}}
+
+// UARTBANK::flush
+// {{{
+void	UARTBANK::flush(void) {
+	for(unsigned k=0; (k<m_nchan)&&(m_ochans > 0); k++)
+		host_write(k);
+}
+// }}}
+
+// UARTBANK::kill
+// {{{
+void	UARTBANK::kill(void) {
+	flush();
+	fflush(stdout);
+
+	for(unsigned k=0; k<m_nchan; k++) {
+		if (m_con[k] >= 0)
+			close(m_con[k]);
+		if (m_skt[k] >= 0)
+			close(m_skt[k]);
+		m_con[k] = m_skt[k] = -1;
+	}
+}
+// }}}
+
+// UARTBANK::operator()(i_tx, o_rx)
+// {{{
+void	UARTBANK::operator()(const unsigned char *i_tx, unsigned char *o_rx) {
+	// The receivers
+	// {{{
+	for(unsigned k=0; k<m_nchan; k++) {
+		const int	tx = i_tx[k];
+
+		if ((!tx)&&(m_last_tx[k]))
+			m_rx_changectr[k] = 0;
+		else	m_rx_changectr[k]++;
+		m_last_tx[k] = tx;
+
+		if (m_rx_state[k] == RXIDLE) {
+			if (!tx) {
+				m_rx_state[k] = RXDATA;
+				m_rx_baudcounter[k] = m_baud_counts[k]
+					+ m_baud_counts[k]/2-1
+					- m_rx_changectr[k];
+				m_rx_busy[k] = 0;
+				m_rx_data[k] = 0;
+			}
+		} else if (m_rx_baudcounter[k] <= 0) {
+			int	nbits = m_nbits[k]+m_nparity[k]+m_nstop[k];
+
+			if (m_rx_busy[k] >= (1<<(nbits-1))) {
+				m_rx_state[k] = RXIDLE;
+				if (m_con[k] >= 0) {
+					unsigned	len = m_olen[k];
+
+					if (len == 0) {
+						if (m_ochans++ == 0)
+							m_flush_countdown = m_flush_clocks;
+					}
+					m_obuf[k * UARTBANK_BUFLEN + len]
+						= (m_rx_data[k] >> (32-nbits))
+						& ((1<<m_nbits[k])-1);
+					m_olen[k] = ++len;
+					if (len >= UARTBANK_BUFLEN)
+						host_write(k);
+				}
+			} else {
+				// Bits arrive LSB first, just as in the UARTSIM
+				m_rx_busy[k] = (m_rx_busy[k] << 1)|1;
+				m_rx_data[k] = ((tx&1)<<31) | (m_rx_data[k]>>1);
+			} m_rx_baudcounter[k] = m_baud_counts[k]-1;
+		} else
+			m_rx_baudcounter[k]--;
+	}
+	// }}}
+
+	// Send any buffered output that's been waiting too long
+	if (m_ochans > 0) {
+		if (m_flush_countdown > 0)
+			m_flush_countdown--;
+		else
+			flush();
+	}
+
+	// Check the host for all channels at once
+	if (m_poll_countdown > 0)
+		m_poll_countdown--;
+	else
+		host_poll();
+
+	// The transmitters
+	// {{{
+	for(unsigned k=0; k<m_nchan; k++) {
+		if (m_tx_state[k] == TXIDLE) {
+			if (m_itail[k] < m_ihead[k]) {
+				unsigned	tx_data;
+				int		ch;
+
+				ch = m_ibuf[k * UARTBANK_BUFLEN + m_itail[k]++];
+				tx_data = (~0u<<(m_nbits[k]+m_nparity[k]+1))
+					// << nstart_bits
+					|((ch & ((1<<m_nbits[k])-1))<<1);
+				if (m_nparity[k]) {
+					int	p;
+
+					if (m_fixdp[k])
+						p = m_evenp[k];
+					else {
+						p = (tx_data >> 1)
+							& ((1<<m_nbits[k])-1);
+						p = p ^ (p>>4);
+						p = p ^ (p>>2);
+						p = p ^ (p>>1);
+						p &= 1;
+						p ^= !m_evenp[k];
+					}
+					tx_data |= (p<<(m_nbits[k]+m_nparity[k]));
+				}
+				m_tx_data[k] = tx_data;
+				m_tx_busy[k] = (1<<(m_nbits[k]+m_nparity[k]+m_nstop[k]+1))-1;
+				m_tx_state[k] = TXDATA;
+				m_tx_baudcounter[k] = m_baud_counts[k]-1;
+				o_rx[k] = 0;
+
+				// Once this channel has sent all it has, check
+				// right away to see if there's more
+				if (m_itail[k] >= m_ihead[k])
+					m_poll_countdown = 0;
+			} else
+				o_rx[k] = 1;
+		} else if (m_tx_baudcounter[k] <= 0) {
+			m_tx_data[k] >>= 1;
+			m_tx_busy[k] >>= 1;
+			if (!m_tx_busy[k])
+				m_tx_state[k] = TXIDLE;
+			else
+				m_tx_baudcounter[k] = m_baud_counts[k]-1;
+			o_rx[k] = m_tx_data[k]&1;
+		} else {
+			m_tx_baudcounter[k]--;
+			o_rx[k] = m_tx_data[k]&1;
+		}
+	}
+	// }}}
+}
+// }}}
@@ -0,0 +1,143 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	uartbank.h
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Simulates a whole bank of UARTs at once, for designs with many
+//		of them.  Each channel behaves like a UARTSIM listening on its
+//	own TCP/IP port (channel k listens on baseport+k), but the state of all
+//	channels is kept in a structure of arrays so that all of them can be
+//	stepped in a single call per clock, and all of their host I/O is
+//	multiplexed through a single epoll instance.
+//
+//	Usage:
+//		UARTBANK	bank(12, 8360);
+//		unsigned char	tx[12], rx[12];
+//		...
+//		for each channel, bank.setup(k, setup_word);
+//		...
+//		Every clock:
+//			for each channel, tx[k] = o_uart_tx from the device
+//			bank(tx, rx);
+//			for each channel, i_uart_rx into the device = rx[k]
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	UARTBANK_H
+#define	UARTBANK_H
+
+// The size of each channel's host buffers, in each direction
+#define	UARTBANK_BUFLEN	1024
+
+class	UARTBANK {
+	// Member declarations
+	// {{{
+	unsigned	m_nchan;
+	// The one epoll instance, and the listener and connection sockets
+	int		m_epfd;
+	int		*m_skt, *m_con;
+
+	// The setup register for each channel, and its pieces broken out
+	unsigned	*m_setup;
+	int		*m_nparity, *m_fixdp, *m_evenp, *m_nbits, *m_nstop,
+			*m_baud_counts;
+
+	// UART state, one entry per channel
+	int		*m_rx_baudcounter, *m_rx_state, *m_rx_busy,
+			*m_rx_changectr, *m_last_tx;
+	int		*m_tx_baudcounter, *m_tx_state, *m_tx_busy;
+	unsigned	*m_rx_data, *m_tx_data;
+
+	// Host buffers.  Channel k's input sits in m_ibuf[k*UARTBANK_BUFLEN
+	// + m_itail[k]] through m_ibuf[k*UARTBANK_BUFLEN + m_ihead[k]-1],
+	// and its output in the first m_olen[k] bytes of its slice of m_obuf.
+	char		*m_ibuf, *m_obuf;
+	unsigned	*m_ihead, *m_itail, *m_olen;
+
+	// All channels share one schedule for checking the host (once per
+	// the shortest character time of any channel), and another for
+	// sending buffered output to the host (sixty four such character times
+	// after the first byte is buffered).  m_ochans counts the channels
+	// with output waiting.
+	unsigned	m_poll_clocks, m_poll_countdown,
+			m_flush_clocks, m_flush_countdown, m_ochans;
+	// }}}
+
+	// Private methods
+	// {{{
+	void	setup_listener(const unsigned chan, const int port);
+	void	close_connection(const unsigned chan);
+	// Handle any host activity, on all channels, with one epoll_wait()
+	void	host_poll(void);
+	// Send any buffered output from the given channel
+	void	host_write(const unsigned chan);
+	// }}}
+public:
+	// UARTBANK(nchan, baseport)
+	// {{{
+	// Creates nchan UARTs, the first of which listens on baseport, the
+	// next on baseport+1, and so on.  All start out as 8N1 with a baud
+	// rate of CLK/25, just like the UARTSIM.
+	UARTBANK(const unsigned nchan, const int baseport);
+	~UARTBANK(void);
+	// }}}
+
+	// nchan(void)
+	// {{{
+	unsigned	nchan(void) const { return m_nchan; }
+	// }}}
+
+	// setup(chan, isetup)
+	// {{{
+	// Sets the baud rate, bits, parity, and stop bits of one channel,
+	// using the same setup word as the UARTSIM.
+	void	setup(const unsigned chan, const unsigned isetup);
+	// }}}
+
+	// flush(void), kill(void)
+	// {{{
+	// flush() sends all buffered output on all channels to the host.
+	// kill() flushes, and then closes all connections and listeners.
+	void	flush(void);
+	void	kill(void);
+	// }}}
+
+	// operator()(i_tx, o_rx)
+	// {{{
+	// Advances every channel by one clock.  i_tx[k] is the transmit wire
+	// from the device for channel k, and o_rx[k] is set to the receive
+	// wire into the device for that channel.
+	void	operator()(const unsigned char *i_tx, unsigned char *o_rx);
+	// }}}
+};
+
+#endif
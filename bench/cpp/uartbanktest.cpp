@@ -0,0 +1,284 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	uartbanktest.cpp
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Checks the UARTBANK, several channels at once, each with its own
+//		framing and baud rate, against one UARTSIM per channel.
+//
+//	Each channel's far end is a UARTSIM, over a LOOPTRANSPORT, standing in
+//	for the device.  This program connects to each channel's TCP/IP port,
+//	as any host would, and sends it a message.  The UARTBANK must send that
+//	message out on the channel's transmit wire, where the UARTSIM must
+//	receive it unchanged (to as many data bits as the framing has), with
+//	no parity or framing errors.  Meanwhile, the UARTSIM sends a second
+//	message back, which the UARTBANK must receive and pass on to the host
+//	through the same connection.  All of the connections, and the
+//	listeners before them, share the UARTBANK's one epoll instance.
+//
+//	The UARTBANK drops anything received while no host is connected, so
+//	each UARTSIM holds off sending (via rts()) until the first character of
+//	the host's message arrives--by which time the UARTBANK must have
+//	accepted the connection.
+//
+//	No Verilated design is needed.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "uartsim.h"
+#include "uartbank.h"
+
+#define	MAXMSG		256
+
+// The channels, and the setup each is given:  8N1, 8O1, 7N2, 8E2, 5M1, and
+// 6S2, at several baud rates
+static const unsigned	setups[] = {
+		0x00000019, 0x04000021, 0x18000032,
+		0x0d00001b, 0x37000040, 0x2e00002b };
+#define	NCHAN	(sizeof(setups)/sizeof(setups[0]))
+
+void	usage(void) {
+// {{{
+	fprintf(stderr, "USAGE: uartbanktest [-p <port>]\n");
+	fprintf(stderr, "\n"
+"\tSends a message each way through every channel of a UARTBANK, each\n"
+"\tchannel with its own framing, and checks that both arrive unchanged.\n"
+"\n"
+"\t-p <port>\tChannel k listens on this port, plus k.  (Default: 8640)\n\n");
+}
+// }}}
+
+// framing_name(setup, str)
+// {{{
+// Describes a framing in the usual form, as in 8N1 or 7E2
+static void	framing_name(unsigned bits, char *str) {
+	static const char	pname[8] = { 'N', 'N', 'N', 'N', 'O', 'E', 'S', 'M' };
+
+	sprintf(str, "%d%c%d", 8-((bits >> 28)&3), pname[(bits >> 24)&7],
+		((bits >> 27)&1)+1);
+}
+// }}}
+
+// host_connect(port)
+// {{{
+static int	host_connect(int port) {
+	struct	sockaddr_in	addr;
+	int	skt;
+
+	skt = socket(AF_INET, SOCK_STREAM, 0);
+	if (skt < 0) {
+		perror("O/S ERR: socket");
+		exit(EXIT_FAILURE);
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	if (connect(skt, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		perror("O/S ERR: connect");
+		exit(EXIT_FAILURE);
+	}
+
+	return skt;
+}
+// }}}
+
+// host_read(skt, buf, len, maxlen, wait_ms)
+// {{{
+// Adds whatever the channel has sent the host so far to buf, waiting up to
+// wait_ms for it, and returns the new length
+static int	host_read(int skt, char *buf, int len, int maxlen, int wait_ms) {
+	struct	pollfd	pfd;
+
+	pfd.fd = skt;
+	pfd.events = POLLIN;
+	while((len < maxlen)&&(poll(&pfd, 1, wait_ms) > 0)) {
+		int	nr = recv(skt, &buf[len], maxlen-len, MSG_DONTWAIT);
+
+		if (nr <= 0)
+			break;
+		len += nr;
+	}
+
+	return len;
+}
+// }}}
+
+int	main(int argc, char **argv) {
+	typedef	UARTSIMT<LOOPTRANSPORT>	DEVICE;
+	DEVICE		*dev[NCHAN];
+	char		tohost[NCHAN][MAXMSG], todev[NCHAN][MAXMSG],
+			athost[NCHAN][MAXMSG], atdev[NCHAN][MAXMSG];
+	int		tohostlen[NCHAN], todevlen[NCHAN], athostlen[NCHAN],
+			skt[NCHAN];
+	unsigned char	bank_tx[NCHAN], bank_rx[NCHAN];
+	unsigned long	clocks = 0, maxclocks = 0;
+	int		baseport = 8640, nfail = 0;
+
+	// Argument processing
+	// {{{
+	for(int argn=1; argn<argc; argn++) {
+		if ((strcmp(argv[argn], "-p") == 0)&&(argn+1 < argc)) {
+			baseport = atoi(argv[++argn]);
+		} else {
+			usage();
+			exit(EXIT_FAILURE);
+		}
+	}
+	// }}}
+
+	UARTBANK	bank(NCHAN, baseport);
+
+	// Set up each channel, its far end, and its host
+	// {{{
+	for(unsigned k=0; k<NCHAN; k++) {
+		unsigned	chclocks;
+
+		// Two messages per channel, each its own length, and each
+		// with some characters wider than the narrower framings
+		todevlen[k] = sprintf(todev[k],
+			"Channel %u, from the host to the device\r\n", k);
+		for(unsigned j=0; j<4*k; j++)
+			todev[k][todevlen[k]++] = (char)(0x81 + 37*j);
+		tohostlen[k] = sprintf(tohost[k],
+			"And channel %u, from the device back to the host\r\n",
+			k);
+		for(unsigned j=0; j<3*k; j++)
+			tohost[k][tohostlen[k]++] = (char)(0xfe - 29*j);
+		athostlen[k] = 0;
+
+		bank.setup(k, setups[k]);
+		dev[k] = new DEVICE(tohost[k], tohostlen[k], atdev[k], MAXMSG);
+		dev[k]->setup(setups[k]);
+		// Nothing may be sent towards the bank until it has a host
+		dev[k]->rts(1);
+
+		bank_tx[k] = bank_rx[k] = 1;
+
+		// Both messages, one after the other, with room to spare
+		chclocks = (setups[k] & 0x0ffffff) * 13;
+		if (maxclocks < 4ul * chclocks * (todevlen[k]+tohostlen[k]))
+			maxclocks = 4ul * chclocks * (todevlen[k]+tohostlen[k]);
+
+		skt[k] = host_connect(baseport+k);
+		if (send(skt[k], todev[k], todevlen[k], 0) != todevlen[k]) {
+			perror("O/S ERR: send");
+			exit(EXIT_FAILURE);
+		}
+	}
+	// }}}
+
+	// Run until every message has gotten where it's going
+	// {{{
+	while(clocks < maxclocks) {
+		bool	done = true;
+
+		for(unsigned k=0; k<NCHAN; k++) {
+			bank_tx[k] = (*dev[k])(bank_rx[k]);
+			if (dev[k]->rx_chars() > 0)
+				dev[k]->rts(0);
+		}
+		bank(bank_tx, bank_rx);
+		clocks++;
+
+		if ((clocks & 0x03ff) != 0)
+			continue;
+
+		bank.flush();
+		for(unsigned k=0; k<NCHAN; k++) {
+			athostlen[k] = host_read(skt[k], athost[k], athostlen[k],
+					MAXMSG, 0);
+			if ((athostlen[k] < tohostlen[k])
+					||((int)dev[k]->rx_chars() < todevlen[k]))
+				done = false;
+		}
+
+		if (done)
+			break;
+	}
+	// }}}
+
+	// Check each channel
+	// {{{
+	bank.flush();
+	for(unsigned k=0; k<NCHAN; k++) {
+		unsigned	mask = (1u << (8-((setups[k] >> 28)&3)))-1;
+		int		nbad = 0, ndev;
+		char		fname[8];
+
+		dev[k]->flush();
+		ndev = dev[k]->host().received();
+		athostlen[k] = host_read(skt[k], athost[k], athostlen[k],
+				MAXMSG, (athostlen[k] < tohostlen[k]) ? 100 : 0);
+
+		if (ndev != todevlen[k])
+			nbad++;
+		for(int j=0; (j<ndev)&&(j<todevlen[k]); j++)
+			if ((atdev[k][j] & mask) != (todev[k][j] & mask))
+				nbad++;
+		if (athostlen[k] != tohostlen[k])
+			nbad++;
+		for(int j=0; (j<athostlen[k])&&(j<tohostlen[k]); j++)
+			if ((athost[k][j] & mask) != (tohost[k][j] & mask))
+				nbad++;
+		nbad += dev[k]->rx_parity_errors() + dev[k]->rx_frame_errors();
+
+		framing_name(setups[k], fname);
+		printf("Channel %u, %s @ %2u: %3d of %3d bytes to the device, %3d of %3d to the host, %lu parity and %lu framing errors: %s\n",
+			k, fname, setups[k] & 0x0ffffff,
+			ndev, todevlen[k], athostlen[k], tohostlen[k],
+			dev[k]->rx_parity_errors(), dev[k]->rx_frame_errors(),
+			(nbad == 0) ? "PASS" : "FAIL");
+		if (nbad != 0)
+			nfail++;
+
+		close(skt[k]);
+		delete dev[k];
+	}
+	// }}}
+
+	printf("\n%u of %u channels passed, in %lu clocks\n%s\n",
+		(unsigned)(NCHAN-nfail), (unsigned)NCHAN, clocks,
+		(nfail == 0) ? "PASS" : "FAIL");
+
+	return (nfail == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
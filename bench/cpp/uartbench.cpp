@@ -0,0 +1,366 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	uartbench.cpp
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Measures how fast each of the Verilated test designs simulates,
+//		with and without VCD tracing, across several baud rates.
+//
+//	Each design is run for a fixed number of clocks, with the UARTSIM
+//	attached as in the other test benches.  Designs with a receiver
+//	(linetest) are fed a repeating test string, so there's always
+//	traffic in both directions.  The results are written as CSV, one line
+//	per run, so they may be tracked from one build to the next:
+//
+//	design		The Verilated design
+//	setup		The setup word given to the design and the UARTSIM
+//	trace		1 if a VCD trace was being recorded, else 0
+//	clocks		The number of clocks simulated
+//	seconds		Wall clock time for the whole run
+//	clocks_per_sec	Simulated clocks per second
+//	bytes		Bytes received from the design by the UARTSIM
+//	bytes_per_sec	The same, per second of wall clock time
+//	eval_seconds	Time spent everywhere but the UARTSIM--the design's
+//			eval(), tracing, and this harness
+//	uart_seconds	Time spent within the UARTSIM
+//
+//	The UARTSIM's share is found by recording its input on every clock,
+//	and then replaying that recording through a second UARTSIM by itself.
+//	This keeps any timing calls out of the per-clock loop, where they'd
+//	cost more than many of the things being measured.
+//
+//	Traces are written to /dev/null, so that the cost of generating them is
+//	measured rather than the speed of the disk.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <verilatedos.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "verilated.h"
+#include "tracectl.h"
+#include "Vhelloworld.h"
+#include "Vhelloworldlite.h"
+#include "Vlinetest.h"
+#include "Vlinetestlite.h"
+#include "Vspeechfifo.h"
+#include "Vspeechfifolite.h"
+#include "uartsim.h"
+
+// The lite designs have their baud rate fixed at 868 clocks per baud
+#define	LITE_SETUP	868
+#define	MAXSETUPS	32
+
+void	usage(void) {
+// {{{
+	fprintf(stderr, "USAGE: uartbench [-c <clocks>] [-d <design>] [-s <setup>] [-n]\n");
+	fprintf(stderr, "\n"
+"\tRuns each test design, writing performance results to stdout as CSV.\n"
+"\n"
+"\t-c <clocks>\tSimulates this many clocks per run (default: 2000000)\n"
+"\t-d <design>\tOnly runs the named design.  May be repeated.\n"
+"\t-s <setup>\tRuns the non-lite designs with this setup word, rather\n"
+"\t\tthan the default set of 25, 100, and 868.  May be repeated.\n"
+"\t-n\tSkips the runs with VCD tracing.  (Designs Verilated without\n"
+"\t\ttracing, as for uartbench-fast, are never traced.)\n\n");
+}
+// }}}
+
+// BENCHTRANSPORT
+// {{{
+// A host that does nothing but count what it's given, and (if given a source
+// string) send that string over and over again.
+class	BENCHTRANSPORT {
+	const char	*m_src;
+	int		m_srclen, m_posn;
+	unsigned long	m_received;
+public:
+	BENCHTRANSPORT(const char *src = NULL) : m_src(src),
+		m_srclen((src) ? strlen(src) : 0), m_posn(0), m_received(0) {}
+
+	int	read(char *buf, int len) {
+		for(int k=0; k<len; k++) {
+			buf[k] = m_src[m_posn++];
+			if (m_posn >= m_srclen)
+				m_posn = 0;
+		} return len;
+	}
+	int	write(const char *buf, int len) {
+		m_received += len; return len; }
+	bool	connected(void) const { return true; }
+	bool	readable(void) const { return (m_srclen > 0); }
+	void	close(void) {}
+
+	unsigned long	received(void) const { return m_received; }
+};
+// }}}
+
+// LAZYUART
+// {{{
+// The UARTSIM, stepped only when something might happen, as within the
+// helloworld test bench
+class	LAZYUART : public UARTSIMT<BENCHTRANSPORT> {
+	unsigned	m_idle, m_skipped;
+	int		m_last, m_rx;
+public:
+	LAZYUART(const char *src) : UARTSIMT<BENCHTRANSPORT>(src),
+		m_idle(0), m_skipped(0), m_last(1), m_rx(1) {}
+
+	int	step(int tx) {
+		if ((m_idle > 0)&&(tx == m_last)) {
+			m_idle--;
+			m_skipped++;
+		} else {
+			skip(m_skipped);
+			m_skipped = 0;
+			m_rx = tick(tx);
+			m_last = tx;
+			m_idle = next_event_clocks();
+		} return m_rx;
+	}
+
+	void	finish(void) {
+		skip(m_skipped);
+		m_skipped = 0;
+		flush();
+	}
+};
+// }}}
+
+// set_rx(tb, rx)
+// {{{
+// Only the linetest designs have a receiver to drive
+template <class VA> static inline void	set_rx(VA *tb, int rx) {}
+static inline void	set_rx(Vlinetest *tb, int rx) { tb->i_uart_rx = rx; }
+static inline void	set_rx(Vlinetestlite *tb, int rx) { tb->i_uart_rx = rx; }
+// }}}
+
+// trace_design(tb, tfp)
+// {{{
+// Starts tracing the design, returning false if it was Verilated without
+// tracing, as for uartbench-fast
+template <class VA> static inline auto	trace_design(VA *tb, TRACECLASS *tfp,
+		int) -> decltype(tb->trace(tfp, 99), bool()) {
+	tb->trace(tfp, 99);
+	return true;
+}
+
+template <class VA> static inline bool	trace_design(VA *tb, TRACECLASS *tfp,
+		long) { return false; }
+// }}}
+
+static double	now(void) {
+	struct	timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// run(name, setup, trace, nclocks, src)
+// {{{
+template <class VA> void	run(const char *name, unsigned setup, bool trace,
+		uint64_t nclocks, const char *src) {
+	VA		*tb = new VA;
+	LAZYUART	*uart = new LAZYUART(src);
+	TRACECLASS	*tfp = NULL;
+	std::vector<uint64_t>	wave((nclocks+63)/64, 0);
+	double		start, elapsed, uart_seconds;
+	unsigned long	bytes;
+
+	tb->i_setup = setup;
+	set_rx(tb, 1);
+	uart->setup(setup);
+
+	if (trace) {
+		tfp = new TRACECLASS;
+		if (!trace_design(tb, tfp, 0)) {
+			// Built without tracing, so there's nothing to measure
+			delete tfp;
+			delete uart;
+			delete tb;
+			return;
+		}
+		tfp->open("/dev/null");
+	}
+
+	// The full simulation
+	// {{{
+	start = now();
+	for(uint64_t clk=0; clk<nclocks; clk++) {
+		int	tx;
+
+		tb->i_clk = 1;
+		tb->eval();
+		if (tfp) tfp->dump(10*clk);
+		tb->i_clk = 0;
+		tb->eval();
+		if (tfp) tfp->dump(10*clk+5);
+
+		tx = tb->o_uart_tx;
+		wave[clk>>6] |= (uint64_t)(tx&1) << (clk&63);
+		set_rx(tb, uart->step(tx));
+	}
+
+	uart->finish();
+	if (tfp)
+		tfp->close();
+	elapsed = now() - start;
+	bytes = uart->host().received();
+	// }}}
+
+	// The UARTSIM alone, replaying the same input
+	// {{{
+	delete uart;
+	uart = new LAZYUART(src);
+	uart->setup(setup);
+
+	start = now();
+	for(uint64_t clk=0; clk<nclocks; clk++)
+		uart->step((wave[clk>>6] >> (clk&63))&1);
+	uart->finish();
+	uart_seconds = now() - start;
+	if (uart_seconds > elapsed)
+		uart_seconds = elapsed;
+	// }}}
+
+	printf("%s,0x%08x,%d,%lu,%.6f,%.0f,%lu,%.1f,%.6f,%.6f\n",
+		name, setup, (trace) ? 1:0, (unsigned long)nclocks, elapsed,
+		nclocks / elapsed, bytes, bytes / elapsed,
+		elapsed - uart_seconds, uart_seconds);
+	fflush(stdout);
+
+	tb->final();
+	delete tfp;
+	delete uart;
+	delete tb;
+}
+// }}}
+
+// The designs
+// {{{
+typedef	void (*BENCHFN)(const char *, unsigned, bool, uint64_t, const char *);
+
+static	const struct	{
+	const char	*m_name;
+	BENCHFN		m_run;
+	bool		m_lite, m_rx;
+} designs[] = {
+	{ "helloworld",     run<Vhelloworld>,     false, false },
+	{ "helloworldlite", run<Vhelloworldlite>, true,  false },
+	{ "linetest",       run<Vlinetest>,       false, true  },
+	{ "linetestlite",   run<Vlinetestlite>,   true,  true  },
+	{ "speechfifo",     run<Vspeechfifo>,     false, false },
+	{ "speechfifolite", run<Vspeechfifolite>, true,  false }
+};
+
+static const int	NDESIGNS = sizeof(designs)/sizeof(designs[0]);
+// }}}
+
+int	main(int argc, char **argv) {
+	Verilated::commandArgs(argc, argv);
+	const char	*testsrc = "This is a UART testing string\r\n";
+	uint64_t	nclocks = 2000000;
+	unsigned	setups[MAXSETUPS], nsetups = 0;
+	bool		selected[NDESIGNS], any_selected = false, notrace = false;
+
+	for(int k=0; k<NDESIGNS; k++)
+		selected[k] = false;
+
+	// Argument processing
+	// {{{
+	for(int argn=1; argn<argc; argn++) {
+		if ((argv[argn][0] == '-')&&(argv[argn][2] == '\0')
+				&&(strchr("cds", argv[argn][1]))
+				&&(argn+1 >= argc)) {
+			usage();
+			exit(EXIT_FAILURE);
+		} else if (strcmp(argv[argn], "-c") == 0) {
+			nclocks = strtoull(argv[++argn], NULL, 0);
+		} else if (strcmp(argv[argn], "-d") == 0) {
+			bool	found = false;
+
+			argn++;
+			for(int k=0; k<NDESIGNS; k++)
+				if (strcmp(argv[argn], designs[k].m_name) == 0)
+					found = selected[k] = true;
+			if (!found) {
+				fprintf(stderr, "Unknown design, %s\n", argv[argn]);
+				exit(EXIT_FAILURE);
+			} any_selected = true;
+		} else if (strcmp(argv[argn], "-s") == 0) {
+			argn++;
+			if (nsetups < MAXSETUPS)
+				setups[nsetups++] = strtoul(argv[argn], NULL, 0);
+		} else if (strcmp(argv[argn], "-n") == 0) {
+			notrace = true;
+		} else {
+			usage();
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (nsetups == 0) {
+		setups[nsetups++] = 25;
+		setups[nsetups++] = 100;
+		setups[nsetups++] = 868;
+	}
+	// }}}
+
+	printf("design,setup,trace,clocks,seconds,clocks_per_sec,bytes,bytes_per_sec,eval_seconds,uart_seconds\n");
+
+	// Once tracing is turned on, it can't be turned off again, and it
+	// slows everything down.  Hence, all of the untraced runs go first.
+	for(int traced=0; traced < ((notrace) ? 1:2); traced++) {
+		if (traced)
+			Verilated::traceEverOn(true);
+
+		for(int k=0; k<NDESIGNS; k++) {
+			if ((any_selected)&&(!selected[k]))
+				continue;
+
+			if (designs[k].m_lite)
+				designs[k].m_run(designs[k].m_name, LITE_SETUP,
+					traced, nclocks,
+					(designs[k].m_rx) ? testsrc : NULL);
+			else for(unsigned s=0; s<nsetups; s++)
+				designs[k].m_run(designs[k].m_name, setups[s],
+					traced, nclocks,
+					(designs[k].m_rx) ? testsrc : NULL);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,264 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	uartshm.h
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Defines the shared memory layout used to connect a UARTSIM
+//		(via its SHMTRANSPORT) to a host process running on the same
+//	machine.  The region holds two single producer, single consumer ring
+//	buffers: one carrying data from the simulation to the host, the other
+//	carrying data from the host to the simulation.  Each ring is lock-free,
+//	so no system calls are required to move data in either direction.
+//
+//	This file is self-contained, so that host programs can include it
+//	without needing anything else from the simulator.  A host would:
+//
+//		UARTSHM	*shm = uartshm_open("/myuart", false);
+//		uartshm_attach(shm);
+//		uartshm_write(&shm->m_fromhost, "Hello\r\n", 7);
+//		n = uartshm_read(&shm->m_tohost, buf, sizeof(buf));
+//		...
+//		uartshm_detach(shm);
+//		uartshm_close(shm);
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	UARTSHM_H
+#define	UARTSHM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define	UARTSHM_MAGIC	0x55415254	// "UART"
+#define	UARTSHM_LGSIZE	16		// 64kB rings, by default
+
+#if	(ATOMIC_INT_LOCK_FREE != 2)
+#error	"The UARTSHM rings require lock-free atomic integers"
+#endif
+
+// UARTSHMRING
+// {{{
+// One direction of data.  The producer only ever writes m_head, and the
+// consumer only ever writes m_tail.  Both are free running counters, so
+// the ring holds (m_head - m_tail) bytes.  They are kept on separate cache
+// lines so the two sides don't fight over them.  The data itself follows
+// the two rings, within the UARTSHM region.
+typedef	struct	{
+	std::atomic<uint32_t>	m_head;
+	char			m_head_pad[60];
+	std::atomic<uint32_t>	m_tail;
+	char			m_tail_pad[60];
+	uint32_t		m_mask;
+	uint32_t		m_offset;	// of the data, from the ring
+} UARTSHMRING;
+// }}}
+
+// UARTSHM
+// {{{
+// The whole shared region.  m_attached is set by the host while it is
+// listening.
+typedef	struct	{
+	uint32_t	m_magic, m_lgsize;
+	std::atomic<uint32_t>	m_attached;
+	char		m_pad[52];
+	UARTSHMRING	m_tohost, m_fromhost;
+} UARTSHM;
+// }}}
+
+// uartshm_size(lgsize)
+// {{{
+static inline size_t uartshm_size(const unsigned lgsize) {
+	return sizeof(UARTSHM) + (2ul << lgsize);
+}
+// }}}
+
+// uartshm_data(ring)
+// {{{
+static inline char *uartshm_data(UARTSHMRING *ring) {
+	return ((char *)ring) + ring->m_offset;
+}
+// }}}
+
+// uartshm_write(ring, buf, len)
+// {{{
+// Copies up to len bytes into the ring.  Returns the number of bytes copied,
+// which will be less than len if the ring is full.
+static inline unsigned	uartshm_write(UARTSHMRING *ring, const char *buf,
+		unsigned len) {
+	uint32_t	head = ring->m_head.load(std::memory_order_relaxed),
+			tail = ring->m_tail.load(std::memory_order_acquire);
+	uint32_t	room = (ring->m_mask + 1) - (head - tail);
+	char		*data = uartshm_data(ring);
+
+	if (len > room)
+		len = room;
+	for(unsigned k=0; k<len; k++)
+		data[(head+k) & ring->m_mask] = buf[k];
+	ring->m_head.store(head + len, std::memory_order_release);
+	return len;
+}
+// }}}
+
+// uartshm_room(ring)
+// {{{
+// How many bytes may be written to the ring before it is full.  Only the
+// writer should ask, since only it can know this won't shrink.
+static inline unsigned	uartshm_room(UARTSHMRING *ring) {
+	uint32_t	head = ring->m_head.load(std::memory_order_relaxed),
+			tail = ring->m_tail.load(std::memory_order_acquire);
+
+	return (ring->m_mask + 1) - (head - tail);
+}
+// }}}
+
+// uartshm_read(ring, buf, len)
+// {{{
+// Copies up to len bytes out of the ring.  Returns the number of bytes
+// copied, which will be zero if the ring is empty.
+static inline unsigned	uartshm_read(UARTSHMRING *ring, char *buf,
+		unsigned len) {
+	uint32_t	tail = ring->m_tail.load(std::memory_order_relaxed),
+			head = ring->m_head.load(std::memory_order_acquire);
+	const char	*data = uartshm_data(ring);
+
+	if (len > head - tail)
+		len = head - tail;
+	for(unsigned k=0; k<len; k++)
+		buf[k] = data[(tail+k) & ring->m_mask];
+	ring->m_tail.store(tail + len, std::memory_order_release);
+	return len;
+}
+// }}}
+
+// uartshm_ring_init(ring, data, lgsize)
+// {{{
+static inline void	uartshm_ring_init(UARTSHMRING *ring, char *data,
+		const unsigned lgsize) {
+	ring->m_head.store(0);
+	ring->m_tail.store(0);
+	ring->m_mask   = (1u << lgsize) - 1;
+	ring->m_offset = (uint32_t)(data - (char *)ring);
+}
+// }}}
+
+// uartshm_open(name, create, lgsize)
+// {{{
+// Maps the shared region of the given name.  The simulation side creates it
+// (create = true), the host side attaches to an existing one.  Returns NULL
+// on any failure.
+static inline UARTSHM	*uartshm_open(const char *name, const bool create,
+		const unsigned lgsize = UARTSHM_LGSIZE) {
+	UARTSHM	*shm;
+	size_t	sz;
+	int	fd;
+
+	if (create) {
+		fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0666);
+		sz = uartshm_size(lgsize);
+		if ((fd >= 0)&&(ftruncate(fd, sz) != 0)) {
+			::close(fd);
+			fd = -1;
+		}
+	} else {
+		struct	stat	sb;
+
+		fd = shm_open(name, O_RDWR, 0);
+		if ((fd >= 0)&&(fstat(fd, &sb) != 0)) {
+			::close(fd);
+			fd = -1;
+		} sz = (fd >= 0) ? sb.st_size : 0;
+	}
+
+	if (fd < 0) {
+		fprintf(stderr, "ERR: Could not open shared memory, %s\n", name);
+		perror("O/S Err:");
+		return NULL;
+	}
+
+	shm = (UARTSHM *)mmap(NULL, sz, PROT_READ|PROT_WRITE, MAP_SHARED, fd,0);
+	::close(fd);
+	if (shm == MAP_FAILED) {
+		perror("ERR: Could not map shared memory:");
+		return NULL;
+	}
+
+	if (create) {
+		char	*data = (char *)(shm + 1);
+
+		shm->m_lgsize = lgsize;
+		shm->m_attached.store(0);
+		uartshm_ring_init(&shm->m_tohost, data, lgsize);
+		uartshm_ring_init(&shm->m_fromhost, data + (1ul<<lgsize),
+				lgsize);
+		std::atomic_thread_fence(std::memory_order_release);
+		shm->m_magic = UARTSHM_MAGIC;
+	} else if ((sz < sizeof(UARTSHM))||(shm->m_magic != UARTSHM_MAGIC)
+			||(sz < uartshm_size(shm->m_lgsize))) {
+		fprintf(stderr, "ERR: %s is not a UART shared memory region\n",
+			name);
+		munmap(shm, sz);
+		return NULL;
+	}
+
+	return shm;
+}
+// }}}
+
+// uartshm_close(shm)
+// {{{
+static inline void	uartshm_close(UARTSHM *shm) {
+	if (shm)
+		munmap(shm, uartshm_size(shm->m_lgsize));
+}
+// }}}
+
+// uartshm_attach(shm), uartshm_detach(shm)
+// {{{
+// The host calls these to tell the simulation it is (or is no longer)
+// listening.  While it is attached, the simulation will wait for room in the
+// ring rather than dropping any output.
+static inline void	uartshm_attach(UARTSHM *shm) {
+	shm->m_attached.store(1, std::memory_order_release);
+}
+
+static inline void	uartshm_detach(UARTSHM *shm) {
+	shm->m_attached.store(0, std::memory_order_release);
+}
+// }}}
+
+#endif
@@ -9,6 +9,16 @@
 //	This file provides the description of the interface between the UARTSIM
 //	and the rest of the world.  See below for more detailed descriptions.
 //
+//	The simulator itself, UARTSIMT, is a template over the transport used
+//	to connect it to the host (see uarttransport.h).  UARTSIM is the
+//	original (and default) choice of either stdin/stdout or a TCP/IP port.
+//
+//	UARTSIMT may also be given a fixed framing (number of bits, parity, and
+//	stop bits) at compile time.  The per-clock logic then works from
+//	constants rather than from the setup register, and only the baud rate
+//	remains configurable.  FIXEDUARTSIM<NBITS,PARITY,NSTOP> is the UARTSIM
+//	with such a fixed framing, and UARTSIM8N1 the most common of these.
+//
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
 //
@@ -45,79 +55,282 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <poll.h>
-#include <unistd.h>
-#include <arpa/inet.h>
-#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <utility>
+
+#include "uarttransport.h"
 
 #define	TXIDLE	0
 #define	TXDATA	1
 #define	RXIDLE	0
 #define	RXDATA	1
 
-class	UARTSIM	{
+// The size of the buffers used to batch up data to and from the host
+#define	UARTSIM_BUFLEN	4096
+
+// Marks the start of a UARTSIM checkpoint, and its format
+#define	UARTSIM_CKPT_MAGIC	0x55534d31	// "USM1"
+
+// UARTSTATS
+// {{{
+// What a UARTSIM has done so far, as returned by its stats() method.  These
+// are meant to tell where the time in a slow simulation is going:  to the
+// host (reads, writes, and system calls), to the UARTSIM itself (m_seconds),
+// or (by elimination) to the design.
+struct	UARTSTATS {
+	unsigned long	m_clocks,	// Clocks simulated, ticked or skipped
+			m_ticks,	// ... of which were full ticks
+			m_rx_bytes,	// Bytes received from the device
+			m_tx_bytes,	// Bytes transmitted to the device
+			m_host_reads,	// Times the host was checked for input
+			m_poll_hits,	// ... and found to have some
+			m_poll_misses,	// ... or not
+			m_host_writes,	// Number of (buffered) writes to the host
+			m_dropped,	// Bytes dropped, with no host to take them
+			m_syscalls,	// System calls made by the transport
+			m_connects,	// Connections the transport accepted
+			m_overflows,	// Bytes lost to a full flow control buffer
+			m_rts_stalls,	// Clocks the transmitter waited on RTS
+			m_cts_stalls;	// Clocks CTS was held off
+	// Host side queue depths:  bytes waiting to be sent to the host (rx),
+	// and bytes from the host waiting for the transmitter (tx), both now
+	// and at their deepest
+	unsigned	m_rx_queue, m_rx_queue_max, m_tx_queue, m_tx_queue_max;
+	// Time spent within the UARTSIM, if profile() has been turned on
+	double		m_seconds;
+};
+// }}}
+
+// UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>
+// {{{
+// NBITS is the number of data bits, 5-8.  PARITY holds the value of setup
+// bits [26:24]: 0 for no parity, otherwise 4 (parity), plus 2 (if fixed),
+// plus 1 (if even, or a fixed mark).  NSTOP is the number of stop bits, 1 or
+// 2.  The defaults (NBITS=0, PARITY=-1, NSTOP=0) take each of these from the
+// setup register instead.
+template <class TRANSPORT, int NBITS=0, int PARITY=-1, int NSTOP=0>
+class	UARTSIMT	{
+protected:
 	// Member declarations
 	// {{{
-	// The file descriptors:
-	//	m_skt   is the socket/port we are listening on
-	//	m_conrd is the file descriptor to read from
-	//	m_conwr is the file descriptor to write to
-	int	m_skt, m_conrd, m_conwr;
+	// The connection to the host
+	TRANSPORT	m_host;
 	//
 	// The m_setup register is the 29'bit control register used within
 	// the core.
 	unsigned m_setup;
 	// And the pieces of the setup register broken out.
 	int	m_nparity, m_fixdp, m_evenp, m_nbits, m_nstop, m_baud_counts;
+	// With m_lgfrac fractional bits in the baud rate, m_baud_counts is
+	// only the whole clocks per baud, and m_baud_frac the fraction left
+	// over.  That fraction is accumulated from one bit to the next, in
+	// m_rx_phase and m_tx_phase, and a bit lasts one more clock whenever
+	// it carries.
+	unsigned	m_lgfrac, m_baud_frac, m_rx_phase, m_tx_phase;
+	// Values used on every character that only change with the setup:
+	// the receiver's last bit marker and final shift, the transmitter's
+	// stop bit mask and busy bits, and the clocks per character.
+	unsigned	m_rx_last, m_rx_shift, m_tx_ones, m_tx_busy_init,
+			m_char_clocks;
 
 	// UART state
 	int	m_rx_baudcounter, m_rx_state, m_rx_busy,
 		m_rx_changectr, m_last_tx;
 	int	m_tx_baudcounter, m_tx_state, m_tx_busy;
 	unsigned	m_rx_data, m_tx_data;
+	// Host polling schedule.  While the transmitter is idle, the host
+	// is only checked for new data once every m_poll_clocks.  This
+	// starts at m_poll_interval, and grows towards m_poll_max while
+	// the host remains quiet.  m_host_countdown counts the clocks to
+	// the next check.
+	unsigned	m_poll_interval, m_poll_max, m_poll_clocks,
+			m_host_countdown;
+
+	// Host I/O buffers.  Bytes received from the device are collected
+	// in m_obuf, and sent to the host m_olen bytes at a time.  Bytes read
+	// from the host wait in m_ibuf, between m_itail and m_ihead, until
+	// the transmitter gets to them.  m_flush_countdown counts down the
+	// clocks remaining before any buffered output must be sent.
+	char		m_ibuf[UARTSIM_BUFLEN], m_obuf[UARTSIM_BUFLEN];
+	unsigned	m_ihead, m_itail, m_olen;
+	unsigned	m_flush_size, m_flush_clocks, m_flush_countdown;
+
+	// Hardware flow control.  With a depth, bytes received from the device
+	// wait in m_fcbuf (a ring, between m_fc_tail and m_fc_head) for the
+	// host, which takes one every m_fc_drain clocks.  m_rts_n is the
+	// device's ready to send output, and holds off the transmitter.
+	char		m_fcbuf[UARTSIM_BUFLEN];
+	unsigned	m_fc_depth, m_fc_drain, m_fc_countdown,
+			m_fc_head, m_fc_tail;
+	int		m_rts_n;
+
+	// Transmitter impairments, for testing the device's receiver.  Each
+	// bit lasts m_baud_counts clocks, plus m_ppm parts per million (the
+	// remainder carried from one bit to the next in m_drift), while each
+	// edge moves up to m_jitter clocks either way (m_edge is where the
+	// last one moved to).  m_glitch_rate bits in every million
+	// are also inverted for m_glitch_clocks, while the baud counter is
+	// within [m_glitch_lo, m_glitch_hi).  m_rng is the random state.
+	bool		m_impaired;
+	int		m_ppm, m_edge, m_glitch_lo, m_glitch_hi;
+	unsigned	m_jitter, m_glitch_rate, m_glitch_clocks;
+	long long	m_drift;
+	uint32_t	m_rng;
+
+	// What's been received from the device:  the number of characters,
+	// how many of those had parity or framing errors, and the last one
+	unsigned long	m_rx_chars, m_rx_perrs, m_rx_ferrs;
+	int		m_rx_char;
+
+	// The last character started towards the device.  As with the count
+	// of them (in m_stats), this isn't part of any checkpoint.
+	int		m_tx_char;
+
+	// Everything else stats() reports, other than what the transport
+	// keeps, and the schedule for reporting it.  These aren't part of any
+	// checkpoint.
+	UARTSTATS	m_stats;
+	bool		m_profile;
+	FILE		*m_stats_fp;
+	unsigned long	m_stats_interval, m_stats_next;
 	// }}}
 
-	// Private methods
+	// Protected methods
 	// {{{
-	// setup_listener is an attempt to encapsulate all of the network
-	// related setup stuff.
-	void	setup_listener(const int port);
+	// rx_check() counts a newly received character, and any errors in it
+	void	rx_check(const unsigned v);
+
+	// The framing, as fixed by the template or else as given by setup().
+	// When fixed, each of these is a compile time constant.
+	static const bool	FIXED_FRAMING = (NBITS > 0)&&(PARITY >= 0)
+					&&(NSTOP > 0);
+	int	nbits(void) const { return (NBITS > 0) ? NBITS : m_nbits; }
+	int	nparity(void) const {
+		return (PARITY >= 0) ? ((PARITY>>2)&1) : m_nparity; }
+	int	fixdp(void) const {
+		return (PARITY >= 0) ? ((PARITY>>1)&1) : m_fixdp; }
+	int	evenp(void) const {
+		return (PARITY >= 0) ? (PARITY&1) : m_evenp; }
+	int	nstop(void) const { return (NSTOP > 0) ? NSTOP : m_nstop; }
+	int	nsam(void) const { return nbits()+nparity()+nstop(); }
+	// The data bits of a character, when fewer than eight
+	unsigned data_mask(void) const { return (1u<<nbits())-1; }
+
+	unsigned rx_last(void) const {
+		return (FIXED_FRAMING) ? (1u<<(nsam()-1)) : m_rx_last; }
+	unsigned rx_shift(void) const {
+		return (FIXED_FRAMING) ? (32-nsam()) : m_rx_shift; }
+	unsigned tx_ones(void) const {
+		return (FIXED_FRAMING) ? (-1u<<(nbits()+nparity()+1))
+			: m_tx_ones; }
+	unsigned tx_busy_init(void) const {
+		return (FIXED_FRAMING) ? ((1u<<(nsam()+1))-1) : m_tx_busy_init; }
+
+	// init() sets up the initial state of the simulator
+	void	init(void);
+
+	// frac_carry(phase) adds the fraction of a clock per baud to phase,
+	// returning one if that carried into a whole clock
+	int	frac_carry(unsigned &phase) const {
+		phase += m_baud_frac;
+		if (phase < (1u << m_lgfrac))
+			return 0;
+		phase -= (1u << m_lgfrac);
+		return 1;
+	}
+
+	// poll_base() returns the nominal number of clocks between polls
+	// of the host.  Unless overridden, this is one character time.
+	unsigned	poll_base(void) const;
+
+	// flush_base() returns the longest number of clocks any output may
+	// sit in the buffer before it is sent to the host.
+	unsigned	flush_base(void) const;
 
-	// Call check_for_new_connections() to see if we can accept a new
-	// network socket connection to our device
-	void	check_for_new_connections(void);
+	// host_read() fills the input buffer from the host, host_write()
+	// empties the output buffer to it, and host_put() adds one byte to
+	// the output buffer
+	void	host_read(void);
+	void	host_write(void);
+	void	host_put(const char ch);
 
-	// nettick() gets called if we are connected to a network, and
-	int	nettick(const int i_tx);
-	int	fdtick(const int i_tx);
-	int	rawtick(const int i_tx, const bool network);
+	// The number of bytes waiting in the flow control buffer
+	unsigned	fc_fill(void) const { return m_fc_head - m_fc_tail; }
 
-	// We'll use the file descriptor for the listener socket to determine
-	// whether we are connected to the network or not.  If not connected
-	// to the network, then we assume m_conrd and m_conwr refer to 
-	// your more traditional file descriptors, and use them as such.
-	int	tick(const int i_tx) {
-		return rawtick(i_tx, (m_skt >= 0));
+	// tx_bit_clocks() returns the length of the next bit to be sent,
+	// placing any glitch within it, and tx_level() is the transmitter's
+	// output--glitch and all
+	int	tx_bit_clocks(void);
+	int	tx_level(void) const {
+		return (m_tx_data & 1) ^ ((m_tx_baudcounter >= m_glitch_lo)
+				&&(m_tx_baudcounter < m_glitch_hi)); }
+	uint32_t	rand32(void) {
+		m_rng ^= m_rng << 13;
+		m_rng ^= m_rng >> 17;
+		m_rng ^= m_rng << 5;
+		return m_rng;
+	}
+
+	// tick() advances the simulator by one clock
+	int	tick(const int i_tx);
+
+	// step() is tick(), plus the clock count, profiling, and any periodic
+	// report that goes with it
+	int	step(const int i_tx);
+
+	// now() returns the time, in seconds, for profiling
+	static double	now(void) {
+		struct timespec	ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec + ts.tv_nsec * 1e-9;
 	}
 	// }}}
 public:
 	// Public member functions
 	// {{{
 
-	// UARTSIM(port)
+	// UARTSIMT(args...)
 	// {{{
-	// The UARTSIM constructor takes one argument: the port on the
-	// localhost to listen in on.  Once started, connections may be made
-	// to this port to get the output from the port.
-	UARTSIM(const int port);
+	// The constructor passes its arguments on to the transport's
+	// constructor.  Hence, UARTSIMT<TCPTRANSPORT>(port) listens on the
+	// given TCP/IP port, while UARTSIMT<PTYTRANSPORT>() creates a pseudo
+	// terminal, and so forth.
+	template <typename... ARGS>	UARTSIMT(ARGS&&... args)
+			: m_host(std::forward<ARGS>(args)...) {
+		init();
+	}
+	// }}}
+
+	// host(void)
+	// {{{
+	// Provides access to the transport, for anything that is particular
+	// to it.
+	TRANSPORT	&host(void) { return m_host; }
+	// }}}
+
+	// flush(void)
+	// {{{
+	// Sends any output still waiting in our buffer to the host.
+	void	flush(void) {
+		host_write(); }
+	// }}}
+
+	// flush_threshold(nbytes, clocks)
+	// {{{
+	// Output from the device is collected and sent to the host in
+	// batches.  A batch is sent once it holds nbytes (default: the size
+	// of the buffer, UARTSIM_BUFLEN), or once its first byte has waited
+	// clocks (default: sixty four character times), or on any call to
+	// flush() or kill().  Zero for either argument selects its default.
+	void	flush_threshold(unsigned nbytes, unsigned clocks = 0);
 	// }}}
 
 	// kill(void)
 	// {{{
-	// kill() closes any active connection and the socket.  Once killed,
-	// no further output will be sent to the port.
+	// kill() sends any buffered output, and then closes any active
+	// connection and the socket.  Once killed, no further output will be
+	// sent to the port.
 	void	kill(void);
 	// }}}
 
@@ -125,10 +338,73 @@ public:
 	// {{{
 	// setup() busts out the bits from isetup to the various internal
 	// parameters.  It is ideally only called between bits at appropriate
-	// transition intervals. 
+	// transition intervals.  Any framing fixed by the template overrides
+	// the framing bits of isetup.
 	void	setup(unsigned isetup);
 	// }}}
 
+	// fractional(lgfrac)
+	// {{{
+	// Matches a device built with LGFRAC=lgfrac, whose baud rate has that
+	// many fractional bits:  setup[23:0] is then the clocks per baud times
+	// 2^lgfrac.  As in the device, each bit lasts the whole number of
+	// clocks, plus one whenever the fraction, carried from bit to bit,
+	// overflows.  Zero, the default, returns to whole clocks.
+	void	fractional(unsigned lgfrac);
+	// }}}
+
+	// flow_control(depth, drain_clocks), cts_n(), rts(rts_n)
+	// {{{
+	// Models a host with hardware flow control, and a receive buffer of
+	// depth bytes (from 2 up to UARTSIM_BUFLEN) which the host empties at
+	// one byte every drain_clocks (zero for as fast as they arrive).
+	// cts_n() is the clear to send output, to the device's i_cts_n.  It
+	// goes high, holding the device off, once the buffer has room for only
+	// one more byte--since one may already be on its way.  Anything that
+	// arrives anyway, once the buffer is full, is dropped and counted as an
+	// overflow.  A depth of zero turns this back off.
+	//
+	// rts() takes the device's o_rts_n output.  While it is high, no new
+	// byte will be started towards the device, nor will any more be
+	// read from the host.  rts() may be called (or not) whether or not
+	// flow_control() has been, and should be called before each
+	// operator().  Like i_tx, any change in rts_n ends a skip().
+	void	flow_control(unsigned depth, unsigned drain_clocks = 0);
+	int	cts_n(void) const {
+		return (m_fc_depth > 0)&&(fc_fill()+1 >= m_fc_depth); }
+	void	rts(int rts_n) { m_rts_n = rts_n; }
+	// }}}
+
+	// impair(ppm, jitter, glitch_rate, glitch_clocks, seed)
+	// {{{
+	// Makes the transmitter less than perfect, for testing how much the
+	// device's receiver will put up with.  ppm offsets the baud rate by
+	// that many parts per million:  positive is slower (longer bits),
+	// negative is faster, and the fraction of a clock is carried from bit
+	// to bit so that the drift accumulates just as a mismatched clock's
+	// would.  jitter moves each edge at random, by up to that many clocks
+	// either way of where it would otherwise be.  glitch_rate is the number of bits, per million,
+	// that are inverted for glitch_clocks somewhere within them.  A
+	// nonzero seed restarts the (repeatable) random numbers.  All zeros
+	// turns this back off.  None of these affect the receiver.
+	void	impair(int ppm, unsigned jitter = 0, unsigned glitch_rate = 0,
+			unsigned glitch_clocks = 1, uint32_t seed = 0);
+	// }}}
+
+	// poll_interval(clocks, maxclocks)
+	// {{{
+	// Controls how often the host is checked for new data to send while
+	// the transmitter is idle.  By default, the host is checked once per
+	// character time (as given by setup()), since there's no point in
+	// checking any faster than that.  Each time a check comes up empty,
+	// the interval doubles, up to maxclocks (by default sixteen character
+	// times).  Any new data returns the interval to its nominal value.
+	// A clocks value of zero returns to the nominal one character time
+	// interval.  A maxclocks value of zero keeps the default backoff if
+	// clocks is also zero, and otherwise disables the backoff.
+	void	poll_interval(unsigned clocks, unsigned maxclocks = 0);
+	// }}}
+
 	// operator()(i_tx)
 	// {{{
 	// The operator() function is called on every tick.  The input is the
@@ -140,7 +416,7 @@ public:
 	// setup register will never change.
 	//
 	int	operator()(int i_tx) {
-		return tick(i_tx); }
+		return step(i_tx); }
 	// }}}
 
 	// operator()(i_tx, isetup)
@@ -149,9 +425,936 @@ public:
 	// then it makes sense to include that current setup when calling the
 	// tick operator.
 	int	operator()(int i_tx, unsigned isetup) {
-		setup(isetup); return tick(i_tx); }
+		setup(isetup); return step(i_tx); }
+	// }}}
+
+	// next_event_clocks()
+	// {{{
+	// Returns the number of clocks the simulator may be advanced by skip()
+	// without anything happening, under the assumption that i_tx will
+	// not change in the meantime.  During this time the output to the
+	// device will remain constant.  A return value of zero means that the
+	// next clock needs to be a full tick (i.e. operator()).
+	//
+	// A testbench can use this to avoid calling the UARTSIM on every clock
+	// while the line is idle.  Count the clocks for which i_tx doesn't
+	// change, up to this limit, and then call skip() with that count
+	// before the next call to operator().
+	unsigned	next_event_clocks(void) const;
+	// }}}
+
+	// skip(nclocks)
+	// {{{
+	// Advances the simulator by nclocks, just as though operator() had
+	// been called nclocks times with the last i_tx value given to it.
+	// The result is the value of the receive wire into the device.
+	// Clocks within the next_event_clocks() limit are advanced in a single
+	// step, any others are processed one at a time.
+	int	skip(unsigned nclocks);
+	// }}}
+
+	// save(os), restore(is)
+	// {{{
+	// Checkpoints the simulator:  its setup, both state machines, the
+	// host polling and flush schedules, flow control, and any bytes still
+	// waiting in any of its buffers.  Any stream with a write(const void *, size_t) (for
+	// save) or read(void *, size_t) (for restore) method will do.  This
+	// includes Verilator's VerilatedSave and VerilatedRestore, so the
+	// UARTSIM may be saved into the same file as the design.
+	//
+	// The connection to the host is not part of the checkpoint.  Anything
+	// restored into the output buffer will be sent to whatever host this
+	// UARTSIM is connected to.  restore() returns false, leaving the
+	// simulator unchanged, if is doesn't hold a UARTSIM checkpoint.
+	template <class OS>	void	save(OS &os) const;
+	template <class IS>	bool	restore(IS &is);
+	// }}}
+
+	// rx_chars(), rx_parity_errors(), rx_frame_errors(), rx_last_char()
+	// {{{
+	// The number of characters received from the device so far, whether
+	// or not they could be given to the host, and how many of those had
+	// parity or framing (i.e. a low stop bit) errors.  Parity is checked
+	// by the same rule the UARTSIM, txuart.v, and rxuart.v all follow.
+	// rx_last_char() is the most recent character received, or -1 if
+	// there hasn't been one yet.  A testbench can watch rx_chars() for a
+	// change to find out when something new has arrived.  tx_chars() and
+	// tx_last_char() are likewise the number of characters started towards
+	// the device, and the last of them (-1 before the first).
+	unsigned long	rx_chars(void) const { return m_rx_chars; }
+	unsigned long	tx_chars(void) const { return m_stats.m_tx_bytes; }
+	unsigned long	rx_parity_errors(void) const { return m_rx_perrs; }
+	unsigned long	rx_frame_errors(void) const { return m_rx_ferrs; }
+	int		rx_last_char(void) const { return m_rx_char; }
+	int		tx_last_char(void) const { return m_tx_char; }
 	// }}}
+
+	// stats(), profile(on)
+	// {{{
+	// Returns everything the UARTSIM (and its transport) have counted so
+	// far.  See UARTSTATS, above.  The time spent within the UARTSIM is
+	// only measured once profile(true) has been called, since measuring
+	// it costs about as much as the UARTSIM itself.
+	UARTSTATS	stats(void) const;
+	void		profile(bool on) { m_profile = on; }
 	// }}}
+
+	// stats_dump(fp), stats_every(clocks, fp)
+	// {{{
+	// stats_dump() writes the stats() out as one line.  stats_every()
+	// does so once every given number of clocks, to fp (stderr by
+	// default).  Zero clocks turns this back off.
+	void	stats_dump(FILE *fp = stderr) const;
+	void	stats_every(unsigned long clocks, FILE *fp = stderr) {
+		m_stats_interval = clocks;
+		m_stats_next = m_stats.m_clocks + clocks;
+		m_stats_fp = fp;
+	}
+	// }}}
+	// }}}
+};
+// }}}
+
+// UARTSIM
+// {{{
+// The original UARTSIM.  Its constructor takes one argument: the port on the
+// localhost to listen in on.  Once started, connections may be made to this
+// port to get the output from the port.  A port of zero uses stdin and stdout
+// instead.  If multi is set, several clients may connect to the port at once,
+// with the first of them driving the UART's input.  If threaded is set, all
+// of the host I/O takes place on a separate thread, so the simulation never
+// waits on it.
+class	UARTSIM : public UARTSIMT<PORTTRANSPORT> {
+public:
+	UARTSIM(const int port, const bool multi = false,
+			const bool threaded = false)
+		: UARTSIMT<PORTTRANSPORT>(port, multi, threaded) {}
 };
 
+// This one is compiled once, in uartsim.cpp
+extern template class UARTSIMT<PORTTRANSPORT>;
+// }}}
+
+// FIXEDUARTSIM, UARTSIM8N1
+// {{{
+// The same, but with the framing fixed at compile time.  As with the UARTSIM,
+// the constructor takes the port to listen on (zero for stdin/stdout).
+template <int NBITS, int PARITY, int NSTOP>
+using	FIXEDUARTSIM = UARTSIMT<PORTTRANSPORT, NBITS, PARITY, NSTOP>;
+
+typedef	FIXEDUARTSIM<8,0,1>	UARTSIM8N1;
+extern template class UARTSIMT<PORTTRANSPORT, 8, 0, 1>;
+// }}}
+
+// UARTSIMT::init
+// {{{
+template <class TRANSPORT, int NBITS, int PARITY, int NSTOP>
+void	UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>::init(void) {
+	m_setup = 0;
+	m_poll_interval = 0;
+	m_poll_max = 0;
+	m_lgfrac = 0;
+	m_rx_phase = m_tx_phase = 0;
+	setup(25);	// Set us up for (default) 8N1 w/ a baud rate of CLK/25
+	m_rx_baudcounter = 0;
+	m_tx_baudcounter = 0;
+	m_rx_state = RXIDLE;
+	m_tx_state = TXIDLE;
+	m_rx_busy = 0;
+	m_tx_busy = 0;
+	m_rx_data = 0;
+	m_tx_data = -1;
+	m_rx_changectr = 0;
+	m_last_tx = 1;
+	m_host_countdown = 0;
+	m_ihead = m_itail = 0;
+	m_olen  = 0;
+	m_flush_size = UARTSIM_BUFLEN;
+	m_flush_clocks = 0;
+	m_flush_countdown = 0;
+	m_fc_depth = m_fc_drain = m_fc_countdown = 0;
+	m_fc_head = m_fc_tail = 0;
+	m_rts_n = 0;
+	m_impaired = false;
+	m_ppm = m_edge = m_glitch_lo = m_glitch_hi = 0;
+	m_jitter = m_glitch_rate = 0;
+	m_glitch_clocks = 1;
+	m_drift = 0;
+	m_rng = 1;
+	m_rx_chars = m_rx_perrs = m_rx_ferrs = 0;
+	m_rx_char = m_tx_char = -1;
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_profile = false;
+	m_stats_fp = stderr;
+	m_stats_interval = m_stats_next = 0;
+}
+// }}}
+
+// UARTSIMT::rx_check(v)
+// {{{
+// v holds the character as received, right justified:  data bits, then any
+// parity bit, then the stop bit(s).
+template <class TRANSPORT, int NBITS, int PARITY, int NSTOP>
+void	UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>::rx_check(const unsigned v) {
+	const unsigned	stop_ones = (1u<<nstop())-1;
+
+	m_rx_char = v & data_mask();
+	m_rx_chars++;
+
+	if (nparity()) {
+		int	p;
+
+		if (fixdp())
+			p = evenp();
+		else {
+			p = m_rx_char;
+			p = p ^ (p>>4);
+			p = p ^ (p>>2);
+			p = p ^ (p>>1);
+			p &= 1;
+			p ^= !evenp();
+		}
+
+		if (((v >> nbits())&1) != (unsigned)p)
+			m_rx_perrs++;
+	}
+
+	if (((v >> (nbits()+nparity())) & stop_ones) != stop_ones)
+		m_rx_ferrs++;
+}
+// }}}
+
+// UARTSIMT::kill
+// {{{
+template <class TRANSPORT, int NBITS, int PARITY, int NSTOP>
+void	UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>::kill(void) {
+	flush();
+	fflush(stdout);
+
+	// Close any active connection
+	m_host.close();
+}
+// }}}
+
+// UARTSIMT::setup(isetup)
+// {{{
+template <class TRANSPORT, int NBITS, int PARITY, int NSTOP>
+void	UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>::setup(unsigned isetup) {
+	if (isetup != m_setup) {
+		m_setup = isetup;
+		m_baud_counts = (isetup & 0x0ffffff) >> m_lgfrac;
+		m_baud_frac   = (isetup & 0x0ffffff) & ((1u << m_lgfrac)-1);
+		m_nbits   = 8-((isetup >> 28)&0x03);
+		m_nstop   =((isetup >> 27)&1)+1;
+		m_nparity = (isetup >> 26)&1;
+		m_fixdp   = (isetup >> 25)&1;
+		m_evenp   = (isetup >> 24)&1;
+
+		m_rx_last  = 1u<<(nsam()-1);
+		m_rx_shift = 32-nsam();
+		m_tx_ones  = -1u<<(nbits()+nparity()+1);
+		m_tx_busy_init = (1u<<(nsam()+1))-1;
+		m_char_clocks  = ((isetup & 0x0ffffff) * (1+nsam())) >> m_lgfrac;
+
+		m_poll_clocks = poll_base();
+	}
+}
+// }}}
+
+// UARTSIMT::fractional(lgfrac)
+// {{{
+template <class TRANSPORT, int NBITS, int PARITY, int NSTOP>
+void	UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>::fractional(unsigned lgfrac) {
+	unsigned	isetup = m_setup;
+
+	m_lgfrac = (lgfrac > 15) ? 15 : lgfrac;
+	m_rx_phase = m_tx_phase = 0;
+	// Force setup() to recalculate everything derived from the baud rate
+	m_setup = ~isetup;
+	setup(isetup);
+}
+// }}}
+
+// UARTSIMT::poll_base
+// {{{
+template <class TRANSPORT, int NBITS, int PARITY, int NSTOP>
+unsigned	UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>::poll_base(void) const {
+	if (m_poll_interval > 0)
+		return m_poll_interval;
+	// One character time: start bit, data bits, parity, and stop bits
+	return m_char_clocks;
+}
+// }}}
+
+// UARTSIMT::poll_interval(clocks, maxclocks)
+// {{{
+template <class TRANSPORT, int NBITS, int PARITY, int NSTOP>
+void	UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>::poll_interval(unsigned clocks, unsigned maxclocks) {
+	m_poll_interval = clocks;
+	m_poll_max = maxclocks;
+	m_poll_clocks = poll_base();
+	if (m_host_countdown > m_poll_clocks)
+		m_host_countdown = m_poll_clocks;
+}
+// }}}
+
+// UARTSIMT::flush_base
+// {{{
+template <class TRANSPORT, int NBITS, int PARITY, int NSTOP>
+unsigned	UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>::flush_base(void) const {
+	if (m_flush_clocks > 0)
+		return m_flush_clocks;
+	// Sixty four character times
+	return 64 * m_char_clocks;
+}
+// }}}
+
+// UARTSIMT::flush_threshold(nbytes, clocks)
+// {{{
+template <class TRANSPORT, int NBITS, int PARITY, int NSTOP>
+void	UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>::flush_threshold(unsigned nbytes, unsigned clocks) {
+	m_flush_size = ((nbytes == 0)||(nbytes > UARTSIM_BUFLEN))
+			? UARTSIM_BUFLEN : nbytes;
+	m_flush_clocks = clocks;
+	if ((m_olen > 0)&&(m_flush_countdown > flush_base()))
+		m_flush_countdown = flush_base();
+	if (m_olen >= m_flush_size)
+		flush();
+}
+// }}}
+
+// UARTSIMT::host_write
+// {{{
+// Sends everything in the output buffer to the host.
+template <class TRANSPORT, int NBITS, int PARITY, int NSTOP>
+void	UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>::host_write(void) {
+	if (m_olen > 0) {
+		if (m_olen > m_stats.m_rx_queue_max)
+			m_stats.m_rx_queue_max = m_olen;
+		m_stats.m_host_writes++;
+		m_host.write(m_obuf, m_olen);
+	}
+	m_olen = 0;
+}
+// }}}
+
+// UARTSIMT::host_put
+// {{{
+// Buffers one byte for the host, rather than sending it immediately
+template <class TRANSPORT, int NBITS, int PARITY, int NSTOP>
+void	UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>::host_put(const char ch) {
+	if (m_host.connected()) {
+		if (m_olen == 0)
+			m_flush_countdown = flush_base();
+		m_obuf[m_olen++] = ch;
+		if (m_olen >= m_flush_size)
+			host_write();
+	} else
+		m_stats.m_dropped++;
+}
+// }}}
+
+// UARTSIMT::impair(ppm, jitter, glitch_rate, glitch_clocks, seed)
+// {{{
+template <class TRANSPORT, int NBITS, int PARITY, int NSTOP>
+void	UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>::impair(int ppm, unsigned jitter, unsigned glitch_rate, unsigned glitch_clocks, uint32_t seed) {
+	m_ppm = ppm;
+	m_jitter = jitter;
+	m_glitch_rate = (glitch_rate > 1000000) ? 1000000 : glitch_rate;
+	m_glitch_clocks = (glitch_clocks > 0) ? glitch_clocks : 1;
+	m_drift = 0;
+	m_edge  = 0;
+	if (seed != 0)
+		m_rng = seed;
+	m_impaired = (m_ppm != 0)||(m_jitter > 0)||(m_glitch_rate > 0);
+}
+// }}}
+
+// UARTSIMT::tx_bit_clocks
+// {{{
+template <class TRANSPORT, int NBITS, int PARITY, int NSTOP>
+int	UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>::tx_bit_clocks(void) {
+	int	n = m_baud_counts;
+
+	if (m_baud_frac)
+		n += frac_carry(m_tx_phase);
+
+	m_glitch_lo = m_glitch_hi = 0;
+	if (!m_impaired)
+		return n;
+
+	if (m_ppm != 0) {
+		long long	extra;
+
+		m_drift += (long long)m_baud_counts * m_ppm;
+		extra    = m_drift / 1000000;
+		m_drift -= extra * 1000000;
+		n += (int)extra;
+	}
+
+	if (m_jitter > 0) {
+		// The bit ends where its next edge moves to, rather than where
+		// the last one did
+		int	edge = (int)(rand32() % (2*m_jitter+1)) - (int)m_jitter;
+
+		n += edge - m_edge;
+		m_edge = edge;
+	}
+	if (n < 1)
+		n = 1;
+
+	if ((m_glitch_rate > 0)&&(rand32() % 1000000 < m_glitch_rate)) {
+		// Anywhere within the bit, so long as it fits
+		int	w = ((int)m_glitch_clocks < n) ? (int)m_glitch_clocks : n;
+
+		m_glitch_lo = rand32() % (n - w + 1);
+		m_glitch_hi = m_glitch_lo + w;
+	}
+
+	return n;
+}
+// }}}
+
+// UARTSIMT::flow_control(depth, drain_clocks)
+// {{{
+template <class TRANSPORT, int NBITS, int PARITY, int NSTOP>
+void	UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>::flow_control(unsigned depth, unsigned drain_clocks) {
+	if ((depth > 0)&&(depth < 2))
+		depth = 2;
+	else if (depth > UARTSIM_BUFLEN)
+		depth = UARTSIM_BUFLEN;
+
+	// Anything still waiting goes straight to the host
+	if (depth == 0) {
+		while(fc_fill() > 0)
+			host_put(m_fcbuf[(m_fc_tail++) & (UARTSIM_BUFLEN-1)]);
+	}
+
+	m_fc_depth = depth;
+	m_fc_drain = drain_clocks;
+	if (m_fc_countdown > m_fc_drain)
+		m_fc_countdown = m_fc_drain;
+}
+// }}}
+
+// UARTSIMT::host_read
+// {{{
+// Reads as much as the host has available, up to the size of our input
+// buffer, without blocking.  Also adjusts the polling schedule based upon
+// whether or not we found anything.
+template <class TRANSPORT, int NBITS, int PARITY, int NSTOP>
+void	UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>::host_read(void) {
+	int	nr;
+
+	nr = m_host.read(m_ibuf, UARTSIM_BUFLEN);
+	m_itail = 0;
+	m_ihead = (nr > 0) ? nr : 0;
+	m_stats.m_host_reads++;
+
+	if (m_ihead > 0) {
+		m_stats.m_poll_hits++;
+		if (m_ihead > m_stats.m_tx_queue_max)
+			m_stats.m_tx_queue_max = m_ihead;
+
+		// The host is active.  Check again as soon as we've sent
+		// everything we've just read, in case there's more.
+		m_poll_clocks = poll_base();
+		m_host_countdown = 0;
+	} else {
+		// Nothing's there.  Back off, and wait a bit longer
+		// before we check again.
+		m_stats.m_poll_misses++;
+		unsigned	maxclocks = (m_poll_max > 0) ? m_poll_max
+			: ((m_poll_interval > 0) ? m_poll_interval
+				: 16 * poll_base());
+		m_host_countdown = m_poll_clocks;
+		if (m_poll_clocks < maxclocks/2)
+			m_poll_clocks *= 2;
+		else
+			m_poll_clocks = maxclocks;
+	}
+}
+// }}}
+
+// UARTSIMT::save(os)
+// {{{
+// Any skip()'d clocks must have been accounted for before this is called, or
+// they'll be lost.
+template <class TRANSPORT, int NBITS, int PARITY, int NSTOP>
+template <class OS>
+void	UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>::save(OS &os) const {
+	const unsigned	magic = UARTSIM_CKPT_MAGIC, npending = m_ihead-m_itail;
+
+	os.write(&magic, sizeof(magic));
+
+	// The setup (and its fractional bits), and the polling configuration
+	// it depends upon
+	os.write(&m_setup, sizeof(m_setup));
+	os.write(&m_lgfrac, sizeof(m_lgfrac));
+	os.write(&m_poll_interval, sizeof(m_poll_interval));
+	os.write(&m_poll_max, sizeof(m_poll_max));
+
+	// The receiver and transmitter state machines
+	os.write(&m_rx_baudcounter, sizeof(m_rx_baudcounter));
+	os.write(&m_rx_state, sizeof(m_rx_state));
+	os.write(&m_rx_busy, sizeof(m_rx_busy));
+	os.write(&m_rx_changectr, sizeof(m_rx_changectr));
+	os.write(&m_last_tx, sizeof(m_last_tx));
+	os.write(&m_rx_data, sizeof(m_rx_data));
+	os.write(&m_tx_baudcounter, sizeof(m_tx_baudcounter));
+	os.write(&m_tx_state, sizeof(m_tx_state));
+	os.write(&m_tx_busy, sizeof(m_tx_busy));
+	os.write(&m_tx_data, sizeof(m_tx_data));
+	os.write(&m_rx_phase, sizeof(m_rx_phase));
+	os.write(&m_tx_phase, sizeof(m_tx_phase));
+
+	// The host polling and flushing schedules
+	os.write(&m_poll_clocks, sizeof(m_poll_clocks));
+	os.write(&m_host_countdown, sizeof(m_host_countdown));
+	os.write(&m_flush_size, sizeof(m_flush_size));
+	os.write(&m_flush_clocks, sizeof(m_flush_clocks));
+	os.write(&m_flush_countdown, sizeof(m_flush_countdown));
+
+	// Anything read from the host but not yet sent, and anything received
+	// but not yet given to the host
+	os.write(&npending, sizeof(npending));
+	os.write(&m_ibuf[m_itail], npending);
+	os.write(&m_olen, sizeof(m_olen));
+	os.write(m_obuf, m_olen);
+
+	// What's been received so far
+	os.write(&m_rx_chars, sizeof(m_rx_chars));
+	os.write(&m_rx_perrs, sizeof(m_rx_perrs));
+	os.write(&m_rx_ferrs, sizeof(m_rx_ferrs));
+	os.write(&m_rx_char, sizeof(m_rx_char));
+
+	// Flow control, and anything still waiting on it
+	{
+		const unsigned	nfc = fc_fill();
+
+		os.write(&m_fc_depth, sizeof(m_fc_depth));
+		os.write(&m_fc_drain, sizeof(m_fc_drain));
+		os.write(&m_fc_countdown, sizeof(m_fc_countdown));
+		os.write(&m_rts_n, sizeof(m_rts_n));
+		os.write(&nfc, sizeof(nfc));
+		for(unsigned k=0; k<nfc; k++)
+			os.write(&m_fcbuf[(m_fc_tail+k) & (UARTSIM_BUFLEN-1)], 1);
+	}
+
+	// Any impairments, and where they are within the current bit
+	os.write(&m_impaired, sizeof(m_impaired));
+	os.write(&m_ppm, sizeof(m_ppm));
+	os.write(&m_jitter, sizeof(m_jitter));
+	os.write(&m_glitch_rate, sizeof(m_glitch_rate));
+	os.write(&m_glitch_clocks, sizeof(m_glitch_clocks));
+	os.write(&m_drift, sizeof(m_drift));
+	os.write(&m_edge, sizeof(m_edge));
+	os.write(&m_glitch_lo, sizeof(m_glitch_lo));
+	os.write(&m_glitch_hi, sizeof(m_glitch_hi));
+	os.write(&m_rng, sizeof(m_rng));
+}
+// }}}
+
+// UARTSIMT::restore(is)
+// {{{
+template <class TRANSPORT, int NBITS, int PARITY, int NSTOP>
+template <class IS>
+bool	UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>::restore(IS &is) {
+	unsigned	magic = 0, isetup = 0, npending = 0;
+
+	is.read(&magic, sizeof(magic));
+	if (magic != UARTSIM_CKPT_MAGIC)
+		return false;
+
+	is.read(&isetup, sizeof(isetup));
+	is.read(&m_lgfrac, sizeof(m_lgfrac));
+	if (m_lgfrac > 15)
+		m_lgfrac = 15;
+	is.read(&m_poll_interval, sizeof(m_poll_interval));
+	is.read(&m_poll_max, sizeof(m_poll_max));
+	// Force setup() to recalculate everything derived from the setup
+	m_setup = ~isetup;
+	setup(isetup);
+
+	is.read(&m_rx_baudcounter, sizeof(m_rx_baudcounter));
+	is.read(&m_rx_state, sizeof(m_rx_state));
+	is.read(&m_rx_busy, sizeof(m_rx_busy));
+	is.read(&m_rx_changectr, sizeof(m_rx_changectr));
+	is.read(&m_last_tx, sizeof(m_last_tx));
+	is.read(&m_rx_data, sizeof(m_rx_data));
+	is.read(&m_tx_baudcounter, sizeof(m_tx_baudcounter));
+	is.read(&m_tx_state, sizeof(m_tx_state));
+	is.read(&m_tx_busy, sizeof(m_tx_busy));
+	is.read(&m_tx_data, sizeof(m_tx_data));
+	is.read(&m_rx_phase, sizeof(m_rx_phase));
+	is.read(&m_tx_phase, sizeof(m_tx_phase));
+
+	is.read(&m_poll_clocks, sizeof(m_poll_clocks));
+	is.read(&m_host_countdown, sizeof(m_host_countdown));
+	is.read(&m_flush_size, sizeof(m_flush_size));
+	is.read(&m_flush_clocks, sizeof(m_flush_clocks));
+	is.read(&m_flush_countdown, sizeof(m_flush_countdown));
+
+	is.read(&npending, sizeof(npending));
+	if (npending > UARTSIM_BUFLEN)
+		npending = UARTSIM_BUFLEN;
+	is.read(m_ibuf, npending);
+	m_itail = 0;
+	m_ihead = npending;
+
+	is.read(&m_olen, sizeof(m_olen));
+	if (m_olen > UARTSIM_BUFLEN)
+		m_olen = UARTSIM_BUFLEN;
+	is.read(m_obuf, m_olen);
+
+	is.read(&m_rx_chars, sizeof(m_rx_chars));
+	is.read(&m_rx_perrs, sizeof(m_rx_perrs));
+	is.read(&m_rx_ferrs, sizeof(m_rx_ferrs));
+	is.read(&m_rx_char, sizeof(m_rx_char));
+
+	is.read(&m_fc_depth, sizeof(m_fc_depth));
+	is.read(&m_fc_drain, sizeof(m_fc_drain));
+	is.read(&m_fc_countdown, sizeof(m_fc_countdown));
+	is.read(&m_rts_n, sizeof(m_rts_n));
+	is.read(&npending, sizeof(npending));
+	if (m_fc_depth > UARTSIM_BUFLEN)
+		m_fc_depth = UARTSIM_BUFLEN;
+	if (npending > m_fc_depth)
+		npending = m_fc_depth;
+	is.read(m_fcbuf, npending);
+	m_fc_tail = 0;
+	m_fc_head = npending;
+
+	is.read(&m_impaired, sizeof(m_impaired));
+	is.read(&m_ppm, sizeof(m_ppm));
+	is.read(&m_jitter, sizeof(m_jitter));
+	is.read(&m_glitch_rate, sizeof(m_glitch_rate));
+	is.read(&m_glitch_clocks, sizeof(m_glitch_clocks));
+	is.read(&m_drift, sizeof(m_drift));
+	is.read(&m_edge, sizeof(m_edge));
+	is.read(&m_glitch_lo, sizeof(m_glitch_lo));
+	is.read(&m_glitch_hi, sizeof(m_glitch_hi));
+	is.read(&m_rng, sizeof(m_rng));
+	if (m_rng == 0)
+		m_rng = 1;
+
+	return true;
+}
+// }}}
+
+// UARTSIMT::tick(i_tx)
+// {{{
+template <class TRANSPORT, int NBITS, int PARITY, int NSTOP>
+int	UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>::tick(const int i_tx) {
+	int	o_rx = 1;
+
+	m_stats.m_ticks++;
+	if ((!i_tx)&&(m_last_tx))
+		m_rx_changectr = 0;
+	else	m_rx_changectr++;
+	m_last_tx = i_tx;
+
+	if (m_rx_state == RXIDLE) {
+		if (!i_tx) {
+			m_rx_state = RXDATA;
+			if (m_baud_frac) {
+				// One and a half bits, to the nearest clock,
+				// as in rxuart.v
+				m_rx_baudcounter = (int)((3*((m_baud_counts
+					<< m_lgfrac)|m_baud_frac))
+					>> (m_lgfrac+1))-1;
+				m_rx_phase = 1u << (m_lgfrac-1);
+			} else
+				m_rx_baudcounter =m_baud_counts+m_baud_counts/2-1;
+			m_rx_baudcounter -= m_rx_changectr;
+			m_rx_busy    = 0;
+			m_rx_data    = 0;
+		}
+	} else if (m_rx_baudcounter <= 0) {
+		if ((unsigned)m_rx_busy >= rx_last()) {
+			m_rx_state = RXIDLE;
+			rx_check(m_rx_data >> rx_shift());
+			if (m_fc_depth == 0)
+				host_put(m_rx_char);
+			else if (fc_fill() < m_fc_depth) {
+				// Wait for the (slow) host to get to it
+				if (fc_fill() == 0)
+					m_fc_countdown = (m_fc_drain > 0)
+						? m_fc_drain-1 : 0;
+				m_fcbuf[(m_fc_head++) & (UARTSIM_BUFLEN-1)]
+					= m_rx_char;
+			} else
+				m_stats.m_overflows++;
+		} else {
+			m_rx_busy = (m_rx_busy << 1)|1;
+			// Low order bit is transmitted first, in this
+			// order:
+			//	Start bit (1'b1)
+			//	bit 0
+			//	bit 1
+			//	bit 2
+			//	...
+			//	bit N-1
+			//	(possible parity bit)
+			//	stop bit
+			//	(possible secondary stop bit)
+			m_rx_data = ((i_tx&1)<<31) | (m_rx_data>>1);
+		} m_rx_baudcounter = m_baud_counts-1;
+		if (m_baud_frac)
+			m_rx_baudcounter += frac_carry(m_rx_phase);
+	} else
+		m_rx_baudcounter--;
+
+	// Let the host have the next byte in the flow control buffer, once
+	// it's ready for it
+	if (fc_fill() > 0) {
+		if (cts_n())
+			m_stats.m_cts_stalls++;
+		if (m_fc_countdown > 0)
+			m_fc_countdown--;
+		else {
+			host_put(m_fcbuf[(m_fc_tail++) & (UARTSIM_BUFLEN-1)]);
+			m_fc_countdown = (m_fc_drain > 0) ? m_fc_drain-1 : 0;
+		}
+	}
+
+	// Send any buffered output that's been waiting too long
+	if (m_olen > 0) {
+		if (m_flush_countdown > 0)
+			m_flush_countdown--;
+		else
+			host_write();
+	}
+
+	if (m_tx_state == TXIDLE) {
+		if (m_itail < m_ihead) {
+			// Nothing to do--we still have data from the host
+			if (m_rts_n)
+				// ... but the device isn't ready for it
+				m_stats.m_rts_stalls++;
+		} else if (m_host_countdown > 0) {
+			// It's not yet time to check the host again
+			m_host_countdown--;
+		} else if (m_host.readable())
+			host_read();
+
+		if ((m_itail < m_ihead)&&(!m_rts_n)) {
+			m_tx_char = m_ibuf[m_itail++] & data_mask();
+			m_tx_data = tx_ones()
+				// << nstart_bits
+				|(m_tx_char<<1);
+			m_stats.m_tx_bytes++;
+			if (nparity()) {
+				int	p;
+
+				// If m_nparity is set, we need to then
+				// create the parity bit.
+				if (fixdp())
+					p = evenp();
+				else {
+					p = (m_tx_data >> 1)&data_mask();
+					p = p ^ (p>>4);
+					p = p ^ (p>>2);
+					p = p ^ (p>>1);
+					p &= 1;
+					p ^= !evenp();
+				}
+				m_tx_data |= (p<<(nbits()+nparity()));
+			}
+			m_tx_busy = tx_busy_init();
+			m_tx_state = TXDATA;
+			m_tx_phase = 0;
+			m_tx_baudcounter = tx_bit_clocks()-1;
+			o_rx = tx_level();
+		}
+	} else if (m_tx_baudcounter <= 0) {
+		m_tx_data >>= 1;
+		m_tx_busy >>= 1;
+		if (!m_tx_busy) {
+			m_tx_state = TXIDLE;
+			m_edge = m_glitch_lo = m_glitch_hi = 0;
+		} else
+			m_tx_baudcounter = tx_bit_clocks()-1;
+		o_rx = tx_level();
+	} else {
+		m_tx_baudcounter--;
+		o_rx = tx_level();
+	}
+
+	return o_rx;
+}
+// }}}
+
+// UARTSIMT::next_event_clocks
+// {{{
+template <class TRANSPORT, int NBITS, int PARITY, int NSTOP>
+unsigned	UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>::next_event_clocks(void) const {
+	unsigned	rx_clocks, tx_clocks;
+
+	// The receiver
+	// {{{
+	// While idle, nothing happens until the line drops.  Once running,
+	// nothing happens until the baud counter runs out.
+	if (m_rx_state == RXIDLE)
+		rx_clocks = (m_last_tx) ? -1 : 0;
+	else if (m_rx_baudcounter > 0)
+		rx_clocks = m_rx_baudcounter;
+	else
+		rx_clocks = 0;
+	// }}}
+
+	// The transmitter
+	// {{{
+	// An idle transmitter can only be skipped if there's no host to
+	// listen to, or until it's time to check the host again.
+	if (m_tx_state == TXIDLE) {
+		if (m_itail < m_ihead)
+			// Nothing changes while RTS holds us off, until it
+			// changes
+			tx_clocks = (m_rts_n) ? -1 : 0;
+		else if (!m_host.readable())
+			tx_clocks = -1;
+		else
+			tx_clocks = m_host_countdown;
+	} else if (m_tx_baudcounter > 0) {
+		tx_clocks = m_tx_baudcounter;
+
+		// A glitch changes the output twice, part way through the bit
+		if (m_tx_baudcounter >= m_glitch_hi)
+			tx_clocks = m_tx_baudcounter - m_glitch_hi;
+		else if ((m_glitch_lo > 0)&&(m_tx_baudcounter >= m_glitch_lo))
+			tx_clocks = m_tx_baudcounter - m_glitch_lo;
+	} else
+		tx_clocks = 0;
+	// }}}
+
+	// Any buffered output needs to be sent on time
+	if ((m_olen > 0)&&(m_flush_countdown < tx_clocks))
+		tx_clocks = m_flush_countdown;
+
+	// ... as does the next byte waiting on the host's flow control
+	if ((fc_fill() > 0)&&(m_fc_countdown < tx_clocks))
+		tx_clocks = m_fc_countdown;
+
+	return (rx_clocks < tx_clocks) ? rx_clocks : tx_clocks;
+}
+// }}}
+
+// UARTSIMT::skip(nclocks)
+// {{{
+template <class TRANSPORT, int NBITS, int PARITY, int NSTOP>
+int	UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>::skip(unsigned nclocks) {
+	double	start = (m_profile) ? now() : 0;
+
+	m_stats.m_clocks += nclocks;
+	while(nclocks > 0) {
+		unsigned	nskip = next_event_clocks();
+
+		if (nskip == 0) {
+			// Something is about to happen, take one full step
+			tick(m_last_tx);
+			nclocks--;
+			continue;
+		} else if (nskip > nclocks)
+			nskip = nclocks;
+
+		// Nothing happens during these clocks but counting
+		if (m_rx_changectr < (1<<30))
+			m_rx_changectr += nskip;
+		if (m_rx_state != RXIDLE)
+			m_rx_baudcounter -= nskip;
+		if (m_tx_state != TXIDLE)
+			m_tx_baudcounter -= nskip;
+		else if (m_itail < m_ihead) {
+			// Waiting on RTS
+			if (m_rts_n)
+				m_stats.m_rts_stalls += nskip;
+		} else if (m_host_countdown >= nskip)
+			m_host_countdown -= nskip;
+		if (m_olen > 0)
+			m_flush_countdown -= nskip;
+		if (fc_fill() > 0) {
+			if (cts_n())
+				m_stats.m_cts_stalls += nskip;
+			m_fc_countdown -= nskip;
+		}
+		nclocks -= nskip;
+	}
+
+	if (m_profile)
+		m_stats.m_seconds += now() - start;
+	if ((m_stats_interval > 0)&&(m_stats.m_clocks >= m_stats_next)) {
+		stats_dump(m_stats_fp);
+		m_stats_next = m_stats.m_clocks + m_stats_interval;
+	}
+
+	return (m_tx_state == TXIDLE) ? 1 : tx_level();
+}
+// }}}
+
+// UARTSIMT::step(i_tx)
+// {{{
+template <class TRANSPORT, int NBITS, int PARITY, int NSTOP>
+int	UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>::step(const int i_tx) {
+	int	o_rx;
+
+	if (m_profile) {
+		double	start = now();
+		o_rx = tick(i_tx);
+		m_stats.m_seconds += now() - start;
+	} else
+		o_rx = tick(i_tx);
+
+	m_stats.m_clocks++;
+	if ((m_stats_interval > 0)&&(m_stats.m_clocks >= m_stats_next)) {
+		stats_dump(m_stats_fp);
+		m_stats_next = m_stats.m_clocks + m_stats_interval;
+	}
+
+	return o_rx;
+}
+// }}}
+
+// UARTSIMT::stats
+// {{{
+template <class TRANSPORT, int NBITS, int PARITY, int NSTOP>
+UARTSTATS	UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>::stats(void) const {
+	UARTSTATS	r = m_stats;
+	TRANSPORTSTATS	ts = transport_stats(m_host, 0);
+
+	r.m_rx_bytes   = m_rx_chars;
+	r.m_dropped   += ts.m_dropped;
+	r.m_syscalls   = ts.m_syscalls;
+	r.m_connects   = ts.m_connects;
+	r.m_rx_queue   = m_olen + fc_fill();
+	r.m_tx_queue   = m_ihead - m_itail;
+	if (r.m_rx_queue > r.m_rx_queue_max)
+		r.m_rx_queue_max = r.m_rx_queue;
+	return r;
+}
+// }}}
+
+// UARTSIMT::stats_dump(fp)
+// {{{
+template <class TRANSPORT, int NBITS, int PARITY, int NSTOP>
+void	UARTSIMT<TRANSPORT, NBITS, PARITY, NSTOP>::stats_dump(FILE *fp) const {
+	UARTSTATS	s = stats();
+
+	fprintf(fp, "UARTSIM: %lu clocks (%lu ticked", s.m_clocks, s.m_ticks);
+	if (m_profile)
+		fprintf(fp, ", %.3fs", s.m_seconds);
+	fprintf(fp, "), RX %lu, TX %lu bytes, "
+		"%lu polls (%lu hits, %lu misses), %lu writes, %lu syscalls, "
+		"%lu connects, %lu dropped, queues RX %u (max %u) TX %u (max %u)\n",
+		s.m_rx_bytes, s.m_tx_bytes,
+		s.m_host_reads, s.m_poll_hits, s.m_poll_misses,
+		s.m_host_writes, s.m_syscalls, s.m_connects, s.m_dropped,
+		s.m_rx_queue, s.m_rx_queue_max, s.m_tx_queue, s.m_tx_queue_max);
+	if ((m_fc_depth > 0)||(s.m_rts_stalls > 0))
+		fprintf(fp, "UARTSIM: flow control, %lu overflows, "
+			"%lu clocks stalled on RTS, %lu with CTS held off\n",
+			s.m_overflows, s.m_rts_stalls, s.m_cts_stalls);
+}
+// }}}
+
 #endif
@@ -0,0 +1,778 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	uarttransport.cpp
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Implements the various host connections the UARTSIM may use.
+//		See uarttransport.h for a description of the interface each
+//	provides.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <signal.h>
+#include <termios.h>
+
+#include "uarttransport.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// FDTRANSPORT
+// {{{
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+
+// FDTRANSPORT::read
+// {{{
+int	FDTRANSPORT::read(char *buf, int len) {
+	struct	pollfd	pb;
+	int	nr;
+
+	if (m_rdfd < 0)
+		return 0;
+
+	pb.fd = m_rdfd;
+	pb.events = POLLIN;
+	pb.revents = 0;
+	m_stats.m_syscalls++;
+	if (poll(&pb, 1, 0) < 0)
+		perror("Polling error:");
+
+	if (0 == (pb.revents & POLLIN))
+		return 0;
+
+	m_stats.m_syscalls++;
+	nr = ::read(m_rdfd, buf, len);
+	if (nr < 0) {
+		fprintf(stderr, "ERR while attempting to read in--closing input port\n");
+		perror("UARTSIM::read() ");
+		m_rdfd = -1;
+		return 0;
+	}
+
+	return nr;
+}
+// }}}
+
+// FDTRANSPORT::write
+// {{{
+int	FDTRANSPORT::write(const char *buf, int len) {
+	int	posn = 0;
+
+	while((posn < len)&&(m_wrfd >= 0)) {
+		int	nw;
+
+		m_stats.m_syscalls++;
+		nw = ::write(m_wrfd, &buf[posn], len-posn);
+
+		if (nw > 0)
+			posn += nw;
+		else {
+			fprintf(stderr, "ERR while attempting to write out--closing output port\n");
+			perror("UARTSIM::write() ");
+			m_rdfd = m_wrfd = -1;
+			break;
+		}
+	}
+
+	if (posn < len) {
+		m_stats.m_dropped += len - posn;
+		return -1;
+	}
+
+	return posn;
+}
+// }}}
+
+// FDTRANSPORT::close
+// {{{
+void	FDTRANSPORT::close(void) {
+	// Quickly double check that we aren't about to close stdin/stdout
+	if (m_rdfd == STDIN_FILENO)
+		m_rdfd = -1;
+	if (m_wrfd == STDOUT_FILENO)
+		m_wrfd = -1;
+	if (m_rdfd >= 0)			::close(m_rdfd);
+	if ((m_wrfd >= 0)&&(m_wrfd != m_rdfd))	::close(m_wrfd);
+
+	m_rdfd = m_wrfd = -1;
+}
+// }}}
+// }}}
+////////////////////////////////////////////////////////////////////////////////
+//
+// TCPTRANSPORT
+// {{{
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+
+// TCPTRANSPORT::TCPTRANSPORT(port)
+// {{{
+TCPTRANSPORT::TCPTRANSPORT(const int port) {
+	struct	sockaddr_in	my_addr;
+
+	m_con = -1;
+	signal(SIGPIPE, SIG_IGN);
+
+	printf("Listening on port %d\n", port);
+
+	m_skt = socket(AF_INET, SOCK_STREAM, 0);
+	if (m_skt < 0) {
+		perror("ERR: Could not allocate socket: ");
+		exit(EXIT_FAILURE);
+	}
+
+	// Set the reuse address option
+	{
+		int optv = 1, er;
+		er = setsockopt(m_skt, SOL_SOCKET, SO_REUSEADDR, &optv, sizeof(optv));
+		if (er != 0) {
+			perror("ERR: SockOpt Err:");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	memset(&my_addr, 0, sizeof(struct sockaddr_in)); // clear structure
+	my_addr.sin_family = AF_INET;
+	// Use *all* internet ports to this computer, allowing connections from
+	// any/every one of them.
+	my_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	my_addr.sin_port = htons(port);
+
+	if (bind(m_skt, (struct sockaddr *)&my_addr, sizeof(my_addr))!=0) {
+		perror("ERR: BIND FAILED:");
+		exit(EXIT_FAILURE);
+	}
+
+	if (listen(m_skt, 1) != 0) {
+		perror("ERR: Listen failed:");
+		exit(EXIT_FAILURE);
+	}
+}
+// }}}
+
+// TCPTRANSPORT::check_for_new_connections
+// {{{
+void	TCPTRANSPORT::check_for_new_connections(void) {
+	if ((m_con < 0)&&(m_skt>=0)) {
+		// Can we accept a connection?
+		struct	pollfd	pb;
+
+		pb.fd = m_skt;
+		pb.events = POLLIN;
+		pb.revents = 0;
+		m_stats.m_syscalls++;
+		poll(&pb, 1, 0);
+
+		if (pb.revents & POLLIN) {
+			m_stats.m_syscalls++;
+			m_con = accept(m_skt, 0, 0);
+
+			if (m_con < 0)
+				perror("Accept failed:");
+			else	// printf("New connection accepted!\n");
+				m_stats.m_connects++;
+		}
+	}
+}
+// }}}
+
+// TCPTRANSPORT::close_connection
+// {{{
+void	TCPTRANSPORT::close_connection(void) {
+	if (m_con >= 0) {
+		m_stats.m_syscalls++;
+		::close(m_con);
+	}
+	m_con = -1;
+}
+// }}}
+
+// TCPTRANSPORT::read
+// {{{
+int	TCPTRANSPORT::read(char *buf, int len) {
+	struct	pollfd	pb;
+	int	nr;
+
+	check_for_new_connections();
+	if (m_con < 0)
+		return 0;
+
+	pb.fd = m_con;
+	pb.events = POLLIN;
+	pb.revents = 0;
+	m_stats.m_syscalls++;
+	if (poll(&pb, 1, 0) < 0)
+		perror("Polling error:");
+
+	if (0 == (pb.revents & POLLIN))
+		return 0;
+
+	m_stats.m_syscalls++;
+	nr = recv(m_con, buf, len, MSG_DONTWAIT);
+	if (nr == 0) {
+		// printf("Closing network connection\n");
+		close_connection();
+	} else if (nr < 0) {
+		perror("O/S Read err:");
+		close_connection();
+		nr = 0;
+	}
+
+	return nr;
+}
+// }}}
+
+// TCPTRANSPORT::write
+// {{{
+int	TCPTRANSPORT::write(const char *buf, int len) {
+	int	posn = 0;
+
+	while((posn < len)&&(m_con >= 0)) {
+		int	nw;
+
+		m_stats.m_syscalls++;
+		nw = send(m_con, &buf[posn], len-posn, 0);
+
+		if (nw > 0)
+			posn += nw;
+		else {
+			close_connection();
+			fprintf(stderr, "Failed write, connection closed\n");
+		}
+	}
+
+	// Anything written while no one is connected is lost
+	if (posn < len) {
+		m_stats.m_dropped += len - posn;
+		return -1;
+	}
+
+	return posn;
+}
+// }}}
+
+// TCPTRANSPORT::close
+// {{{
+void	TCPTRANSPORT::close(void) {
+	close_connection();
+	if (m_skt >= 0)
+		::close(m_skt);
+	m_skt = -1;
+}
+// }}}
+// }}}
+////////////////////////////////////////////////////////////////////////////////
+//
+// MULTITCPTRANSPORT
+// {{{
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+
+// MULTITCPTRANSPORT::MULTITCPTRANSPORT(port, maxclients)
+// {{{
+MULTITCPTRANSPORT::MULTITCPTRANSPORT(const int port, const int maxclients) {
+	struct	sockaddr_in	my_addr;
+	struct	epoll_event	ev;
+
+	m_maxclients = (maxclients > 0) ? maxclients : 1;
+	m_nclients   = 0;
+	m_client     = new CLIENT[m_maxclients];
+	signal(SIGPIPE, SIG_IGN);
+
+	printf("Listening on port %d, for up to %d clients\n", port,
+		m_maxclients);
+
+	m_skt = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if (m_skt < 0) {
+		perror("ERR: Could not allocate socket: ");
+		exit(EXIT_FAILURE);
+	}
+
+	// Set the reuse address option
+	{
+		int optv = 1, er;
+		er = setsockopt(m_skt, SOL_SOCKET, SO_REUSEADDR, &optv, sizeof(optv));
+		if (er != 0) {
+			perror("ERR: SockOpt Err:");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	memset(&my_addr, 0, sizeof(struct sockaddr_in)); // clear structure
+	my_addr.sin_family = AF_INET;
+	my_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	my_addr.sin_port = htons(port);
+
+	if (bind(m_skt, (struct sockaddr *)&my_addr, sizeof(my_addr))!=0) {
+		perror("ERR: BIND FAILED:");
+		exit(EXIT_FAILURE);
+	}
+
+	if (listen(m_skt, m_maxclients) != 0) {
+		perror("ERR: Listen failed:");
+		exit(EXIT_FAILURE);
+	}
+
+	m_epfd = epoll_create1(0);
+	if (m_epfd < 0) {
+		perror("ERR: epoll_create1 failed:");
+		exit(EXIT_FAILURE);
+	}
+
+	ev.events  = EPOLLIN;
+	ev.data.fd = m_skt;
+	if (epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_skt, &ev) != 0) {
+		perror("ERR: epoll_ctl failed:");
+		exit(EXIT_FAILURE);
+	}
+}
+
+MULTITCPTRANSPORT::~MULTITCPTRANSPORT(void) {
+	close();
+	delete[] m_client;
+}
+// }}}
+
+// MULTITCPTRANSPORT::accept_clients
+// {{{
+void	MULTITCPTRANSPORT::accept_clients(void) {
+	while(m_skt >= 0) {
+		struct	epoll_event	ev;
+		int	fd;
+
+		m_stats.m_syscalls++;
+		fd = accept4(m_skt, 0, 0, SOCK_NONBLOCK);
+		if (fd < 0) {
+			if ((errno != EAGAIN)&&(errno != EWOULDBLOCK))
+				perror("Accept failed:");
+			return;
+		}
+
+		if (m_nclients >= m_maxclients) {
+			fprintf(stderr, "Too many clients, connection refused\n");
+			m_stats.m_syscalls++;
+			::close(fd);
+			continue;
+		}
+
+		ev.events  = EPOLLIN;
+		ev.data.fd = fd;
+		m_stats.m_syscalls++;
+		if (epoll_ctl(m_epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+			perror("O/S epoll_ctl err:");
+			m_stats.m_syscalls++;
+			::close(fd);
+			continue;
+		}
+
+		CLIENT	&c = m_client[m_nclients++];
+		c.m_fd    = fd;
+		c.m_queue = new char[MULTITCP_QLEN];
+		c.m_head  = c.m_tail = 0;
+		m_stats.m_connects++;
+	}
+}
+// }}}
+
+// MULTITCPTRANSPORT::drop_client
+// {{{
+// Closes the connection to client k.  Those after it move up one, so that the
+// oldest connection is always at zero, and so always the source.
+void	MULTITCPTRANSPORT::drop_client(int k) {
+	if ((k < 0)||(k >= m_nclients))
+		return;
+
+	m_stats.m_syscalls += 2;
+	epoll_ctl(m_epfd, EPOLL_CTL_DEL, m_client[k].m_fd, NULL);
+	::close(m_client[k].m_fd);
+	delete[] m_client[k].m_queue;
+
+	for(int i=k+1; i<m_nclients; i++)
+		m_client[i-1] = m_client[i];
+	m_nclients--;
+}
+// }}}
+
+// MULTITCPTRANSPORT::send_queued
+// {{{
+bool	MULTITCPTRANSPORT::send_queued(CLIENT &c) {
+	while(c.m_head != c.m_tail) {
+		unsigned	posn = c.m_tail & (MULTITCP_QLEN-1);
+		unsigned	ln   = c.m_head - c.m_tail;
+		int		nw;
+
+		// Only as far as the end of the queue at a time
+		if (posn + ln > MULTITCP_QLEN)
+			ln = MULTITCP_QLEN - posn;
+
+		m_stats.m_syscalls++;
+		nw = send(c.m_fd, &c.m_queue[posn], ln,
+				MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (nw > 0)
+			c.m_tail += nw;
+		else if ((nw < 0)&&((errno == EAGAIN)||(errno == EWOULDBLOCK)))
+			// This client is full, try again later
+			return true;
+		else
+			return false;
+	}
+
+	return true;
+}
+// }}}
+
+// MULTITCPTRANSPORT::service
+// {{{
+int	MULTITCPTRANSPORT::service(char *buf, int len) {
+	struct	epoll_event	ev[MULTITCP_MAXCLIENTS+1];
+	int	nev, nr = 0;
+
+	if (m_skt < 0)
+		return 0;
+
+	m_stats.m_syscalls++;
+	nev = epoll_wait(m_epfd, ev, MULTITCP_MAXCLIENTS+1, 0);
+	if (nev < 0) {
+		if (errno != EINTR)
+			perror("O/S epoll_wait err:");
+		return 0;
+	}
+
+	for(int e=0; e<nev; e++) {
+		int	k;
+
+		if (ev[e].data.fd == m_skt) {
+			accept_clients();
+			continue;
+		}
+
+		// Find the client this event is for.  There are few enough
+		// of them that a search is cheaper than keeping a map.
+		for(k=0; k<m_nclients; k++)
+			if (m_client[k].m_fd == ev[e].data.fd)
+				break;
+		if (k >= m_nclients)
+			continue;
+
+		if (ev[e].events & EPOLLIN) {
+			char	discard[256];
+			int	ln;
+
+			m_stats.m_syscalls++;
+			if (k == 0) {
+				// The source.  Anything left over, once buf
+				// is full, simply waits for the next read.
+				if (nr >= len)
+					continue;
+				ln = recv(m_client[0].m_fd, &buf[nr], len-nr,
+					MSG_DONTWAIT);
+				if (ln > 0)
+					nr += ln;
+			} else
+				ln = recv(m_client[k].m_fd, discard,
+					sizeof(discard), MSG_DONTWAIT);
+
+			if ((ln == 0)||((ln < 0)&&(errno != EAGAIN)
+						&&(errno != EWOULDBLOCK))) {
+				// A hangup, or an error.  Anything already
+				// read from the source is still good.
+				drop_client(k);
+			}
+		} else if (ev[e].events & (EPOLLHUP | EPOLLERR))
+			drop_client(k);
+	}
+
+	// Send out whatever we can of what's been queued
+	for(int k=0; k<m_nclients; k++)
+		if (!send_queued(m_client[k]))
+			drop_client(k--);
+
+	return nr;
+}
+// }}}
+
+// MULTITCPTRANSPORT::read
+// {{{
+int	MULTITCPTRANSPORT::read(char *buf, int len) {
+	return service(buf, len);
+}
+// }}}
+
+// MULTITCPTRANSPORT::write
+// {{{
+int	MULTITCPTRANSPORT::write(const char *buf, int len) {
+	// Anything written while no one is connected is lost
+	if (m_nclients == 0) {
+		m_stats.m_dropped += len;
+		return -1;
+	}
+
+	for(int k=0; k<m_nclients; k++) {
+		CLIENT		&c = m_client[k];
+		unsigned	room = MULTITCP_QLEN - (c.m_head - c.m_tail),
+				ln = (unsigned)len;
+
+		// A client that isn't keeping up loses what won't fit
+		if (ln > room) {
+			m_stats.m_dropped += ln - room;
+			ln = room;
+		}
+
+		for(unsigned i=0; i<ln; i++)
+			c.m_queue[(c.m_head++) & (MULTITCP_QLEN-1)] = buf[i];
+
+		if (!send_queued(c))
+			drop_client(k--);
+	}
+
+	return len;
+}
+// }}}
+
+// MULTITCPTRANSPORT::close
+// {{{
+void	MULTITCPTRANSPORT::close(void) {
+	while(m_nclients > 0)
+		drop_client(m_nclients-1);
+	if (m_skt >= 0) {
+		::close(m_skt);
+		::close(m_epfd);
+	}
+	m_skt = m_epfd = -1;
+}
+// }}}
+// }}}
+////////////////////////////////////////////////////////////////////////////////
+//
+// PTYTRANSPORT
+// {{{
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+
+// PTYTRANSPORT::PTYTRANSPORT(linkname)
+// {{{
+PTYTRANSPORT::PTYTRANSPORT(const char *linkname) {
+	struct	termios	tb;
+	const char	*slave;
+
+	m_name = m_link = NULL;
+	m_master = posix_openpt(O_RDWR | O_NOCTTY);
+	if ((m_master < 0)||(grantpt(m_master) != 0)
+			||(unlockpt(m_master) != 0)
+			||(NULL == (slave = ptsname(m_master)))) {
+		perror("ERR: Could not create pseudo-terminal:");
+		exit(EXIT_FAILURE);
+	}
+
+	m_name = strdup(slave);
+	fcntl(m_master, F_SETFL, fcntl(m_master, F_GETFL) | O_NONBLOCK);
+
+	// Raw mode: no echo, no line editing, and no CR/LF translation.  The
+	// terminal program attaching to us may change this, but that's its
+	// business.
+	if (tcgetattr(m_master, &tb) == 0) {
+		cfmakeraw(&tb);
+		tcsetattr(m_master, TCSANOW, &tb);
+	}
+
+	if (linkname) {
+		unlink(linkname);
+		if (symlink(m_name, linkname) != 0)
+			perror("ERR: Could not create link to pseudo-terminal:");
+		else
+			m_link = strdup(linkname);
+	}
+
+	printf("Pseudo-terminal at %s\n", (m_link) ? m_link : m_name);
+}
+// }}}
+
+// PTYTRANSPORT::~PTYTRANSPORT
+// {{{
+PTYTRANSPORT::~PTYTRANSPORT(void) {
+	close();
+	free(m_name);
+}
+// }}}
+
+// PTYTRANSPORT::read
+// {{{
+int	PTYTRANSPORT::read(char *buf, int len) {
+	int	nr;
+
+	if (m_master < 0)
+		return 0;
+
+	// The master is non-blocking, so there's no need to poll() first.
+	// EIO just means no one has the terminal open at present.
+	m_stats.m_syscalls++;
+	nr = ::read(m_master, buf, len);
+	if (nr < 0) {
+		if ((errno != EAGAIN)&&(errno != EIO))
+			perror("O/S Read err:");
+		nr = 0;
+	}
+
+	return nr;
+}
+// }}}
+
+// PTYTRANSPORT::write
+// {{{
+int	PTYTRANSPORT::write(const char *buf, int len) {
+	int	nw;
+
+	if (m_master < 0) {
+		m_stats.m_dropped += len;
+		return -1;
+	}
+
+	m_stats.m_syscalls++;
+	nw = ::write(m_master, buf, len);
+	if ((nw < 0)&&(errno != EAGAIN)&&(errno != EIO))
+		perror("O/S Write err:");
+	// Anything that didn't fit is dropped
+	if (nw != len) {
+		m_stats.m_dropped += (nw > 0) ? (len - nw) : len;
+		return -1;
+	}
+	return nw;
+}
+// }}}
+
+// PTYTRANSPORT::close
+// {{{
+void	PTYTRANSPORT::close(void) {
+	if (m_master >= 0)
+		::close(m_master);
+	m_master = -1;
+	if (m_link) {
+		unlink(m_link);
+		free(m_link);
+		m_link = NULL;
+	}
+}
+// }}}
+// }}}
+////////////////////////////////////////////////////////////////////////////////
+//
+// SHMTRANSPORT
+// {{{
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+
+// SHMTRANSPORT::SHMTRANSPORT(name, lgsize)
+// {{{
+SHMTRANSPORT::SHMTRANSPORT(const char *name, const unsigned lgsize) {
+	m_shm = uartshm_open(name, true, lgsize);
+	if (m_shm == NULL)
+		exit(EXIT_FAILURE);
+	m_name = strdup(name);
+	printf("Shared memory UART at %s\n", m_name);
+}
+// }}}
+
+// SHMTRANSPORT::~SHMTRANSPORT
+// {{{
+SHMTRANSPORT::~SHMTRANSPORT(void) {
+	close();
+}
+// }}}
+
+// SHMTRANSPORT::read
+// {{{
+int	SHMTRANSPORT::read(char *buf, int len) {
+	if (m_shm == NULL)
+		return 0;
+	return uartshm_read(&m_shm->m_fromhost, buf, len);
+}
+// }}}
+
+// SHMTRANSPORT::write
+// {{{
+int	SHMTRANSPORT::write(const char *buf, int len) {
+	int	posn = 0;
+
+	if (m_shm == NULL) {
+		m_stats.m_dropped += len;
+		return -1;
+	}
+
+	posn = uartshm_write(&m_shm->m_tohost, buf, len);
+	while((posn < len)
+			&&(m_shm->m_attached.load(std::memory_order_acquire))) {
+		// The host is attached, but hasn't kept up.  Give it a chance
+		// to catch up, rather than lose anything.
+		m_stats.m_syscalls++;
+		sched_yield();
+		posn += uartshm_write(&m_shm->m_tohost, &buf[posn], len-posn);
+	}
+
+	if (posn < len) {
+		m_stats.m_dropped += len - posn;
+		return -1;
+	}
+
+	return posn;
+}
+// }}}
+
+// SHMTRANSPORT::close
+// {{{
+void	SHMTRANSPORT::close(void) {
+	if (m_shm) {
+		uartshm_close(m_shm);
+		shm_unlink(m_name);
+		free(m_name);
+	}
+	m_shm  = NULL;
+	m_name = NULL;
+}
+// }}}
+// }}}
@@ -0,0 +1,546 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	uarttransport.h
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Describes the various ways the UARTSIM can be connected to the
+//		host: a TCP/IP port, a pair of file descriptors, a pseudo
+//	terminal, a ring buffer in shared memory, or a function within the
+//	test bench itself.  Any of these may also be given a thread of its
+//	own (THREADTRANSPORT), so that the simulation never waits on the host.
+//
+//	Each of these classes offers the same small interface:
+//
+//	int	read(char *buf, int len)
+//		Reads up to len bytes from the host into buf, without blocking.
+//		Returns the number of bytes read, or zero if nothing is
+//		available.
+//
+//	int	write(const char *buf, int len)
+//		Sends len bytes to the host.  Returns the number of bytes sent,
+//		or a negative number if the bytes were dropped.
+//
+//	bool	connected(void)
+//		True if anything written will go anywhere.  If not, the UARTSIM
+//		won't bother to buffer it.
+//
+//	bool	readable(void)
+//		True if read() might ever return data.  If not, the UARTSIM
+//		doesn't need to check the host at all.
+//
+//	void	close(void)
+//		Closes the connection.  Nothing will be read or written after
+//		this.
+//
+//	The UARTSIMT class is templated on the transport, so there's no run
+//	time cost to choosing one over another.  Any other class offering this
+//	interface may be used as well.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	UARTTRANSPORT_H
+#define	UARTTRANSPORT_H
+
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "uartshm.h"
+
+// The most clients a MULTITCPTRANSPORT accepts at once, by default
+#define	MULTITCP_MAXCLIENTS	8
+// The size of the output queue kept for each client.  Must be a power of two.
+#define	MULTITCP_QLEN		65536
+// The log, base two, of the size of each THREADTRANSPORT queue
+#define	THREADTRANSPORT_LGSIZE	16
+// How long a THREADTRANSPORT's thread sleeps, in microseconds, once it finds
+// nothing to do
+#define	THREADTRANSPORT_IDLE_US	50
+
+// TRANSPORTSTATS
+// {{{
+// What a transport has needed to do to talk to the host:  the system calls
+// it has made, the number of connections it has accepted, and the number of
+// bytes it has had to drop for lack of anyone to give them to.  A transport
+// needn't keep these--transport_stats(), below, returns zeros for any that
+// doesn't have a stats() method.
+struct	TRANSPORTSTATS {
+	unsigned long	m_syscalls, m_connects, m_dropped;
+
+	TRANSPORTSTATS(void) : m_syscalls(0), m_connects(0), m_dropped(0) {}
+};
+
+template <class T>
+auto	transport_stats(const T &t, int) -> decltype(TRANSPORTSTATS(t.stats())) {
+	return t.stats(); }
+template <class T>
+TRANSPORTSTATS	transport_stats(const T &t, long) {
+	return TRANSPORTSTATS(); }
+// }}}
+
+// FDTRANSPORT
+// {{{
+// Reads from one file descriptor, and writes to another--by default stdin
+// and stdout.  Neither descriptor is closed if it is stdin or stdout.
+class	FDTRANSPORT {
+	int	m_rdfd, m_wrfd;
+	TRANSPORTSTATS	m_stats;
+public:
+	FDTRANSPORT(const int rdfd = STDIN_FILENO,
+			const int wrfd = STDOUT_FILENO)
+		: m_rdfd(rdfd), m_wrfd(wrfd) {}
+
+	int	read(char *buf, int len);
+	int	write(const char *buf, int len);
+	bool	connected(void) const { return (m_wrfd >= 0); }
+	bool	readable(void) const { return (m_rdfd >= 0); }
+	void	close(void);
+	const TRANSPORTSTATS &stats(void) const { return m_stats; }
+};
+// }}}
+
+// TCPTRANSPORT
+// {{{
+// Listens on a TCP/IP port, and accepts one connection at a time.  Anything
+// written while no one is connected is dropped.
+class	TCPTRANSPORT {
+	// m_skt is the socket we are listening on, m_con is the connection
+	int	m_skt, m_con;
+	TRANSPORTSTATS	m_stats;
+
+	// Accept a new connection, if there's one waiting and we don't
+	// already have one
+	void	check_for_new_connections(void);
+	void	close_connection(void);
+public:
+	TCPTRANSPORT(const int port);
+
+	int	read(char *buf, int len);
+	int	write(const char *buf, int len);
+	bool	connected(void) const { return (m_con >= 0); }
+	bool	readable(void) const { return (m_skt >= 0); }
+	void	close(void);
+	const TRANSPORTSTATS &stats(void) const { return m_stats; }
+};
+// }}}
+
+// MULTITCPTRANSPORT
+// {{{
+// Listens on a TCP/IP port, as TCPTRANSPORT does, but accepts up to
+// maxclients connections at once.  Everything received from the device goes
+// to every client, via a queue of its own, so a client that's slow to read
+// only loses its own output (once its queue, of MULTITCP_QLEN bytes, fills)
+// rather than stalling the simulation.  Only the oldest connection is the
+// source of anything sent to the device--input from any other client is
+// read and discarded.  Once that client leaves, the next oldest takes its
+// place.  All of this is handled through one (non-blocking) epoll instance.
+class	MULTITCPTRANSPORT {
+	// m_skt is the socket we are listening on, m_epfd our epoll instance
+	int	m_skt, m_epfd, m_maxclients, m_nclients;
+
+	// Each client, in the order they connected, together with the output
+	// waiting for it in m_queue, between m_tail and m_head
+	typedef	struct {
+		int		m_fd;
+		char		*m_queue;
+		unsigned	m_head, m_tail;
+	} CLIENT;
+	CLIENT		*m_client;
+	TRANSPORTSTATS	m_stats;
+
+	void	accept_clients(void);
+	void	drop_client(int k);
+	// Sends what it can of a client's queue, returning false on error
+	bool	send_queued(CLIENT &c);
+	// Checks for connections, input, and hangups, keeping up to len bytes
+	// of input from the source client in buf
+	int	service(char *buf, int len);
+public:
+	MULTITCPTRANSPORT(const int port,
+			const int maxclients = MULTITCP_MAXCLIENTS);
+	~MULTITCPTRANSPORT(void);
+
+	int	read(char *buf, int len);
+	int	write(const char *buf, int len);
+	bool	connected(void) const { return (m_nclients > 0); }
+	bool	readable(void) const { return (m_skt >= 0); }
+	void	close(void);
+	const TRANSPORTSTATS &stats(void) const { return m_stats; }
+
+	// The number of clients currently connected
+	int	clients(void) const { return m_nclients; }
+};
+// }}}
+
+// PTYTRANSPORT
+// {{{
+// Creates a pseudo-terminal, whose name is printed on startup (or may be
+// found from name()), so that a terminal program such as minicom can be
+// attached to it directly.  If linkname is given, a symbolic link to the
+// terminal is created under that name as well.  The terminal is placed in
+// raw mode.  Output that the terminal isn't keeping up with is dropped,
+// rather than allowing it to stall the simulation.
+class	PTYTRANSPORT {
+	int	m_master;
+	char	*m_name, *m_link;
+	TRANSPORTSTATS	m_stats;
+public:
+	PTYTRANSPORT(const char *linkname = NULL);
+	~PTYTRANSPORT(void);
+
+	int	read(char *buf, int len);
+	int	write(const char *buf, int len);
+	bool	connected(void) const { return (m_master >= 0); }
+	bool	readable(void) const { return (m_master >= 0); }
+	void	close(void);
+	const char *name(void) const { return m_name; }
+	const TRANSPORTSTATS &stats(void) const { return m_stats; }
+};
+// }}}
+
+// SHMTRANSPORT
+// {{{
+// Communicates with a host process via a pair of lock-free single producer,
+// single consumer ring buffers in POSIX shared memory (see uartshm.h).  Once
+// a host has attached, writes wait for room in the ring rather than dropping
+// data.  Until then, output is dropped.  Neither side ever makes a system
+// call to move data.
+class	SHMTRANSPORT {
+	UARTSHM	*m_shm;
+	char	*m_name;
+	TRANSPORTSTATS	m_stats;
+public:
+	SHMTRANSPORT(const char *name, const unsigned lgsize = UARTSHM_LGSIZE);
+	~SHMTRANSPORT(void);
+
+	int	read(char *buf, int len);
+	int	write(const char *buf, int len);
+	bool	connected(void) const { return (m_shm != NULL); }
+	bool	readable(void) const { return (m_shm != NULL); }
+	void	close(void);
+	const TRANSPORTSTATS &stats(void) const { return m_stats; }
+};
+// }}}
+
+// CALLBACKTRANSPORT
+// {{{
+// Hands everything written to a function, rather than to a file or socket,
+// so that a test bench may check the UART's output without ever leaving the
+// process.  The function is given the data pointer, followed by the bytes
+// received, and should return the number of bytes it accepted.  Nothing is
+// ever read from the host.
+class	CALLBACKTRANSPORT {
+public:
+	typedef	int	(*CALLBACK)(void *data, const char *buf, int len);
+private:
+	CALLBACK	m_fn;
+	void		*m_data;
+public:
+	CALLBACKTRANSPORT(CALLBACK fn, void *data = NULL)
+		: m_fn(fn), m_data(data) {}
+
+	int	read(char *, int) { return 0; }
+	int	write(const char *buf, int len) {
+		return (m_fn) ? m_fn(m_data, buf, len) : -1; }
+	bool	connected(void) const { return (m_fn != NULL); }
+	bool	readable(void) const { return false; }
+	void	close(void) { m_fn = NULL; }
+};
+// }}}
+
+// LOOPTRANSPORT
+// {{{
+// A host that sends one message (src) to the UARTSIM, and keeps whatever comes
+// back in dst.  Anything past the end of dst is counted, but dropped.
+class	LOOPTRANSPORT {
+	const char	*m_src;
+	int		m_srclen, m_sent;
+	char		*m_dst;
+	int		m_dstlen, m_received;
+public:
+	LOOPTRANSPORT(const char *src, int srclen, char *dst, int dstlen)
+		: m_src(src), m_srclen(srclen), m_sent(0),
+		m_dst(dst), m_dstlen(dstlen), m_received(0) {}
+
+	int	read(char *buf, int len) {
+		if (len > m_srclen - m_sent)
+			len = m_srclen - m_sent;
+		memcpy(buf, &m_src[m_sent], len);
+		m_sent += len;
+		return len;
+	}
+
+	int	write(const char *buf, int len) {
+		for(int k=0; k<len; k++, m_received++)
+			if (m_received < m_dstlen)
+				m_dst[m_received] = buf[k];
+		return len;
+	}
+
+	bool	connected(void) const { return true; }
+	bool	readable(void) const { return (m_sent < m_srclen); }
+	void	close(void) {}
+
+	int	received(void) const { return m_received; }
+};
+// }}}
+
+// THREADTRANSPORT
+// {{{
+// Runs another transport, TRANSPORT, on a thread of its own.  The simulation
+// and that thread only ever meet through two lock free, single producer
+// single consumer rings (the same as SHMTRANSPORT uses, from uartshm.h), so
+// the simulation's read() and write() touch nothing but memory.  A
+// host that is slow to accept output--a stalled TCP/IP peer, or a terminal
+// that isn't keeping up with stdout--then only costs the thread its time.
+// Should the output ring ever fill, what won't fit is dropped (and counted)
+// rather than waiting on it.
+//
+// The arguments to the constructor are passed on to TRANSPORT's.  close()
+// sends whatever is still in the output ring before stopping the thread and
+// closing TRANSPORT.
+template <class TRANSPORT>
+class	THREADTRANSPORT {
+	typedef	struct {
+		UARTSHMRING	m_ring;
+		char		m_data[1u << THREADTRANSPORT_LGSIZE];
+	} RING;
+
+	TRANSPORT	m_transport;
+	RING		*m_tohost, *m_fromhost;
+	std::atomic<bool>	m_run, m_connected, m_readable;
+	std::thread	m_thread;
+
+	// The transport's statistics, as last copied by the thread, and
+	// those returned by stats()
+	mutable	std::mutex	m_lock;
+	TRANSPORTSTATS		m_inner;
+	mutable	TRANSPORTSTATS	m_stats;
+	// Bytes dropped for lack of room in the output ring
+	unsigned long		m_dropped;
+
+	// copy_stats(void)
+	// {{{
+	void	copy_stats(void) {
+		std::lock_guard<std::mutex>	guard(m_lock);
+		m_inner = transport_stats(m_transport, 0);
+	}
+	// }}}
+
+	// send(buf)
+	// {{{
+	// Passes everything in the output ring on to the transport.  Returns
+	// true if there was anything to pass on.
+	bool	send(char *buf, unsigned len) {
+		unsigned	ln;
+		bool		busy = false;
+
+		while((ln = uartshm_read(&m_tohost->m_ring, buf, len)) > 0) {
+			m_transport.write(buf, ln);
+			busy = true;
+		}
+
+		return busy;
+	}
+	// }}}
+
+	// run(void)
+	// {{{
+	// The thread itself
+	void	run(void) {
+		char	buf[4096];
+
+		while(m_run.load(std::memory_order_acquire)) {
+			bool		busy = send(buf, sizeof(buf));
+			unsigned	room = uartshm_room(&m_fromhost->m_ring);
+
+			// Only read what there's room to keep
+			if ((room > 0)&&(m_transport.readable())) {
+				int	nr;
+
+				if (room > sizeof(buf))
+					room = sizeof(buf);
+				nr = m_transport.read(buf, room);
+				if (nr > 0) {
+					uartshm_write(&m_fromhost->m_ring,
+						buf, nr);
+					busy = true;
+				}
+			}
+
+			m_connected.store(m_transport.connected(),
+					std::memory_order_release);
+			m_readable.store(m_transport.readable(),
+					std::memory_order_release);
+			copy_stats();
+
+			if (!busy)
+				usleep(THREADTRANSPORT_IDLE_US);
+		}
+
+		// Whatever was written before close() still goes out
+		send(buf, sizeof(buf));
+		copy_stats();
+	}
+	// }}}
+public:
+	template <typename... ARGS>	THREADTRANSPORT(ARGS&&... args)
+			: m_transport(std::forward<ARGS>(args)...),
+			m_tohost(new RING), m_fromhost(new RING), m_dropped(0) {
+		uartshm_ring_init(&m_tohost->m_ring, m_tohost->m_data,
+				THREADTRANSPORT_LGSIZE);
+		uartshm_ring_init(&m_fromhost->m_ring, m_fromhost->m_data,
+				THREADTRANSPORT_LGSIZE);
+		m_connected.store(m_transport.connected());
+		m_readable.store(m_transport.readable());
+		m_inner = transport_stats(m_transport, 0);
+		m_run.store(true);
+		m_thread = std::thread(&THREADTRANSPORT::run, this);
+	}
+
+	~THREADTRANSPORT(void) {
+		close();
+		delete m_tohost;
+		delete m_fromhost;
+	}
+
+	int	read(char *buf, int len) {
+		return uartshm_read(&m_fromhost->m_ring, buf, len); }
+
+	int	write(const char *buf, int len) {
+		unsigned	nw;
+
+		nw = uartshm_write(&m_tohost->m_ring, buf, len);
+		if (nw < (unsigned)len) {
+			m_dropped += len - nw;
+			return -1;
+		}
+		return len;
+	}
+
+	bool	connected(void) const {
+		return m_connected.load(std::memory_order_acquire); }
+
+	// Readable as long as the transport is, or anything it read remains
+	bool	readable(void) const {
+		UARTSHMRING	*ring = &m_fromhost->m_ring;
+
+		return (m_readable.load(std::memory_order_acquire))
+			||(ring->m_head.load(std::memory_order_acquire)
+				!= ring->m_tail.load(std::memory_order_relaxed));
+	}
+
+	void	close(void) {
+		if (m_thread.joinable()) {
+			m_run.store(false, std::memory_order_release);
+			m_thread.join();
+			m_transport.close();
+			copy_stats();
+			m_connected.store(false);
+			m_readable.store(false);
+		}
+	}
+
+	const TRANSPORTSTATS &stats(void) const {
+		std::lock_guard<std::mutex>	guard(m_lock);
+		m_stats = m_inner;
+		m_stats.m_dropped += m_dropped;
+		return m_stats;
+	}
+
+	// The transport the thread is running.  Until close(), it belongs to
+	// the thread.
+	TRANSPORT	&transport(void) { return m_transport; }
+};
+// }}}
+
+// PORTTRANSPORT
+// {{{
+// The original UARTSIM behavior: a port number of zero selects stdin and
+// stdout, anything else selects a TCP/IP port.  If multi is set, the port
+// accepts several clients at once (see MULTITCPTRANSPORT).  If threaded is
+// set, whichever is chosen runs on a thread of its own (THREADTRANSPORT).
+// This choice is only made when actually talking to the host, not on every
+// clock.
+class	PORTTRANSPORT {
+	TCPTRANSPORT		*m_tcp;
+	MULTITCPTRANSPORT	*m_multi;
+	THREADTRANSPORT<PORTTRANSPORT>	*m_thread;
+	FDTRANSPORT		m_fd;
+public:
+	PORTTRANSPORT(const int port, const bool multi = false,
+			const bool threaded = false)
+		: m_tcp(((port != 0)&&(!multi)&&(!threaded))
+			? new TCPTRANSPORT(port) : NULL),
+		m_multi(((port != 0)&&(multi)&&(!threaded))
+			? new MULTITCPTRANSPORT(port) : NULL),
+		m_thread((threaded)
+			? new THREADTRANSPORT<PORTTRANSPORT>(port, multi)
+			: NULL) {}
+	~PORTTRANSPORT(void) { delete m_thread; delete m_tcp; delete m_multi; }
+
+	int	read(char *buf, int len) {
+		return (m_thread) ? m_thread->read(buf, len)
+			: (m_tcp) ? m_tcp->read(buf, len)
+			: (m_multi) ? m_multi->read(buf, len)
+			: m_fd.read(buf, len); }
+	int	write(const char *buf, int len) {
+		return (m_thread) ? m_thread->write(buf, len)
+			: (m_tcp) ? m_tcp->write(buf,len)
+			: (m_multi) ? m_multi->write(buf, len)
+			: m_fd.write(buf,len); }
+	bool	connected(void) const {
+		return (m_thread) ? m_thread->connected()
+			: (m_tcp) ? m_tcp->connected()
+			: (m_multi) ? m_multi->connected()
+			: m_fd.connected(); }
+	bool	readable(void) const {
+		return (m_thread) ? m_thread->readable()
+			: (m_tcp) ? m_tcp->readable()
+			: (m_multi) ? m_multi->readable()
+			: m_fd.readable(); }
+	void	close(void) {
+		if (m_thread) m_thread->close();
+		else if (m_tcp) m_tcp->close();
+		else if (m_multi) m_multi->close();
+		else m_fd.close(); }
+	const TRANSPORTSTATS &stats(void) const {
+		return (m_thread) ? m_thread->stats()
+			: (m_tcp) ? m_tcp->stats()
+			: (m_multi) ? m_multi->stats()
+			: m_fd.stats(); }
+};
+// }}}
+
+#endif
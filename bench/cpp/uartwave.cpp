@@ -0,0 +1,400 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	uartwave.cpp
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Implements the bulk waveform routines described in uartwave.h.
+//
+//	The decoder spends nearly all of its time looking for start bits, so
+//	that's where the effort goes:  words of all ones (idle) are skipped
+//	several at a time, and only the word containing the next falling edge
+//	is ever examined bit by bit.  Once a start bit is found, the handful
+//	of mid-bit samples that make up the character are pulled out directly,
+//	skipping everything in between.
+//
+//	The encoders share one routine that breaks each character into its
+//	runs.  Packed waveforms are then filled in a word at a time from
+//	those runs.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#if	defined(__AVX2__)
+#include <immintrin.h>
+#elif	defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "uartwave.h"
+
+// The most runs any one character may take: start, data, parity, and stop
+#define	MAXCHARRUNS	(1+8+1+2)
+
+// sample(samples, k)
+// {{{
+static inline int	sample(const uint64_t *samples, uint64_t k) {
+	return (samples[k>>6] >> (k&63))&1;
+}
+// }}}
+
+// find_low(samples, from, nsamples)
+// {{{
+// Returns the number of the first sample at or after from that is low, or
+// nsamples if there are none.
+static uint64_t	find_low(const uint64_t *samples, uint64_t from,
+		const uint64_t nsamples) {
+	uint64_t	w, nwords = (nsamples+63)>>6, wd;
+
+	if (from >= nsamples)
+		return nsamples;
+
+	// The first, partial, word
+	wd = from >> 6;
+	w = (~samples[wd]) & ((~0ull) << (from & 63));
+	if (w == 0) {
+		wd++;
+
+		// Skip whole idle words, several at a time
+		// {{{
+#if	defined(__AVX2__)
+		const __m256i	ones = _mm256_set1_epi64x(-1);
+		while(wd + 4 <= nwords) {
+			__m256i	v = _mm256_loadu_si256((const __m256i *)&samples[wd]);
+			if (!_mm256_testc_si256(v, ones))
+				break;
+			wd += 4;
+		}
+#elif	defined(__SSE2__)
+		const __m128i	ones = _mm_set1_epi32(-1);
+		while(wd + 2 <= nwords) {
+			__m128i	v = _mm_loadu_si128((const __m128i *)&samples[wd]);
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(v, ones)) != 0x0ffff)
+				break;
+			wd += 2;
+		}
+#endif
+		// }}}
+
+		while((wd < nwords)&&(samples[wd] == ~0ull))
+			wd++;
+		if (wd >= nwords)
+			return nsamples;
+		w = ~samples[wd];
+	}
+
+	from = (wd << 6) + __builtin_ctzll(w);
+	return (from < nsamples) ? from : nsamples;
+}
+// }}}
+
+// uartwave_decode
+// {{{
+size_t	uartwave_decode(const uint64_t *samples, uint64_t nsamples,
+		unsigned setup, uint16_t *out, size_t maxout, uint64_t *posn) {
+	int	baud_counts, nbits, nstop, nparity, fixdp, evenp, nsam;
+	uint64_t	period, t, start, edge, first;
+	size_t		nout = 0;
+
+	// Break out the setup register, as UARTSIM::setup() does
+	// {{{
+	baud_counts = (setup & 0x0ffffff);
+	nbits   = 8-((setup >> 28)&0x03);
+	nstop   =((setup >> 27)&1)+1;
+	nparity = (setup >> 26)&1;
+	fixdp   = (setup >> 25)&1;
+	evenp   = (setup >> 24)&1;
+	nsam    = nbits + nparity + nstop;
+	period  = (baud_counts > 0) ? baud_counts : 1;
+	// }}}
+
+	t = 0;
+	while(nout < maxout) {
+		unsigned	v = 0, data, flags = 0;
+		int64_t		delay;
+
+		// Find the start bit
+		// {{{
+		start = find_low(samples, t, nsamples);
+		if (start >= nsamples)
+			break;
+
+		// The UARTSIM times the character from the last falling edge
+		// of the line.  Normally that's the start bit itself, but if
+		// the line was already low when we started looking (i.e. a
+		// framing error, or a break), it may have been earlier.  There's
+		// no need to look back further than the initial delay, though.
+		edge = start;
+		if ((start == t)&&(start > 0)) {
+			uint64_t	limit = baud_counts + baud_counts/2;
+
+			while((edge > 0)&&(start-edge < limit)
+					&&(!sample(samples, edge-1)))
+				edge--;
+		}
+
+		delay = (int64_t)baud_counts + baud_counts/2 - 1
+				- (int64_t)(start - edge);
+		first = start + ((delay > 0) ? delay : 0) + 1;
+		// }}}
+
+		// Make sure the whole character is here
+		if (first + (nsam-1) * period >= nsamples)
+			break;
+
+		// Collect the mid-bit samples, LSB first
+		// {{{
+		for(int k=0; k<nsam; k++)
+			v |= sample(samples, first + k*period) << k;
+		// }}}
+
+		// Check the parity and stop bits
+		// {{{
+		data = v & ((1<<nbits)-1);
+		if (nparity) {
+			int	p;
+
+			// Same convention as txuart.v, rxuart.v, and the
+			// UARTSIM: a fixed parity bit equals evenp, otherwise
+			// the parity bit is the XOR of the data bits, inverted
+			// for odd parity.
+			if (fixdp)
+				p = evenp;
+			else {
+				p = data;
+				p = p ^ (p>>4);
+				p = p ^ (p>>2);
+				p = p ^ (p>>1);
+				p &= 1;
+				p ^= !evenp;
+			}
+
+			if (((v >> nbits)&1) != (unsigned)p)
+				flags |= UARTWAVE_PERR;
+		}
+
+		if (((v >> (nbits+nparity)) & ((1<<nstop)-1))
+				!= (unsigned)((1<<nstop)-1))
+			flags |= UARTWAVE_FERR;
+		// }}}
+
+		if (posn)
+			posn[nout] = edge;
+		out[nout++] = data | flags;
+
+		// The UARTSIM returns to idle one baud interval after the last
+		// stop bit sample, and starts looking on the clock after that
+		t = first + nsam * period + 1;
+	}
+
+	return nout;
+}
+// }}}
+
+// rand32(state)
+// {{{
+// A small, fast, and--most importantly--repeatable source of randomness,
+// so that the same options always generate the same waveform
+static inline uint32_t	rand32(uint32_t &state) {
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+// }}}
+
+// char_runs(ch, setup, opts, rng, runs)
+// {{{
+// Breaks one character into runs, returning the number of runs.  Runs of the
+// same level are merged.
+static int	char_runs(int ch, unsigned setup, const UARTWAVEOPTS *opts,
+		uint32_t &rng, UARTWAVERUN *runs) {
+	int	baud_counts, nbits, nstop, nparity, fixdp, evenp, nsam,
+		nruns = 0;
+	unsigned	v, gap = 0;
+
+	// Break out the setup register, as UARTSIM::setup() does
+	// {{{
+	baud_counts = (setup & 0x0ffffff);
+	nbits   = 8-((setup >> 28)&0x03);
+	nstop   =((setup >> 27)&1)+1;
+	nparity = (setup >> 26)&1;
+	fixdp   = (setup >> 25)&1;
+	evenp   = (setup >> 24)&1;
+	nsam    = nbits + nparity + nstop;
+	// }}}
+
+	if (opts) {
+		// Adjust the baud interval, and pick the gap that follows
+		// {{{
+		if (opts->m_baud_jitter > 0) {
+			baud_counts += (int)(rand32(rng)
+				% (2*opts->m_baud_jitter+1))
+				- (int)opts->m_baud_jitter;
+		}
+
+		gap = opts->m_gap;
+		if (opts->m_gap_jitter > 0)
+			gap += rand32(rng) % (opts->m_gap_jitter+1);
+		// }}}
+	} if (baud_counts < 1)
+		baud_counts = 1;
+
+	// The bits to send after the start bit, LSB first, exactly as the
+	// UARTSIM builds its m_tx_data
+	// {{{
+	v = ch & ((1<<nbits)-1);
+	if (nparity) {
+		int	p;
+
+		if (fixdp)
+			p = evenp;
+		else {
+			p = v;
+			p = p ^ (p>>4);
+			p = p ^ (p>>2);
+			p = p ^ (p>>1);
+			p &= 1;
+			p ^= !evenp;
+		}
+		v |= (p<<nbits);
+	}
+	v |= ((1<<nstop)-1) << (nbits+nparity);
+	// }}}
+
+	// The start bit
+	runs[nruns].m_level  = 0;
+	runs[nruns++].m_clocks = baud_counts;
+
+	for(int k=0; k<nsam; k++) {
+		unsigned	b = (v >> k)&1;
+
+		if (runs[nruns-1].m_level == b)
+			runs[nruns-1].m_clocks += baud_counts;
+		else {
+			runs[nruns].m_level  = b;
+			runs[nruns++].m_clocks = baud_counts;
+		}
+	}
+
+	// The last stop bit is always high, so any gap just extends it
+	runs[nruns-1].m_clocks += gap;
+
+	return nruns;
+}
+// }}}
+
+// uartwave_encode_runs
+// {{{
+size_t	uartwave_encode_runs(const char *buf, size_t len, unsigned setup,
+		UARTWAVERUN *runs, size_t maxruns, const UARTWAVEOPTS *opts) {
+	UARTWAVERUN	cr[MAXCHARRUNS];
+	uint32_t	rng = (opts) ? opts->m_seed : 0;
+	size_t		nruns = 0;
+
+	if (rng == 0)
+		rng = 1;
+
+	// Every character starts low and ends high, so runs never need to be
+	// merged from one character to the next
+	for(size_t i=0; i<len; i++) {
+		int	n = char_runs(buf[i], setup, opts, rng, cr);
+
+		if (runs) {
+			if (nruns + n > maxruns)
+				break;
+			for(int k=0; k<n; k++)
+				runs[nruns+k] = cr[k];
+		}
+
+		nruns += n;
+	}
+
+	return nruns;
+}
+// }}}
+
+// uartwave_encode
+// {{{
+uint64_t uartwave_encode(const char *buf, size_t len, unsigned setup,
+		uint64_t *samples, uint64_t maxsamples,
+		const UARTWAVEOPTS *opts) {
+	UARTWAVERUN	cr[MAXCHARRUNS];
+	uint32_t	rng = (opts) ? opts->m_seed : 0;
+	uint64_t	posn = 0;
+
+	if (rng == 0)
+		rng = 1;
+
+	for(size_t i=0; i<len; i++) {
+		int		n = char_runs(buf[i], setup, opts, rng, cr);
+		uint64_t	clocks = 0;
+
+		for(int k=0; k<n; k++)
+			clocks += cr[k].m_clocks;
+
+		if (!samples) {
+			posn += clocks;
+			continue;
+		} else if (posn + clocks > maxsamples)
+			break;
+
+		for(int k=0; k<n; k++) {
+			uint64_t	end = posn + cr[k].m_clocks;
+
+			// Fill this run in, a word at a time where possible
+			// {{{
+			while(posn < end) {
+				uint64_t	wd = posn >> 6, mask;
+				unsigned	lo = posn & 63, nb;
+
+				nb = ((end - posn) < (uint64_t)(64-lo))
+					? (unsigned)(end - posn) : 64-lo;
+				mask = ((nb == 64) ? ~0ull : ((1ull << nb)-1))
+					<< lo;
+				if (lo == 0)
+					samples[wd] = 0;
+				if (cr[k].m_level)
+					samples[wd] |= mask;
+				else
+					samples[wd] &= ~mask;
+				posn += nb;
+			}
+			// }}}
+		}
+	}
+
+	return posn;
+}
+// }}}
@@ -0,0 +1,207 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	uartwave.h
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Converts between whole UART waveforms and the bytes they carry,
+//		rather than working one clock at a time as the UARTSIM does.
+//
+//	Waveforms are packed one sample (i.e. one clock) per bit, least
+//	significant bit first, into 64-bit words.  Sample number k is therefore
+//	found in bit (k&63) of word (k>>6).  This is the same as a capture of
+//	o_uart_tx, taken one bit per clock.
+//
+//	The setup word has the same layout as for the UARTSIM::setup() call.
+//
+//	uartwave_decode(samples, nsamples, setup, out, maxout, posn)
+//		Decodes nsamples worth of captured waveform into at most maxout
+//		characters.  Each character is returned in the low order bits
+//		of out[], together with the UARTWAVE_PERR and UARTWAVE_FERR
+//		flags.  If posn is given, the sample number of each character's
+//		start bit is placed there.  Returns the number of characters
+//		decoded.  Characters are sampled at exactly the same times the
+//		UARTSIM would sample them:  one and a half baud intervals after
+//		the falling edge of the start bit, and every baud interval
+//		thereafter.  Only the search through the long idle periods
+//		between characters is vectorized:  whole idle words are skipped
+//		four at a time with AVX2 (build with make SIMD=avx2), or two at
+//		a time with SSE2 (any x86-64 build), or else one at a time.
+//		Finding the falling edge within a word, and pulling out the
+//		mid-bit samples, are always scalar.
+//
+//	uartwave_encode_runs(buf, len, setup, runs, maxruns, opts)
+//		The reverse.  Encodes len characters from buf into a list of
+//		runs, each a level and the number of clocks it lasts, and
+//		returns the number of runs.  If runs is NULL, nothing is
+//		written, but the number of runs required is still returned.
+//		Each character produces at most 1+nbits+nparity+nstop runs.
+//
+//	uartwave_encode(buf, len, setup, samples, maxsamples, opts)
+//		As above, but produces a packed waveform (the same format the
+//		decoder takes) and returns the number of samples.  Again, if
+//		samples is NULL, only the length is returned.
+//
+//	Both encoders produce characters just as the UARTSIM (and txuart.v)
+//	would, with the extra options of idle gaps between characters and
+//	of a baud interval that varies randomly from one character to the
+//	next, as given by a UARTWAVEOPTS structure.  The same opts (including
+//	the seed) always produce the same waveform.
+//
+//	UARTWAVEPLAYER
+//		Replays a list of runs into a simulation, one clock per call,
+//		and can skip whole runs at a time as the UARTSIM can.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	UARTWAVE_H
+#define	UARTWAVE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Flags returned with each decoded character
+#define	UARTWAVE_PERR	0x0100	// The parity bit was wrong
+#define	UARTWAVE_FERR	0x0200	// A stop bit was low
+
+// UARTWAVERUN
+// {{{
+// A stretch of constant line level, lasting m_clocks clocks
+typedef	struct	{
+	uint32_t	m_level, m_clocks;
+} UARTWAVERUN;
+// }}}
+
+// UARTWAVEOPTS
+// {{{
+typedef	struct	{
+	// Idle clocks after every character, plus a random number of up to
+	// m_gap_jitter more
+	unsigned	m_gap, m_gap_jitter;
+	// Each character's baud interval is chosen at random within
+	// +/- m_baud_jitter clocks of that given by the setup
+	unsigned	m_baud_jitter;
+	// The seed for the random numbers above
+	unsigned	m_seed;
+} UARTWAVEOPTS;
+// }}}
+
+extern	size_t	uartwave_decode(const uint64_t *samples, uint64_t nsamples,
+			unsigned setup, uint16_t *out, size_t maxout,
+			uint64_t *posn = NULL);
+
+extern	size_t	uartwave_encode_runs(const char *buf, size_t len,
+			unsigned setup, UARTWAVERUN *runs, size_t maxruns,
+			const UARTWAVEOPTS *opts = NULL);
+
+extern	uint64_t uartwave_encode(const char *buf, size_t len,
+			unsigned setup, uint64_t *samples, uint64_t maxsamples,
+			const UARTWAVEOPTS *opts = NULL);
+
+// UARTWAVEPLAYER
+// {{{
+// Usage:
+//	n = uartwave_encode_runs(msg, len, setup, runs, maxruns);
+//	UARTWAVEPLAYER	player(runs, n);
+//	...
+//	Every clock:
+//		tb->i_uart_rx = player();
+//
+//	Or, to skip over long runs of constant level:
+//		n = player.next_event_clocks();
+//		(advance the simulation n clocks)
+//		player.skip(n);
+//
+// The line is idle (high) once the runs are exhausted.
+class	UARTWAVEPLAYER {
+	const UARTWAVERUN	*m_runs;
+	size_t		m_nruns, m_run;
+	uint32_t	m_left;
+public:
+	UARTWAVEPLAYER(const UARTWAVERUN *runs, size_t nruns)
+		: m_runs(runs), m_nruns(nruns), m_run(0),
+		m_left((nruns > 0) ? runs[0].m_clocks : 0) {}
+
+	// done(void)
+	// {{{
+	// True once every run has been played
+	bool	done(void) const { return (m_run >= m_nruns); }
+	// }}}
+
+	// level(void)
+	// {{{
+	// The level on this clock, without advancing
+	int	level(void) const {
+		return (m_run < m_nruns) ? m_runs[m_run].m_level : 1; }
+	// }}}
+
+	// next_event_clocks(void)
+	// {{{
+	// The number of clocks, including this one, before the level may
+	// change.  All ones (-1) when done.
+	uint32_t next_event_clocks(void) const {
+		return (m_run < m_nruns) ? m_left : -1; }
+	// }}}
+
+	// skip(nclocks)
+	// {{{
+	void	skip(uint64_t nclocks) {
+		while((nclocks > 0)&&(m_run < m_nruns)) {
+			if (nclocks < m_left) {
+				m_left -= nclocks;
+				return;
+			}
+
+			nclocks -= m_left;
+			m_run++;
+			m_left = (m_run < m_nruns) ? m_runs[m_run].m_clocks : 0;
+		}
+	}
+	// }}}
+
+	// operator()(void)
+	// {{{
+	// Returns the level for this clock, and advances to the next
+	int	operator()(void) {
+		int	v = level();
+
+		if ((m_run < m_nruns)&&(--m_left == 0)) {
+			m_run++;
+			m_left = (m_run < m_nruns) ? m_runs[m_run].m_clocks : 0;
+		}
+
+		return v;
+	}
+	// }}}
+};
+// }}}
+
+#endif
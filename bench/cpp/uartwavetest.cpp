@@ -0,0 +1,565 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	uartwavetest.cpp
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Checks the uartwave routines across every framing the UART
+//		supports and several baud rates.
+//
+//	First, uartwave_decode() is checked against the UARTSIM's own receiver.
+//	For each combination, three waveforms are captured, one bit per clock:
+//	a message as sent by a UARTSIM, the same message as sent by a UARTSIM
+//	impaired with edge jitter and glitches (so that there are parity and
+//	framing errors to find), and random noise with long idle stretches
+//	(so that breaks, runt start bits, and the skipping of whole idle words
+//	all get exercised).  Each waveform is then fed, clock by clock, into a
+//	second UARTSIM, and decoded by uartwave_decode().  Both must find the
+//	same characters, with the same errors, in the same order.
+//
+//	Second, the encoders and the UARTWAVEPLAYER.  The message is encoded
+//	both as runs and as a packed waveform, plain, with random idle gaps, and
+//	with baud jitter as well.  The two encodings must agree, sample for
+//	sample, and decode back into the message, with no errors, each start
+//	bit on a falling edge.  The same options must give the same runs again,
+//	and another seed different ones.  A UARTWAVEPLAYER must then play the
+//	runs back into the same samples, whether one clock at a time, from one
+//	next_event_clocks() to the next, or skip()ing by random amounts.
+//
+//	No Verilated design is needed.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "uartsim.h"
+#include "uartwave.h"
+
+#define	MAXCHARS	4096
+
+// Every framing:  4 data widths, 5 parity modes, and 2 stop bit settings
+#define	NFRAMINGS	(4*5*2)
+
+void	usage(void) {
+// {{{
+	fprintf(stderr, "USAGE: uartwavetest [-s <seed>] [-v]\n");
+	fprintf(stderr, "\n"
+"\tChecks uartwave_decode() against the UARTSIM's receiver, across every\n"
+"\tframing and several baud rates, on clean, impaired, and noisy lines.\n"
+"\tThen checks that the encoders and the UARTWAVEPLAYER agree with each\n"
+"\tother, and with the decoder.\n"
+"\n"
+"\t-s <seed>\tSeeds the impairments and the noise.  (Default: 1)\n"
+"\t-v\tReports every waveform checked, not just the failures\n\n");
+}
+// }}}
+
+// framing_bits(k), framing_name(bits, str)
+// {{{
+// Returns bits [29:24] of the setup word for framing number k
+static unsigned	framing_bits(unsigned k) {
+	static const unsigned	parity[5] = { 0, 4, 5, 6, 7 };
+	unsigned	width = k / 10, par = (k/2) % 5, stop = k & 1;
+
+	return (width << 28) | (stop << 27) | (parity[par] << 24);
+}
+
+// Describes a framing in the usual form, as in 8N1 or 7E2
+static void	framing_name(unsigned bits, char *str) {
+	static const char	pname[8] = { 'N', 'N', 'N', 'N', 'O', 'E', 'S', 'M' };
+
+	sprintf(str, "%d%c%d", 8-((bits >> 28)&3), pname[(bits >> 24)&7],
+		((bits >> 27)&1)+1);
+}
+// }}}
+
+// rand32(state)
+// {{{
+static uint32_t	rand32(uint32_t &state) {
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+// }}}
+
+// char_clocks(setup)
+// {{{
+// Clocks per character:  start bit, data bits, parity, and stop bits
+static unsigned	char_clocks(unsigned setup) {
+	unsigned	nsam = 8-((setup >> 28)&3) + ((setup >> 26)&1)
+				+ ((setup >> 27)&1)+1;
+
+	return (setup & 0x0ffffff) * (1+nsam);
+}
+// }}}
+
+// put_sample(samples, k, v)
+// {{{
+static inline void	put_sample(uint64_t *samples, uint64_t k, int v) {
+	if (v)
+		samples[k>>6] |=  (1ull << (k&63));
+	else
+		samples[k>>6] &= ~(1ull << (k&63));
+}
+// }}}
+
+// capture(setup, msg, len, impaired, seed, samples, maxsamples)
+// {{{
+// Sends msg from a UARTSIM, optionally impaired, and captures its transmit
+// wire until everything has been sent and the line has been idle for a few
+// character times.  Returns the number of samples captured.
+static uint64_t	capture(unsigned setup, const char *msg, int len,
+		bool impaired, uint32_t seed, uint64_t *samples,
+		uint64_t maxsamples) {
+	UARTSIMT<LOOPTRANSPORT>	uart(msg, len, (char *)NULL, 0);
+	uint64_t	k = 0, idle = 0, tail = 4 * char_clocks(setup);
+
+	uart.setup(setup);
+	if (impaired)
+		uart.impair(0, (setup & 0x0ffffff)/8, 50000, 1, seed);
+
+	while(k < maxsamples) {
+		int	v = uart(1);
+
+		put_sample(samples, k++, v);
+		idle = (v) ? idle+1 : 0;
+		if (((int)uart.tx_chars() >= len)&&(idle >= tail))
+			break;
+	}
+
+	return k;
+}
+// }}}
+
+// noise(setup, seed, samples, nsamples)
+// {{{
+// Fills nsamples with random runs of either level, anywhere from one clock
+// to a few bits long, and now and then a long idle stretch.  The waveform
+// starts and ends idle, so the UARTSIM's receiver starts and finishes in the
+// same state the decoder assumes.
+static void	noise(unsigned setup, uint32_t &seed, uint64_t *samples,
+		uint64_t nsamples) {
+	unsigned	baud = setup & 0x0ffffff, tail = 4 * char_clocks(setup);
+	uint64_t	k = 0, end = nsamples - tail;
+	int		level = 1;
+
+	while(k < end) {
+		uint64_t	n;
+
+		if ((level)&&((rand32(seed) & 7) == 0))
+			n = 1 + rand32(seed) % 2000;
+		else
+			n = 1 + rand32(seed) % (3*baud);
+		if (k == 0)
+			n += tail;
+		for(uint64_t j=0; (j<n)&&(k<end); j++)
+			put_sample(samples, k++, level);
+		level ^= 1;
+	}
+
+	while(k < nsamples)
+		put_sample(samples, k++, 1);
+}
+// }}}
+
+// receive(setup, samples, nsamples, out, maxout)
+// {{{
+// Feeds a captured waveform into a UARTSIM's receiver, one clock at a time,
+// and returns what it found in the same form as uartwave_decode() does.
+static size_t	receive(unsigned setup, const uint64_t *samples,
+		uint64_t nsamples, uint16_t *out, size_t maxout) {
+	UARTSIMT<LOOPTRANSPORT>	uart("", 0, (char *)NULL, 0);
+	unsigned long	nchars = 0, perrs = 0, ferrs = 0;
+	size_t		nout = 0;
+
+	uart.setup(setup);
+	for(uint64_t k=0; k<nsamples; k++) {
+		uart((samples[k>>6] >> (k&63))&1);
+
+		if (uart.rx_chars() != nchars) {
+			unsigned	flags = 0;
+
+			if (uart.rx_parity_errors() != perrs)
+				flags |= UARTWAVE_PERR;
+			if (uart.rx_frame_errors() != ferrs)
+				flags |= UARTWAVE_FERR;
+			if (nout < maxout)
+				out[nout++] = uart.rx_last_char() | flags;
+
+			nchars = uart.rx_chars();
+			perrs  = uart.rx_parity_errors();
+			ferrs  = uart.rx_frame_errors();
+		}
+	}
+
+	return nout;
+}
+// }}}
+
+// compare(name, samples, nsamples, setup, verbose)
+// {{{
+// Decodes the waveform both ways, and reports whether the two agree
+static bool	compare(const char *name, const uint64_t *samples,
+		uint64_t nsamples, unsigned setup, bool verbose) {
+	static uint16_t	expected[MAXCHARS], decoded[MAXCHARS];
+	size_t		nexp, ndec, nerr = 0;
+	char		fname[8];
+	bool		pass;
+
+	framing_name(setup, fname);
+	nexp = receive(setup, samples, nsamples, expected, MAXCHARS);
+	ndec = uartwave_decode(samples, nsamples, setup, decoded, MAXCHARS);
+
+	pass = (nexp == ndec);
+	for(size_t k=0; (k<nexp)&&(k<ndec); k++) {
+		if (expected[k] & (UARTWAVE_PERR|UARTWAVE_FERR))
+			nerr++;
+		if ((pass)&&(expected[k] != decoded[k])) {
+			printf("%-7s @ %5u: %-8s character %zu: UARTSIM 0x%03x, decoded 0x%03x\n",
+				fname, setup & 0x0ffffff, name, k,
+				expected[k], decoded[k]);
+			pass = false;
+		}
+	}
+
+	if ((pass)&&(!verbose))
+		return true;
+
+	printf("%-7s @ %5u: %-8s %6lu samples, %4zu characters (%zu with errors), decoded %4zu: %s\n",
+		fname, setup & 0x0ffffff, name, (unsigned long)nsamples,
+		nexp, nerr, ndec, (pass) ? "PASS" : "FAIL");
+	return pass;
+}
+// }}}
+
+// sample(samples, k)
+// {{{
+static inline int	sample(const uint64_t *samples, uint64_t k) {
+	return (samples[k>>6] >> (k&63))&1;
+}
+// }}}
+
+// playback(runs, nruns, samples, nsamples, seed)
+// {{{
+// Plays the runs back three ways, and returns NULL if every one of them gives
+// the same samples as uartwave_encode() did, or else a description of the
+// first that didn't
+static const char *playback(const UARTWAVERUN *runs, size_t nruns,
+		const uint64_t *samples, uint64_t nsamples, uint32_t &seed) {
+	uint64_t	posn;
+
+	// One clock at a time
+	// {{{
+	{
+		UARTWAVEPLAYER	player(runs, nruns);
+
+		for(posn=0; posn<nsamples; posn++)
+			if (player() != sample(samples, posn))
+				return "player() doesn't match the samples";
+		if ((!player.done())||(player() != 1)
+				||(player.next_event_clocks() != (uint32_t)-1))
+			return "player() isn't idle once done";
+	}
+	// }}}
+
+	// From one event to the next
+	// {{{
+	{
+		UARTWAVEPLAYER	player(runs, nruns);
+
+		posn = 0;
+		while(!player.done()) {
+			uint32_t	n = player.next_event_clocks();
+			int		v = player.level();
+
+			// The level must hold for all n clocks, and then
+			// change, since the encoder merges runs of one level
+			if ((n == 0)||(posn + n > nsamples)
+					||(v != sample(samples, posn))
+					||(v != sample(samples, posn+n-1))
+					||((posn+n < nsamples)
+					  &&(v == sample(samples, posn+n))))
+				return "next_event_clocks() doesn't match the samples";
+			player.skip(n);
+			posn += n;
+		}
+
+		if (posn != nsamples)
+			return "next_event_clocks() doesn't add up to the samples";
+	}
+	// }}}
+
+	// skip()ing by random amounts, across runs
+	// {{{
+	{
+		UARTWAVEPLAYER	player(runs, nruns);
+		uint32_t	span = (nruns > 0) ? 3*runs[0].m_clocks : 1;
+
+		posn = 0;
+		while(posn < nsamples) {
+			uint64_t	n = rand32(seed) % span;
+
+			if (posn + n >= nsamples)
+				n = nsamples - posn - 1;
+			player.skip(n);
+			posn += n;
+			if (player() != sample(samples, posn++))
+				return "skip() doesn't match the samples";
+		}
+
+		player.skip(1000);
+		if ((!player.done())||(player.level() != 1))
+			return "skip() isn't idle once done";
+	}
+	// }}}
+
+	return NULL;
+}
+// }}}
+
+// roundtrip(name, setup, msg, len, opts, seed, verbose)
+// {{{
+// Encodes msg, both as runs and as a packed waveform, and checks both against
+// each other, the decoder, and the player
+static bool	roundtrip(const char *name, unsigned setup, const char *msg,
+		int len, const UARTWAVEOPTS *opts, uint32_t &seed,
+		bool verbose) {
+	const unsigned	nsam = 8-((setup >> 28)&3) + ((setup >> 26)&1)
+				+ ((setup >> 27)&1)+1;
+	const unsigned	mask = (1u << (8-((setup >> 28)&3)))-1;
+	const char	*err = NULL;
+	UARTWAVERUN	*runs, *again;
+	uint64_t	*samples, *posn, nsamples, k;
+	uint16_t	*decoded;
+	size_t		nruns, ndec = 0;
+	char		fname[8];
+
+	framing_name(setup, fname);
+
+	// Encode the message, after first asking how much room it needs
+	// {{{
+	nruns    = uartwave_encode_runs(msg, len, setup, NULL, 0, opts);
+	nsamples = uartwave_encode(msg, len, setup, NULL, 0, opts);
+
+	runs    = new UARTWAVERUN[nruns];
+	again   = new UARTWAVERUN[nruns];
+	samples = new uint64_t[(nsamples+63)/64];
+	decoded = new uint16_t[len+1];
+	posn    = new uint64_t[len+1];
+
+	if (nruns > (size_t)len * (1+nsam))
+		err = "too many runs";
+	else if (uartwave_encode_runs(msg, len, setup, runs, nruns, opts)
+			!= nruns)
+		err = "encode_runs() came up short";
+	else if (uartwave_encode(msg, len, setup, samples, nsamples, opts)
+			!= nsamples)
+		err = "encode() came up short";
+	// }}}
+
+	// The runs must add up to the samples
+	// {{{
+	k = 0;
+	for(size_t r=0; (!err)&&(r<nruns); r++) {
+		if ((runs[r].m_clocks == 0)
+				||((r > 0)&&(runs[r].m_level == runs[r-1].m_level)))
+			err = "runs aren't merged";
+		for(uint32_t j=0; (!err)&&(j<runs[r].m_clocks); j++)
+			if ((k >= nsamples)
+				||((unsigned)sample(samples, k++) != runs[r].m_level))
+				err = "the runs and samples don't agree";
+	} if ((!err)&&(k != nsamples))
+		err = "the runs and samples aren't the same length";
+	// }}}
+
+	// Decode the samples back into the message
+	// {{{
+	if (!err) {
+		ndec = uartwave_decode(samples, nsamples, setup, decoded, len+1,
+				posn);
+		if (ndec != (size_t)len)
+			err = "decoded the wrong number of characters";
+		for(size_t c=0; (!err)&&(c<ndec); c++) {
+			if (decoded[c] != (msg[c] & mask))
+				err = "decoded the wrong character";
+			else if (((c > 0)&&(posn[c] <= posn[c-1]))
+					||(sample(samples, posn[c]) != 0)
+					||((posn[c] > 0)
+					  &&(sample(samples, posn[c]-1) != 1)))
+				err = "a start bit isn't on a falling edge";
+		}
+	}
+	// }}}
+
+	// The same options must give the same runs, another seed different
+	// ones (so long as there's some randomness to them)
+	// {{{
+	if ((!err)&&(opts)) {
+		UARTWAVEOPTS	other = *opts;
+
+		if ((uartwave_encode_runs(msg, len, setup, again, nruns, opts)
+				!= nruns)
+				||(memcmp(runs, again, nruns*sizeof(runs[0])) != 0))
+			err = "the same seed gave different runs";
+
+		other.m_seed++;
+		if ((!err)&&((opts->m_gap_jitter > 0)||(opts->m_baud_jitter > 0))
+				&&(uartwave_encode_runs(msg, len, setup, again,
+					nruns, &other) == nruns)
+				&&(memcmp(runs, again, nruns*sizeof(runs[0])) == 0))
+			err = "another seed gave the same runs";
+	}
+	// }}}
+
+	if (!err)
+		err = playback(runs, nruns, samples, nsamples, seed);
+
+	if ((err)||(verbose))
+		printf("%-7s @ %5u: %-8s %6lu samples, %4zu runs, decoded %4zu: %s%s\n",
+			fname, setup & 0x0ffffff, name,
+			(unsigned long)nsamples, nruns, ndec,
+			(err) ? "FAIL, " : "PASS", (err) ? err : "");
+
+	delete[] runs;
+	delete[] again;
+	delete[] samples;
+	delete[] decoded;
+	delete[] posn;
+
+	return (err == NULL);
+}
+// }}}
+
+int	main(int argc, char **argv) {
+	const char	*msg = "This is a UART testing string\r\n"
+			"\x00\x01\x7f\x80\xaa\x55\xfe\xff";
+	const unsigned	bauds[] = { 3, 8, 25 };
+	const unsigned	nbauds = sizeof(bauds)/sizeof(bauds[0]);
+	const int	len = 32+8;
+	uint32_t	seed = 1;
+	unsigned	nchecks = 0, npass = 0;
+	uint64_t	*samples, maxsamples;
+	bool		verbose = false;
+
+	// Argument processing
+	// {{{
+	for(int argn=1; argn<argc; argn++) {
+		if ((strcmp(argv[argn], "-s") == 0)&&(argn+1 < argc)) {
+			seed = strtoul(argv[++argn], NULL, 0);
+			if (seed == 0)
+				seed = 1;
+		} else if (strcmp(argv[argn], "-v") == 0) {
+			verbose = true;
+		} else {
+			usage();
+			exit(EXIT_FAILURE);
+		}
+	}
+	// }}}
+
+	// Room enough for the message at the slowest baud rate, twice over
+	maxsamples = 2 * (uint64_t)(len+8) * 12 * bauds[nbauds-1];
+	samples = new uint64_t[(maxsamples+63)/64];
+
+	for(unsigned f=0; f<NFRAMINGS; f++)
+	for(unsigned b=0; b<nbauds; b++) {
+		unsigned	setup = framing_bits(f) | bauds[b];
+		uint64_t	n;
+
+		// A clean line, as sent by the UARTSIM
+		n = capture(setup, msg, len, false, 0, samples, maxsamples);
+		nchecks++;
+		if (compare("clean", samples, n, setup, verbose))
+			npass++;
+
+		// An impaired one, with parity and framing errors on it
+		n = capture(setup, msg, len, true, seed++, samples, maxsamples);
+		nchecks++;
+		if (compare("impaired", samples, n, setup, verbose))
+			npass++;
+
+		// Noise
+		noise(setup, seed, samples, maxsamples);
+		nchecks++;
+		if (compare("noise", samples, maxsamples, setup, verbose))
+			npass++;
+	}
+
+	delete[] samples;
+
+	// Now the encoders, and the player
+	// {{{
+	for(unsigned f=0; f<NFRAMINGS; f++) {
+		UARTWAVEOPTS	opts;
+
+		for(unsigned b=0; b<nbauds; b++) {
+			unsigned	setup = framing_bits(f) | bauds[b];
+
+			nchecks++;
+			if (roundtrip("plain", setup, msg, len, NULL, seed,
+					verbose))
+				npass++;
+
+			opts.m_gap = 2*bauds[b];
+			opts.m_gap_jitter = 3*bauds[b];
+			opts.m_baud_jitter = 0;
+			opts.m_seed = seed++;
+			nchecks++;
+			if (roundtrip("gaps", setup, msg, len, &opts, seed,
+					verbose))
+				npass++;
+		}
+
+		// Baud jitter, small enough that every bit is still sampled
+		// within the bit it belongs to.  The decoder starts looking
+		// for the next start bit half a (nominal) bit into it, so with
+		// no gap, an 8E2 character and the start bit after it (13
+		// bits in all) may come up short by no more than half a bit:
+		// 13*3 < 100/2
+		opts.m_gap = 0;
+		opts.m_gap_jitter = 50;
+		opts.m_baud_jitter = 3;
+		opts.m_seed = seed++;
+		nchecks++;
+		if (roundtrip("jitter", framing_bits(f) | 100, msg, len, &opts,
+				seed, verbose))
+			npass++;
+	}
+	// }}}
+
+	printf("\n%u of %u checks passed\n%s\n",
+		npass, nchecks, (npass == nchecks) ? "PASS" : "FAIL");
+
+	return (npass == nchecks) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,501 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	wbmodeltest.cpp
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	Runs the same firmware, an echo loop, against both the wbuart
+//		RTL (a Verilated wbuart.v, with a UARTSIM on its line) and the
+//	C++ wbuart model of wbuartmodel.h, and checks the one against the other.
+//	Each is sent the same block of bytes by its host.  The firmware reads
+//	each byte from the receive register, and writes it back to the transmit
+//	register as soon as the FIFO register says there's room, until its host
+//	has them all back again.
+//
+//	Since both run the same firmware, through the same registers, they
+//	should see the same bytes at nearly the same times.  The clock at which
+//	the firmware read each byte, and at which the host got each back, are
+//	recorded from each, and compared:  the bytes must match, the host must
+//	get back exactly what it sent, and the two times must agree to within
+//	a tolerance.  The report then gives how fast each ran.
+//
+//	Options:
+//		-s <setup>	The setup word.  Bit 30 is set, since the
+//				UARTSIM here doesn't watch RTS.  (Default: 25,
+//				8N1)
+//		-n <nbytes>	How many bytes to send (Default: 256)
+//		-p		Use packed access, reading up to three bytes,
+//				and writing up to four, at a time
+//		-i		Wait on the receive and transmit interrupts,
+//				rather than polling the FIFO register
+//		-d <clocks>	The firmware's clocks between polls, or after
+//				each interrupt (Default: 16)
+//		-t <chars>	The tolerance, in character times (Default: 2)
+//		-m		Run the model alone, with nothing to check
+//				it against
+//		-r		Run the RTL alone
+//
+//	The result is a report, ending in PASS or FAIL.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <verilatedos.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "verilated.h"
+#include "Vwbuart.h"
+#include "testb.h"
+#include "wbuartmodel.h"
+
+// ECHOLOG
+// {{{
+// What one run of the firmware saw:  the bytes it read, the clock it read
+// each at, the clock its host got each back at, and what the run cost
+struct	ECHOLOG {
+	std::vector<char>		m_data;
+	std::vector<unsigned long>	m_read_at, m_echo_at;
+	unsigned long			m_clocks;
+	double				m_seconds;
+	bool				m_done;
+};
+// }}}
+
+// MODELBUS
+// {{{
+// The firmware's view of the wbuart model.  Each bus access takes the same
+// two clocks it does on the RTL, with its effect half way through.
+class	MODELBUS {
+	WBUARTMODELT<LOOPTRANSPORT>	m_uart;
+	unsigned long			m_origin;
+public:
+	MODELBUS(const char *msg, int nbytes, char *reply)
+		: m_uart(msg, nbytes, reply, nbytes), m_origin(0) {
+		// As ../verilog builds Vwbuart, with OPT_PACKED set
+		m_uart.parameters(25, 0, true, true);
+	}
+
+	// The setup is written before the first clock, since the host would
+	// otherwise start sending just in time for it to reset the receiver
+	void	begin(unsigned setup) {
+		m_uart.flush_threshold(1);
+		m_uart.write(UART_SETUP, setup);
+		m_origin = m_uart.clocks();
+	}
+
+	unsigned	read(unsigned addr) {
+		unsigned	v;
+
+		m_uart.advance(1);
+		v = m_uart.read(addr);
+		m_uart.advance(1);
+		return v;
+	}
+
+	void	write(unsigned addr, unsigned data, unsigned sel = 0x0f) {
+		m_uart.advance(1);
+		m_uart.write(addr, data, sel);
+		m_uart.advance(1);
+	}
+
+	void	idle(unsigned long nclocks) { m_uart.advance(nclocks); }
+	void	wait(unsigned mask, unsigned long maxclocks) {
+		m_uart.wait_interrupt(mask, maxclocks); }
+
+	unsigned long	now(void) const { return m_uart.clocks() - m_origin; }
+	int	received(void) { return m_uart.host().received(); }
+	void	close(void) { m_uart.kill(); }
+};
+// }}}
+
+// RTLBUS
+// {{{
+// The same, for the Verilated wbuart.v, through its Wishbone port.  Until
+// begin() is over, only the design is clocked, so that the UARTSIM doesn't
+// start sending before the receiver is ready.
+class	RTLBUS {
+	TESTB<Vwbuart, UARTSIMT<LOOPTRANSPORT> >	m_tb;
+	unsigned long	m_origin;
+	bool		m_ready;
+
+	void	step(void) {
+		if (m_ready)
+			m_tb.tick();
+		else
+			m_tb.clock();
+	}
+public:
+	RTLBUS(const char *msg, int nbytes, char *reply)
+		: m_tb(msg, nbytes, reply, nbytes), m_origin(0),
+		m_ready(false) {}
+
+	void	begin(unsigned setup) {
+		m_tb.m_uart.setup(setup);
+		m_tb.m_uart.flush_threshold(1);
+
+		m_tb.m_core.i_wb_cyc = 0;
+		m_tb.m_core.i_wb_stb = 0;
+		m_tb.m_core.i_uart_rx = 1;
+		m_tb.m_core.i_cts_n = 0;
+		m_tb.m_core.i_reset = 1;
+		for(int k=0; k<4; k++)
+			m_tb.clock();
+		m_tb.m_core.i_reset = 0;
+
+		write(UART_SETUP, setup);
+		for(unsigned k=0; k<(setup & 0x0ffffff)*24; k++)
+			m_tb.clock();
+		m_ready = true;
+		m_origin = m_tb.clocks();
+	}
+
+	// access(addr, we, data, sel)
+	// {{{
+	// One Wishbone transaction:  the request is held until it isn't
+	// stalled, and then the cycle until it is acknowledged
+	unsigned	access(unsigned addr, bool we, unsigned data,
+			unsigned sel) {
+		bool	stalled;
+
+		m_tb.m_core.i_wb_cyc  = 1;
+		m_tb.m_core.i_wb_stb  = 1;
+		m_tb.m_core.i_wb_we   = (we) ? 1 : 0;
+		m_tb.m_core.i_wb_addr = addr & 3;
+		m_tb.m_core.i_wb_data = data;
+		m_tb.m_core.i_wb_sel  = sel;
+		do {
+			stalled = m_tb.m_core.o_wb_stall;
+			step();
+		} while(stalled);
+		m_tb.m_core.i_wb_stb = 0;
+
+		while(!m_tb.m_core.o_wb_ack)
+			step();
+		m_tb.m_core.i_wb_cyc = 0;
+		return m_tb.m_core.o_wb_data;
+	}
+	// }}}
+
+	unsigned	read(unsigned addr) { return access(addr, false, 0, 0x0f); }
+	void	write(unsigned addr, unsigned data, unsigned sel = 0x0f) {
+		access(addr, true, data, sel); }
+
+	void	idle(unsigned long nclocks) {
+		for(unsigned long k=0; k<nclocks; k++)
+			step();
+	}
+
+	unsigned	interrupts(void) const {
+		return ((m_tb.m_core.o_uart_rx_int) ? WBUARTMODEL_RXINT : 0)
+			| ((m_tb.m_core.o_uart_tx_int) ? WBUARTMODEL_TXINT : 0)
+			| ((m_tb.m_core.o_uart_rxfifo_int)
+				? WBUARTMODEL_RXFIFOINT : 0)
+			| ((m_tb.m_core.o_uart_txfifo_int)
+				? WBUARTMODEL_TXFIFOINT : 0);
+	}
+
+	void	wait(unsigned mask, unsigned long maxclocks) {
+		for(unsigned long k=0; (k<maxclocks)
+				&&((interrupts() & mask) == 0); k++)
+			step();
+	}
+
+	unsigned long	now(void) const { return m_tb.clocks() - m_origin; }
+	int	received(void) {
+		m_tb.sync(); return m_tb.m_uart.host().received(); }
+	void	close(void) { m_tb.close(); }
+};
+// }}}
+
+// seconds(void)
+// {{{
+static double	seconds(void) {
+	struct timespec	ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+// }}}
+
+// echo(bus, setup, ...)
+// {{{
+// The firmware.  Everything read is echoed, in order, and every byte's times
+// are logged.
+template <class BUS> void	echo(BUS &bus, unsigned setup, unsigned nbytes,
+		bool packed, bool irq, unsigned delay, unsigned long maxclocks,
+		ECHOLOG &log) {
+	double		start = seconds();
+	unsigned	nsent = 0;
+	int		nback = 0;
+
+	bus.begin(setup | ((packed) ? 0x80000000 : 0));
+
+	while(((log.m_data.size() < nbytes)||(nsent < log.m_data.size()))
+			&&(bus.now() < maxclocks)) {
+		unsigned	v, n;
+
+		if (irq)
+			bus.wait(WBUARTMODEL_RXINT | ((nsent < log.m_data.size())
+				? WBUARTMODEL_TXINT : 0), maxclocks - bus.now());
+
+		// Read whatever has arrived
+		// {{{
+		do {
+			v = bus.read(UART_RXREG);
+			n = (packed) ? (v >> 30) : ((v & 0x100) ? 0 : 1);
+			for(unsigned k=0; k<n; k++) {
+				log.m_data.push_back((char)(v >> (8*k)));
+				log.m_read_at.push_back(bus.now());
+			}
+		} while((irq)&&(n > 0));
+		// }}}
+
+		// Echo as much as there's room for
+		// {{{
+		while(nsent < log.m_data.size()) {
+			unsigned	fifo = bus.read(UART_FIFO), room;
+
+			if ((fifo & 0x10000) == 0)
+				break;
+			room = (fifo >> 18) & 0x03ff;
+			if (!packed)
+				room = 1;
+			else if (room > 4)
+				room = 4;
+			if (room > log.m_data.size() - nsent)
+				room = log.m_data.size() - nsent;
+
+			unsigned	word = 0;
+			for(unsigned k=0; k<room; k++)
+				word |= (log.m_data[nsent+k] & 0x0ff) << (8*k);
+			bus.write(UART_TXREG, word, (1u << room)-1);
+			nsent += room;
+		}
+		// }}}
+
+		for(int r = bus.received(); nback < r; nback++)
+			log.m_echo_at.push_back(bus.now());
+		bus.idle(delay);
+	}
+
+	// Then wait for the last of it to get back to the host
+	while((nback < (int)nbytes)&&(bus.now() < maxclocks)) {
+		bus.idle(delay + 1);
+		for(int r = bus.received(); nback < r; nback++)
+			log.m_echo_at.push_back(bus.now());
+	}
+
+	log.m_done    = (nback >= (int)nbytes);
+	log.m_clocks  = bus.now();
+	bus.close();
+	log.m_seconds = seconds() - start;
+}
+// }}}
+
+// check(name, log, msg, reply, nbytes, mask)
+// {{{
+// Checks one run on its own:  every byte read, and echoed, as sent
+static bool	check(const char *name, const ECHOLOG &log, const char *msg,
+		const char *reply, unsigned nbytes, unsigned mask) {
+	bool	pass = log.m_done;
+
+	if (!log.m_done)
+		printf("%-6s Ran out of clocks, with %u bytes read and %u "
+			"echoed\n", name, (unsigned)log.m_data.size(),
+			(unsigned)log.m_echo_at.size());
+	for(unsigned k=0; (pass)&&(k<nbytes); k++) {
+		if ((k >= log.m_data.size())||(((log.m_data[k] ^ msg[k]) & mask)
+				!= 0)) {
+			printf("%-6s Byte %u read as 0x%02x, not 0x%02x\n", name,
+				k, (k < log.m_data.size())
+				? (log.m_data[k] & 0x0ff) : 0, msg[k] & mask);
+			pass = false;
+		} else if (((reply[k] ^ msg[k]) & mask) != 0) {
+			printf("%-6s Byte %u echoed as 0x%02x, not 0x%02x\n",
+				name, k, reply[k] & mask, msg[k] & mask);
+			pass = false;
+		}
+	}
+
+	return pass;
+}
+// }}}
+
+// compare(what, rtl, model, tolerance)
+// {{{
+// The scoreboard:  each byte's time in the model must be within tolerance
+// of its time in the RTL.  Returns the worst difference, or -1 on failure.
+static long	compare(const char *what,
+		const std::vector<unsigned long> &rtl,
+		const std::vector<unsigned long> &model, unsigned long tolerance) {
+	long	worst = 0;
+
+	if (rtl.size() != model.size()) {
+		printf("MISMATCH: %u bytes %s by the RTL, %u by the model\n",
+			(unsigned)rtl.size(), what, (unsigned)model.size());
+		return -1;
+	}
+
+	for(unsigned k=0; k<rtl.size(); k++) {
+		long	d = (long)model[k] - (long)rtl[k];
+
+		if ((unsigned long)labs(d) > tolerance) {
+			printf("MISMATCH: Byte %u %s at clock %lu by the RTL, "
+				"but %lu by the model\n", k, what,
+				rtl[k], model[k]);
+			return -1;
+		}
+		if (labs(d) > worst)
+			worst = labs(d);
+	}
+
+	return worst;
+}
+// }}}
+
+// report(name, log)
+// {{{
+static void	report(const char *name, const ECHOLOG &log) {
+	printf("%-6s %10lu clocks in %8.3fs, %14.0f clocks/s\n", name,
+		log.m_clocks, log.m_seconds,
+		(log.m_seconds > 0) ? log.m_clocks / log.m_seconds : 0.0);
+}
+// }}}
+
+int	main(int argc, char **argv) {
+	Verilated::commandArgs(argc, argv);
+	unsigned	setup = 25, nbytes = 256, delay = 16, tolerance = 2,
+			char_clocks, mask;
+	unsigned long	maxclocks;
+	bool		packed = false, irq = false, run_rtl = true,
+			run_model = true, pass = true;
+	char		*msg, *rtl_reply, *model_reply;
+	ECHOLOG		rtl, model;
+
+	// Argument processing
+	// {{{
+	for(int argn=1; argn<argc; argn++) {
+		if (argv[argn][0] == '-') for(int j=1; (j<1000)&&(argv[argn][j]); j++)
+		switch(argv[argn][j]) {
+			case 's':
+				setup = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'n':
+				nbytes = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'd':
+				delay = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 't':
+				tolerance = strtoul(argv[++argn], NULL, 0); j+= 4000;
+				break;
+			case 'p':
+				packed = true;
+				break;
+			case 'i':
+				irq = true;
+				break;
+			case 'm':
+				run_rtl = false;
+				break;
+			case 'r':
+				run_model = false;
+				break;
+			default:
+				printf("Undefined option, -%c\n", argv[argn][j]);
+				break;
+		}
+	}
+	// }}}
+
+	setup = (setup & 0x3fffffff) | 0x40000000;
+	if ((nbytes == 0)||((!run_rtl)&&(!run_model))) {
+		fprintf(stderr, "ERR: Bad -n, or both -m and -r\n");
+		exit(EXIT_FAILURE);
+	}
+
+	char_clocks = (setup & 0x0ffffff) * (2 + (8-((setup>>28)&3))
+				+ ((setup>>26)&1) + ((setup>>27)&1));
+	mask = (1u << (8-((setup>>28)&3))) - 1;
+	maxclocks = 4ul * (nbytes + 16) * (char_clocks + 8 * (delay + 8));
+
+	msg         = new char[nbytes];
+	rtl_reply   = new char[nbytes];
+	model_reply = new char[nbytes];
+	for(unsigned k=0; k<nbytes; k++)
+		msg[k] = (char)(k * 13 + 5);
+	memset(rtl_reply,   0, nbytes);
+	memset(model_reply, 0, nbytes);
+
+	printf("Setup 0x%08x, %u bytes, %s, %s every %u clocks\n",
+		setup, nbytes, (packed) ? "packed" : "unpacked",
+		(irq) ? "interrupt driven" : "polled", delay);
+
+	if (run_rtl) {
+		RTLBUS	bus(msg, nbytes, rtl_reply);
+
+		echo(bus, setup, nbytes, packed, irq, delay, maxclocks, rtl);
+		pass = check("RTL", rtl, msg, rtl_reply, nbytes, mask) && pass;
+		report("RTL", rtl);
+	}
+
+	if (run_model) {
+		MODELBUS	bus(msg, nbytes, model_reply);
+
+		echo(bus, setup, nbytes, packed, irq, delay, maxclocks, model);
+		pass = check("Model", model, msg, model_reply, nbytes, mask)
+				&& pass;
+		report("Model", model);
+	}
+
+	if ((run_rtl)&&(run_model)&&(pass)) {
+		unsigned long	tol = tolerance * (unsigned long)char_clocks;
+		long		wread, wecho;
+
+		wread = compare("read", rtl.m_read_at, model.m_read_at, tol);
+		wecho = compare("echoed", rtl.m_echo_at, model.m_echo_at, tol);
+		if ((wread < 0)||(wecho < 0))
+			pass = false;
+		else
+			printf("Model within %ld clocks of the RTL on reads, "
+				"%ld on echoes (tolerance %lu), %.0fx faster\n",
+				wread, wecho, tol, (model.m_seconds > 0)
+				? rtl.m_seconds / model.m_seconds : 0.0);
+	}
+
+	delete[] msg;
+	delete[] rtl_reply;
+	delete[] model_reply;
+
+	printf("%s\n", (pass) ? "PASS" : "FAIL");
+	exit((pass) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -0,0 +1,867 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	wbuartmodel.h
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	A C++ model of the wbuart, as seen from the bus, for running
+//		firmware against something much faster than a Verilated
+//	wbuart and a UARTSIM.  It offers the same four registers, with the same
+//	bits in them, as wbuart.v:
+//
+//		UART_SETUP	The setup register, and the packed mode bit
+//		UART_FIFO	The status of both FIFOs, and (on write) the
+//				receive threshold and idle timeout
+//		UART_RXREG	The receive FIFO, and its error flags
+//		UART_TXREG	The transmit FIFO, break, and line status
+//
+//	Each FIFO is modelled as ufifo.v builds it: 2^LGFLEN entries, of which
+//	2^LGFLEN-1 may be used, reporting its fill, half full, and available
+//	flags in the same status word.  The four interrupts, hardware flow
+//	control, packed access, breaks, and the reset bits all follow the RTL.
+//
+//	Nothing is simulated by the bit.  Instead, each character takes the
+//	character time the setup register gives it (fractional baud rates
+//	included), and is handed to the host through the same transports the
+//	UARTSIM uses, whole, once its last stop bit has been sent.  Characters
+//	from the host are likewise written into the receive FIFO midway through
+//	their first stop bit, just as rxuart.v would, as often as a UARTSIM
+//	would send them:  one character time, and one idle clock, apart.
+//	Between such events the model does nothing at all, so advance() costs
+//	the same whether it is asked for one clock or a million.  Timing is
+//	within a few clocks of the RTL, rather than exact.
+//
+//	What can't be known without the line itself reads back as the line
+//	would if nothing were wrong with it:  the receiver sees no parity or
+//	framing errors, nor any breaks, the line levels in the transmit
+//	register read as idle (unless sending a break), and the FIFO error
+//	bits (which the RTL only sets for the one clock of an overflow) read
+//	as zero.  Overflows are counted instead.
+//
+//	Usage:
+//		WBUARTMODELT<LOOPTRANSPORT>	uart(msg, n, reply, n);
+//		...
+//		uart.write(UART_SETUP, setup);
+//		while(!done) {
+//			unsigned v = uart.read(UART_RXREG);
+//			...
+//			uart.advance(clocks);	// However long the CPU took
+//		}
+//
+//	or, to wait on an interrupt as a CPU would,
+//
+//		uart.wait_interrupt(WBUARTMODEL_RXINT, maxclocks);
+//
+//	WBUARTMODEL is the model on a UARTSIM's port transport:  stdin and
+//	stdout, or a TCP/IP port, just as the UARTSIM would use.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	WBUARTMODEL_H
+#define	WBUARTMODEL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <utility>
+
+#include "uartsim.h"
+
+// The register addresses, as in wbuart.v
+#define	UART_SETUP	0
+#define	UART_FIFO	1
+#define	UART_RXREG	2
+#define	UART_TXREG	3
+
+// The interrupts, as bits of interrupts() and wait_interrupt()'s mask
+#define	WBUARTMODEL_RXINT	1	// o_uart_rx_int
+#define	WBUARTMODEL_TXINT	2	// o_uart_tx_int
+#define	WBUARTMODEL_RXFIFOINT	4	// o_uart_rxfifo_int
+#define	WBUARTMODEL_TXFIFOINT	8	// o_uart_txfifo_int
+
+// UFIFOMODEL<LGFLEN>
+// {{{
+// One ufifo.v.  As in the RTL, one entry is always left empty, so at most
+// 2^LGFLEN-1 bytes may be held, and a reset only moves the pointers--so that
+// the data read from an empty FIFO is whatever its memory last held there.
+template <int LGFLEN>
+class	UFIFOMODEL {
+public:
+	static const unsigned	FLEN = (1u << LGFLEN);
+private:
+	unsigned char	m_mem[FLEN];
+	unsigned	m_rd, m_wr;
+public:
+	UFIFOMODEL(void) : m_rd(0), m_wr(0) { memset(m_mem, 0, FLEN); }
+
+	void	reset(void) { m_rd = m_wr = 0; }
+	unsigned	fill(void) const { return (m_wr - m_rd) & (FLEN-1); }
+	bool	empty(void) const { return (m_rd == m_wr); }
+	bool	full(void) const { return (fill() == FLEN-1); }
+	unsigned	head(void) const { return m_mem[m_rd]; }
+
+	// push(ch) returns false, dropping ch, if the FIFO is full
+	bool	push(unsigned ch) {
+		if (full())
+			return false;
+		m_mem[m_wr] = ch;
+		m_wr = (m_wr + 1) & (FLEN-1);
+		return true;
+	}
+
+	void	pop(void) {
+		if (!empty())
+			m_rd = (m_rd + 1) & (FLEN-1);
+	}
+
+	// status(rxfifo)
+	// {{{
+	// The o_status word:  the log of the size, the fill (in units of
+	// 2^(LGFLEN-10) for FIFOs deeper than 2^10), the half full bit, and
+	// whether a read (receive FIFO) or a write (transmit FIFO) would
+	// succeed.  The transmit FIFO's fill is the number of empty entries.
+	unsigned	status(bool rxfifo) const {
+		unsigned	r_fill, w_fill;
+
+		r_fill = (rxfifo) ? fill() : (FLEN-1) - fill();
+		w_fill = (LGFLEN > 10) ? (r_fill >> (LGFLEN-10)) : r_fill;
+		return (LGFLEN << 12) | (w_fill << 2)
+			| (((r_fill >> (LGFLEN-1))&1) << 1)
+			| ((rxfifo) ? (!empty()) : (!full()));
+	}
+	// }}}
+};
+// }}}
+
+// WBUARTMODELT<TRANSPORT, LGFLEN>
+// {{{
+// A wbuart.v, built with LGFLEN, connected to the host by TRANSPORT.  The
+// constructor passes its arguments on to the transport's constructor, as
+// UARTSIMT's does.  Its other parameters default to those of wbuart.v, and
+// may be changed with parameters().
+template <class TRANSPORT, int LGFLEN = 4>
+class	WBUARTMODELT {
+	static_assert((LGFLEN >= 2)&&(LGFLEN <= 15),
+		"wbuart FIFOs must be between 2^2 and 2^15 entries");
+public:
+	static const unsigned	FLEN = (1u << LGFLEN);
+protected:
+	// Member declarations
+	// {{{
+	// The connection to the host
+	TRANSPORT	m_host;
+
+	// The wbuart's parameters
+	unsigned	m_initial_setup, m_lgfrac;
+	bool		m_hw_flow, m_opt_packed;
+
+	// Registers:  the setup, packed mode, the receive threshold and idle
+	// timeout, the parity error flag, the break, and the last byte written
+	// to the transmit register.  m_cts_n is the i_cts_n input.
+	unsigned	m_setup, m_threshold, m_timeout, m_tx_last;
+	bool		m_packed, m_rx_perr, m_tx_break;
+	int		m_cts_n;
+
+	// The FIFOs, and the packed receive buffer
+	UFIFOMODEL<LGFLEN>	m_rxf, m_txf;
+	unsigned	m_rxp_data, m_rxp_count;
+
+	// The time, in clocks
+	unsigned long	m_clocks;
+
+	// The transmitter.  While busy, m_tx_char finishes at m_tx_done.
+	bool		m_tx_busy;
+	unsigned	m_tx_char;
+	unsigned long	m_tx_done;
+
+	// The receiver.  While busy, m_rx_char is written into the receive
+	// FIFO at m_rx_stb (unless m_rx_strobed says it has been, or that it
+	// has been lost to a reset), and the next character may start at
+	// m_rx_free.
+	bool		m_rx_busy, m_rx_strobed;
+	unsigned	m_rx_char;
+	unsigned long	m_rx_stb, m_rx_free;
+
+	// Fractions of a clock, carried from one character to the next when
+	// the baud rate has m_lgfrac fractional bits
+	unsigned	m_tx_phase, m_rx_phase;
+
+	// The idle timeout counts the baud intervals, starting from
+	// m_baud_origin, since m_idle_from
+	unsigned long	m_baud_origin, m_idle_from;
+
+	// Host I/O, batched just as the UARTSIM batches it.  The host is
+	// checked for more to send once every character time, at m_poll_at,
+	// and output is sent once m_flush_size bytes have accumulated, or at
+	// m_flush_at.
+	char		m_ibuf[UARTSIM_BUFLEN], m_obuf[UARTSIM_BUFLEN];
+	unsigned	m_ihead, m_itail, m_olen;
+	unsigned	m_flush_size, m_flush_clocks;
+	unsigned long	m_poll_at, m_flush_at;
+
+	// Counts
+	unsigned long	m_rx_chars, m_tx_chars, m_rx_overflows, m_tx_overflows;
+	// }}}
+
+	// Protected methods
+	// {{{
+	// The framing, and times, given by the setup register
+	unsigned	baud_field(void) const { return m_setup & 0x0ffffff; }
+	unsigned	nbits(void) const { return 8-((m_setup >> 28)&3); }
+	unsigned	nparity(void) const { return (m_setup >> 26)&1; }
+	unsigned	nstop(void) const { return ((m_setup >> 27)&1)+1; }
+	unsigned	data_mask(void) const { return (1u << nbits())-1; }
+	unsigned	baud_clocks(void) const {
+		unsigned b = baud_field() >> m_lgfrac; return (b > 0) ? b : 1; }
+	unsigned	char_clocks(void) const {
+		unsigned c = (baud_field() * (1+nbits()+nparity()+nstop()))
+				>> m_lgfrac;
+		return (c > 0) ? c : 1; }
+
+	// frac_clocks(x, phase) converts x, in clocks times 2^m_lgfrac, into
+	// whole clocks, carrying the fraction left over in phase
+	unsigned	frac_clocks(unsigned long x, unsigned &phase) const {
+		unsigned long	v = x + phase;
+		unsigned	c;
+
+		phase = v & ((1u << m_lgfrac)-1);
+		c = v >> m_lgfrac;
+		return (c > 0) ? c : 1;
+	}
+
+	// Hardware flow control:  whether it is on, the o_rts_n output
+	// holding off the host, and the i_cts_n input holding off the
+	// transmitter
+	bool	flow_control(void) const {
+		return (m_hw_flow)&&(((m_setup >> 30)&1) == 0); }
+	bool	tx_held(void) const { return (flow_control())&&(m_cts_n); }
+
+	// The receive FIFO interrupt's two halves
+	bool	rx_waiting(void) const {
+		return (!m_rxf.empty())||(m_rxp_count > 0); }
+	unsigned	rx_idle(void) const;
+	unsigned long	timeout_at(void) const;
+
+	void	rx_reset(void);
+	void	tx_reset(void);
+	void	rxp_refill(void);
+
+	// host_read() fills the input buffer from the host, host_write()
+	// empties the output buffer to it, and host_put() adds one byte to
+	// the output buffer
+	void	host_read(void);
+	void	host_write(void);
+	void	host_put(const char ch);
+
+	// next_event() is the clock of the next thing that will happen, and
+	// process() does everything that is due to happen by now
+	unsigned long	next_event(void) const;
+	void		process(void);
+	// }}}
+public:
+	// Public member functions
+	// {{{
+
+	// WBUARTMODELT(args...)
+	// {{{
+	template <typename... ARGS>	WBUARTMODELT(ARGS&&... args)
+			: m_host(std::forward<ARGS>(args)...),
+			m_initial_setup(25), m_lgfrac(0), m_hw_flow(true),
+			m_opt_packed(false), m_clocks(0) {
+		m_flush_size = UARTSIM_BUFLEN;
+		m_flush_clocks = 0;
+		m_rx_chars = m_tx_chars = 0;
+		m_rx_overflows = m_tx_overflows = 0;
+		m_cts_n = 0;
+		reset();
+	}
+	// }}}
+
+	// host(void)
+	// {{{
+	TRANSPORT	&host(void) { return m_host; }
+	// }}}
+
+	// parameters(initial_setup, lgfrac, hw_flow, opt_packed)
+	// {{{
+	// Matches a wbuart built with INITIAL_SETUP, LGFRAC,
+	// HARDWARE_FLOW_CONTROL_PRESENT, and OPT_PACKED set to these.  The
+	// model is then reset.
+	void	parameters(unsigned initial_setup, unsigned lgfrac = 0,
+			bool hw_flow = true, bool opt_packed = false) {
+		m_initial_setup = initial_setup & 0x7fffffff;
+		m_lgfrac = (lgfrac > 15) ? 15 : lgfrac;
+		m_hw_flow = hw_flow;
+		m_opt_packed = opt_packed;
+		reset();
+	}
+	// }}}
+
+	// reset(void)
+	// {{{
+	// As for i_reset, or on power up:  the setup returns to its initial
+	// value, and everything else is cleared.  The clock keeps counting.
+	void	reset(void);
+	// }}}
+
+	// read(addr), write(addr, data, sel)
+	// {{{
+	// A bus read or write of one register, with all of its side effects,
+	// but taking no time--the bus's own clocks are up to the caller.  read()
+	// returns what o_wb_data would.  sel is the byte select, i_wb_sel.
+	unsigned	read(unsigned addr);
+	void		write(unsigned addr, unsigned data, unsigned sel = 0x0f);
+	// }}}
+
+	// advance(nclocks)
+	// {{{
+	// Runs the UART, and its host, forward by nclocks.
+	void	advance(unsigned long nclocks);
+	// }}}
+
+	// next_event_clocks(void)
+	// {{{
+	// The number of clocks that may pass before anything will change, as
+	// seen either from the bus or by the host, or -1 if nothing will until
+	// the bus does something.  The idle timeout is included only when it
+	// is about to set the receive FIFO interrupt.
+	unsigned long	next_event_clocks(void) const;
+	// }}}
+
+	// interrupts(void), wait_interrupt(mask, maxclocks)
+	// {{{
+	// interrupts() returns the four interrupt outputs, as WBUARTMODEL_*
+	// bits.  wait_interrupt() advances until any interrupt in mask is set,
+	// or maxclocks have passed, from one event to the next, and returns
+	// the number of clocks it took.
+	unsigned	interrupts(void) const;
+	unsigned long	wait_interrupt(unsigned mask, unsigned long maxclocks);
+	// }}}
+
+	// rts_n(void), cts_n(v)
+	// {{{
+	// The o_rts_n output:  high once the receive FIFO is within two bytes
+	// of full, and flow control is on.  The model's host honors it,
+	// sending nothing new while it is high.  cts_n() sets the i_cts_n
+	// input, holding the transmitter off between characters while high.
+	int	rts_n(void) const {
+		return (flow_control())&&(m_rxf.fill() > FLEN-3); }
+	void	cts_n(int v) { m_cts_n = (v) ? 1 : 0; }
+	// }}}
+
+	// flush(void), flush_threshold(nbytes, clocks), kill(void)
+	// {{{
+	// As for the UARTSIM:  output is sent to the host once nbytes (default
+	// UARTSIM_BUFLEN) have been collected, once its first byte has waited
+	// clocks (default sixty four character times), by flush(), or by
+	// kill(), which then closes the transport.
+	void	flush(void) { host_write(); }
+	void	flush_threshold(unsigned nbytes, unsigned clocks = 0) {
+		m_flush_size = ((nbytes == 0)||(nbytes > UARTSIM_BUFLEN))
+				? UARTSIM_BUFLEN : nbytes;
+		m_flush_clocks = clocks;
+		if (m_olen >= m_flush_size)
+			host_write();
+	}
+	void	kill(void) { host_write(); fflush(stdout); m_host.close(); }
+	// }}}
+
+	// clocks(), rx_chars(), tx_chars(), rx_overflows(), tx_overflows()
+	// {{{
+	// The clocks run so far, the characters received from the host and
+	// sent to it, and the bytes lost to a full receive FIFO or written
+	// to a full transmit FIFO
+	unsigned long	clocks(void) const { return m_clocks; }
+	unsigned long	rx_chars(void) const { return m_rx_chars; }
+	unsigned long	tx_chars(void) const { return m_tx_chars; }
+	unsigned long	rx_overflows(void) const { return m_rx_overflows; }
+	unsigned long	tx_overflows(void) const { return m_tx_overflows; }
+	// }}}
+	// }}}
+};
+// }}}
+
+// WBUARTMODEL
+// {{{
+// The model, on the UARTSIM's own choice of stdin/stdout (port zero) or a
+// TCP/IP port, with the wbuart's default FIFO size
+class	WBUARTMODEL : public WBUARTMODELT<PORTTRANSPORT> {
+public:
+	WBUARTMODEL(const int port, const bool multi = false,
+			const bool threaded = false)
+		: WBUARTMODELT<PORTTRANSPORT>(port, multi, threaded) {}
+};
+
+// This one is compiled once, in wbuartmodel.cpp
+extern template class WBUARTMODELT<PORTTRANSPORT>;
+// }}}
+
+// WBUARTMODELT::reset
+// {{{
+template <class TRANSPORT, int LGFLEN>
+void	WBUARTMODELT<TRANSPORT, LGFLEN>::reset(void) {
+	m_setup = m_initial_setup | ((m_hw_flow) ? 0 : 0x40000000);
+	m_packed = false;
+	m_threshold = m_timeout = 0;
+	m_tx_last = 0;
+	m_tx_break = false;
+	m_tx_busy = false;
+	m_tx_phase = m_rx_phase = 0;
+	m_baud_origin = m_clocks;
+	tx_reset();
+	rx_reset();
+	m_rx_busy = false;
+	m_ihead = m_itail = 0;
+	m_olen = 0;
+	m_poll_at = m_flush_at = m_clocks;
+}
+// }}}
+
+// WBUARTMODELT::rx_reset
+// {{{
+// The receiver, its FIFO, the packed buffer, and the error flags.  Any
+// character on its way in is lost.
+template <class TRANSPORT, int LGFLEN>
+void	WBUARTMODELT<TRANSPORT, LGFLEN>::rx_reset(void) {
+	m_rxf.reset();
+	m_rxp_data = m_rxp_count = 0;
+	m_rx_perr = false;
+	m_rx_strobed = true;
+	m_idle_from = m_clocks;
+}
+// }}}
+
+// WBUARTMODELT::tx_reset
+// {{{
+// Only the transmit FIFO.  As in the RTL, any character already started is
+// still sent.
+template <class TRANSPORT, int LGFLEN>
+void	WBUARTMODELT<TRANSPORT, LGFLEN>::tx_reset(void) {
+	m_txf.reset();
+}
+// }}}
+
+// WBUARTMODELT::rxp_refill
+// {{{
+// In packed mode, the RTL moves bytes from the receive FIFO to the packed
+// buffer one per clock--far faster than any bus could read them, so here
+// they are moved all at once.
+template <class TRANSPORT, int LGFLEN>
+void	WBUARTMODELT<TRANSPORT, LGFLEN>::rxp_refill(void) {
+	if (!m_packed)
+		return;
+	while((m_rxp_count < 3)&&(!m_rxf.empty())) {
+		m_rxp_data |= m_rxf.head() << (8*m_rxp_count);
+		m_rxf.pop();
+		m_rxp_count++;
+	}
+}
+// }}}
+
+// WBUARTMODELT::rx_idle
+// {{{
+// The number of ticks of the (free running) baud counter since the idle count
+// was last cleared, saturating at sixteen bits as rx_idle does
+template <class TRANSPORT, int LGFLEN>
+unsigned	WBUARTMODELT<TRANSPORT, LGFLEN>::rx_idle(void) const {
+	unsigned long	b = baud_clocks(), n;
+
+	n = (m_clocks - m_baud_origin) / b - (m_idle_from - m_baud_origin) / b;
+	return (n > 0x0ffff) ? 0x0ffff : (unsigned)n;
+}
+// }}}
+
+// WBUARTMODELT::timeout_at
+// {{{
+// The clock at which the idle timeout will set the receive FIFO interrupt,
+// assuming nothing else happens first
+template <class TRANSPORT, int LGFLEN>
+unsigned long	WBUARTMODELT<TRANSPORT, LGFLEN>::timeout_at(void) const {
+	unsigned long	b = baud_clocks();
+
+	return m_baud_origin
+		+ ((m_idle_from - m_baud_origin) / b + m_timeout) * b;
+}
+// }}}
+
+// WBUARTMODELT::host_read
+// {{{
+template <class TRANSPORT, int LGFLEN>
+void	WBUARTMODELT<TRANSPORT, LGFLEN>::host_read(void) {
+	int	nr;
+
+	nr = m_host.read(m_ibuf, UARTSIM_BUFLEN);
+	m_itail = 0;
+	m_ihead = (nr > 0) ? nr : 0;
+	if (m_ihead == 0)
+		m_poll_at = m_clocks + char_clocks();
+}
+// }}}
+
+// WBUARTMODELT::host_write
+// {{{
+template <class TRANSPORT, int LGFLEN>
+void	WBUARTMODELT<TRANSPORT, LGFLEN>::host_write(void) {
+	if (m_olen > 0)
+		m_host.write(m_obuf, m_olen);
+	m_olen = 0;
+}
+// }}}
+
+// WBUARTMODELT::host_put
+// {{{
+template <class TRANSPORT, int LGFLEN>
+void	WBUARTMODELT<TRANSPORT, LGFLEN>::host_put(const char ch) {
+	if (!m_host.connected())
+		return;
+	if (m_olen == 0)
+		m_flush_at = m_clocks + ((m_flush_clocks > 0) ? m_flush_clocks
+				: 64ul * char_clocks());
+	m_obuf[m_olen++] = ch;
+	if (m_olen >= m_flush_size)
+		host_write();
+}
+// }}}
+
+// WBUARTMODELT::read(addr)
+// {{{
+template <class TRANSPORT, int LGFLEN>
+unsigned	WBUARTMODELT<TRANSPORT, LGFLEN>::read(unsigned addr) {
+	unsigned	v, rxs, txs;
+
+	switch(addr & 3) {
+	case UART_SETUP:
+		return ((m_packed) ? 0x80000000 : 0) | m_setup;
+	case UART_FIFO:
+		rxs = m_rxf.status(true);
+		txs = m_txf.status(false);
+		return (txs << 16) | (rxs & 0x0fffc)
+			| (((interrupts() & WBUARTMODEL_RXFIFOINT) ? 1:0) << 1)
+			| (rxs & 1);
+	case UART_RXREG:
+		if (m_packed) {
+			v = (m_rxp_count << 30)
+				| ((m_rx_perr) ? (1u << 25) : 0)
+				| ((m_rxp_count == 0) ? (1u << 24) : 0)
+				| m_rxp_data;
+			m_rxp_data = m_rxp_count = 0;
+			rxp_refill();
+		} else {
+			v = ((m_rx_perr) ? 0x200 : 0)
+				| ((m_rxf.empty()) ? 0x100 : 0)
+				| m_rxf.head();
+			m_rxf.pop();
+		}
+		m_idle_from = m_clocks;
+		return v;
+	default: // UART_TXREG
+		txs = m_txf.status(false);
+		v = (m_cts_n << 15) | ((txs & 3) << 13)
+			// ck_uart, the receive line, always reads as idle
+			| 0x800
+			| ((m_tx_break) ? 0x200 : 0x400);
+		if ((m_tx_busy)||(txs & 1))
+			v |= 0x100 | m_tx_last;
+		return v;
+	}
+}
+// }}}
+
+// WBUARTMODELT::write(addr, data, sel)
+// {{{
+template <class TRANSPORT, int LGFLEN>
+void	WBUARTMODELT<TRANSPORT, LGFLEN>::write(unsigned addr, unsigned data,
+		unsigned sel) {
+	bool	treset = false;
+
+	switch(addr & 3) {
+	case UART_SETUP:
+		// {{{
+		for(int k=0; k<3; k++)
+			if (sel & (1<<k))
+				m_setup = (m_setup & ~(0x0ffu << (8*k)))
+					| (data & (0x0ffu << (8*k)));
+		if (sel & 8) {
+			m_setup = (m_setup & 0x0ffffff) | (data & 0x7f000000);
+			if (!m_hw_flow)
+				m_setup |= 0x40000000;
+			m_packed = (m_opt_packed)&&((data >> 31)&1);
+		}
+		// Any write here resets both FIFOs, and restarts the baud
+		// counter (to within a baud interval) at the new rate
+		rx_reset();
+		tx_reset();
+		m_baud_origin = m_clocks;
+		break;
+		// }}}
+	case UART_FIFO:
+		// {{{
+		if (sel & 1)
+			m_threshold = (m_threshold & 0x0ff00) | (data & 0x0ff);
+		if (sel & 2)
+			m_threshold = (m_threshold & 0x0ff) | (data & 0x0ff00);
+		if (sel & 4)
+			m_timeout = (m_timeout & 0x0ff00) | ((data >> 16)&0x0ff);
+		if (sel & 8)
+			m_timeout = (m_timeout & 0x0ff) | ((data >> 16)&0x0ff00);
+		break;
+		// }}}
+	case UART_RXREG:
+		// {{{
+		// Writing a one to bit 9 clears the parity error flag, while
+		// bit 12 resets the receiver
+		if (sel & 2) {
+			if (data & 0x200)
+				m_rx_perr = false;
+			if (data & 0x1000)
+				rx_reset();
+		}
+		break;
+		// }}}
+	default: // UART_TXREG
+		// {{{
+		m_tx_last = data & 0x0ff;
+		if (m_packed) {
+			// One byte per byte lane selected, bottom lane first
+			for(int k=0; k<4; k++)
+			if (sel & (1<<k)) {
+				if (!m_txf.push((data >> (8*k)) & 0x0ff))
+					m_tx_overflows++;
+			}
+			break;
+		}
+
+		if (sel & 2) {
+			m_tx_break = (data >> 9)&1;
+			treset = (data >> 12)&1;
+			if (treset)
+				tx_reset();
+			if (m_tx_break) {
+				// A break aborts whatever is being sent, and
+				// holds the transmit FIFO in reset
+				m_tx_busy = false;
+				tx_reset();
+			}
+		}
+
+		// The byte is lost to any reset of the FIFO it is going into
+		if ((sel & 1)&&(!treset)&&(!m_tx_break)) {
+			if (!m_txf.push(data & 0x0ff))
+				m_tx_overflows++;
+		}
+		break;
+		// }}}
+	}
+}
+// }}}
+
+// WBUARTMODELT::interrupts
+// {{{
+template <class TRANSPORT, int LGFLEN>
+unsigned	WBUARTMODELT<TRANSPORT, LGFLEN>::interrupts(void) const {
+	unsigned	r = 0, rxs = m_rxf.status(true), txs = m_txf.status(false),
+			rxlevel = m_rxf.fill() + m_rxp_count;
+	bool		level, tmo;
+
+	if ((rxs & 1)||(m_rxp_count > 0))
+		r |= WBUARTMODEL_RXINT;
+	if (txs & 1)
+		r |= WBUARTMODEL_TXINT;
+	if (txs & 2)
+		r |= WBUARTMODEL_TXFIFOINT;
+
+	// Bytes already moved into the packed buffer still count towards the
+	// threshold, and towards the half-full default
+	level = (m_threshold == 0) ? (rxlevel >= FLEN/2)
+			: (rxlevel >= m_threshold);
+	tmo = (m_timeout != 0)&&(rx_waiting())&&(rx_idle() >= m_timeout);
+	if ((level)||(tmo))
+		r |= WBUARTMODEL_RXFIFOINT;
+
+	return r;
+}
+// }}}
+
+// WBUARTMODELT::next_event
+// {{{
+template <class TRANSPORT, int LGFLEN>
+unsigned long	WBUARTMODELT<TRANSPORT, LGFLEN>::next_event(void) const {
+	unsigned long	t = -1;
+
+	// The transmitter
+	// {{{
+	if (m_tx_busy)
+		t = m_tx_done;
+	else if ((!m_txf.empty())&&(!tx_held()))
+		return m_clocks;
+	// }}}
+
+	// The receiver
+	// {{{
+	if (m_rx_busy) {
+		unsigned long	r = (m_rx_strobed) ? m_rx_free : m_rx_stb;
+		if (r < t)
+			t = r;
+	} else if (!rts_n()) {
+		// Nothing new is started towards us while RTS holds the host
+		// off
+		if (m_itail < m_ihead)
+			return m_clocks;
+		else if ((m_host.readable())&&(m_poll_at < t))
+			t = m_poll_at;
+	}
+	// }}}
+
+	if ((m_olen > 0)&&(m_flush_at < t))
+		t = m_flush_at;
+
+	return (t < m_clocks) ? m_clocks : t;
+}
+// }}}
+
+// WBUARTMODELT::process
+// {{{
+template <class TRANSPORT, int LGFLEN>
+void	WBUARTMODELT<TRANSPORT, LGFLEN>::process(void) {
+	// The transmitter
+	// {{{
+	if ((m_tx_busy)&&(m_tx_done <= m_clocks)) {
+		host_put(m_tx_char);
+		m_tx_chars++;
+		m_tx_busy = false;
+	}
+
+	if ((!m_tx_busy)&&(!m_txf.empty())&&(!tx_held())) {
+		m_tx_char = m_txf.head() & data_mask();
+		m_txf.pop();
+		m_tx_busy = true;
+		m_tx_done = m_clocks + frac_clocks((unsigned long)baud_field()
+				* (1+nbits()+nparity()+nstop()), m_tx_phase);
+	}
+	// }}}
+
+	// The receiver
+	// {{{
+	if ((m_rx_busy)&&(!m_rx_strobed)&&(m_rx_stb <= m_clocks)) {
+		m_rx_strobed = true;
+		if (m_rxf.push(m_rx_char))
+			rxp_refill();
+		else
+			m_rx_overflows++;
+		m_idle_from = m_clocks;
+	}
+
+	if ((m_rx_busy)&&(m_rx_strobed)&&(m_rx_free <= m_clocks))
+		m_rx_busy = false;
+
+	if ((!m_rx_busy)&&(!rts_n())) {
+		if ((m_itail >= m_ihead)&&(m_host.readable())
+				&&(m_poll_at <= m_clocks))
+			host_read();
+
+		if (m_itail < m_ihead) {
+			unsigned long	baud_x = baud_field();
+
+			// The character is written into the FIFO half way
+			// through its first stop bit.  The next may start one
+			// clock after its last stop bit is over, since that's
+			// when a UARTSIM would start it.
+			m_rx_char = m_ibuf[m_itail++] & data_mask();
+			m_rx_chars++;
+			m_rx_busy = true;
+			m_rx_strobed = false;
+			m_rx_stb = m_clocks + (((1+nbits()+nparity())*baud_x
+					+ baud_x/2) >> m_lgfrac);
+			m_rx_free = m_clocks + 1 + frac_clocks(baud_x
+				* (1+nbits()+nparity()+nstop()), m_rx_phase);
+			if (m_itail >= m_ihead)
+				m_poll_at = m_rx_free;
+		}
+	}
+	// }}}
+
+	if ((m_olen > 0)&&(m_flush_at <= m_clocks))
+		host_write();
+}
+// }}}
+
+// WBUARTMODELT::advance(nclocks)
+// {{{
+template <class TRANSPORT, int LGFLEN>
+void	WBUARTMODELT<TRANSPORT, LGFLEN>::advance(unsigned long nclocks) {
+	unsigned long	target = m_clocks + nclocks, t;
+
+	while((t = next_event()) <= target) {
+		m_clocks = t;
+		process();
+	}
+	m_clocks = target;
+}
+// }}}
+
+// WBUARTMODELT::next_event_clocks
+// {{{
+template <class TRANSPORT, int LGFLEN>
+unsigned long	WBUARTMODELT<TRANSPORT, LGFLEN>::next_event_clocks(void) const {
+	unsigned long	t = next_event();
+
+	if ((m_timeout != 0)&&(rx_waiting())&&(rx_idle() < m_timeout)) {
+		unsigned long	tmo = timeout_at();
+
+		if (tmo < t)
+			t = tmo;
+	}
+
+	return (t == (unsigned long)-1) ? t : t - m_clocks;
+}
+// }}}
+
+// WBUARTMODELT::wait_interrupt(mask, maxclocks)
+// {{{
+template <class TRANSPORT, int LGFLEN>
+unsigned long	WBUARTMODELT<TRANSPORT, LGFLEN>::wait_interrupt(unsigned mask,
+		unsigned long maxclocks) {
+	unsigned long	start = m_clocks, dt;
+
+	while(((interrupts() & mask) == 0)&&(m_clocks - start < maxclocks)) {
+		dt = next_event_clocks();
+		if (dt > maxclocks - (m_clocks - start))
+			dt = maxclocks - (m_clocks - start);
+		// With dt zero, this does whatever is due now
+		advance(dt);
+	}
+
+	return m_clocks - start;
+}
+// }}}
+
+#endif
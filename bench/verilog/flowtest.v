@@ -0,0 +1,202 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	flowtest.v
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	To test the wbuart's hardware flow control, and to measure how
+//		the depth of its FIFOs affects the rate it can sustain, by
+//	echoing everything it receives back out again--slowly.
+//
+//	A small bus master reads the receive FIFO once every i_drain clocks,
+//	and writes anything it finds back to the transmit FIFO (waiting, if
+//	need be, for room in it).  If i_drain is slower than the line, the
+//	receive FIFO fills, and the wbuart must hold the other end off with
+//	o_rts_n.  Likewise, the other end may hold the wbuart's transmitter
+//	off with i_cts_n.  If anything ever overflows the receive FIFO anyway,
+//	o_err is set, and stays set until the next reset.
+//
+//	Unlike the other tests here, this one has no use as a top level design
+//	on its own.  It's only meant for simulation.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory, run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+`default_nettype none
+// }}}
+module	flowtest #(
+		// {{{
+		// The log, base two, of the size of the wbuart's FIFOs
+		parameter [3:0]	LGFLEN = 4
+		// }}}
+	) (
+		// {{{
+		input	wire		i_clk, i_reset,
+		// The UART setup.  Bit 30 should be clear, to use hardware
+		// flow control.
+		input	wire	[30:0]	i_setup,
+		// How many clocks between reads of the receive FIFO
+		input	wire	[15:0]	i_drain,
+		input	wire		i_uart_rx,
+		output	wire		o_uart_tx,
+		input	wire		i_cts_n,
+		output	wire		o_rts_n,
+		output	reg		o_err
+		// }}}
+	);
+
+	// Signal declarations
+	// {{{
+	localparam [1:0]	UART_SETUP = 2'b00,
+				UART_RXREG = 2'b10,
+				UART_TXREG = 2'b11;
+	localparam [2:0]	S_SETUP = 3'h0,
+				S_WAIT  = 3'h1,
+				S_READ  = 3'h2,
+				S_POLL  = 3'h3,
+				S_WRITE = 3'h4;
+
+	reg		pwr_reset;
+	reg	[2:0]	state;
+	reg		wb_cyc, wb_stb, wb_we;
+	reg	[1:0]	wb_addr;
+	reg	[31:0]	wb_data;
+	reg	[15:0]	countdown;
+	reg	[7:0]	rx_byte;
+
+	wire		uart_stall, uart_ack;
+	wire	[31:0]	uart_data;
+
+	/* verilator lint_off UNUSED */
+	wire		ignored_rx_int, ignored_tx_int,
+			ignored_rxfifo_int, ignored_txfifo_int;
+	/* verilator lint_on UNUSED */
+	// }}}
+
+	// pwr_reset
+	// {{{
+	initial	pwr_reset = 1'b1;
+	always @(posedge i_clk)
+		pwr_reset <= i_reset;
+	// }}}
+
+	// The bus master
+	// {{{
+	// One request at a time.  S_SETUP writes the setup register, S_WAIT
+	// waits i_drain clocks, S_READ reads the receive FIFO.  If that found
+	// anything, S_POLL reads the transmit status until there's room in the
+	// transmit FIFO, and S_WRITE writes what was read into it.
+	initial	state  = S_SETUP;
+	initial	wb_cyc = 1'b0;
+	initial	wb_stb = 1'b0;
+	initial	o_err  = 1'b0;
+	always @(posedge i_clk)
+	if (pwr_reset)
+	begin
+		// {{{
+		state    <= S_SETUP;
+		wb_cyc   <= 1'b1;
+		wb_stb   <= 1'b1;
+		wb_we    <= 1'b1;
+		wb_addr  <= UART_SETUP;
+		wb_data  <= { 1'b0, i_setup };
+		countdown<= 16'h0;
+		o_err    <= 1'b0;
+		// }}}
+	end else begin
+		if (!uart_stall)
+			wb_stb <= 1'b0;
+		if (uart_ack)
+			wb_cyc <= 1'b0;
+
+		case(state)
+		S_SETUP: if (uart_ack)
+			begin
+			state     <= S_WAIT;
+			countdown <= i_drain;
+			end
+		S_WAIT: if (countdown != 16'h0)
+				countdown <= countdown - 1'b1;
+			else begin
+				// Read from the receive FIFO
+				state   <= S_READ;
+				wb_cyc  <= 1'b1;
+				wb_stb  <= 1'b1;
+				wb_we   <= 1'b0;
+				wb_addr <= UART_RXREG;
+			end
+		S_READ: if (uart_ack)
+			begin
+			// Bit 12 is the receive FIFO's overflow flag
+			if (uart_data[12])
+				o_err <= 1'b1;
+
+			if (uart_data[8])
+			begin
+				// Bit 8 set means the FIFO was empty
+				state     <= S_WAIT;
+				countdown <= i_drain;
+			end else begin
+				rx_byte <= uart_data[7:0];
+				state   <= S_POLL;
+				wb_cyc  <= 1'b1;
+				wb_stb  <= 1'b1;
+				wb_addr <= UART_TXREG;
+			end
+			end
+		S_POLL: if (uart_ack)
+			begin
+			// Bit 13 is set when the transmit FIFO isn't full
+			state   <= (uart_data[13]) ? S_WRITE : S_POLL;
+			wb_cyc  <= 1'b1;
+			wb_stb  <= 1'b1;
+			wb_we   <= uart_data[13];
+			wb_data <= { 24'h00, rx_byte };
+			end
+		S_WRITE: if (uart_ack)
+			begin
+			state     <= S_WAIT;
+			countdown <= i_drain;
+			end
+		default: state <= S_WAIT;
+		endcase
+	end
+	// }}}
+
+	// The unit under test
+	// {{{
+	wbuart	#(.INITIAL_SETUP(31'd25), .LGFLEN(LGFLEN),
+		.HARDWARE_FLOW_CONTROL_PRESENT(1'b1))
+	wbuarti(i_clk, pwr_reset,
+		wb_cyc, wb_stb, wb_we, wb_addr, wb_data, 4'hf,
+		uart_stall, uart_ack, uart_data,
+		i_uart_rx, o_uart_tx, i_cts_n, o_rts_n,
+		ignored_rx_int, ignored_tx_int,
+		ignored_rxfifo_int, ignored_txfifo_int);
+	// }}}
+endmodule
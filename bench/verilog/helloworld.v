@@ -170,6 +170,12 @@ module	helloworld #(
 	txuartlite
 		#(24'd868)
 		transmitter(i_clk, tx_stb, tx_data, o_uart_tx, tx_busy);
+
+	// Make Verilator happy
+	// Verilator lint_off UNUSED
+	wire	unused;
+	assign	unused = &{ 1'b0, i_setup, pwr_reset, tx_break, cts_n };
+	// Verilator lint_on  UNUSED
 `else
 	txuart	transmitter(i_clk, pwr_reset, i_setup, tx_break,
 			tx_stb, tx_data, cts_n, o_uart_tx, tx_busy);
@@ -64,11 +64,27 @@
 //
 `default_nettype none
 //
-module	linetest(
+module	linetest #(
+		// {{{
+		// The number of fractional bits in the baud rate, given to the
+		// full (not lite) UART
+		// Verilator lint_off UNUSED
+		parameter [3:0]	LGFRAC = 0
+		// Verilator lint_on  UNUSED
+		// }}}
+	) (
 		// {{{
 		input	wire	i_clk,
 `ifndef	OPT_STANDALONE
 		input	wire	[30:0]	i_setup,
+		input	wire		i_reset,
+		// What the receiver strobed out, and what was handed to the
+		// transmitter, for the simulation's scoreboard to check
+		output	wire		o_rx_stb,
+		output	wire	[7:0]	o_rx_data,
+		output	wire		o_rx_err,
+		output	wire		o_tx_stb,
+		output	wire	[7:0]	o_tx_data,
 `endif
 		input		i_uart_rx,
 		output	wire	o_uart_tx
@@ -104,15 +120,20 @@ module	linetest(
 `ifdef	OPT_STANDALONE
 	wire	[30:0]	i_setup;
 	assign		i_setup = 31'd868;	// 115200 Baud, if clk @ 100MHz
+	wire		i_reset;
+	assign		i_reset = 1'b0;
 `endif
 	// }}}
 
 	// pwr_reset
 	// {{{
-	// Create a reset line that will always be true on a power on reset
+	// Create a reset line that will always be true on a power on reset.
+	// When simulated, i_reset allows the test bench to reset the design
+	// as well, so it can be rerun with a new i_setup without building a
+	// new copy of it.
 	initial	pwr_reset = 1'b1;
 	always @(posedge i_clk)
-		pwr_reset <= 1'b0;
+		pwr_reset <= i_reset;
 	// }}}
 
 	// The UART Receiver
@@ -125,8 +146,15 @@ module	linetest(
 `ifdef	USE_LITE_UART
 	rxuartlite #(24'd868)
 		receiver(i_clk, i_uart_rx, rx_stb, rx_data);
+
+	// The lite receiver doesn't detect any errors
+	assign	rx_break   = 1'b0;
+	assign	rx_perr    = 1'b0;
+	assign	rx_ferr    = 1'b0;
+	assign	rx_ignored = 1'b0;
 `else
-	rxuart	receiver(i_clk, pwr_reset, i_setup, i_uart_rx, rx_stb, rx_data,
+	rxuart	#(.LGFRAC(LGFRAC))
+		receiver(i_clk, pwr_reset, i_setup, i_uart_rx, rx_stb, rx_data,
 			rx_break, rx_perr, rx_ferr, rx_ignored);
 `endif
 	// }}}
@@ -240,9 +268,30 @@ module	linetest(
 `ifdef	USE_LITE_UART
 	txuartlite #(24'd868)
 		transmitter(i_clk, tx_stb, tx_data, o_uart_tx, tx_busy);
+
+	// Make Verilator happy
+	// Verilator lint_off UNUSED
+	wire	unused;
+	assign	unused = &{ 1'b0, i_setup, tx_break, cts_n };
+	// Verilator lint_on  UNUSED
 `else
-	txuart	transmitter(i_clk, pwr_reset, i_setup, tx_break,
+	txuart	#(.LGFRAC(LGFRAC))
+		transmitter(i_clk, pwr_reset, i_setup, tx_break,
 			tx_stb, tx_data, cts_n, o_uart_tx, tx_busy);
+`endif
+	// }}}
+
+	// Scoreboard outputs
+	// {{{
+	// o_rx_stb is true for each character received, whether or not it had
+	// an error (o_rx_err) or was kept.  o_tx_stb is true for each
+	// character the transmitter accepts.
+`ifndef	OPT_STANDALONE
+	assign	o_rx_stb  = rx_stb;
+	assign	o_rx_data = rx_data;
+	assign	o_rx_err  = (rx_break)||(rx_perr)||(rx_ferr);
+	assign	o_tx_stb  = (tx_stb)&&(!tx_busy);
+	assign	o_tx_data = tx_data;
 `endif
 	// }}}
 endmodule
@@ -0,0 +1,274 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	rxinttest.v
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	To test when the wbuart's receive FIFO interrupt is set: once
+//		the receive FIFO reaches its fill threshold, or once whatever
+//	is in it has sat idle past its timeout.
+//
+//	A small bus master writes the setup register, and then the FIFO
+//	register with the threshold and timeout, i_threshold and i_timeout.
+//	It then does nothing until i_drain is set.  While i_drain is set, it
+//	reads the receive FIFO until it finds the FIFO empty, counting the
+//	bytes it reads in o_count.  The interrupts themselves are brought out
+//	as o_rx_int and o_rxfifo_int, for the test bench to time.  o_ready is
+//	set once the wbuart has been set up.
+//
+//	With i_packed set, setup bit 31 selects packed mode, and each read
+//	returns up to three bytes.  o_count still counts bytes.
+//
+//	With USE_AXILUART defined, the same bus master runs the same tests
+//	against the axiluart instead, through a small bridge to AXI-lite.
+//
+//	As with flowtest.v, this is only meant for simulation.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory, run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+`default_nettype none
+// }}}
+module	rxinttest #(
+		// {{{
+		// The log, base two, of the size of the wbuart's FIFOs
+		parameter [3:0]	LGFLEN = 4
+		// }}}
+	) (
+		// {{{
+		input	wire		i_clk, i_reset,
+		input	wire	[30:0]	i_setup,
+		// Read the receive register in packed mode, three bytes at once
+		input	wire		i_packed,
+		// The RX threshold and timeout, as written to the FIFO register
+		input	wire	[15:0]	i_threshold,
+		input	wire	[15:0]	i_timeout,
+		// Read everything in the receive FIFO
+		input	wire		i_drain,
+		input	wire		i_uart_rx,
+		output	wire		o_uart_tx,
+		output	wire		o_rx_int, o_rxfifo_int,
+		output	reg		o_ready,
+		output	reg	[15:0]	o_count
+		// }}}
+	);
+
+	// Signal declarations
+	// {{{
+	localparam [1:0]	UART_SETUP = 2'b00,
+				UART_FIFO  = 2'b01,
+				UART_RXREG = 2'b10;
+	localparam [1:0]	S_SETUP  = 2'h0,
+				S_CONFIG = 2'h1,
+				S_IDLE   = 2'h2,
+				S_READ   = 2'h3;
+
+	reg		pwr_reset;
+	reg	[1:0]	state;
+	reg		wb_cyc, wb_stb, wb_we;
+	reg	[1:0]	wb_addr;
+	reg	[31:0]	wb_data;
+
+	wire		uart_stall, uart_ack;
+
+	/* verilator lint_off UNUSED */
+	// Only the empty bit, bit 8--or, in packed mode, the count in the top
+	// two bits--of what's read is ever looked at
+	wire	[31:0]	uart_data;
+	wire		ignored_rts_n, ignored_tx_int, ignored_txfifo_int;
+	/* verilator lint_on UNUSED */
+	// }}}
+
+	// pwr_reset
+	// {{{
+	initial	pwr_reset = 1'b1;
+	always @(posedge i_clk)
+		pwr_reset <= i_reset;
+	// }}}
+
+	// The bus master
+	// {{{
+	// One request at a time.  S_SETUP writes the setup register, S_CONFIG
+	// the FIFO register, and S_READ reads the receive FIFO until it's
+	// empty.  o_count counts the bytes read.
+	initial	state   = S_SETUP;
+	initial	wb_cyc  = 1'b0;
+	initial	wb_stb  = 1'b0;
+	initial	o_ready = 1'b0;
+	initial	o_count = 16'h0;
+	always @(posedge i_clk)
+	if (pwr_reset)
+	begin
+		// {{{
+		state   <= S_SETUP;
+		wb_cyc  <= 1'b1;
+		wb_stb  <= 1'b1;
+		wb_we   <= 1'b1;
+		wb_addr <= UART_SETUP;
+		wb_data <= { i_packed, i_setup };
+		o_ready <= 1'b0;
+		o_count <= 16'h0;
+		// }}}
+	end else begin
+		if (!uart_stall)
+			wb_stb <= 1'b0;
+		if (uart_ack)
+			wb_cyc <= 1'b0;
+
+		case(state)
+		S_SETUP: if (uart_ack)
+			begin
+			state   <= S_CONFIG;
+			wb_cyc  <= 1'b1;
+			wb_stb  <= 1'b1;
+			wb_addr <= UART_FIFO;
+			wb_data <= { i_timeout, i_threshold };
+			end
+		S_CONFIG: if (uart_ack)
+			begin
+			state   <= S_IDLE;
+			o_ready <= 1'b1;
+			end
+		S_IDLE: if (i_drain)
+			begin
+			state   <= S_READ;
+			wb_cyc  <= 1'b1;
+			wb_stb  <= 1'b1;
+			wb_we   <= 1'b0;
+			wb_addr <= UART_RXREG;
+			end
+		S_READ: if (uart_ack)
+			begin
+			// Bit 8 set means the FIFO was empty.  A packed read
+			// returns its byte count in the top two bits instead.
+			if ((i_packed) ? (uart_data[31:30] == 2'b00)
+						: uart_data[8])
+				state <= S_IDLE;
+			else begin
+				o_count <= o_count + ((i_packed)
+					? { 14'h0, uart_data[31:30] } : 16'h1);
+				wb_cyc  <= 1'b1;
+				wb_stb  <= 1'b1;
+			end
+			end
+		default: state <= S_IDLE;
+		endcase
+	end
+	// }}}
+
+	// The unit under test
+	// {{{
+`ifdef	USE_AXILUART
+	// {{{
+	// The bus master above, bridged to AXI-lite.  Each request is issued
+	// on the clock after wb_stb, and each channel held until accepted.
+	// Since the master waits on each response before its next request,
+	// there's never more than one outstanding, and nothing need stall.
+	reg		awvalid, wvalid, arvalid;
+	wire		awready, wready, bvalid, arready, rvalid;
+
+	/* verilator lint_off UNUSED */
+	wire	[1:0]	ignored_bresp, ignored_rresp;
+	wire		ignored_cyc;
+	/* verilator lint_on UNUSED */
+
+	assign	ignored_cyc = wb_cyc;
+
+	initial	awvalid = 1'b0;
+	initial	wvalid  = 1'b0;
+	initial	arvalid = 1'b0;
+	always @(posedge i_clk)
+	if (pwr_reset)
+	begin
+		awvalid <= 1'b0;
+		wvalid  <= 1'b0;
+		arvalid <= 1'b0;
+	end else if (wb_stb)
+	begin
+		awvalid <= wb_we;
+		wvalid  <= wb_we;
+		arvalid <= !wb_we;
+	end else begin
+		if (awready)
+			awvalid <= 1'b0;
+		if (wready)
+			wvalid  <= 1'b0;
+		if (arready)
+			arvalid <= 1'b0;
+	end
+
+	assign	uart_stall = 1'b0;
+	assign	uart_ack   = (bvalid)||(rvalid);
+
+	axiluart #(
+		// {{{
+		.INITIAL_SETUP(31'd25), .LGFLEN(LGFLEN),
+		.HARDWARE_FLOW_CONTROL_PRESENT(1'b0), .OPT_PACKED(1'b1)
+		// }}}
+	) uut (
+		// {{{
+		.S_AXI_ACLK(i_clk), .S_AXI_ARESETN(!pwr_reset),
+		//
+		.S_AXI_AWVALID(awvalid), .S_AXI_AWREADY(awready),
+		.S_AXI_AWADDR({ wb_addr, 2'b00 }), .S_AXI_AWPROT(3'h0),
+		//
+		.S_AXI_WVALID(wvalid), .S_AXI_WREADY(wready),
+		.S_AXI_WDATA(wb_data), .S_AXI_WSTRB(4'hf),
+		//
+		.S_AXI_BVALID(bvalid), .S_AXI_BREADY(1'b1),
+		.S_AXI_BRESP(ignored_bresp),
+		//
+		.S_AXI_ARVALID(arvalid), .S_AXI_ARREADY(arready),
+		.S_AXI_ARADDR({ wb_addr, 2'b00 }), .S_AXI_ARPROT(3'h0),
+		//
+		.S_AXI_RVALID(rvalid), .S_AXI_RREADY(1'b1),
+		.S_AXI_RDATA(uart_data), .S_AXI_RRESP(ignored_rresp),
+		//
+		.i_uart_rx(i_uart_rx), .o_uart_tx(o_uart_tx),
+		.i_cts_n(1'b1), .o_rts_n(ignored_rts_n),
+		//
+		.o_uart_rx_int(o_rx_int), .o_uart_tx_int(ignored_tx_int),
+		.o_uart_rxfifo_int(o_rxfifo_int),
+		.o_uart_txfifo_int(ignored_txfifo_int)
+		// }}}
+	);
+	// }}}
+`else
+	// {{{
+	wbuart	#(.INITIAL_SETUP(31'd25), .LGFLEN(LGFLEN),
+		.HARDWARE_FLOW_CONTROL_PRESENT(1'b0), .OPT_PACKED(1'b1))
+	wbuarti(i_clk, pwr_reset,
+		wb_cyc, wb_stb, wb_we, wb_addr, wb_data, 4'hf,
+		uart_stall, uart_ack, uart_data,
+		i_uart_rx, o_uart_tx, 1'b1, ignored_rts_n,
+		o_rx_int, ignored_tx_int,
+		o_rxfifo_int, ignored_txfifo_int);
+	// }}}
+`endif
+	// }}}
+endmodule
@@ -16,6 +16,11 @@
 //	able to be run as a top-level testing file, requiring only that the
 //	clock and the transmit UART pins be working.
 //
+//	Any other message may be sent instead, of any length, by setting the
+//	MSGLEN and HEXFILE parameters.  mkspeech -H writes a header defining
+//	SPEECH_MSGLEN and SPEECH_HEXFILE to match the hex file it writes.
+//	Read that header ahead of this file, and these become the defaults.
+//
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
 //
@@ -57,6 +62,13 @@
 `ifndef	VERILATOR
 `define OPT_STANDALONE
 `endif
+//
+// Unless mkspeech's header for some other message has been read first, the
+// message is the Gettysburg address, in speech.hex
+`ifndef	SPEECH_MSGLEN
+`define	SPEECH_MSGLEN	2203
+`define	SPEECH_HEXFILE	"speech.hex"
+`endif
 // }}}
 module	speechfifo #(
 		// {{{
@@ -69,8 +81,17 @@ module	speechfifo #(
 		parameter	INITIAL_UART_SETUP = 31'd868,
 
 		// Let's set our message length, in case we ever wish to change
-		// it in the future
-		localparam	MSGLEN=2203
+		// it in the future.  This must match the hex file, and so
+		// must count the CR that mkspeech places before every LF.
+		// Since the message restarts every 2^31 clocks, it must also
+		// be short enough to be sent in that time.
+		parameter	MSGLEN=`SPEECH_MSGLEN,
+		parameter	HEXFILE=`SPEECH_HEXFILE,
+		//
+		// The message memory holds at least 4096 characters, but will
+		// grow to hold any longer message, with room to spare for the
+		// index to start a few characters before zero
+		localparam	LGMEM = (MSGLEN < 4080) ? 12 : $clog2(MSGLEN+16)
 		// }}}
 	) (
 		// {{{
@@ -102,9 +123,9 @@ module	speechfifo #(
 	/* verilator lint_on UNUSED */
 
 	reg		pwr_reset;
-	reg	[7:0]	message [0:4095];
+	reg	[7:0]	message [0:(1<<LGMEM)-1];
 	reg	[30:0]	restart_counter;
-	reg	[11:0]	msg_index;
+	reg	[LGMEM-1:0]	msg_index;
 	reg		end_of_message;
 
 	wire	cts_n;
@@ -137,7 +158,7 @@ module	speechfifo #(
 	// The message we wish to transmit is kept in "message".  It needs to be
 	// set initially.  Do so here.
 	//
-	// Since the message has fewer than 2048 elements in it, we preset every
+	// Since the message is shorter than the memory, we preset every other
 	// element to a space so that if (for some reason) we broadcast past the
 	// end of our message, we'll at least be sending something useful.
 	integer	i;
@@ -153,8 +174,8 @@ module	speechfifo #(
 		// file is both built, and copied into a directory where your
 		// synthesis tool can find it.
 		//
-		$readmemh("speech.hex", message);
-		for(i=MSGLEN; i<4095; i=i+1)
+		$readmemh(HEXFILE, message);
+		for(i=MSGLEN; i<(1<<LGMEM); i=i+1)
 			message[i] = 8'h20;
 
 		//
@@ -207,7 +228,7 @@ module	speechfifo #(
 	// transmit next.  Note, there's a clock delay between setting this 
 	// index and when the wb_data is valid.  Hence, we set the index on
 	// restart[0] to zero.
-	initial	msg_index = 12'h000 - 12'h8;
+	initial	msg_index = { {(LGMEM-4){1'b1}}, 4'h8 };
 	always @(posedge i_clk)
 	if (restart)
 		msg_index <= 0;
@@ -0,0 +1,195 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	streamtest.v
+// {{{
+// Project:	wbuart32, a full featured UART with simulator
+//
+// Purpose:	To test the axiluart's AXI-Stream ports, and to measure how
+//		many bytes per clock they can sustain.  A small AXI-lite
+//	master writes the setup register, and then the FIFO register with the
+//	receive idle timeout, i_timeout, which sets where TLAST falls.  From
+//	then on, the test bench moves all of the data itself, straight through
+//	the axiluart's AXI-Stream master (M_AXIS_*, bytes received) and slave
+//	(S_AXIS_*, bytes to transmit), just as a DMA would.  o_ready is set
+//	once the setup is complete.
+//
+//	The axiluart only has its stream ports with USE_AXIS_STREAM defined,
+//	so this must be Verilated with -DUSE_AXIS_STREAM, as the Makefile does.
+//
+//	As with flowtest.v, this is only meant for simulation.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2021, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory, run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+`default_nettype none
+// }}}
+module	streamtest #(
+		// {{{
+		// The log, base two, of the size of the axiluart's FIFOs
+		parameter [3:0]	LGFLEN = 4
+		// }}}
+	) (
+		// {{{
+		input	wire		i_clk, i_reset,
+		input	wire	[30:0]	i_setup,
+		// The receive idle timeout, in baud intervals
+		input	wire	[15:0]	i_timeout,
+		input	wire		i_uart_rx,
+		output	wire		o_uart_tx,
+		output	reg		o_ready,
+		//
+		output	wire		M_AXIS_TVALID,
+		input	wire		M_AXIS_TREADY,
+		output	wire	[7:0]	M_AXIS_TDATA,
+		output	wire		M_AXIS_TLAST,
+		//
+		input	wire		S_AXIS_TVALID,
+		output	wire		S_AXIS_TREADY,
+		input	wire	[7:0]	S_AXIS_TDATA,
+		input	wire		S_AXIS_TLAST
+		// }}}
+	);
+
+	// Signal declarations
+	// {{{
+	localparam [3:0]	UART_SETUP = 4'h0,
+				UART_FIFO  = 4'h4;
+	localparam [1:0]	S_SETUP  = 2'h0,
+				S_CONFIG = 2'h1,
+				S_DONE   = 2'h2;
+
+	reg		pwr_reset;
+	reg	[1:0]	state;
+	reg		awvalid, wvalid;
+	reg	[3:0]	awaddr;
+	reg	[31:0]	wdata;
+	wire		awready, wready, bvalid;
+
+	/* verilator lint_off UNUSED */
+	wire	[1:0]	ignored_bresp, ignored_rresp;
+	wire		ignored_arready, ignored_rvalid;
+	wire	[31:0]	ignored_rdata;
+	wire		ignored_rts_n, ignored_rx_int, ignored_tx_int,
+			ignored_rxfifo_int, ignored_txfifo_int;
+	/* verilator lint_on UNUSED */
+	// }}}
+
+	// pwr_reset
+	// {{{
+	initial	pwr_reset = 1'b1;
+	always @(posedge i_clk)
+		pwr_reset <= i_reset;
+	// }}}
+
+	// The AXI-lite master
+	// {{{
+	// Two writes, one after the other: the setup register, then the FIFO
+	// register.  The address and data are each held until accepted, and
+	// the next write waits on the response to the last.
+	initial	state   = S_SETUP;
+	initial	awvalid = 1'b0;
+	initial	wvalid  = 1'b0;
+	initial	o_ready = 1'b0;
+	always @(posedge i_clk)
+	if (pwr_reset)
+	begin
+		// {{{
+		state   <= S_SETUP;
+		awvalid <= 1'b1;
+		wvalid  <= 1'b1;
+		awaddr  <= UART_SETUP;
+		wdata   <= { 1'b0, i_setup };
+		o_ready <= 1'b0;
+		// }}}
+	end else begin
+		if (awready)
+			awvalid <= 1'b0;
+		if (wready)
+			wvalid <= 1'b0;
+
+		if (bvalid)
+		case(state)
+		S_SETUP: begin
+			state   <= S_CONFIG;
+			awvalid <= 1'b1;
+			wvalid  <= 1'b1;
+			awaddr  <= UART_FIFO;
+			wdata   <= { i_timeout, 16'h0 };
+			end
+		S_CONFIG: begin
+			state   <= S_DONE;
+			o_ready <= 1'b1;
+			end
+		default: begin end
+		endcase
+	end
+	// }}}
+
+	// The unit under test
+	// {{{
+	axiluart #(
+		// {{{
+		.INITIAL_SETUP(31'd25), .LGFLEN(LGFLEN),
+		.HARDWARE_FLOW_CONTROL_PRESENT(1'b0),
+		.OPT_STREAM(1'b1)
+		// }}}
+	) uut (
+		// {{{
+		.S_AXI_ACLK(i_clk), .S_AXI_ARESETN(!pwr_reset),
+		//
+		.S_AXI_AWVALID(awvalid), .S_AXI_AWREADY(awready),
+		.S_AXI_AWADDR(awaddr), .S_AXI_AWPROT(3'h0),
+		//
+		.S_AXI_WVALID(wvalid), .S_AXI_WREADY(wready),
+		.S_AXI_WDATA(wdata), .S_AXI_WSTRB(4'hf),
+		//
+		.S_AXI_BVALID(bvalid), .S_AXI_BREADY(1'b1),
+		.S_AXI_BRESP(ignored_bresp),
+		//
+		.S_AXI_ARVALID(1'b0), .S_AXI_ARREADY(ignored_arready),
+		.S_AXI_ARADDR(4'h0), .S_AXI_ARPROT(3'h0),
+		//
+		.S_AXI_RVALID(ignored_rvalid), .S_AXI_RREADY(1'b1),
+		.S_AXI_RDATA(ignored_rdata), .S_AXI_RRESP(ignored_rresp),
+		//
+		.i_uart_rx(i_uart_rx), .o_uart_tx(o_uart_tx),
+		.i_cts_n(1'b0), .o_rts_n(ignored_rts_n),
+		//
+		.M_AXIS_TVALID(M_AXIS_TVALID), .M_AXIS_TREADY(M_AXIS_TREADY),
+		.M_AXIS_TDATA(M_AXIS_TDATA), .M_AXIS_TLAST(M_AXIS_TLAST),
+		//
+		.S_AXIS_TVALID(S_AXIS_TVALID), .S_AXIS_TREADY(S_AXIS_TREADY),
+		.S_AXIS_TDATA(S_AXIS_TDATA), .S_AXIS_TLAST(S_AXIS_TLAST),
+		//
+		.o_uart_rx_int(ignored_rx_int), .o_uart_tx_int(ignored_tx_int),
+		.o_uart_rxfifo_int(ignored_rxfifo_int),
+		.o_uart_txfifo_int(ignored_txfifo_int)
+		// }}}
+	);
+	// }}}
+endmodule
@@ -7,6 +7,10 @@
 // Purpose:	A basic AXI-Lite serial port controller.  It has the same
 //		interface as the WBUART core in the same directory.
 //
+//	The AXI-Stream ports used by OPT_STREAM are only present when
+//	USE_AXIS_STREAM is defined, so that designs instantiating this core
+//	without them, by position or by name, still match its ports.
+//
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
 //
@@ -39,24 +43,40 @@
 //
 `default_nettype none
 //
+// `define	USE_AXIS_STREAM
 module	axiluart #(
 		// {{{
 		// 4MB 8N1, when using 100MHz clock
 		parameter [30:0] INITIAL_SETUP = 31'd25,
+		// LGFRAC: The number of fractional bits in the baud rate,
+		// setup[23:0].  With LGFRAC > 0, the baud field holds the
+		// clocks per baud times 2^LGFRAC, as in txuart.v.
+		parameter [3:0]	LGFRAC = 0,
 		//
 		// LGFLEN: The log (based two) of our FIFOs size.  Maxes out
-		// at 10, representing a FIFO length of 1024.
+		// at 15, representing a FIFO length of 32768.
 		parameter [3:0]	LGFLEN = 4,
 		//
 		// HARDWARE_FLOW_CONTROL_PRESET controls whether or not we
 		// ignore the RTS/CTS signaling.  If present, we only start
 		// transmitting if 
 		parameter [0:0]	HARDWARE_FLOW_CONTROL_PRESENT = 1'b1,
+		//
+		// OPT_PACKED allows setup bit 31 to select packed access to
+		// the FIFOs, moving several bytes per bus word rather than one.
+		// It's off by default, so that bit 31 keeps reading as zero.
+		parameter [0:0]	OPT_PACKED = 1'b0,
+		//
+		// OPT_STREAM adds an AXI-Stream master, from the receive FIFO,
+		// and slave, into the transmit FIFO, so that a DMA may move
+		// data through the UART without the CPU.  It's ignored unless
+		// USE_AXIS_STREAM is defined, since the ports aren't there.
+		parameter [0:0]	OPT_STREAM = 1'b0,
 		// Perform a simple/quick bounds check on the log FIFO length,
 		// to make sure its within the bounds we can support with our
-		// current interface.
-		localparam [3:0]	LCLLGFLEN = (LGFLEN > 4'ha)? 4'ha
-					: ((LGFLEN < 4'h2) ? 4'h2 : LGFLEN),
+		// current interface.  The FIFO register's four bit size field
+		// can't report anything over 15, so LGFLEN has only four bits.
+		localparam [3:0]	LCLLGFLEN = (LGFLEN < 4'h2) ? 4'h2 : LGFLEN,
 		//
 		// Size of the AXI-lite bus.  These are fixed, since 1) AXI-lite
 		// is fixed at a width of 32-bits by Xilinx def'n, and 2) since
@@ -118,6 +138,25 @@ module	axiluart #(
 		// simply remove this logic.
 		output	reg		o_rts_n,
 		// }}}
+`ifdef	USE_AXIS_STREAM
+		// AXI-Stream signaling
+		// {{{
+		// Used only with OPT_STREAM.  Bytes received come out of the
+		// master, M_AXIS_*, with TLAST set on the last byte before the
+		// receive idle timeout.  Bytes given to the slave, S_AXIS_*,
+		// are transmitted.  Without OPT_STREAM, M_AXIS_TVALID and
+		// S_AXIS_TREADY are held low.
+		output	wire		M_AXIS_TVALID,
+		input	wire		M_AXIS_TREADY,
+		output	wire	[7:0]	M_AXIS_TDATA,
+		output	wire		M_AXIS_TLAST,
+		//
+		input	wire		S_AXIS_TVALID,
+		output	wire		S_AXIS_TREADY,
+		input	wire	[7:0]	S_AXIS_TDATA,
+		input	wire		S_AXIS_TLAST,
+		// }}}
+`endif
 		// A series of outgoing interrupts to select from among
 		// {{{
 		output	wire	o_uart_rx_int,
@@ -152,6 +191,7 @@ module	axiluart #(
 	wire		tx_busy;
 	//
 	reg	[30:0]	uart_setup;
+	reg		r_packed;
 	//
 	wire		rx_stb, rx_break, rx_perr, rx_ferr, ck_uart;
 	wire	[7:0]	rx_uart_data;
@@ -159,25 +199,61 @@ module	axiluart #(
 	//
 	wire		rx_empty_n, rx_fifo_err;
 	wire	[7:0]	rxf_axil_data;
-	wire	[15:0]	rxf_status;
+	wire	[15:0]	rxf_status, rxf_fill;
 	reg		rxf_axil_read;
 	reg		r_rx_perr, r_rx_ferr;
 	//
 	wire	[(LCLLGFLEN-1):0]	check_cutoff;
 	wire	[31:0]	axil_rx_data;
+	//
+	reg	[23:0]	rxp_data;
+	reg	[1:0]	rxp_count;
+	reg		r_rxp_read;
+	wire		rxp_fill;
+	//
+	reg	[15:0]	rx_threshold;
+	reg	[15:0]	rx_timeout, rx_idle;
+	reg	[23:0]	rx_baud_counter;
+	reg		rx_baud_tick;
+	wire	[23:0]	rx_baud;
+	wire		rx_waiting, rx_level_int, rx_timeout_int;
+	wire	[15:0]	rx_level;
+	//
+	wire		axis_rx_read, axis_tx_write;
+	reg		r_axis_valid, r_axis_last;
+`ifdef	USE_AXIS_STREAM
+	localparam [0:0]	LCL_STREAM = OPT_STREAM;
+`else
+	// Without the stream ports, OPT_STREAM is ignored.  The ports' inputs
+	// are tied off here, and their outputs go nowhere.
+	localparam [0:0]	LCL_STREAM = 1'b0;
+
+	wire		M_AXIS_TVALID, M_AXIS_TREADY, M_AXIS_TLAST;
+	wire	[7:0]	M_AXIS_TDATA;
+	wire		S_AXIS_TVALID, S_AXIS_TREADY, S_AXIS_TLAST;
+	wire	[7:0]	S_AXIS_TDATA;
+
+	assign	M_AXIS_TREADY = 1'b0;
+	assign	S_AXIS_TVALID = 1'b0;
+	assign	S_AXIS_TDATA  = 8'h0;
+	assign	S_AXIS_TLAST  = 1'b0;
+`endif
 	//
 	wire		tx_empty_n, txf_err, tx_break;
 	wire	[7:0]	tx_data;
 	wire	[15:0]	txf_status;
 	reg		txf_axil_write, tx_uart_reset;
 	reg	[7:0]	txf_axil_data;
+	reg	[31:0]	txp_data;
+	reg	[3:0]	txp_sel;
+	wire		txp_busy;
 	wire	[31:0]	axil_tx_data;
 	wire	[31:0]	axil_fifo_data;
 	//
 	reg	[1:0]	r_axil_addr;
 	reg		r_preread;
 
-	reg	[31:0]	new_setup;
+	reg	[31:0]	new_setup, new_fifocfg;
 
 	// }}}
 	////////////////////////////////////////////////////////////////////////
@@ -219,7 +295,7 @@ module	axiluart #(
 			.o_data({ wskd_data, wskd_strb }));
 
 		assign	axil_write_ready = awskd_valid && wskd_valid
-				&& (!S_AXI_BVALID || S_AXI_BREADY);
+				&& (!S_AXI_BVALID || S_AXI_BREADY) && !txp_busy;
 
 	end else begin : SIMPLE_WRITES
 
@@ -232,7 +308,11 @@ module	axiluart #(
 		else
 			axil_awready <= !axil_awready
 				&& (S_AXI_AWVALID && S_AXI_WVALID)
-				&& (!S_AXI_BVALID || S_AXI_BREADY);
+				&& (!S_AXI_BVALID || S_AXI_BREADY)
+				// Writes arrive a clock after this, by when
+				// the packed transmit buffer will have moved
+				// on by one byte
+				&& (txp_sel[3:2] == 2'b00);
 
 		assign	S_AXI_AWREADY = axil_awready;
 		assign	S_AXI_WREADY  = axil_awready;
@@ -331,7 +411,7 @@ module	axiluart #(
 				UART_TXREG = 2'b11;
 
 	always @(*)
-		new_setup = apply_wstrb({1'b0,uart_setup},wskd_data,wskd_strb);
+		new_setup = apply_wstrb({r_packed,uart_setup},wskd_data,wskd_strb);
 	
 	//
 	// The UART setup parameters: bits per byte, stop bits, parity, and
@@ -348,6 +428,19 @@ module	axiluart #(
 			uart_setup[30] <= 1'b1;
 	end
 
+	//
+	// The top bit of the setup register, otherwise unused, selects packed
+	// access to the FIFOs.  Reads of the receive register then return up
+	// to three bytes at a time, and writes to the transmit register send
+	// one byte for every byte lane (WSTRB bit) set.  Since any write to
+	// the setup register resets both FIFOs, nothing is ever left half
+	// packed when this changes.
+	//
+	initial	r_packed = 1'b0;
+	always @(posedge S_AXI_ACLK)
+	if ((axil_write_ready)&&(awskd_addr == UART_SETUP))
+		r_packed <= (OPT_PACKED)&&(new_setup[31]);
+
 	/////////////////////////////////////////
 	//
 	// First, the UART receiver
@@ -362,14 +455,18 @@ module	axiluart #(
 	// a stb (true when new data is ready), and an 8-bit data out value
 	// valid when stb is high.
 `ifdef	FORMAL
-	(* anyseq *) reg	w_rx_break, w_rx_perr, w_rx_ferr, w_ck_uart;
-	assign		rx_break  = w_rx_break;
-	assign		w_rx_perr = w_rx_perr;
-	assign		w_rx_ferr = w_rx_ferr;
-	assign		ck_uart  = w_ck_uart;
+	(* anyseq *) reg	w_rx_stb, w_rx_break, w_rx_perr, w_rx_ferr,
+				w_ck_uart;
+	(* anyseq *) reg [7:0]	w_rx_data;
+	assign		rx_stb       = w_rx_stb;
+	assign		rx_uart_data = w_rx_data;
+	assign		rx_break     = w_rx_break;
+	assign		rx_perr      = w_rx_perr;
+	assign		rx_ferr      = w_rx_ferr;
+	assign		ck_uart      = w_ck_uart;
 `else
 `ifdef	USE_LITE_UART
-	rxuartlite	#(.CLOCKS_PER_BAUD(INITIAL_SETUP[23:0]))
+	rxuartlite	#(.CLOCKS_PER_BAUD(INITIAL_SETUP[23:0]), .LGFRAC(LGFRAC))
 		rx(S_AXI_ACLK, i_uart_rx, rx_stb, rx_uart_data);
 	assign	rx_break = 1'b0;
 	assign	rx_perr  = 1'b0;
@@ -378,7 +475,8 @@ module	axiluart #(
 `else
 	// The full receiver also produces a break value (true during a break
 	// cond.), and parity/framing error flags--also valid when stb is true.
-	rxuart	#(.INITIAL_SETUP(INITIAL_SETUP)) rx(S_AXI_ACLK, (!S_AXI_ARESETN)||(rx_uart_reset),
+	rxuart	#(.INITIAL_SETUP(INITIAL_SETUP), .LGFRAC(LGFRAC))
+		rx(S_AXI_ACLK, (!S_AXI_ARESETN)||(rx_uart_reset),
 			uart_setup, i_uart_rx,
 			rx_stb, rx_uart_data, rx_break,
 			rx_perr, rx_ferr, ck_uart);
@@ -403,14 +501,112 @@ module	axiluart #(
 		rxfifo(S_AXI_ACLK, (!S_AXI_ARESETN)||(rx_break)||(rx_uart_reset),
 			rx_stb, rx_uart_data,
 			rx_empty_n,
-			rxf_axil_read, rxf_axil_data,
+			(rxf_axil_read)||(rxp_fill)||(axis_rx_read),
+			rxf_axil_data,
 			rxf_status, rx_fifo_err);
-	assign	o_uart_rxfifo_int = rxf_status[1];
+
+	//
+	// The number of bytes in the receive FIFO, for the threshold, flow
+	// control, and stream logic below.  Up to 2^10, the FIFO's status
+	// register holds it.  Deeper FIFOs only report the top ten bits of
+	// their fill there, so it's counted here instead, following the
+	// FIFO's own count:  up on any byte the FIFO accepts, and down on any
+	// byte read from it.
+	//
+	generate if (LCLLGFLEN > 4'ha)
+	begin : GEN_RXF_COUNT
+		reg	[15:0]	r_rxf_fill;
+
+		initial	r_rxf_fill = 16'h0;
+		always @(posedge S_AXI_ACLK)
+		if ((!S_AXI_ARESETN)||(rx_break)||(rx_uart_reset))
+			r_rxf_fill <= 16'h0;
+		else case({ (rx_stb)&&(!rx_fifo_err),
+				((rxf_axil_read)||(rxp_fill)||(axis_rx_read))
+					&&(rx_empty_n) })
+		2'b01:	r_rxf_fill <= r_rxf_fill - 1'b1;
+		2'b10:	r_rxf_fill <= r_rxf_fill + 1'b1;
+		default: begin end
+		endcase
+
+		assign	rxf_fill = r_rxf_fill;
+	end else begin : GEN_RXF_STATUS
+		assign	rxf_fill = { 6'h0, rxf_status[11:2] };
+	end endgenerate
+
+	//
+	// Writes to the otherwise read-only FIFO register set when the receive
+	// FIFO interrupt is generated.  The bottom sixteen bits set a fill
+	// threshold, at or above which the interrupt is set--zero, the
+	// default, keeps the original half-full interrupt.  The top sixteen
+	// bits set an idle timeout, in baud intervals: if anything is waiting
+	// to be read, yet nothing has been received or read for this long,
+	// the interrupt is set as well.  Zero, the default, turns this off.
+	//
+	always @(*)
+		new_fifocfg = apply_wstrb({ rx_timeout, rx_threshold },
+					wskd_data, wskd_strb);
+
+	initial	rx_threshold = 16'h0;
+	initial	rx_timeout   = 16'h0;
+	always @(posedge S_AXI_ACLK)
+	if ((axil_write_ready)&&(awskd_addr == UART_FIFO))
+	begin
+		rx_threshold <= new_fifocfg[15:0];
+		rx_timeout   <= new_fifocfg[31:16];
+	end
+
+	//
+	// The timeout is measured in baud intervals, counted by a free running
+	// counter of the receiver's clocks per baud.  It may therefore be up
+	// to one baud interval short.
+	//
+`ifdef	USE_LITE_UART
+	assign	rx_baud = INITIAL_SETUP[23:0] >> LGFRAC;
+`else
+	assign	rx_baud = uart_setup[23:0] >> LGFRAC;
+`endif
+
+	initial	rx_baud_counter = 24'h0;
+	initial	rx_baud_tick    = 1'b0;
+	always @(posedge S_AXI_ACLK)
+	if (rx_baud_counter == 24'h0)
+	begin
+		rx_baud_counter <= rx_baud - 1'b1;
+		rx_baud_tick    <= 1'b1;
+	end else begin
+		rx_baud_counter <= rx_baud_counter - 1'b1;
+		rx_baud_tick    <= 1'b0;
+	end
+
+	assign	rx_waiting = (rx_empty_n)||(rxp_count != 2'b00);
+
+	initial	rx_idle = 16'h0;
+	always @(posedge S_AXI_ACLK)
+	if ((!S_AXI_ARESETN)||(rx_uart_reset)||(rx_stb)||(rxf_axil_read)
+			||(r_rxp_read)||(axis_rx_read)||(!rx_waiting))
+		rx_idle <= 16'h0;
+	else if ((rx_baud_tick)&&(rx_idle != 16'hffff))
+		rx_idle <= rx_idle + 1'b1;
+
+	// In packed mode, up to three received bytes have already left the
+	// FIFO for the packed buffer.  They still count towards the threshold,
+	// and towards the half-full default, rather than delaying both.
+	assign	rx_level = rxf_fill + { 14'h0, rxp_count };
+	assign	rx_level_int = (rx_threshold == 16'h0)
+				? (rx_level >= (16'h1 << (LCLLGFLEN-1)))
+				: (rx_level >= rx_threshold);
+	assign	rx_timeout_int = (rx_timeout != 16'h0)&&(rx_waiting)
+				&&(rx_idle >= rx_timeout);
+
+	// The receive FIFO interrupt, then, is set once the FIFO reaches its
+	// threshold, or when whatever is in it has waited too long.
+	assign	o_uart_rxfifo_int = (rx_level_int)||(rx_timeout_int);
 
 	// We produce four interrupts.  One of the receive interrupts indicates
-	// whether or not the receive FIFO is non-empty.  This should wake up
-	// the CPU.
-	assign	o_uart_rx_int = rxf_status[0];
+	// whether or not the receive FIFO (or, in packed mode, the packed
+	// buffer) is non-empty.  This should wake up the CPU.
+	assign	o_uart_rx_int = (rxf_status[0])||(rxp_count != 2'b00);
 
 	// The clear to send line, which may be ignored, but which we set here
 	// to be true any time the FIFO has fewer than N-2 items in it.
@@ -423,15 +619,86 @@ module	axiluart #(
 	always @(posedge S_AXI_ACLK)
 		o_rts_n <= ((HARDWARE_FLOW_CONTROL_PRESENT)
 			&&(!uart_setup[30])
-			&&(rxf_status[(LCLLGFLEN+1):2] > check_cutoff));
+			&&(rxf_fill[(LCLLGFLEN-1):0] > check_cutoff));
 
 	// If the bus requests that we read from the receive FIFO, we need to
 	// tell this to the receive FIFO.  Note that because we are using a 
 	// clock here, the output from the receive FIFO will necessarily be
-	// delayed by an extra clock.
+	// delayed by an extra clock.  With OPT_STREAM, the stream master owns
+	// the receive FIFO, so such reads only look at it.
 	initial	rxf_axil_read = 1'b0;
 	always @(posedge S_AXI_ACLK)
-		rxf_axil_read<=(axil_read_ready)&&(arskd_addr[1:0]==UART_RXREG);
+		rxf_axil_read<=(axil_read_ready)&&(arskd_addr[1:0]==UART_RXREG)
+				&&(!r_packed)&&(!LCL_STREAM);
+
+	// In packed mode, bytes are moved from the receive FIFO into a small
+	// buffer instead, one per clock, until it holds three of them.  A read
+	// of the receive register then returns (and empties) the whole buffer
+	// at once, the oldest byte in the bottom.
+	initial	r_rxp_read = 1'b0;
+	always @(posedge S_AXI_ACLK)
+		r_rxp_read <= (axil_read_ready)&&(arskd_addr[1:0]==UART_RXREG)
+				&&(r_packed);
+
+	assign	rxp_fill = (!LCL_STREAM)&&(r_packed)&&(rx_empty_n)
+				&&((rxp_count != 2'b11)||(r_rxp_read));
+
+	initial	rxp_count = 2'b00;
+	initial	rxp_data  = 24'h0;
+	always @(posedge S_AXI_ACLK)
+	if ((!S_AXI_ARESETN)||(rx_break)||(rx_uart_reset)||(!r_packed))
+	begin
+		rxp_count <= 2'b00;
+		rxp_data  <= 24'h0;
+	end else if (r_rxp_read)
+	begin
+		// The buffer is being read.  Start over, with whatever byte
+		// might be arriving from the FIFO on this clock.
+		rxp_count <= (rxp_fill) ? 2'b01 : 2'b00;
+		rxp_data  <= { 16'h0, (rxp_fill) ? rxf_axil_data : 8'h00 };
+	end else if (rxp_fill)
+	begin
+		rxp_count <= rxp_count + 1'b1;
+		case(rxp_count)
+		2'b00: rxp_data[ 7: 0] <= rxf_axil_data;
+		2'b01: rxp_data[15: 8] <= rxf_axil_data;
+		default: rxp_data[23:16] <= rxf_axil_data;
+		endcase
+	end
+
+	// The AXI-Stream master
+	//
+	// With OPT_STREAM, bytes leave the receive FIFO through M_AXIS_*, one
+	// per beat, rather than through the AXI-lite bus.  TLAST marks the
+	// end of a burst: it's set on the last byte in the FIFO once the
+	// receive idle timeout, as set through the FIFO register, has passed.
+	// That last byte is therefore held back until either another byte
+	// arrives behind it, or the timeout passes.  With no timeout, nothing
+	// is held back, and TLAST is never set.
+	//
+	// Once TVALID is set, it stays set, and nothing about the beat
+	// changes, until it is accepted--the FIFO can only grow beneath it.
+	// r_axis_valid and r_axis_last hold on to the beat until then.
+	initial	r_axis_valid = 1'b0;
+	initial	r_axis_last  = 1'b0;
+	always @(posedge S_AXI_ACLK)
+	if ((!S_AXI_ARESETN)||(rx_break)||(rx_uart_reset))
+	begin
+		r_axis_valid <= 1'b0;
+		r_axis_last  <= 1'b0;
+	end else begin
+		r_axis_valid <= (M_AXIS_TVALID)&&(!M_AXIS_TREADY);
+		r_axis_last  <= (M_AXIS_TLAST)&&(!M_AXIS_TREADY);
+	end
+
+	assign	M_AXIS_TVALID = (LCL_STREAM)&&(rx_empty_n)
+				&&((r_axis_valid)||(rx_timeout == 16'h0)
+				||(rxf_fill > 16'h1)||(rx_timeout_int));
+	assign	M_AXIS_TLAST  = (r_axis_valid) ? r_axis_last
+				: ((rx_timeout != 16'h0)&&(rx_timeout_int)
+					&&(rxf_fill == 16'h1));
+	assign	M_AXIS_TDATA  = rxf_axil_data;
+	assign	axis_rx_read  = (M_AXIS_TVALID)&&(M_AXIS_TREADY);
 
 	// Now, let's deal with those RX UART errors: both the parity and frame
 	// errors.  As you may recall, these are valid only when rx_stb is
@@ -482,7 +749,16 @@ module	axiluart #(
 	// that would be read from the FIFO, an error indicator set upon
 	// reading from an empty FIFO, a break indicator, and the frame and
 	// parity error signals.
-	assign	axil_rx_data = { 16'h00,
+	//
+	// In packed mode, the same flags are moved up by sixteen bits, to make
+	// room for three bytes of data beneath them, and the number of bytes
+	// returned (zero to three) is placed in the top two bits.  The empty
+	// flag is then set when there are none.
+	assign	axil_rx_data = (r_packed) ? { rxp_count,
+				1'b0, rx_fifo_err,
+				rx_break, rx_ferr, r_rx_perr,
+				(rxp_count == 2'b00), rxp_data }
+			: { 16'h00,
 				3'h0, rx_fifo_err,
 				rx_break, rx_ferr, r_rx_perr, !rx_empty_n,
 				rxf_axil_data};
@@ -506,10 +782,42 @@ module	axiluart #(
 	always @(posedge S_AXI_ACLK)
 	begin
 		txf_axil_write <= (axil_write_ready)&&(awskd_addr == UART_TXREG)
-			&& wskd_strb[0];
+			&& wskd_strb[0] && !r_packed;
 		txf_axil_data  <= wskd_data[7:0];
 	end
 
+	// In packed mode, a write to the transmit register is captured here,
+	// together with its write strobes.  Each byte lane that was strobed is
+	// then written into the FIFO in turn, from the bottom lane up, at one
+	// lane per clock.  No more writes are accepted while more than one
+	// lane remains.
+	initial	txp_sel = 4'h0;
+	always @(posedge S_AXI_ACLK)
+	if ((!S_AXI_ARESETN)||(tx_uart_reset)||(!OPT_PACKED))
+		txp_sel <= 4'h0;
+	else if ((axil_write_ready)&&(awskd_addr == UART_TXREG)&&(r_packed))
+		txp_sel <= wskd_strb;
+	else
+		txp_sel <= txp_sel >> 1;
+
+	always @(posedge S_AXI_ACLK)
+	if ((axil_write_ready)&&(awskd_addr == UART_TXREG))
+		txp_data <= wskd_data;
+	else
+		txp_data <= txp_data >> 8;
+
+	assign	txp_busy = (OPT_PACKED)&&(txp_sel[3:1] != 3'h0);
+
+	// The AXI-Stream slave
+	//
+	// With OPT_STREAM, bytes may also be written into the transmit FIFO
+	// through S_AXIS_*.  The AXI-lite bus has priority: the stream is held
+	// off on any clock one of its writes is reaching the FIFO, as well as
+	// whenever the FIFO is full.  TLAST is ignored.
+	assign	S_AXIS_TREADY = (LCL_STREAM)&&(txf_status[0])
+				&&(!txf_axil_write)&&(!txp_sel[0]);
+	assign	axis_tx_write = (S_AXIS_TVALID)&&(S_AXIS_TREADY);
+
 	// Transmit FIFO
 	//
 	// Most of this is just wire management.  The TX FIFO is identical in
@@ -519,9 +827,11 @@ module	axiluart #(
 	// break.  We read from the FIFO any time the UART transmitter is idle.
 	// and ... we just set the values (above) for controlling writing into
 	// this.
-	ufifo	#(.LGFLEN(LGFLEN), .RXFIFO(0))
+	ufifo	#(.LGFLEN(LCLLGFLEN), .RXFIFO(0))
 		txfifo(S_AXI_ACLK, (tx_break)||(tx_uart_reset),
-			txf_axil_write, txf_axil_data,
+			(txf_axil_write)||(txp_sel[0])||(axis_tx_write),
+			(axis_tx_write) ? S_AXIS_TDATA
+				: ((r_packed) ? txp_data[7:0] : txf_axil_data),
 			tx_empty_n,
 			(!tx_busy)&&(tx_empty_n), tx_data,
 			txf_status, txf_err);
@@ -550,7 +860,7 @@ module	axiluart #(
 	if (!S_AXI_ARESETN)
 		r_tx_break <= 1'b0;
 	else if (axil_write_ready &&(awskd_addr[1:0]== UART_TXREG) &&
-			wskd_strb[1])
+			wskd_strb[1] && !r_packed)
 		r_tx_break <= wskd_data[9];
 	assign	tx_break = r_tx_break;
 `else
@@ -562,23 +872,26 @@ module	axiluart #(
 	// This is nearly identical to the RX reset logic above.  Basically,
 	// any time someone writes to bit [12] the transmitter will go through
 	// a reset cycle.  Keep bit [12] low, and everything will proceed as
-	// normal.
+	// normal.  (In packed mode, bit [12] is data, so this is only
+	// available outside of it.)
 	initial	tx_uart_reset = 1'b1;
 	always @(posedge S_AXI_ACLK)
 	if ((!S_AXI_ARESETN)||((axil_write_ready)&&(awskd_addr == UART_SETUP)))
 		tx_uart_reset <= 1'b1;
-	else if ((axil_write_ready)&&(awskd_addr[1:0]== UART_TXREG) && wskd_strb[1])
+	else if ((axil_write_ready)&&(awskd_addr[1:0]== UART_TXREG) && wskd_strb[1]
+			&& !r_packed)
 		tx_uart_reset <= wskd_data[12];
 	else
 		tx_uart_reset <= 1'b0;
 
 `ifdef	FORMAL
 	(* anyseq *) reg w_uart_tx, w_tx_busy;
-	assign	tx_busy   = w_uart_tx;
+	assign	tx_busy   = w_tx_busy;
 	assign	o_uart_tx = w_uart_tx;
 `else
 `ifdef	USE_LITE_UART
-	txuartlite #(.CLOCKS_PER_BAUD(INITIAL_SETUP[23:0])) tx(S_AXI_ACLK, (tx_empty_n), tx_data,
+	txuartlite #(.CLOCKS_PER_BAUD(INITIAL_SETUP[23:0]), .LGFRAC(LGFRAC))
+		tx(S_AXI_ACLK, (tx_empty_n), tx_data,
 			o_uart_tx, tx_busy);
 `else
 	wire	cts_n;
@@ -593,7 +906,8 @@ module	axiluart #(
 	// we read it here.  (You might notice above, we register a read any
 	// time (tx_empty_n) and (!tx_busy) are both true---the condition for
 	// starting to transmit a new byte.)
-	txuart	#(.INITIAL_SETUP(INITIAL_SETUP)) tx(S_AXI_ACLK, 1'b0, uart_setup,
+	txuart	#(.INITIAL_SETUP(INITIAL_SETUP), .LGFRAC(LGFRAC))
+		tx(S_AXI_ACLK, 1'b0, uart_setup,
 			r_tx_break, (tx_empty_n), tx_data,
 			cts_n, o_uart_tx, tx_busy);
 `endif
@@ -626,8 +940,10 @@ module	axiluart #(
 	// Each of the FIFO's returns a 16 bit status value.  This value tells
 	// us both how big the FIFO is, as well as how much of the FIFO is in 
 	// use.  Let's merge those two status words together into a word we
-	// can use when reading about the FIFO.
-	assign	axil_fifo_data = { txf_status, rxf_status };
+	// can use when reading about the FIFO.  The receive half's H bit
+	// mirrors the receive FIFO interrupt, threshold and timeout alike.
+	assign	axil_fifo_data = { txf_status, rxf_status[15:2],
+				o_uart_rxfifo_int, rxf_status[0] };
 
 	// }}}
 	/////////////////////////////////////////
@@ -661,7 +977,7 @@ module	axiluart #(
 	if (!S_AXI_RVALID || S_AXI_RREADY)
 	begin
 		casez(r_axil_addr)
-		UART_SETUP: axil_read_data <= { 1'b0, uart_setup };
+		UART_SETUP: axil_read_data <= { r_packed, uart_setup };
 		UART_FIFO:  axil_read_data <= axil_fifo_data;
 		UART_RXREG: axil_read_data <= axil_rx_data;
 		UART_TXREG: axil_read_data <= axil_tx_data;
@@ -694,7 +1010,8 @@ module	axiluart #(
 	wire	unused;
 	assign	unused = &{ 1'b0, S_AXI_AWPROT, S_AXI_ARPROT,
 			S_AXI_ARADDR[ADDRLSB-1:0],
-			S_AXI_AWADDR[ADDRLSB-1:0], new_setup[31] };
+			S_AXI_AWADDR[ADDRLSB-1:0], S_AXIS_TLAST,
+			M_AXIS_TDATA };
 	// Verilator lint_on  UNUSED
 	// }}}
 `ifdef	FORMAL
@@ -794,7 +1111,7 @@ module	axiluart #(
 		S_AXI_ARVALID && S_AXI_ARREADY && S_AXI_ARADDR[3:2]== UART_SETUP
 		|=> r_preread && r_axil_addr == UART_SETUP
 		##1 S_AXI_RVALID && axil_read_data
-						== { 1'b0, $past(uart_setup) });
+						== { $past(r_packed), $past(uart_setup) });
 			
 	assert property (@(posedge S_AXI_ACLK)
 		disable iff (!S_AXI_ARESETN || (S_AXI_RVALID && !S_AXI_RREADY))
@@ -823,6 +1140,68 @@ module	axiluart #(
 	if (OPT_LOWPOWER && !S_AXI_RVALID)
 		assert(S_AXI_RDATA == 0);
 
+	// }}}
+	////////////////////////////////////////////////////////////////////////
+	//
+	// The AXI-Stream master and slave
+	//
+	////////////////////////////////////////////////////////////////////////
+	//
+	// {{{
+
+	// Once presented, a received byte must stay presented, unchanged,
+	// until it's taken--unless the receive FIFO is reset beneath it
+	always @(posedge S_AXI_ACLK)
+	if ((f_past_valid)&&($past(S_AXI_ARESETN))&&(S_AXI_ARESETN)
+		&&(!$past(rx_break))&&(!$past(rx_uart_reset))
+		&&($past(M_AXIS_TVALID))&&(!$past(M_AXIS_TREADY)))
+	begin
+		assert(M_AXIS_TVALID);
+		assert($stable(M_AXIS_TDATA));
+		assert($stable(M_AXIS_TLAST));
+	end
+
+	always @(*)
+	if (!LCL_STREAM)
+	begin
+		assert(!M_AXIS_TVALID);
+		assert(!S_AXIS_TREADY);
+	end
+
+	// Taking a byte from the stream master is a read, and so restarts the
+	// receive idle timeout, just as a bus read would
+	always @(posedge S_AXI_ACLK)
+	if ((f_past_valid)&&($past(axis_rx_read)))
+	begin
+		assert(rx_idle == 16'h0);
+		assert(!rx_timeout_int);
+	end
+
+	// }}}
+	////////////////////////////////////////////////////////////////////////
+	//
+	// The receive interrupts
+	//
+	////////////////////////////////////////////////////////////////////////
+	//
+	// {{{
+
+	// The receive interrupt is set while anything is waiting to be read,
+	// and clears once the last of it has been
+	always @(*)
+		assert(o_uart_rx_int == rx_waiting);
+
+	// A read of the receive register restarts the idle timeout.  On the
+	// clock after one, the receive FIFO interrupt is therefore only set
+	// if the FIFO is still at its threshold.
+	always @(posedge S_AXI_ACLK)
+	if ((f_past_valid)&&(($past(rxf_axil_read))||($past(r_rxp_read))))
+	begin
+		assert(rx_idle == 16'h0);
+		assert(!rx_timeout_int);
+		assert(o_uart_rxfifo_int == rx_level_int);
+	end
+
 	// }}}
 	////////////////////////////////////////////////////////////////////////
 	//
@@ -836,6 +1215,14 @@ module	axiluart #(
 	// set above, you'll probably still want to cover something
 	// application specific here
 
+	// Bytes moving through both stream ports
+	always @(*)
+	if ((LCL_STREAM)&&(S_AXI_ARESETN))
+	begin
+		cover(axis_rx_read);
+		cover(axis_tx_write);
+	end
+
 	// }}}
 	// }}}
 `endif
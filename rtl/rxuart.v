@@ -58,6 +58,14 @@
 //	32'h0006c8		// For 115,200 baud, 8 bit, no parity
 //	32'h005161		// For 9600 baud, 8 bit, no parity
 //	
+//	If the core is built with LGFRAC > 0, the low LGFRAC bits of
+//	i_setup[23:0] are instead a fraction of a clock, just as in txuart.v.
+//	The fraction is accumulated from one baud interval to the next, and
+//	each carry adds a clock to a baud interval, so the sampling error
+//	doesn't grow from one bit to the next.  Every bit is still sampled
+//	within about a clock of its center:  the half baud interval to the
+//	middle of the start bit is truncated to whole clocks, and each later
+//	interval is rounded to the nearest clock.
 //
 //
 // Creator:	Dan Gisselquist, Ph.D.
@@ -95,6 +103,9 @@ module rxuart #(
 		// {{{
 		// 8 data bits, no parity, (at least 1) stop bit
 		parameter [30:0] INITIAL_SETUP = 31'd868,
+		// LGFRAC: The number of fractional bits in the baud rate.
+		// Zero, the default, for whole clocks only.
+		parameter [3:0]	LGFRAC = 0,
 		// States: (@ baud counter == 0)
 		//	0	First bit arrives
 		//	..7	Bits arrive
@@ -153,16 +164,17 @@ module rxuart #(
 	reg	[7:0]	data_reg;
 	reg		calc_parity;
 	reg		pre_wr;
+	wire		baud_carry;
 
-	assign	clocks_per_baud = { 4'h0, r_setup[23:0] };
+	assign	clocks_per_baud = { 4'h0, r_setup[23:0] } >> LGFRAC;
 	// assign hw_flow_control = !r_setup[30];
 	assign	data_bits   = r_setup[29:28];
 	assign	dblstop     = r_setup[27];
 	assign	use_parity  = r_setup[26];
 	assign	fixd_parity = r_setup[25];
 	assign	parity_even = r_setup[24];
-	assign	break_condition = { r_setup[23:0], 4'h0 };
-	assign	half_baud = { 5'h00, r_setup[23:1] }-28'h1;
+	assign	break_condition = { clocks_per_baud[23:0], 4'h0 };
+	assign	half_baud = ({ 4'h0, r_setup[23:0] } >> (LGFRAC+1))-28'h1;
 
 	// }}}
 
@@ -407,8 +419,8 @@ module rxuart #(
 			// the parity bit must be zero.
 			o_parity_err <= (calc_parity != ck_uart);
 		else
-			// Parity odd: the parity bit must equal the
-			// XOR of all the data bits.
+			// Parity odd: the parity bit must differ from
+			// the XOR of all the data bits.
 			o_parity_err <= (calc_parity == ck_uart);
 	end else if (state >= RXU_BREAK)
 		o_parity_err <= 1'b0;
@@ -487,7 +499,7 @@ module rxuart #(
 	if (i_reset)
 		baud_counter <= clocks_per_baud-28'h01;
 	else if (zero_baud_counter)
-		baud_counter <= clocks_per_baud-28'h01;
+		baud_counter <= clocks_per_baud+{ 27'h0, baud_carry }-28'h01;
 	else case(state)
 		RXU_RESET_IDLE:baud_counter <= clocks_per_baud-28'h01;
 		RXU_BREAK:	baud_counter <= clocks_per_baud-28'h01;
@@ -496,6 +508,34 @@ module rxuart #(
 	endcase
 	// }}}
 
+	// baud_carry
+	// {{{
+	// With a fractional baud rate, the fraction is accumulated across the
+	// baud intervals of each character, and any carry adds one clock to
+	// the next.  Starting from one half, rather than zero, rounds each
+	// sample to the nearest clock.
+	generate if (LGFRAC > 0)
+	begin : GEN_FRACTIONAL_BAUD
+		localparam [(LGFRAC-1):0]	HALF = 1 << (LGFRAC-1);
+		reg	[(LGFRAC-1):0]	baud_frac;
+		wire	[LGFRAC:0]	next_frac;
+
+		assign	next_frac = { 1'b0, baud_frac }
+					+ { 1'b0, r_setup[(LGFRAC-1):0] };
+
+		initial	baud_frac = 0;
+		always @(posedge i_clk)
+		if ((i_reset)||(state >= RXU_BREAK))
+			baud_frac <= HALF;
+		else if (zero_baud_counter)
+			baud_frac <= next_frac[(LGFRAC-1):0];
+
+		assign	baud_carry = next_frac[LGFRAC];
+	end else begin : NO_FRACTION
+		assign	baud_carry = 1'b0;
+	end endgenerate
+	// }}}
+
 	// zero_baud_counter
 	// {{{
 	// Rather than testing whether or not (baud_counter == 0) within our
@@ -509,6 +549,79 @@ module rxuart #(
 	else
 		zero_baud_counter <= (baud_counter == 28'h01);
 	// }}}
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//
+// Formal properties
+// {{{
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+`ifdef	FORMAL
+`ifdef	RXUART
+`define	ASSUME	assume
+`else
+`define	ASSUME	assert
+`endif
+	// Declarations
+	// {{{
+	reg		f_past_valid;
+	// With LGFRAC > 0, the setup counts fractions of a clock, and a carry
+	// from that fraction adds one clock to a baud interval.  Every
+	// interval must then be within a clock of f_clocks_per_baud.
+	wire	[27:0]	f_clocks_per_baud, f_baud_max;
+
+	assign	f_clocks_per_baud = { 4'h0, r_setup[23:0] } >> LGFRAC;
+	assign	f_baud_max = f_clocks_per_baud
+				- ((LGFRAC == 0) ? 28'h1 : 28'h0);
+	// }}}
+
+	initial	f_past_valid = 1'b0;
+	always @(posedge i_clk)
+		f_past_valid <= 1'b1;
+
+	// Setup
+	// {{{
+	// As in wbuart.v, the setup only ever changes together with a reset
+	always @(posedge i_clk)
+	if ((f_past_valid)&&(!i_reset))
+		`ASSUME($stable(i_setup));
+
+	always @(*)
+		`ASSUME(({ 4'h0, i_setup[23:0] } >> LGFRAC) > 2);
+
+	always @(*)
+		assert(f_clocks_per_baud > 2);
+
+	// Once out of the reset, r_setup only ever holds the current setup
+	always @(*)
+	if ((f_past_valid)&&(!i_reset)&&(state != RXU_RESET_IDLE))
+		assert(r_setup == i_setup[29:0]);
+	// }}}
+
+	// Baud interval bounds
+	// {{{
+	always @(*)
+		assert((state <= RXU_SECOND_STOP)||(state >= RXU_BREAK));
+
+	// While receiving a character, the baud counter never holds more
+	// than one baud interval, and zero_baud_counter tracks it exactly
+	always @(*)
+	if (state <= RXU_SECOND_STOP)
+	begin
+		assert(baud_counter <= f_baud_max);
+		assert(zero_baud_counter == (baud_counter == 0));
+	end
+
+	// Every reload is within a clock of f_clocks_per_baud
+	always @(posedge i_clk)
+	if ((f_past_valid)&&(!$past(i_reset))&&($past(zero_baud_counter))
+			&&(state <= RXU_SECOND_STOP))
+		assert(baud_counter + 28'h1 >= f_clocks_per_baud);
+	// }}}
+`endif	// FORMAL
+// }}}
 endmodule
 
 
@@ -15,6 +15,10 @@
 //	This interface only handles 8N1 serial port communications.  It does
 //	not handle the break, parity, or frame error conditions.
 //
+//	With LGFRAC > 0, CLOCKS_PER_BAUD is given in units of 2^-LGFRAC clocks,
+//	and the fraction is carried from one baud interval to the next, as in
+//	rxuart.v.
+//
 //
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
@@ -56,6 +60,9 @@ module rxuartlite #(
 `else
 		parameter  [(TIMER_BITS-1):0]	CLOCKS_PER_BAUD = 868,	// 115200 MBaud at 100MHz
 `endif
+		// LGFRAC -- the number of fractional bits in CLOCKS_PER_BAUD.
+		// Zero, the default, for whole clocks only.
+		parameter	[3:0]		LGFRAC = 0,
 		localparam			TB = TIMER_BITS,
 		//
 		localparam [3:0]	RXUL_BIT_ZERO  = 4'h0,
@@ -84,10 +91,15 @@ module rxuartlite #(
 
 	// Signal/register declarations
 	// {{{
+	// The whole clocks in each baud interval, and the fraction left over
+	localparam [(TB-1):0]	BAUD_CLOCKS = CLOCKS_PER_BAUD >> LGFRAC,
+				BAUD_FRAC = CLOCKS_PER_BAUD
+						- (BAUD_CLOCKS << LGFRAC);
 	wire	[(TB-1):0]	half_baud;
 	reg	[3:0]		state;
+	wire			baud_carry;
 
-	assign	half_baud = { 1'b0, CLOCKS_PER_BAUD[(TB-1):1] };
+	assign	half_baud = CLOCKS_PER_BAUD >> (LGFRAC+1);
 	reg	[(TB-1):0]	baud_counter;
 	reg			zero_baud_counter;
 
@@ -204,15 +216,43 @@ module rxuartlite #(
 	initial	baud_counter = 0;
 	always @(posedge i_clk)
 	if (((state==RXUL_IDLE))&&(!ck_uart)&&(half_baud_time))
-		baud_counter <= CLOCKS_PER_BAUD-1'b1;
+		baud_counter <= BAUD_CLOCKS-1'b1;
 	else if (state == RXUL_WAIT)
 		baud_counter <= 0;
 	else if ((zero_baud_counter)&&(state < RXUL_STOP))
-		baud_counter <= CLOCKS_PER_BAUD-1'b1;
+		baud_counter <= BAUD_CLOCKS+{ {(TB-1){1'b0}}, baud_carry }-1'b1;
 	else if (!zero_baud_counter)
 		baud_counter <= baud_counter-1'b1;
 	// }}}
 
+	// baud_carry
+	// {{{
+	// With a fractional CLOCKS_PER_BAUD, the fraction is accumulated
+	// across the baud intervals of each character, and any carry adds one
+	// clock to the next.  Starting from one half rounds each sample to the
+	// nearest clock.
+	generate if (LGFRAC > 0)
+	begin : GEN_FRACTIONAL_BAUD
+		localparam [(LGFRAC-1):0]	HALF = 1 << (LGFRAC-1);
+		reg	[(LGFRAC-1):0]	baud_frac;
+		wire	[LGFRAC:0]	next_frac;
+
+		assign	next_frac = { 1'b0, baud_frac }
+					+ { 1'b0, BAUD_FRAC[(LGFRAC-1):0] };
+
+		initial	baud_frac = HALF;
+		always @(posedge i_clk)
+		if (state == RXUL_IDLE)
+			baud_frac <= HALF;
+		else if ((zero_baud_counter)&&(state < RXUL_STOP))
+			baud_frac <= next_frac[(LGFRAC-1):0];
+
+		assign	baud_carry = next_frac[LGFRAC];
+	end else begin : NO_FRACTION
+		assign	baud_carry = 1'b0;
+	end endgenerate
+	// }}}
+
 	// zero_baud_counter
 	// {{{
 	// Rather than testing whether or not (baud_counter == 0) within our
@@ -252,6 +292,10 @@ module rxuartlite #(
 `ifdef	FORMAL
 `define ASSUME	assume
 `define ASSERT	assert
+// The transmitter model below sends whole clocks per baud.  Checks of the
+// receiver's timing and data against it therefore only apply when
+// LGFRAC == 0.  With a fraction, only the baud counter bounds are proven.
+`define	WHOLE_BAUD_ASSERT(X)	assert((LGFRAC != 0)||(X))
 `ifdef	VERIFIC
 	// We need this to use $global_clock below
 	(* gclk *) wire	gbl_clk;
@@ -503,31 +547,31 @@ module rxuartlite #(
 		f_rx_count <= f_rx_count + 1'b1;
 	always @(posedge i_clk)
 	if (state == 0)
-		`ASSERT(f_rx_count
+		`WHOLE_BAUD_ASSERT(f_rx_count
 				== half_baud + (CLOCKS_PER_BAUD-baud_counter));
 	else if (state == 1)
-		`ASSERT(f_rx_count == half_baud + 2 * CLOCKS_PER_BAUD
+		`WHOLE_BAUD_ASSERT(f_rx_count == half_baud + 2 * CLOCKS_PER_BAUD
 					- baud_counter);
 	else if (state == 2)
-		`ASSERT(f_rx_count == half_baud + 3 * CLOCKS_PER_BAUD
+		`WHOLE_BAUD_ASSERT(f_rx_count == half_baud + 3 * CLOCKS_PER_BAUD
 					- baud_counter);
 	else if (state == 3)
-		`ASSERT(f_rx_count == half_baud + 4 * CLOCKS_PER_BAUD
+		`WHOLE_BAUD_ASSERT(f_rx_count == half_baud + 4 * CLOCKS_PER_BAUD
 					- baud_counter);
 	else if (state == 4)
-		`ASSERT(f_rx_count == half_baud + 5 * CLOCKS_PER_BAUD
+		`WHOLE_BAUD_ASSERT(f_rx_count == half_baud + 5 * CLOCKS_PER_BAUD
 					- baud_counter);
 	else if (state == 5)
-		`ASSERT(f_rx_count == half_baud + 6 * CLOCKS_PER_BAUD
+		`WHOLE_BAUD_ASSERT(f_rx_count == half_baud + 6 * CLOCKS_PER_BAUD
 					- baud_counter);
 	else if (state == 6)
-		`ASSERT(f_rx_count == half_baud + 7 * CLOCKS_PER_BAUD
+		`WHOLE_BAUD_ASSERT(f_rx_count == half_baud + 7 * CLOCKS_PER_BAUD
 					- baud_counter);
 	else if (state == 7)
-		`ASSERT(f_rx_count == half_baud + 8 * CLOCKS_PER_BAUD
+		`WHOLE_BAUD_ASSERT(f_rx_count == half_baud + 8 * CLOCKS_PER_BAUD
 					- baud_counter);
 	else if (state == 8)
-		`ASSERT((f_rx_count == half_baud + 9 * CLOCKS_PER_BAUD
+		`WHOLE_BAUD_ASSERT((f_rx_count == half_baud + 9 * CLOCKS_PER_BAUD
 					- baud_counter)
 			||(f_rx_count == half_baud + 10 * CLOCKS_PER_BAUD
 					- baud_counter));
@@ -539,6 +583,17 @@ module rxuartlite #(
 			||((zero_baud_counter)&&(baud_counter == 0))
 			||((!zero_baud_counter)&&(baud_counter != 0)));
 
+	// Between characters the baud counter is stopped at zero
+	always @(*)
+	if (state >= RXUL_WAIT)
+		`ASSERT(zero_baud_counter);
+
+	// Every baud interval, fractional or not, is either BAUD_CLOCKS or
+	// (given a carry) one more
+	always @(posedge i_clk)
+	if ((f_past_valid)&&($past(zero_baud_counter))&&(!zero_baud_counter))
+		`ASSERT(baud_counter + 1 >= BAUD_CLOCKS);
+
 	always @(posedge i_clk)
 	if (!f_past_valid)
 		`ASSERT((state == RXUL_IDLE)&&(baud_counter == 0)
@@ -625,47 +680,47 @@ module rxuartlite #(
 
 	always @($global_clock)
 	if (state == RXUL_WAIT)
-		`ASSERT((!f_tx_busy)||(f_tx_reg[9:1] == 0));
+		`WHOLE_BAUD_ASSERT((!f_tx_busy)||(f_tx_reg[9:1] == 0));
 
 	always @($global_clock)
 	if (state == RXUL_IDLE)
 	begin
-		`ASSERT((!f_tx_busy)||(f_tx_reg[9])||(f_tx_reg[9:1]==0));
+		`WHOLE_BAUD_ASSERT((!f_tx_busy)||(f_tx_reg[9])||(f_tx_reg[9:1]==0));
 		if (!ck_uart)
 			;//`PHASE_TWO_ASSERT((f_rx_count < 4)||(f_sub_baud_difference <= ((CLOCKS_PER_BAUD<<F_CKRES)/20)));
 		else
-			`ASSERT((f_tx_reg[9:1]==0)||(f_tx_count < (3 + CLOCKS_PER_BAUD/2)));
+			`WHOLE_BAUD_ASSERT((f_tx_reg[9:1]==0)||(f_tx_count < (3 + CLOCKS_PER_BAUD/2)));
 	end else if (state == 0)
-		`ASSERT(f_sub_baud_difference
+		`WHOLE_BAUD_ASSERT(f_sub_baud_difference
 				<=  2 * ((CLOCKS_PER_BAUD<<F_CKRES)/20));
 	else if (state == 1)
-		`ASSERT(f_sub_baud_difference
+		`WHOLE_BAUD_ASSERT(f_sub_baud_difference
 				<=  3 * ((CLOCKS_PER_BAUD<<F_CKRES)/20));
 	else if (state == 2)
-		`ASSERT(f_sub_baud_difference
+		`WHOLE_BAUD_ASSERT(f_sub_baud_difference
 				<=  4 * ((CLOCKS_PER_BAUD<<F_CKRES)/20));
 	else if (state == 3)
-		`ASSERT(f_sub_baud_difference
+		`WHOLE_BAUD_ASSERT(f_sub_baud_difference
 				<=  5 * ((CLOCKS_PER_BAUD<<F_CKRES)/20));
 	else if (state == 4)
-		`ASSERT(f_sub_baud_difference
+		`WHOLE_BAUD_ASSERT(f_sub_baud_difference
 				<=  6 * ((CLOCKS_PER_BAUD<<F_CKRES)/20));
 	else if (state == 5)
-		`ASSERT(f_sub_baud_difference
+		`WHOLE_BAUD_ASSERT(f_sub_baud_difference
 				<=  7 * ((CLOCKS_PER_BAUD<<F_CKRES)/20));
 	else if (state == 6)
-		`ASSERT(f_sub_baud_difference
+		`WHOLE_BAUD_ASSERT(f_sub_baud_difference
 				<=  8 * ((CLOCKS_PER_BAUD<<F_CKRES)/20));
 	else if (state == 7)
-		`ASSERT(f_sub_baud_difference
+		`WHOLE_BAUD_ASSERT(f_sub_baud_difference
 				<=  9 * ((CLOCKS_PER_BAUD<<F_CKRES)/20));
 	else if (state == 8)
-		`ASSERT(f_sub_baud_difference
+		`WHOLE_BAUD_ASSERT(f_sub_baud_difference
 				<= 10 * ((CLOCKS_PER_BAUD<<F_CKRES)/20));
 
 	always @(posedge i_clk)
 	if (o_wr)
-		`ASSERT(o_data == $past(f_tx_data,4));
+		`WHOLE_BAUD_ASSERT(o_data == $past(f_tx_data,4));
 
 	// always @(posedge i_clk)
 	// if ((zero_baud_counter)&&(state != 4'hf)&&(CLOCKS_PER_BAUD > 6))
@@ -676,33 +731,33 @@ module rxuartlite #(
 	// if ((f_past_valid)&&(state != $past(state)))
 	begin
 		if (state == 4'h0)
-			`ASSERT(!data_reg[7]);
+			`WHOLE_BAUD_ASSERT(!data_reg[7]);
 
 		if (state == 4'h1)
-			`ASSERT((data_reg[7]
+			`WHOLE_BAUD_ASSERT((data_reg[7]
 				== $past(f_tx_data[0]))&&(!data_reg[6]));
 
 		if (state == 4'h2)
-			`ASSERT(data_reg[7:6]
+			`WHOLE_BAUD_ASSERT(data_reg[7:6]
 					== $past(f_tx_data[1:0]));
 
 		if (state == 4'h3)
-			`ASSERT(data_reg[7:5] == $past(f_tx_data[2:0]));
+			`WHOLE_BAUD_ASSERT(data_reg[7:5] == $past(f_tx_data[2:0]));
 
 		if (state == 4'h4)
-			`ASSERT(data_reg[7:4] == $past(f_tx_data[3:0]));
+			`WHOLE_BAUD_ASSERT(data_reg[7:4] == $past(f_tx_data[3:0]));
 
 		if (state == 4'h5)
-			`ASSERT(data_reg[7:3] == $past(f_tx_data[4:0]));
+			`WHOLE_BAUD_ASSERT(data_reg[7:3] == $past(f_tx_data[4:0]));
 
 		if (state == 4'h6)
-			`ASSERT(data_reg[7:2] == $past(f_tx_data[5:0]));
+			`WHOLE_BAUD_ASSERT(data_reg[7:2] == $past(f_tx_data[5:0]));
 
 		if (state == 4'h7)
-			`ASSERT(data_reg[7:1] == $past(f_tx_data[6:0]));
+			`WHOLE_BAUD_ASSERT(data_reg[7:1] == $past(f_tx_data[6:0]));
 
 		if (state == 4'h8)
-			`ASSERT(data_reg[7:0] == $past(f_tx_data[7:0]));
+			`WHOLE_BAUD_ASSERT(data_reg[7:0] == $past(f_tx_data[7:0]));
 	end
 	// }}}
 	////////////////////////////////////////////////////////////////////////
@@ -745,7 +800,10 @@ module rxuartlite #(
 	always @(*)
 		assert(zero_baud_counter == (baud_counter == 0)? 1'b1:1'b0);
 	always @(*)
-		assert(baud_counter <= CLOCKS_PER_BAUD-1'b1);
+	if (LGFRAC == 0)
+		assert(baud_counter <= BAUD_CLOCKS-1'b1);
+	else	// A carry may add one clock
+		assert(baud_counter <= BAUD_CLOCKS);
 	// }}}
 `endif
 // }}}
@@ -63,6 +63,14 @@
 //	32'h0006c8		// For 115,200 baud, 8 bit, no parity
 //	32'h005161		// For 9600 baud, 8 bit, no parity
 //	
+//	If the core is built with LGFRAC > 0, the low LGFRAC bits of
+//	i_setup[23:0] are instead a fraction of a clock.  The field then holds
+//	the clocks per baud times 2^LGFRAC, so that at 100 MHz and LGFRAC=4,
+//	3 Mbaud (33 1/3 clocks per baud) may be set as 24'd533, rather than
+//	being rounded to 24'd33 (3.03 Mbaud).  Each baud interval is the whole
+//	number of clocks, plus one whenever the fraction, accumulated from one
+//	interval to the next, carries.  Hence no bit edge is ever more than a
+//	clock from where it belongs.
 //
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
@@ -99,6 +107,9 @@
 module txuart #(
 		// {{{
 		parameter	[30:0]	INITIAL_SETUP = 31'd868,
+		// LGFRAC: The number of fractional bits in the baud rate, as
+		// above.  Zero, the default, for whole clocks only.
+		parameter	[3:0]	LGFRAC = 0,
 		//
 		localparam 	[3:0]	TXU_BIT_ZERO  = 4'h0,
 		localparam 	[3:0]	TXU_BIT_ONE   = 4'h1,
@@ -137,21 +148,23 @@ module txuart #(
 
 	// Signal declarations
 	// {{{
-	wire	[27:0]	clocks_per_baud, break_condition;
+	wire	[27:0]	clocks_per_baud, break_condition, i_clocks_per_baud;
 	wire	[1:0]	i_data_bits, data_bits;
 	wire		use_parity, parity_odd, dblstop, fixd_parity,
 			fixdp_value, hw_flow_control, i_parity_odd;
+	wire		baud_carry;
 	reg	[30:0]	r_setup;
-	assign	clocks_per_baud = { 4'h0, r_setup[23:0] };
-	assign	break_condition = { r_setup[23:0], 4'h0 };
+	assign	clocks_per_baud = { 4'h0, r_setup[23:0] } >> LGFRAC;
+	assign	i_clocks_per_baud = { 4'h0, i_setup[23:0] } >> LGFRAC;
+	assign	break_condition = { clocks_per_baud[23:0], 4'h0 };
 	assign	hw_flow_control = !r_setup[30];
 	assign	i_data_bits     =  i_setup[29:28];
 	assign	data_bits       =  r_setup[29:28];
 	assign	dblstop         =  r_setup[27];
 	assign	use_parity      =  r_setup[26];
 	assign	fixd_parity     =  r_setup[25];
-	assign	i_parity_odd    =  i_setup[24];
-	assign	parity_odd      =  r_setup[24];
+	assign	i_parity_odd    = !i_setup[24];
+	assign	parity_odd      = !r_setup[24];
 	assign	fixdp_value     =  r_setup[24];
 
 	reg	[27:0]	baud_counter;
@@ -321,11 +334,11 @@ module txuart #(
 	// Calculate the parity to be placed into the parity bit.  If the
 	// parity is fixed, then the parity bit is given by the fixed parity
 	// value (r_setup[24]).  Otherwise the parity is given by the GF2
-	// sum of all the data bits (plus one for even parity).
+	// sum of all the data bits (plus one for odd parity).
 	initial	calc_parity = 1'b0;
 	always @(posedge i_clk)
 	if (!o_busy)
-		calc_parity <= i_setup[24];
+		calc_parity <= i_parity_odd;
 	else if (fixd_parity)
 		calc_parity <= fixdp_value;
 	else if (zero_baud_counter)
@@ -404,16 +417,47 @@ module txuart #(
 			zero_baud_counter <= 1'b1;
 			if ((i_wr)&&(!r_busy))
 			begin
-				baud_counter <= { 4'h0, i_setup[23:0]} - 28'h01;
+				baud_counter <= i_clocks_per_baud - 28'h01;
 				zero_baud_counter <= 1'b0;
 			end
 		end else if (last_state)
-			baud_counter <= clocks_per_baud - 28'h02;
+			baud_counter <= clocks_per_baud
+					+ { 27'h0, baud_carry } - 28'h02;
 		else
-			baud_counter <= clocks_per_baud - 28'h01;
+			baud_counter <= clocks_per_baud
+					+ { 27'h0, baud_carry } - 28'h01;
 	end
 	// }}}
 
+	// baud_carry
+	// {{{
+	// With a fractional baud rate, the fraction is accumulated from one
+	// baud interval to the next.  Any carry out of it adds one more clock
+	// to the next baud interval.  The accumulator starts each character
+	// holding the fraction itself--the start bit has already been counted.
+	generate if (LGFRAC > 0)
+	begin : GEN_FRACTIONAL_BAUD
+		reg	[(LGFRAC-1):0]	baud_frac;
+		wire	[LGFRAC:0]	next_frac;
+
+		assign	next_frac = { 1'b0, baud_frac }
+					+ { 1'b0, r_setup[(LGFRAC-1):0] };
+
+		initial	baud_frac = 0;
+		always @(posedge i_clk)
+		if ((i_reset)||(i_break))
+			baud_frac <= 0;
+		else if (state == TXU_IDLE)
+			baud_frac <= i_setup[(LGFRAC-1):0];
+		else if (zero_baud_counter)
+			baud_frac <= next_frac[(LGFRAC-1):0];
+
+		assign	baud_carry = next_frac[LGFRAC];
+	end else begin : NO_FRACTION
+		assign	baud_carry = 1'b0;
+	end endgenerate
+	// }}}
+
 	// last_state
 	// {{{
 	initial	last_state = 1'b0;
@@ -428,7 +472,7 @@ module txuart #(
 	// {{{
 	// Verilator lint_off UNUSED
 	wire	unused;
-	assign	unused = &{ 1'b0, i_parity_odd, data_bits };
+	assign	unused = &{ 1'b0, data_bits };
 	// Verilator lint_on  UNUSED
 	// }}}
 ////////////////////////////////////////////////////////////////////////////////
@@ -445,6 +489,10 @@ module txuart #(
 	// {{{
 	reg		fsv_parity;
 	reg	[30:0]	fsv_setup;
+	// With LGFRAC > 0, the setup counts fractions of a clock.  Any carry
+	// from that fraction adds one clock to a baud interval, so every
+	// interval must then be within a clock of f_clocks_per_baud.
+	wire	[27:0]	f_clocks_per_baud, f_baud_max;
 	reg	[7:0]	fsv_data;
 	reg		f_past_valid;
 	//
@@ -472,6 +520,10 @@ module txuart #(
 	always @(*)
 		assert(r_setup == fsv_setup);
 
+	assign	f_clocks_per_baud = { 4'h0, fsv_setup[23:0] } >> LGFRAC;
+	assign	f_baud_max = f_clocks_per_baud
+				- ((LGFRAC == 0) ? 28'h1 : 28'h0);
+
 
 	always @(posedge i_clk)
 		assert(zero_baud_counter == (baud_counter == 0));
@@ -534,7 +586,7 @@ module txuart #(
 	begin
 		assert(fsv_setup[29:28] == data_bits);
 		assert(data_bits == 2'b11);
-		assert(baud_counter < fsv_setup[23:0]);
+		assert(baud_counter <= f_baud_max);
 
 		assert(1'b0 == |f_six_seq);
 		assert(1'b0 == |f_seven_seq);
@@ -616,7 +668,7 @@ module txuart #(
 	begin
 		assert(fsv_setup[29:28] == 2'b10);
 		assert(fsv_setup[29:28] == data_bits);
-		assert(baud_counter < fsv_setup[23:0]);
+		assert(baud_counter <= f_baud_max);
 
 		assert(1'b0 == |f_five_seq);
 		assert(1'b0 == |f_seven_seq);
@@ -705,7 +757,7 @@ module txuart #(
 	begin
 		assert(fsv_setup[29:28] == 2'b01);
 		assert(fsv_setup[29:28] == data_bits);
-		assert(baud_counter < fsv_setup[23:0]);
+		assert(baud_counter <= f_baud_max);
 
 		assert(1'b0 == |f_five_seq);
 		assert(1'b0 == |f_six_seq);
@@ -798,7 +850,7 @@ module txuart #(
 	begin
 		assert(fsv_setup[29:28] == 2'b00);
 		assert(fsv_setup[29:28] == data_bits);
-		assert(baud_counter < { 6'h0, fsv_setup[23:0]});
+		assert(baud_counter <= f_baud_max);
 
 		assert(1'b0 == |f_five_seq);
 		assert(1'b0 == |f_six_seq);
@@ -887,7 +939,15 @@ module txuart #(
 	if (((|f_five_seq[5:0]) || (|f_six_seq[6:0]) || (|f_seven_seq[7:0])
 			|| (|f_eight_seq[8:0]))
 		&& ($past(zero_baud_counter)))
-		assert(baud_counter == { 4'h0, fsv_setup[23:0] }-1);
+	begin
+		if (LGFRAC == 0)
+			assert(baud_counter == f_clocks_per_baud - 1);
+		else begin
+			// A carry may add one clock
+			assert(baud_counter + 1 >= f_clocks_per_baud);
+			assert(baud_counter <= f_clocks_per_baud);
+		end
+	end
 
 	// }}}
 	////////////////////////////////////////////////////////////////////////
@@ -965,7 +1025,7 @@ module txuart #(
 	begin
 		assert(state == 4'hf);
 		assert(o_uart_tx);
-		assert(baud_counter < fsv_setup[23:0]-1'b1);
+		assert(baud_counter < f_baud_max);
 	end
 		
 
@@ -974,10 +1034,10 @@ module txuart #(
 		fsv_parity <= fsv_setup[24];
 	else
 		case(fsv_setup[29:28])
-		2'b00: fsv_parity = (^fsv_data[7:0]) ^ fsv_setup[24];
-		2'b01: fsv_parity = (^fsv_data[6:0]) ^ fsv_setup[24];
-		2'b10: fsv_parity = (^fsv_data[5:0]) ^ fsv_setup[24];
-		2'b11: fsv_parity = (^fsv_data[4:0]) ^ fsv_setup[24];
+		2'b00: fsv_parity = (^fsv_data[7:0]) ^ !fsv_setup[24];
+		2'b01: fsv_parity = (^fsv_data[6:0]) ^ !fsv_setup[24];
+		2'b10: fsv_parity = (^fsv_data[5:0]) ^ !fsv_setup[24];
+		2'b11: fsv_parity = (^fsv_data[4:0]) ^ !fsv_setup[24];
 		endcase
 	// }}}
 	//////////////////////////////////////////////////////////////////////
@@ -1000,7 +1060,7 @@ module txuart #(
 
 	always @(posedge i_clk)
 	if (f_break_seq[0])
-		assert(baud_counter == { $past(fsv_setup[23:0]), 4'h0 });
+		assert(baud_counter == { $past(f_clocks_per_baud[23:0]), 4'h0 });
 	always @(posedge i_clk)
 	if ((f_past_valid)&&($past(f_break_seq[1]))&&(state != TXU_BREAK))
 	begin
@@ -1036,7 +1096,9 @@ module txuart #(
 		f_counter <= f_counter + 1'b1;
 
 	always @(*)
-	if (f_five_seq[0]|f_six_seq[0]|f_seven_seq[0]|f_eight_seq[0])
+	if (LGFRAC != 0)
+		;	// These exact counts need whole clocks per baud
+	else if (f_five_seq[0]|f_six_seq[0]|f_seven_seq[0]|f_eight_seq[0])
 		// {{{
 		assert(f_counter == (fsv_setup[23:0] - baud_counter - 1));
 		// }}}
@@ -1197,15 +1259,37 @@ module txuart #(
 	//////////////////////////////////////////////////////////////////////
 	always @(*)
 		assert((state < 4'hb)||(state >= 4'he));
+
+	// Baud interval bounds
+	// {{{
+	// Outside of the idle and break states, which both follow a reset, the
+	// baud counter never holds more than one baud interval
+	always @(*)
+	if ((state != TXU_IDLE)&&(state != TXU_BREAK))
+	begin
+		assert(r_busy);
+		assert(baud_counter <= f_baud_max);
+	end
+
+	// Every reload is within a clock of f_clocks_per_baud.  The last
+	// stop bit, counted out in the idle state, is one clock short.
+	always @(posedge i_clk)
+	if ((f_past_valid)&&(!$past(i_reset))&&(!$past(i_break))
+			&&($past(zero_baud_counter))&&(!zero_baud_counter))
+	begin
+		assert(baud_counter <= f_baud_max);
+		assert(baud_counter + 28'h2 >= f_clocks_per_baud);
+	end
+	// }}}
 	//////////////////////////////////////////////////////////////////////
 	//
 	// Careless/limiting assumption section
 	//
 	//////////////////////////////////////////////////////////////////////
 	always @(*)
-		assume(i_setup[23:0] > 2);
+		assume(i_clocks_per_baud > 2);
 	always @(*)
-		assert(fsv_setup[23:0] > 2);
+		assert(f_clocks_per_baud > 2);
 
 `endif	// FORMAL
 // }}}
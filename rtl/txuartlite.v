@@ -20,6 +20,10 @@
 //	them set until the busy line is low.  Then I move on to the next piece
 //	of data.)
 //
+//	With LGFRAC > 0, CLOCKS_PER_BAUD is given in units of 2^-LGFRAC clocks,
+//	and the fraction is carried from one baud interval to the next, as in
+//	txuart.v.
+//
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
 //
@@ -61,7 +65,10 @@ module txuartlite #(
 		localparam		TB = TIMING_BITS,
 		// CLOCKS_PER_BAUD -- the number of system clocks per baud
 		// interval.
-		parameter	[(TB-1):0]	CLOCKS_PER_BAUD = 8 // 24'd868
+		parameter	[(TB-1):0]	CLOCKS_PER_BAUD = 8, // 24'd868
+		// LGFRAC -- the number of fractional bits in CLOCKS_PER_BAUD.
+		// Zero, the default, for whole clocks only.
+		parameter	[3:0]	LGFRAC = 0
 		// }}}
 	) (
 		// {{{
@@ -89,11 +96,16 @@ module txuartlite #(
 			//	TXUL_BIT_SEVEN = 4'h7,
 				TXUL_STOP      = 4'h8,
 				TXUL_IDLE      = 4'hf;
+	// The whole clocks in each baud interval, and the fraction left over
+	localparam [(TB-1):0]	BAUD_CLOCKS = CLOCKS_PER_BAUD >> LGFRAC,
+				BAUD_FRAC = CLOCKS_PER_BAUD
+						- (BAUD_CLOCKS << LGFRAC);
 
 	reg	[(TB-1):0]	baud_counter;
 	reg	[3:0]	state;
 	reg	[7:0]	lcl_data;
 	reg		r_busy, zero_baud_counter;
+	wire		baud_carry;
 	// }}}
 
 	// Big state machine controlling: r_busy, state
@@ -222,7 +234,7 @@ module txuartlite #(
 			zero_baud_counter <= 1'b1;
 			if ((i_wr)&&(!r_busy))
 			begin
-				baud_counter <= CLOCKS_PER_BAUD - 1'b1;
+				baud_counter <= BAUD_CLOCKS - 1'b1;
 				zero_baud_counter <= 1'b0;
 			end
 		end else if (!zero_baud_counter)
@@ -237,11 +249,37 @@ module txuartlite #(
 			// is complete, so we can start on the next byte
 			// exactly 10*CLOCKS_PER_BAUD clocks after we started
 			// the last one
-			baud_counter <= CLOCKS_PER_BAUD - 2;
+			baud_counter <= BAUD_CLOCKS + { {(TB-1){1'b0}}, baud_carry } - 2;
 		else // All other states
-			baud_counter <= CLOCKS_PER_BAUD - 1'b1;
+			baud_counter <= BAUD_CLOCKS + { {(TB-1){1'b0}}, baud_carry } - 1'b1;
 	end
 	// }}}
+
+	// baud_carry
+	// {{{
+	// With a fractional CLOCKS_PER_BAUD, the fraction is accumulated from
+	// one baud interval to the next, and any carry adds one clock to the
+	// next interval.
+	generate if (LGFRAC > 0)
+	begin : GEN_FRACTIONAL_BAUD
+		reg	[(LGFRAC-1):0]	baud_frac;
+		wire	[LGFRAC:0]	next_frac;
+
+		assign	next_frac = { 1'b0, baud_frac }
+					+ { 1'b0, BAUD_FRAC[(LGFRAC-1):0] };
+
+		initial	baud_frac = 0;
+		always @(posedge i_clk)
+		if (state == TXUL_IDLE)
+			baud_frac <= BAUD_FRAC[(LGFRAC-1):0];
+		else if (zero_baud_counter)
+			baud_frac <= next_frac[(LGFRAC-1):0];
+
+		assign	baud_carry = next_frac[LGFRAC];
+	end else begin : NO_FRACTION
+		assign	baud_carry = 1'b0;
+	end endgenerate
+	// }}}
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -265,6 +303,11 @@ module txuartlite #(
 	reg	[7:0]		f_request_tx_data;
 	wire	[3:0]		subcount;
 
+	// The longest baud interval is BAUD_CLOCKS, less one for the clock
+	// where the counter is reloaded--unless a fractional carry adds it back
+	localparam [(TB-1):0]	F_BAUD_MAX = (LGFRAC == 0) ? (BAUD_CLOCKS-1)
+						: BAUD_CLOCKS;
+
 	// Setup
 	// {{{
 	initial	f_past_valid = 1'b0;
@@ -301,11 +344,23 @@ module txuartlite #(
 		f_baud_count <= f_baud_count + 1'b1;
 
 	always @(posedge i_clk)
-		assert(f_baud_count < CLOCKS_PER_BAUD);
+		assert(f_baud_count <= F_BAUD_MAX);
 
 	always @(posedge i_clk)
 	if (baud_counter != 0)
 		assert(o_busy);
+
+	// Every reload must be within a clock of BAUD_CLOCKS, save the stop
+	// bit which ends one clock early
+	always @(posedge i_clk)
+	if ((f_past_valid)&&($past(zero_baud_counter))&&(!zero_baud_counter))
+	begin
+		assert(baud_counter <= F_BAUD_MAX);
+		if ($past(state) == TXUL_STOP)
+			assert(baud_counter + 2 >= BAUD_CLOCKS);
+		else
+			assert(baud_counter + 1 >= BAUD_CLOCKS);
+	end
 	// }}}
 
 	// {{{
@@ -420,11 +475,15 @@ module txuartlite #(
 	// Once the byte is transmitted, make certain we return to
 	// idle
 	//
-	assert property (
-		@(posedge i_clk)
-		(i_wr)&&(!o_busy)
-		|=> ((o_busy) throughout SEND(CLOCKS_PER_BAUD,fsv_data))
-		##1 (!o_busy)&&(o_uart_tx)&&(zero_baud_counter));
+	// With a fraction, the baud intervals aren't all the same length
+	generate if (LGFRAC == 0)
+	begin : F_WHOLE_BAUD
+		assert property (
+			@(posedge i_clk)
+			(i_wr)&&(!o_busy)
+			|=> ((o_busy) throughout SEND(CLOCKS_PER_BAUD,fsv_data))
+			##1 (!o_busy)&&(o_uart_tx)&&(zero_baud_counter));
+	end endgenerate
 	// }}}
 
 	// {{{
@@ -445,9 +504,12 @@ module txuartlite #(
 	always @(*)
 		assert(zero_baud_counter == (baud_counter == 0));
 
-	// To make certain baud_counter stays below CLOCKS_PER_BAUD
+	// To make certain baud_counter stays within one baud interval
 	always @(*)
-		assert(baud_counter < CLOCKS_PER_BAUD);
+	if (LGFRAC == 0)
+		assert(baud_counter < BAUD_CLOCKS);
+	else
+		assert(baud_counter <= BAUD_CLOCKS);
 
 	//
 	// Insist that we are only ever in a valid state
@@ -13,6 +13,13 @@
 //	whereas the RXFIFO = 0 applies to writing to the FIFO from bus logic
 //	and reading it automatically any time the transmit UART is idle.
 //
+//	The FIFO may be up to 2^15 entries deep.  Its memory is only ever
+//	read into a register, r_data, from an address that isn't being written
+//	on the same clock, so that deeper FIFOs may be placed in block RAM.
+//	That register holds the value at the head of the FIFO, ready for the
+//	next read, one clock after it has been written.  For FIFOs deeper than
+//	2^10, the fill in o_status is only the top ten bits of the fill proper.
+//
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
 //
@@ -68,23 +75,21 @@ module ufifo #(
 	// Signal declarations
 	// {{{
 	reg	[(BW-1):0]	fifo[0:(FLEN-1)];
-	reg	[(BW-1):0]	r_data, last_write;
-	reg	[(LGFLEN-1):0]	wr_addr, rd_addr, r_next;
-	reg			will_overflow, will_underflow;
-	reg			osrc;
-
-	wire	[(LGFLEN-1):0]	w_waddr_plus_one, w_waddr_plus_two;
-	wire			w_write, w_read;
-	reg	[(LGFLEN-1):0]	r_fill;
+	reg	[(BW-1):0]	r_data;
+	reg	[(LGFLEN-1):0]	wr_addr, rd_addr;
+	reg			will_overflow, r_valid;
+
+	wire	[(LGFLEN-1):0]	w_waddr_plus_one;
+	wire			w_write, w_read, mem_empty, w_load;
+	reg	[(LGFLEN-1):0]	r_count, r_fill;
 	wire	[3:0]		lglen;
 	wire			w_half_full;
 	reg	[9:0]		w_fill;
 	// }}}
 
-	assign	w_write = (i_wr && (!will_overflow || i_rd));
+	assign	w_write = (i_wr && (!will_overflow || w_read));
 	assign	w_read  = (i_rd && o_empty_n);
 
-	assign	w_waddr_plus_two = wr_addr + 2;
 	assign	w_waddr_plus_one = wr_addr + 1;
 
 	////////////////////////////////////////////////////////////////////////
@@ -95,18 +100,34 @@ module ufifo #(
 	//
 	//
 
+	// r_count
+	// {{{
+	// The number of values within the FIFO, counting the one waiting in
+	// r_data to be read
+	initial	r_count = 0;
+	always @(posedge i_clk)
+	if (i_reset)
+		r_count <= 0;
+	else case({ w_write, w_read })
+	2'b01:	r_count <= r_count - 1'b1;
+	2'b10:	r_count <= r_count + 1'b1;
+	default:  begin end
+	endcase
+	// }}}
+
 	// will_overflow
 	// {{{
+	// One entry of the memory is always left empty, so the FIFO is full
+	// once it holds FLEN-1 values
 	initial	will_overflow = 1'b0;
 	always @(posedge i_clk)
 	if (i_reset)
 		will_overflow <= 1'b0;
-	else if (i_rd)
-		will_overflow <= (will_overflow)&&(i_wr);
-	else if (w_write)
-		will_overflow <= (will_overflow)||(w_waddr_plus_two == rd_addr);
-	else if (w_waddr_plus_one == rd_addr)
-		will_overflow <= 1'b1;
+	else case({ w_write, w_read })
+	2'b01:	will_overflow <= 1'b0;
+	2'b10:	will_overflow <= (r_count == { {(LGFLEN-1){1'b1}}, 1'b0 });
+	default:  begin end
+	endcase
 	// }}}
 
 	// wr_addr
@@ -136,78 +157,59 @@ module ufifo #(
 
 	// Notes
 	// {{{
-	//	Following a read, the next sample will be available on the
-	//	next clock
-	//	Clock	ReadCMD	ReadAddr	Output
-	//	0	0	0		fifo[0]
-	//	1	1	0		fifo[0]
-	//	2	0	1		fifo[1]
-	//	3	0	1		fifo[1]
-	//	4	1	1		fifo[1]
-	//	5	1	2		fifo[2]
-	//	6	0	3		fifo[3]
-	//	7	0	3		fifo[3]
+	//	The head of the FIFO is read from memory into r_data whenever
+	//	r_data is empty, or is being read, and the memory holds
+	//	something.  A value written on clock 0 is thus ready to be read
+	//	on clock 2.  Reads may then follow on every clock, each taking
+	//	the value loaded on the one before it.
+	//
+	//	Clock	Write	Read	rd_addr	r_valid	r_data
+	//	0	A	0	0	0	-
+	//	1	B	0	0	0	-
+	//	2	0	0	1	1	A
+	//	3	0	1	1	1	A
+	//	4	0	1	2	1	B
+	//	5	0	0	2	0	B
+	//
+	//	Since nothing is ever read from the address being written,
+	//	there's no need to bypass the memory.
 	// }}}
 
-	// will_underflow
-	// {{{
-	initial	will_underflow = 1'b1;
-	always @(posedge i_clk)
-	if (i_reset)
-		will_underflow <= 1'b1;
-	else if (i_wr)
-		will_underflow <= 1'b0;
-	else if (w_read)
-		will_underflow <= (will_underflow)||(r_next == wr_addr);
-	// }}}
+	assign	mem_empty = (wr_addr == rd_addr);
+	assign	w_load    = (!mem_empty)&&((!r_valid)||(w_read));
 
-	// rd_addr, r_next
+	// rd_addr
 	// {{{
-	// Don't report FIFO underflow errors.  These'll be caught elsewhere
-	// in the system, and the logic below makes it hard to reset them.
-	// We'll still report FIFO overflow, however.
-	//
 	initial	rd_addr = 0;
-	initial	r_next  = 1;
 	always @(posedge i_clk)
 	if (i_reset)
-	begin
 		rd_addr <= 0;
-		r_next  <= 1;
-	end else if (w_read)
-	begin
+	else if (w_load)
 		rd_addr <= rd_addr + 1;
-		r_next  <= rd_addr + 2;
-	end
 	// }}}
 
 	// Read from the FIFO
 	// {{{
 	always @(posedge i_clk)
-	if (w_read)
-		r_data <= fifo[r_next[LGFLEN-1:0]];
+	if (w_load)
+		r_data <= fifo[rd_addr];
 	// }}}
 
-	// last_write -- for bypassing the memory read
+	// r_valid
 	// {{{
-	always @(posedge i_clk)
-	if (i_wr && (!o_empty_n || (w_read && r_next == wr_addr)))
-		last_write <= i_data;
-	// }}}
-
-	// osrc
-	// {{{
-	initial	osrc = 1'b0;
+	// Don't report FIFO underflow errors.  These'll be caught elsewhere
+	// in the system.  We'll still report FIFO overflow, however.
+	initial	r_valid = 1'b0;
 	always @(posedge i_clk)
 	if (i_reset)
-		osrc <= 1'b0;
-	else if (i_wr && (!o_empty_n || (w_read && r_next == wr_addr)))
-		osrc <= 1'b1;
-	else if (i_rd)
-		osrc <= 1'b0;
+		r_valid <= 1'b0;
+	else if (w_load)
+		r_valid <= 1'b1;
+	else if (w_read)
+		r_valid <= 1'b0;
 	// }}}
 
-	assign o_data = (osrc) ? last_write : r_data;
+	assign o_data = r_data;
 	// }}}
 	////////////////////////////////////////////////////////////////////////
 	//
@@ -227,40 +229,14 @@ module ufifo #(
 	// Adjust for these differences here.
 	generate if (RXFIFO)
 	begin : RXFIFO_FILL
-		// {{{
-		// Calculate the number of elements in our FIFO
-		//
-		// Although used for receive, this is actually the more
-		// generic answer--should you wish to use the FIFO in
-		// another context.
-
-		initial	r_fill = 0;
-		always @(posedge i_clk)
-		if (i_reset)
-			r_fill <= 0;
-		else case({ w_write, w_read })
-		2'b01:	r_fill <= r_fill - 1'b1;
-		2'b10:	r_fill <= r_fill + 1'b1;
-		default:  begin end
-		endcase
-		// }}}
+		// The number of elements in our FIFO
+		always @(*)
+			r_fill = r_count;
 	end else begin : TXFIFO_FILL
-		// {{{
-		// Calculate the number of empty elements in our FIFO
-		//
-		// This is the number you could send to the FIFO
-		// if you wanted to.
-
-		initial	r_fill = -1;
-		always @(posedge i_clk)
-		if (i_reset)
-			r_fill <= -1;
-		else case({ w_write, w_read })
-		2'b01:	r_fill <= r_fill + 1'b1;
-		2'b10:	r_fill <= r_fill - 1'b1;
-		default:  begin end
-		endcase
-		// }}}
+		// The number of empty elements in our FIFO.  This is the
+		// number you could send to the FIFO if you wanted to.
+		always @(*)
+			r_fill = ~r_count;
 	end endgenerate
 	// }}}
 
@@ -273,11 +249,19 @@ module ufifo #(
 	// {{{
 	assign lglen = LGFLEN;
 
-	always @(*)
-	begin
-		w_fill = 0;
-		w_fill[(LGFLEN-1):0] = r_fill;
-	end
+	generate if (LGFLEN > 10)
+	begin : SCALED_FILL
+		// Deeper FIFOs report their fill, in o_status, in units of
+		// 2^(LGFLEN-10) entries
+		always @(*)
+			w_fill = r_fill[(LGFLEN-1):(LGFLEN-10)];
+	end else begin : EXACT_FILL
+		always @(*)
+		begin
+			w_fill = 0;
+			w_fill[(LGFLEN-1):0] = r_fill;
+		end
+	end endgenerate
 
 	assign	w_half_full = r_fill[(LGFLEN-1)];
 
@@ -300,11 +284,11 @@ module ufifo #(
 		// receive FIFO), or be written to (if it isn't).  An interrupt
 		// may be sourced from this bit, indicating that at least one
 		// operation will be successful.
-		(RXFIFO!=0)?!will_underflow:!will_overflow
+		(RXFIFO!=0)?r_valid:!will_overflow
 	};
 	// }}}
 
-	assign	o_empty_n = !will_underflow;
+	assign	o_empty_n = r_valid;
 	// }}}
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -330,35 +314,35 @@ module ufifo #(
 	//
 	//
 	reg	[LGFLEN-1:0]	f_fill;
-	wire	[LGFLEN-1:0]	f_raddr_plus_one;
 
+	// f_fill is the number of values in memory, not yet loaded into r_data
 	always @(*)
 		f_fill = wr_addr - rd_addr;
 
 	always @(*)
-		assert(will_underflow == (f_fill == 0));
+		assert({ 1'b0, r_count } == { 1'b0, f_fill } + { {(LGFLEN){1'b0}}, r_valid });
 
 	always @(*)
-		assert(will_overflow  == (&f_fill));
+		assert(will_overflow == (&r_count));
 
-	assign	f_raddr_plus_one = rd_addr + 1;
+	always @(*)
+		assert(mem_empty == (f_fill == 0));
 
+	// The memory is never left holding more than one value while r_data
+	// is empty
 	always @(*)
-		assert(f_raddr_plus_one  == r_next);
+	if (!r_valid)
+		assert(f_fill <= 1);
 
 	always @(*)
-	if (will_underflow)
-	begin
+	if (!r_valid)
 		assert(!w_read);
-		assert(!osrc);
-	end
-
 
-	always @(posedge i_clk)
+	always @(*)
 	if (RXFIFO)
-		assert(r_fill == f_fill);
+		assert(r_fill == r_count);
 	else
-		assert(r_fill == (~f_fill));
+		assert(r_fill == (~r_count));
 	// }}}
 	////////////////////////////////////////////////////////////////////////
 	//
@@ -374,12 +358,15 @@ module ufifo #(
 	(* anyconst *) reg [BW-1:0]	f_const_data, f_const_second;
 	reg [LGFLEN-1:0]	f_next_addr;
 	reg	[1:0]		f_state;
-	reg			f_first_in_fifo, f_second_in_fifo;
+	reg			f_first_in_mem, f_first_in_reg,
+				f_second_in_mem, f_second_in_reg;
 	reg	[LGFLEN-1:0]	f_distance_to_first, f_distance_to_second;
 	// }}}
 
-	// Determine if those data values are at their addresses in the FIFO
+	// Determine where those data values are in the FIFO
 	// {{{
+	// Each is either in memory, at its address and not yet loaded, or
+	// has been loaded into r_data, leaving rd_addr just past it
 	always @(*)
 	begin
 		f_next_addr = f_const_addr + 1;
@@ -387,12 +374,15 @@ module ufifo #(
 		f_distance_to_first  = f_const_addr - rd_addr;
 		f_distance_to_second = f_next_addr  - rd_addr;
 
-		f_first_in_fifo  = (f_distance_to_first  < f_fill)
-			&& !will_underflow
+		f_first_in_mem  = (f_distance_to_first  < f_fill)
 			&& (fifo[f_const_addr] == f_const_data);
-		f_second_in_fifo = (f_distance_to_second < f_fill)
-			&& !will_underflow
+		f_second_in_mem = (f_distance_to_second < f_fill)
 			&& (fifo[f_next_addr] == f_const_second);
+
+		f_first_in_reg  = r_valid && (rd_addr == f_next_addr)
+			&& (r_data == f_const_data);
+		f_second_in_reg = r_valid && (rd_addr == f_next_addr + 1'b1)
+			&& (r_data == f_const_second);
 	end
 	// }}}
 
@@ -406,11 +396,11 @@ module ufifo #(
 	2'b00: if (w_write &&(wr_addr == f_const_addr)
 			&&(i_data == f_const_data))
 		f_state <= 2'b01;
-	2'b01: if (w_read && (rd_addr == f_const_addr))
+	2'b01: if (w_read && (rd_addr == f_next_addr))
 			f_state <= 2'b00;
-		else if (w_write && (wr_addr == f_next_addr))
+		else if (w_write)
 			f_state <= (i_data == f_const_second) ? 2'b10 : 2'b00;
-	2'b10: if (w_read && (rd_addr == f_const_addr))
+	2'b10: if (w_read && (rd_addr == f_next_addr))
 			f_state <= 2'b11;
 	2'b11: if (w_read)
 			f_state <= 2'b00;
@@ -423,21 +413,16 @@ module ufifo #(
 	case(f_state)
 	2'b00: begin end
 	2'b01: begin
-		assert(!will_underflow);
-		assert(f_first_in_fifo);
-		assert(!f_second_in_fifo);
+		assert(r_count != 0);
 		assert(wr_addr == f_next_addr);
-		assert(fifo[f_const_addr] == f_const_data);
-		if (rd_addr == f_const_addr)
-			assert(o_data == f_const_data);
+		assert(f_first_in_mem || f_first_in_reg);
 		end
 	2'b10: begin
-		assert(f_first_in_fifo);
-		assert(f_second_in_fifo);
+		assert(f_first_in_mem || f_first_in_reg);
+		assert(f_second_in_mem);
 		end
 	2'b11: begin
-		assert(f_second_in_fifo);
-		assert(rd_addr == f_next_addr);
+		assert(f_second_in_reg);
 		assert(o_data  == f_const_second);
 		end
 	endcase
@@ -466,7 +451,7 @@ module ufifo #(
 	always @(posedge i_clk)
 	if (i_reset)
 		cvr_filled <= 0;
-	else if (&f_fill[LGFLEN-1:0])
+	else if (&r_count)
 		cvr_filled <= 1;
 
 	always @(*)
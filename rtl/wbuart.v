@@ -46,13 +46,23 @@ module	wbuart #(
 		// {{{
 		// 4MB 8N1, when using 100MHz clock
 		parameter [30:0] INITIAL_SETUP = 31'd25,
+		// LGFRAC: The number of fractional bits in the baud rate,
+		// setup[23:0].  With LGFRAC > 0, the baud field holds the
+		// clocks per baud times 2^LGFRAC, as in txuart.v.
+		parameter [3:0]	LGFRAC = 0,
+		// LGFLEN: The log (based two) of our FIFOs size.  Maxes out
+		// at 15, representing a FIFO length of 32768.
 		parameter [3:0]	LGFLEN = 4,
 		parameter [0:0]	HARDWARE_FLOW_CONTROL_PRESENT = 1'b1,
+		// OPT_PACKED allows setup bit 31 to select packed access to the
+		// FIFOs, moving several bytes per bus word rather than one.
+		// It's off by default, so that bit 31 keeps reading as zero.
+		parameter [0:0]	OPT_PACKED = 1'b0,
 		// Perform a simple/quick bounds check on the log FIFO length,
 		// to make sure its within the bounds we can support with our
-		// current interface.
-		localparam [3:0]	LCLLGFLEN = (LGFLEN > 4'ha)? 4'ha
-					: ((LGFLEN < 4'h2) ? 4'h2 : LGFLEN)
+		// current interface.  The FIFO register's four bit size field
+		// can't report anything over 15, so LGFLEN has only four bits.
+		localparam [3:0]	LCLLGFLEN = (LGFLEN < 4'h2) ? 4'h2 : LGFLEN
 		// }}}
 	) (
 		// {{{
@@ -85,6 +95,8 @@ module	wbuart #(
 	// {{{
 	wire	tx_busy;
 	reg	[30:0]	uart_setup;
+	reg		r_packed;
+	wire		wb_stb;
 	// Receiver
 	wire		rx_stb, rx_break, rx_perr, rx_ferr, ck_uart;
 	wire	[7:0]	rx_uart_data;
@@ -92,18 +104,34 @@ module	wbuart #(
 	// Receive FIFO
 	wire		rx_empty_n, rx_fifo_err;
 	wire	[7:0]	rxf_wb_data;
-	wire	[15:0]	rxf_status;
+	wire	[15:0]	rxf_status, rxf_fill;
 	reg		rxf_wb_read;
 	//
 	wire	[(LCLLGFLEN-1):0]	check_cutoff;
 	reg			r_rx_perr, r_rx_ferr;
 	wire	[31:0]		wb_rx_data;
+	// The packed receive buffer
+	reg	[23:0]		rxp_data;
+	reg	[1:0]		rxp_count;
+	reg			r_rxp_read;
+	wire			rxp_fill;
+	// The receive threshold and idle timeout interrupt
+	reg	[15:0]		rx_threshold;
+	reg	[15:0]		rx_timeout, rx_idle;
+	reg	[23:0]		rx_baud_counter;
+	reg			rx_baud_tick;
+	wire	[23:0]		rx_baud;
+	wire			rx_waiting, rx_level_int, rx_timeout_int;
+	wire	[15:0]		rx_level;
 	// The transmitter
 	wire		tx_empty_n, txf_err, tx_break;
 	wire	[7:0]	tx_data;
 	wire	[15:0]	txf_status;
 	reg		txf_wb_write, tx_uart_reset;
 	reg	[7:0]	txf_wb_data;
+	// The packed transmit buffer
+	reg	[31:0]	txp_data;
+	reg	[3:0]	txp_sel;
 	//
 	wire	[31:0]	wb_tx_data;
 	wire	[31:0]	wb_fifo_data;
@@ -111,6 +139,13 @@ module	wbuart #(
 	reg		r_wb_ack;
 	// }}}
 
+	// wb_stb
+	// {{{
+	// A request is only accepted when we aren't stalled.  (We only stall
+	// while unpacking a packed transmit write, below.)
+	assign	wb_stb = (i_wb_stb)&&(!o_wb_stall);
+	// }}}
+
 	// uart_setup
 	// {{{
 	// The UART setup parameters: bits per byte, stop bits, parity, and
@@ -122,7 +157,7 @@ module	wbuart #(
 	// Under wishbone rules, a write takes place any time i_wb_stb
 	// is high.  If that's the case, and if the write was to the
 	// setup address, then set us up for the new parameters.
-	if ((i_wb_stb)&&(i_wb_addr == UART_SETUP)&&(i_wb_we))
+	if ((wb_stb)&&(i_wb_addr == UART_SETUP)&&(i_wb_we))
 	begin
 		if (i_wb_sel[0])
 			uart_setup[7:0] <= i_wb_data[7:0];
@@ -136,6 +171,20 @@ module	wbuart #(
 				i_wb_data[29:24] };
 	end
 	// }}}
+
+	// r_packed
+	// {{{
+	// The top bit of the setup register, otherwise unused, selects packed
+	// access to the FIFOs.  Reads of the receive register then return up
+	// to three bytes at a time, and writes to the transmit register send
+	// one byte for every byte lane selected.  Since any write to the setup
+	// register resets both FIFOs, nothing is ever left half packed when
+	// this changes.
+	initial	r_packed = 1'b0;
+	always @(posedge i_clk)
+	if ((wb_stb)&&(i_wb_addr == UART_SETUP)&&(i_wb_we)&&(i_wb_sel[3]))
+		r_packed <= (OPT_PACKED)&&(i_wb_data[31]);
+	// }}}
 	////////////////////////////////////////////////////////////////////////
 	//
 	// The UART receiver
@@ -150,9 +199,23 @@ module	wbuart #(
 	// the UART input, a clock, and a reset line, and produces outputs:
 	// a stb (true when new data is ready), and an 8-bit data out value
 	// valid when stb is high.
+`ifdef	FORMAL
+	// {{{
+	// The receiver has its own proof.  Here, it may produce anything.
+	(* anyseq *) reg	w_rx_stb, w_rx_break, w_rx_perr, w_rx_ferr,
+				w_ck_uart;
+	(* anyseq *) reg [7:0]	w_rx_data;
+	assign	rx_stb       = w_rx_stb;
+	assign	rx_uart_data = w_rx_data;
+	assign	rx_break     = w_rx_break;
+	assign	rx_perr      = w_rx_perr;
+	assign	rx_ferr      = w_rx_ferr;
+	assign	ck_uart      = w_ck_uart;
+	// }}}
+`else
 `ifdef	USE_LITE_UART
 	// {{{
-	rxuartlite	#(.CLOCKS_PER_BAUD(INITIAL_SETUP[23:0]))
+	rxuartlite	#(.CLOCKS_PER_BAUD(INITIAL_SETUP[23:0]), .LGFRAC(LGFRAC))
 		rx(i_clk, i_uart_rx, rx_stb, rx_uart_data);
 	assign	rx_break = 1'b0;
 	assign	rx_perr  = 1'b0;
@@ -163,7 +226,8 @@ module	wbuart #(
 	// {{{
 	// The full receiver also produces a break value (true during a break
 	// cond.), and parity/framing error flags--also valid when stb is true.
-	rxuart	#(.INITIAL_SETUP(INITIAL_SETUP)) rx(i_clk, (i_reset)||(rx_uart_reset),
+	rxuart	#(.INITIAL_SETUP(INITIAL_SETUP), .LGFRAC(LGFRAC))
+		rx(i_clk, (i_reset)||(rx_uart_reset),
 			uart_setup, i_uart_rx,
 			rx_stb, rx_uart_data, rx_break,
 			rx_perr, rx_ferr, ck_uart);
@@ -171,6 +235,7 @@ module	wbuart #(
 	// with it?
 	// }}}
 `endif
+`endif	// FORMAL
 	// }}}
 
 	// The receive FIFO
@@ -193,16 +258,124 @@ module	wbuart #(
 		rxfifo(i_clk, (i_reset)||(rx_break)||(rx_uart_reset),
 			rx_stb, rx_uart_data,
 			rx_empty_n,
-			rxf_wb_read, rxf_wb_data,
+			(rxf_wb_read)||(rxp_fill), rxf_wb_data,
 			rxf_status, rx_fifo_err);
 	// }}}
 
-	assign	o_uart_rxfifo_int = rxf_status[1];
+	// rxf_fill
+	// {{{
+	// The number of bytes in the receive FIFO, for the threshold and flow
+	// control below.  Up to 2^10, the FIFO's status register holds it.
+	// Deeper FIFOs only report the top ten bits of their fill there, so
+	// it's counted here instead, following the FIFO's own count:  up on
+	// any byte the FIFO accepts, and down on any byte read from it.
+	generate if (LCLLGFLEN > 4'ha)
+	begin : GEN_RXF_COUNT
+		reg	[15:0]	r_rxf_fill;
+
+		initial	r_rxf_fill = 16'h0;
+		always @(posedge i_clk)
+		if ((i_reset)||(rx_break)||(rx_uart_reset))
+			r_rxf_fill <= 16'h0;
+		else case({ (rx_stb)&&(!rx_fifo_err),
+				((rxf_wb_read)||(rxp_fill))&&(rx_empty_n) })
+		2'b01:	r_rxf_fill <= r_rxf_fill - 1'b1;
+		2'b10:	r_rxf_fill <= r_rxf_fill + 1'b1;
+		default: begin end
+		endcase
+
+		assign	rxf_fill = r_rxf_fill;
+	end else begin : GEN_RXF_STATUS
+		assign	rxf_fill = { 6'h0, rxf_status[11:2] };
+	end endgenerate
+	// }}}
+
+	// rx_threshold, rx_timeout
+	// {{{
+	// Writes to the otherwise read-only FIFO register set when the receive
+	// FIFO interrupt is generated.  The bottom sixteen bits set a fill
+	// threshold: the interrupt is set once the receive FIFO holds at least
+	// this many bytes.  Zero, the default, keeps the original half-full
+	// interrupt.  The top sixteen bits set an idle timeout, in baud
+	// intervals: if anything is waiting to be read, yet nothing has been
+	// received or read for this long, the interrupt is set as well.  Zero,
+	// the default, turns the timeout off.  Something near four character
+	// times (40 baud intervals for 8N1) is the classic choice, so that a
+	// partly filled FIFO is never left waiting on a threshold that the
+	// remaining data will never reach.
+	initial	rx_threshold = 16'h0;
+	initial	rx_timeout   = 16'h0;
+	always @(posedge i_clk)
+	if ((wb_stb)&&(i_wb_addr == UART_FIFO)&&(i_wb_we))
+	begin
+		if (i_wb_sel[0])
+			rx_threshold[7:0] <= i_wb_data[7:0];
+		if (i_wb_sel[1])
+			rx_threshold[15:8] <= i_wb_data[15:8];
+		if (i_wb_sel[2])
+			rx_timeout[7:0] <= i_wb_data[23:16];
+		if (i_wb_sel[3])
+			rx_timeout[15:8] <= i_wb_data[31:24];
+	end
+	// }}}
+
+	// rx_baud_counter, rx_baud_tick
+	// {{{
+	// The idle timeout is measured in baud intervals, of the same clocks
+	// per baud as the receiver is using.  This counter is free running,
+	// so the timeout may be up to one baud interval short.
+`ifdef	USE_LITE_UART
+	assign	rx_baud = INITIAL_SETUP[23:0] >> LGFRAC;
+`else
+	assign	rx_baud = uart_setup[23:0] >> LGFRAC;
+`endif
+
+	initial	rx_baud_counter = 24'h0;
+	initial	rx_baud_tick    = 1'b0;
+	always @(posedge i_clk)
+	if (rx_baud_counter == 24'h0)
+	begin
+		rx_baud_counter <= rx_baud - 1'b1;
+		rx_baud_tick    <= 1'b1;
+	end else begin
+		rx_baud_counter <= rx_baud_counter - 1'b1;
+		rx_baud_tick    <= 1'b0;
+	end
+	// }}}
+
+	// rx_idle
+	// {{{
+	// The number of baud intervals since a byte was last received, or the
+	// receive register last read, while something is waiting to be read
+	assign	rx_waiting = (rx_empty_n)||(rxp_count != 2'b00);
+
+	initial	rx_idle = 16'h0;
+	always @(posedge i_clk)
+	if ((i_reset)||(rx_uart_reset)||(rx_stb)||(rxf_wb_read)||(r_rxp_read)
+			||(!rx_waiting))
+		rx_idle <= 16'h0;
+	else if ((rx_baud_tick)&&(rx_idle != 16'hffff))
+		rx_idle <= rx_idle + 1'b1;
+	// }}}
+
+	// In packed mode, up to three received bytes have already left the
+	// FIFO for the packed buffer.  They still count towards the threshold,
+	// and towards the half-full default, rather than delaying both.
+	assign	rx_level = rxf_fill + { 14'h0, rxp_count };
+	assign	rx_level_int = (rx_threshold == 16'h0)
+				? (rx_level >= (16'h1 << (LCLLGFLEN-1)))
+				: (rx_level >= rx_threshold);
+	assign	rx_timeout_int = (rx_timeout != 16'h0)&&(rx_waiting)
+				&&(rx_idle >= rx_timeout);
+
+	// The receive FIFO interrupt, then, is set once the FIFO reaches its
+	// threshold, or when whatever is in it has waited too long.
+	assign	o_uart_rxfifo_int = (rx_level_int)||(rx_timeout_int);
 
 	// We produce four interrupts.  One of the receive interrupts indicates
-	// whether or not the receive FIFO is non-empty.  This should wake up
-	// the CPU.
-	assign	o_uart_rx_int = rxf_status[0];
+	// whether or not the receive FIFO (or, in packed mode, the packed
+	// buffer) is non-empty.  This should wake up the CPU.
+	assign	o_uart_rx_int = (rxf_status[0])||(rxp_count != 2'b00);
 
 	// o_rts_n
 	// {{{
@@ -217,7 +390,7 @@ module	wbuart #(
 	always @(posedge i_clk)
 		o_rts_n <= ((HARDWARE_FLOW_CONTROL_PRESENT)
 			&&(!uart_setup[30])
-			&&(rxf_status[(LCLLGFLEN+1):2] > check_cutoff));
+			&&(rxf_fill[(LCLLGFLEN-1):0] > check_cutoff));
 	// }}}
 
 	// rxf_wb_read
@@ -228,8 +401,49 @@ module	wbuart #(
 	// delayed by an extra clock.
 	initial	rxf_wb_read = 1'b0;
 	always @(posedge i_clk)
-		rxf_wb_read <= (i_wb_stb)&&(i_wb_addr[1:0]== UART_RXREG)
-				&&(!i_wb_we);
+		rxf_wb_read <= (wb_stb)&&(i_wb_addr[1:0]== UART_RXREG)
+				&&(!i_wb_we)&&(!r_packed);
+	// }}}
+
+	// rxp_data, rxp_count: the packed receive buffer
+	// {{{
+	// In packed mode, bytes are moved from the receive FIFO into this
+	// buffer, one per clock, until it holds three of them.  A read of the
+	// receive register then returns (and empties) the whole buffer at
+	// once, the oldest byte in the bottom.  Since the buffer refills at
+	// one byte per clock, and a byte takes at least ten baud intervals to
+	// arrive, it will always be as full as it can be by the time the next
+	// read shows up.
+	initial	r_rxp_read = 1'b0;
+	always @(posedge i_clk)
+		r_rxp_read <= (wb_stb)&&(i_wb_addr[1:0]== UART_RXREG)
+				&&(!i_wb_we)&&(r_packed);
+
+	assign	rxp_fill = (r_packed)&&(rx_empty_n)
+				&&((rxp_count != 2'b11)||(r_rxp_read));
+
+	initial	rxp_count = 2'b00;
+	initial	rxp_data  = 24'h0;
+	always @(posedge i_clk)
+	if ((i_reset)||(rx_break)||(rx_uart_reset)||(!r_packed))
+	begin
+		rxp_count <= 2'b00;
+		rxp_data  <= 24'h0;
+	end else if (r_rxp_read)
+	begin
+		// The buffer is being read.  Start over, with whatever byte
+		// might be arriving from the FIFO on this clock.
+		rxp_count <= (rxp_fill) ? 2'b01 : 2'b00;
+		rxp_data  <= { 16'h0, (rxp_fill) ? rxf_wb_data : 8'h00 };
+	end else if (rxp_fill)
+	begin
+		rxp_count <= rxp_count + 1'b1;
+		case(rxp_count)
+		2'b00: rxp_data[ 7: 0] <= rxf_wb_data;
+		2'b01: rxp_data[15: 8] <= rxf_wb_data;
+		default: rxp_data[23:16] <= rxf_wb_data;
+		endcase
+	end
 	// }}}
 
 	// r_rx_perr, r_rx_ferr -- parity and framing errors
@@ -246,7 +460,7 @@ module	wbuart #(
 		// Clear the error
 		r_rx_perr <= 1'b0;
 		r_rx_ferr <= 1'b0;
-	end else if ((i_wb_stb)
+	end else if ((wb_stb)
 			&&(i_wb_addr[1:0]== UART_RXREG)&&(i_wb_we))
 	begin
 		// Reset the error lines if a '1' is ever written to
@@ -274,11 +488,11 @@ module	wbuart #(
 	// {{{
 	initial	rx_uart_reset = 1'b1;
 	always @(posedge i_clk)
-	if ((i_reset)||((i_wb_stb)&&(i_wb_addr[1:0]== UART_SETUP)&&(i_wb_we)))
+	if ((i_reset)||((wb_stb)&&(i_wb_addr[1:0]== UART_SETUP)&&(i_wb_we)))
 		// The receiver reset, always set on a master reset
 		// request.
 		rx_uart_reset <= 1'b1;
-	else if ((i_wb_stb)&&(i_wb_addr[1:0]== UART_RXREG)&&(i_wb_we)&&i_wb_sel[1])
+	else if ((wb_stb)&&(i_wb_addr[1:0]== UART_RXREG)&&(i_wb_we)&&i_wb_sel[1])
 		// Writes to the receive register will command a receive
 		// reset anytime bit[12] is set.
 		rx_uart_reset <= i_wb_data[12];
@@ -293,7 +507,16 @@ module	wbuart #(
 	// that would be read from the FIFO, an error indicator set upon
 	// reading from an empty FIFO, a break indicator, and the frame and
 	// parity error signals.
-	assign	wb_rx_data = { 16'h00,
+	//
+	// In packed mode, the same flags are moved up by sixteen bits, to make
+	// room for three bytes of data beneath them, and the number of bytes
+	// returned (zero to three) is placed in the top two bits.  The empty
+	// flag is then set when there are none.
+	assign	wb_rx_data = (r_packed) ? { rxp_count,
+				1'b0, rx_fifo_err,
+				rx_break, rx_ferr, r_rx_perr,
+				(rxp_count == 2'b00), rxp_data }
+			: { 16'h00,
 				3'h0, rx_fifo_err,
 				rx_break, rx_ferr, r_rx_perr, !rx_empty_n,
 				rxf_wb_data};
@@ -320,12 +543,34 @@ module	wbuart #(
 	initial	txf_wb_write = 1'b0;
 	always @(posedge i_clk)
 	begin
-		txf_wb_write <= (i_wb_stb)&&(i_wb_addr == UART_TXREG)
-					&&(i_wb_we)&&(i_wb_sel[0]);
+		txf_wb_write <= (wb_stb)&&(i_wb_addr == UART_TXREG)
+					&&(i_wb_we)&&(i_wb_sel[0])&&(!r_packed);
 		txf_wb_data  <= i_wb_data[7:0];
 	end
 	// }}}
 
+	// txp_data, txp_sel: the packed transmit buffer
+	// {{{
+	// In packed mode, a write to the transmit register is captured here,
+	// together with its byte selects.  Each byte lane that was selected is
+	// then written into the FIFO in turn, from the bottom lane up, at one
+	// lane per clock.  We stall the bus while more than one lane remains.
+	initial	txp_sel = 4'h0;
+	always @(posedge i_clk)
+	if ((i_reset)||(tx_uart_reset)||(!OPT_PACKED))
+		txp_sel <= 4'h0;
+	else if ((wb_stb)&&(i_wb_addr == UART_TXREG)&&(i_wb_we)&&(r_packed))
+		txp_sel <= i_wb_sel;
+	else
+		txp_sel <= txp_sel >> 1;
+
+	always @(posedge i_clk)
+	if ((wb_stb)&&(i_wb_addr == UART_TXREG)&&(i_wb_we))
+		txp_data <= i_wb_data;
+	else
+		txp_data <= txp_data >> 8;
+	// }}}
+
 	// Transmit FIFO
 	// {{{
 	// Most of this is just wire management.  The TX FIFO is identical in
@@ -335,9 +580,10 @@ module	wbuart #(
 	// break.  We read from the FIFO any time the UART transmitter is idle.
 	// and ... we just set the values (above) for controlling writing into
 	// this.
-	ufifo	#(.LGFLEN(LGFLEN), .RXFIFO(0))
+	ufifo	#(.LGFLEN(LCLLGFLEN), .RXFIFO(0))
 		txfifo(i_clk, (tx_break)||(tx_uart_reset),
-			txf_wb_write, txf_wb_data,
+			(txf_wb_write)||(txp_sel[0]),
+			(r_packed) ? txp_data[7:0] : txf_wb_data,
 			tx_empty_n,
 			(!tx_busy)&&(tx_empty_n), tx_data,
 			txf_status, txf_err);
@@ -369,8 +615,8 @@ module	wbuart #(
 	always @(posedge i_clk)
 	if (i_reset)
 		r_tx_break <= 1'b0;
-	else if ((i_wb_stb)&&(i_wb_addr[1:0]== UART_TXREG)&&(i_wb_we)
-		&&(i_wb_sel[1]))
+	else if ((wb_stb)&&(i_wb_addr[1:0]== UART_TXREG)&&(i_wb_we)
+		&&(i_wb_sel[1])&&(!r_packed))
 		r_tx_break <= i_wb_data[9];
 
 	assign	tx_break = r_tx_break;
@@ -386,21 +632,32 @@ module	wbuart #(
 	// This is nearly identical to the RX reset logic above.  Basically,
 	// any time someone writes to bit [12] the transmitter will go through
 	// a reset cycle.  Keep bit [12] low, and everything will proceed as
-	// normal.
+	// normal.  (In packed mode, bit [12] is data, so this is only
+	// available outside of it.)
 	initial	tx_uart_reset = 1'b1;
 	always @(posedge i_clk)
-	if((i_reset)||((i_wb_stb)&&(i_wb_addr ==  UART_SETUP)&&(i_wb_we)))
+	if((i_reset)||((wb_stb)&&(i_wb_addr ==  UART_SETUP)&&(i_wb_we)))
 		tx_uart_reset <= 1'b1;
-	else if ((i_wb_stb)&&(i_wb_addr[1:0]== UART_TXREG)&&(i_wb_we) && i_wb_sel[1])
+	else if ((wb_stb)&&(i_wb_addr[1:0]== UART_TXREG)&&(i_wb_we) && i_wb_sel[1]
+			&&(!r_packed))
 		tx_uart_reset <= i_wb_data[12];
 	else
 		tx_uart_reset <= 1'b0;
 	// }}}
 
 	// The actuall transmitter itself
+`ifdef	FORMAL
+	// {{{
+	// As with the receiver, the transmitter is proven on its own
+	(* anyseq *) reg	w_uart_tx, w_tx_busy;
+	assign	tx_busy   = w_tx_busy;
+	assign	o_uart_tx = w_uart_tx;
+	// }}}
+`else
 `ifdef	USE_LITE_UART
 	// {{{
-	txuartlite #(.CLOCKS_PER_BAUD(INITIAL_SETUP[23:0])) tx(i_clk, (tx_empty_n), tx_data,
+	txuartlite #(.CLOCKS_PER_BAUD(INITIAL_SETUP[23:0]), .LGFRAC(LGFRAC))
+		tx(i_clk, (tx_empty_n), tx_data,
 			o_uart_tx, tx_busy);
 	// }}}
 `else
@@ -421,11 +678,13 @@ module	wbuart #(
 	// we read it here.  (You might notice above, we register a read any
 	// time (tx_empty_n) and (!tx_busy) are both true---the condition for
 	// starting to transmit a new byte.)
-	txuart	#(.INITIAL_SETUP(INITIAL_SETUP)) tx(i_clk, 1'b0, uart_setup,
+	txuart	#(.INITIAL_SETUP(INITIAL_SETUP), .LGFRAC(LGFRAC))
+		tx(i_clk, 1'b0, uart_setup,
 			r_tx_break, (tx_empty_n), tx_data,
 			cts_n, o_uart_tx, tx_busy);
 	// }}}
 `endif
+`endif	// FORMAL
 
 	// wb_tx_data
 	// {{{
@@ -461,8 +720,10 @@ module	wbuart #(
 	// Each of the FIFO's returns a 16 bit status value.  This value tells
 	// us both how big the FIFO is, as well as how much of the FIFO is in 
 	// use.  Let's merge those two status words together into a word we
-	// can use when reading about the FIFO.
-	assign	wb_fifo_data = { txf_status, rxf_status };
+	// can use when reading about the FIFO.  The receive half's H bit
+	// mirrors the receive FIFO interrupt, threshold and timeout alike.
+	assign	wb_fifo_data = { txf_status, rxf_status[15:2],
+				o_uart_rxfifo_int, rxf_status[0] };
 	// }}}
 
 	// r_wb_addr
@@ -478,7 +739,7 @@ module	wbuart #(
 	// {{{
 	initial	r_wb_ack = 1'b0;
 	always @(posedge i_clk) // We'll ACK in two clocks
-		r_wb_ack <= i_wb_stb;
+		r_wb_ack <= wb_stb;
 	// }}}
 
 	// o_wb_ack
@@ -496,7 +757,7 @@ module	wbuart #(
 	// interconnect, etc.  For this reason, we can just simplify our logic.
 	always @(posedge i_clk)
 	casez(r_wb_addr)
-	UART_SETUP: o_wb_data <= { 1'b0, uart_setup };
+	UART_SETUP: o_wb_data <= { r_packed, uart_setup };
 	UART_FIFO:  o_wb_data <= wb_fifo_data;
 	UART_RXREG: o_wb_data <= wb_rx_data;
 	UART_TXREG: o_wb_data <= wb_tx_data;
@@ -505,19 +766,141 @@ module	wbuart #(
 
 	// o_wb_stall
 	// {{{
-	// This device never stalls.  Sure, it takes two clocks, but they are
-	// pipelined, and nothing stalls that pipeline.  (Creates FIFO errors,
-	// perhaps, but doesn't stall the pipeline.)  Hence, we can just
-	// set this value to zero.
-	assign	o_wb_stall = 1'b0;
+	// This device only stalls while writing the bytes of a packed write
+	// into the transmit FIFO, and then only if there's more than one byte
+	// left.  Otherwise, sure, it takes two clocks, but they are pipelined,
+	// and nothing stalls that pipeline.  (Creates FIFO errors, perhaps,
+	// but doesn't stall the pipeline.)  Without OPT_PACKED, this is always
+	// zero.
+	assign	o_wb_stall = (OPT_PACKED)&&(txp_sel[3:1] != 3'h0);
 	// }}}
 	// }}}
+`ifdef	FORMAL
+	////////////////////////////////////////////////////////////////////////
+	//
+	// Formal properties
+	// {{{
+	////////////////////////////////////////////////////////////////////////
+	//
+	// The receiver and transmitter are replaced by (* anyseq *) stubs
+	// above.  These properties are about what's left: the receive
+	// interrupts, and the packed buffers.
+	//
+	reg	f_past_valid;
+
+	initial	f_past_valid = 1'b0;
+	always @(posedge i_clk)
+		f_past_valid <= 1'b1;
 
-	// Make verilator happy
+	////////////////////////////////////////////////////////////////////////
+	//
+	// The receive interrupts
 	// {{{
-	// verilator lint_off UNUSED
-	wire	unused;
-	assign	unused = &{ 1'b0, i_wb_data[31] };
-	// verilator lint_on UNUSED
+	////////////////////////////////////////////////////////////////////////
+	//
+	//
+
+	// The receive interrupt is set while anything is waiting to be read,
+	// and clears once the last of it has been
+	always @(*)
+		assert(o_uart_rx_int == rx_waiting);
+
+	// A read of the receive register restarts the idle timeout.  On the
+	// clock after one, the receive FIFO interrupt is therefore only set
+	// if the FIFO is still at its threshold.
+	always @(posedge i_clk)
+	if ((f_past_valid)&&(($past(rxf_wb_read))||($past(r_rxp_read))))
+	begin
+		assert(rx_idle == 16'h0);
+		assert(!rx_timeout_int);
+		assert(o_uart_rxfifo_int == rx_level_int);
+	end
 	// }}}
+	////////////////////////////////////////////////////////////////////////
+	//
+	// Packed access
+	// {{{
+	////////////////////////////////////////////////////////////////////////
+	//
+	//
+	reg	[31:0]	f_txp_word;
+	reg	[3:0]	f_txp_sel;
+	reg	[1:0]	f_txp_count;
+
+	// Without OPT_PACKED, there's no packed mode, and nothing ever stalls
+	always @(*)
+	if (!OPT_PACKED)
+	begin
+		assert(!r_packed);
+		assert(txp_sel == 4'h0);
+		assert(!o_wb_stall);
+	end
+
+	// Outside of packed mode, both packed buffers are empty--save for the
+	// clock after leaving it, when the receiver is still being reset
+	always @(*)
+	if (!r_packed)
+	begin
+		assert(txp_sel == 4'h0);
+		if (!rx_uart_reset)
+			assert(rxp_count == 2'b00);
+	end
+
+	// Packed and unpacked accesses never reach either FIFO together
+	always @(*)
+	begin
+		assert((!txf_wb_write)||(!txp_sel[0]));
+		assert((!rxf_wb_read)||(!r_rxp_read));
+	end
+
+	// The packed receive buffer holds rxp_count bytes, from the bottom up,
+	// and nothing above them.  Unused bytes therefore read as zero.
+	always @(*)
+	case(rxp_count)
+	2'b00: assert(rxp_data == 24'h0);
+	2'b01: assert(rxp_data[23:8] == 16'h0);
+	2'b10: assert(rxp_data[23:16] == 8'h0);
+	default: begin end
+	endcase
+
+	// Each lane of a packed write reaches the transmit FIFO in turn, from
+	// the bottom lane up, one per clock, and only the lanes selected
+	initial	f_txp_count = 2'b00;
+	always @(posedge i_clk)
+	if ((wb_stb)&&(i_wb_addr == UART_TXREG)&&(i_wb_we)&&(r_packed))
+	begin
+		f_txp_word  <= i_wb_data;
+		f_txp_sel   <= i_wb_sel;
+		f_txp_count <= 2'b00;
+	end else if (f_txp_count != 2'b11)
+		f_txp_count <= f_txp_count + 1'b1;
+
+	always @(*)
+	if (txp_sel != 4'h0)
+	begin
+		assert(txp_sel  == (f_txp_sel >> f_txp_count));
+		assert(txp_data == (f_txp_word >> (8*f_txp_count)));
+	end
+	// }}}
+	////////////////////////////////////////////////////////////////////////
+	//
+	// Cover checks
+	// {{{
+	////////////////////////////////////////////////////////////////////////
+	//
+	//
+	always @(posedge i_clk)
+	if ((OPT_PACKED)&&(f_past_valid)&&(!$past(i_reset)))
+	begin
+		// Packed reads of three bytes, and of a partial word of one
+		cover((r_rxp_read)&&(rxp_count == 2'b11));
+		cover((r_rxp_read)&&(rxp_count == 2'b01));
+
+		// A partial packed write, down to its last lane
+		cover((f_txp_sel == 4'h7)&&(f_txp_count == 2'b10)
+				&&(txp_sel == 4'h1));
+	end
+	// }}}
+	// }}}
+`endif
 endmodule